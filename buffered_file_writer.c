@@ -47,8 +47,31 @@ buffered_file_writer_free (buffered_file_writer_t *writer) {
     free (writer);
 }
 
+static int
+_grow (buffered_file_writer_t *writer, size_t size) {
+    size_t new_size = writer->size;
+    while (size > new_size - writer->written) {
+        new_size *= 2;
+    }
+    char *buffer = realloc (writer->buffer, new_size);
+    if (buffer == NULL) {
+        return -1;
+    }
+    writer->buffer = buffer;
+    writer->size = new_size;
+    return 0;
+}
+
 int
 buffered_file_writer_write (buffered_file_writer_t *writer, const void *bytes, size_t size) {
+    if (writer->fp == NULL) {
+        if (size > writer->size - writer->written && _grow (writer, size) < 0) {
+            return -1;
+        }
+        memcpy (writer->buffer + writer->written, bytes, size);
+        writer->written += size;
+        return 0;
+    }
     if (size > writer->size - writer->written) {
         int res = buffered_file_writer_flush (writer);
         if (res < 0) {
@@ -71,7 +94,7 @@ buffered_file_writer_write (buffered_file_writer_t *writer, const void *bytes, s
 
 int
 buffered_file_writer_flush (buffered_file_writer_t *writer) {
-    if (writer->written == 0) {
+    if (writer->written == 0 || writer->fp == NULL) {
         return 0;
     }
     size_t res = fwrite (writer->buffer, 1, writer->written, writer->fp);
@@ -81,3 +104,15 @@ buffered_file_writer_flush (buffered_file_writer_t *writer) {
     writer->written = 0;
     return 0;
 }
+
+int
+buffered_file_writer_write_to_file (buffered_file_writer_t *writer, FILE *fp) {
+    if (writer->written == 0) {
+        return 0;
+    }
+    size_t res = fwrite (writer->buffer, 1, writer->written, fp);
+    if (res != writer->written) {
+        return -1;
+    }
+    return 0;
+}
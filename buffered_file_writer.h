@@ -28,6 +28,9 @@
 
 typedef struct _buffered_file_writer_s buffered_file_writer_t;
 
+/// Create a writer, which writes to @c fp in chunks of @c buffer_size.
+/// If @c fp is NULL, all data is accumulated in memory, growing the buffer as needed,
+/// and can be written out later using @c buffered_file_writer_write_to_file.
 buffered_file_writer_t *
 buffered_file_writer_new (FILE *fp, size_t buffer_size);
 
@@ -40,4 +43,8 @@ buffered_file_writer_write (buffered_file_writer_t *writer, const void *bytes, s
 int
 buffered_file_writer_flush (buffered_file_writer_t *writer);
 
+/// Write all data accumulated by an in-memory writer to @c fp.
+int
+buffered_file_writer_write_to_file (buffered_file_writer_t *writer, FILE *fp);
+
 #endif /* buffered_file_writer_h */
@@ -99,7 +99,7 @@ extern "C" {
 // 0.1 -- deadbeef-0.2.0
 
 #define DB_API_VERSION_MAJOR 1
-#define DB_API_VERSION_MINOR 16
+#define DB_API_VERSION_MINOR 17
 
 #if defined(__clang__)
 
@@ -136,6 +136,12 @@ extern "C" {
 #define DDB_API_LEVEL DB_API_VERSION_MINOR
 #endif
 
+#if (DDB_WARN_DEPRECATED && DDB_API_LEVEL >= 17)
+#define DEPRECATED_117 DDB_DEPRECATED("since deadbeef API 1.17")
+#else
+#define DEPRECATED_117
+#endif
+
 #if (DDB_WARN_DEPRECATED && DDB_API_LEVEL >= 16)
 #define DEPRECATED_116 DDB_DEPRECATED("since deadbeef API 1.16")
 #else
@@ -797,6 +803,54 @@ typedef enum {
 } ddb_insert_file_flags_t;
 #endif
 
+#if (DDB_API_LEVEL >= 17)
+/// Task group priorities of the shared thread pool.
+/// Pending tasks of a higher priority group are always started first,
+/// groups of the same priority take turns.
+/// One worker is reserved for the high priority tasks, when the pool has more than one.
+typedef enum {
+    DDB_TASK_PRIORITY_HIGH = 0,
+    DDB_TASK_PRIORITY_NORMAL = 1,
+    DDB_TASK_PRIORITY_LOW = 2,
+    DDB_TASK_PRIORITY_COUNT
+} ddb_task_priority_t;
+
+/// Opaque task group. Each subsystem creates its own group, which bounds its concurrency,
+/// and allows to cancel and wait for all of its tasks at once.
+typedef struct ddb_task_group_s ddb_task_group_t;
+
+/// A sample of the streamer and output state, see @c streamer_telemetry_read.
+typedef struct {
+    int64_t time; // microseconds, monotonic clock
+    int blocks_ready; // decoded blocks waiting in the streamer buffer
+    int block_count; // total number of blocks in the streamer buffer
+    int output_buffer_bytes; // processed data waiting to be read by the output plugin
+    int is_buffering;
+    float decode_speed; // decoded duration of the streaming track divided by the decoding time, 0 if unknown
+    float dsp_time; // average DSP chain time per block since the previous sample, in seconds
+    int64_t underruns; // total number of output reads which got less data than requested
+    int64_t buffering_changes; // total number of buffering state changes
+} ddb_streamer_telemetry_t;
+
+/// Processing time statistics of a DSP in the streamer DSP chain, see @c dsp_get_profile.
+typedef struct {
+    struct DB_dsp_s *plugin;
+    int enabled;
+    int64_t blocks; // number of processed blocks
+    float mean_time; // microseconds per block
+    float p99_time; // microseconds per block, 99th percentile, approximate
+    float realtime_factor; // processing time divided by the duration of the processed audio
+} ddb_dsp_profile_t;
+
+/// Statistics of the search index of a playlist, see @c plt_get_search_index_stats.
+typedef struct {
+    int item_count;
+    int trigram_count;
+    size_t memory_size; // bytes
+    int64_t build_time_us; // time it took to index all the items at once
+} ddb_search_index_stats_t;
+#endif
+
 // forward decl for plugin struct
 struct DB_plugin_s;
 
@@ -1679,6 +1733,94 @@ typedef struct {
     /// since this function internally uses streamer_lock, which may cause a deadlock against pl_lock.
     ddb_playItem_t * (*streamer_get_playing_track_safe) (void);
 #endif
+
+#if (DDB_API_LEVEL >= 17)
+    /// Create a task group in the shared thread pool.
+    /// The pool workers run at low priority, and leave one core free for playback.
+    /// @param name Group name, for debugging.
+    /// @param priority One of @c ddb_task_priority_t values.
+    /// @param max_concurrency Max number of tasks of this group running at the same time, 0 means the number of pool workers.
+    /// @return The new group, which must be freed with @c task_group_free.
+    ddb_task_group_t *(*task_group_create) (const char *name, ddb_task_priority_t priority, int max_concurrency);
+
+    /// Cancel the group, wait for its tasks to finish, and free it.
+    void (*task_group_free) (ddb_task_group_t *group);
+
+    /// Add a task to the group.
+    /// Tasks are started in the order of submission, but may finish in any order.
+    /// @return 0 on success, -1 if the pool is shutting down (the task will not run).
+    int (*task_group_submit) (ddb_task_group_t *group, void (*fn)(void *ctx), void *ctx);
+
+    /// Set the cancellation flag of the group.
+    /// Pending tasks still run, and are expected to check @c task_group_is_cancelled and return early,
+    /// so that they can release their context.
+    void (*task_group_cancel) (ddb_task_group_t *group);
+
+    int (*task_group_is_cancelled) (ddb_task_group_t *group);
+
+    /// Wait until the group has no pending or running tasks.
+    /// Must not be called from a task of the same group.
+    void (*task_group_wait) (ddb_task_group_t *group);
+
+    /// Call @c fn for each index from 0 to count-1, using up to @c max_concurrency workers of the group.
+    /// The calling thread takes part in the loop, and the function returns when all iterations are done.
+    /// When the group has no free slots, e.g. when called from a task of the same group, the loop runs on the calling thread.
+    /// Remaining iterations are skipped if the group gets cancelled.
+    void (*task_parallel_for) (ddb_task_group_t *group, int count, void (*fn)(void *ctx, int index), void *ctx);
+
+    /// @return The number of worker threads in the shared thread pool.
+    int (*threadpool_get_worker_count) (void);
+
+    /// Register the magic bytes found at @c offset in the files supported by the decoder.
+    /// When adding files, decoders whose signature matches the file header are tried first,
+    /// regardless of the file extension.
+    /// Should be called from the plugin load function.
+    /// Signatures must fit in the first 64 bytes of the file, and be at most 16 bytes long.
+    /// @return 0 on success, -1 otherwise
+    int (*plug_register_decoder_signature) (struct DB_decoder_s *decoder, int offset, const char *magic, int size);
+
+    /// Output plugins can report the duration of the audio which was read from the streamer,
+    /// but not played yet, e.g. the device buffer and the sound server latency.
+    /// It's subtracted from the reported playback position.
+    /// Set to 0 when the output is stopped.
+    void (*streamer_set_output_latency) (float latency);
+
+    /// Get a read-only pointer to @c size bytes of the file at @c offset, without copying when possible.
+    /// Doesn't change the read position.
+    /// The pointer is valid until the next call on the same file, or until the file is closed.
+    /// @return NULL if the range is out of the file bounds, or the VFS plugin doesn't support this,
+    /// in which case the data should be read with @c fread.
+    const uint8_t *(*fget_region) (DB_FILE *stream, int64_t offset, int64_t size);
+
+    /// Read the streamer telemetry samples, which are recorded during playback
+    /// every @c streamer.telemetry_interval milliseconds (100 by default, 0 disables recording).
+    /// Only the most recent samples are kept.
+    /// Doesn't block the streamer, and can be called from any thread.
+    /// @param samples Array to copy the samples to, oldest first.
+    /// @param cursor The number of the first sample to copy, should be 0 for the first call.
+    /// Updated to continue from the next sample on the following call.
+    /// @return The number of samples copied.
+    int (*streamer_telemetry_read) (ddb_streamer_telemetry_t *samples, int count, uint64_t *cursor);
+
+    /// Write the recorded streamer telemetry to a tab-separated text file, one line per sample.
+    /// @return 0 on success, -1 on failure.
+    int (*streamer_telemetry_dump) (const char *fname);
+
+    /// Get the processing time statistics of the DSPs in the streamer DSP chain,
+    /// in the same order as returned by @c streamer_get_dsp_chain.
+    /// The statistics are reset when the DSP chain changes.
+    /// @param profile Array to fill, up to @c count entries.
+    /// @return The number of DSPs in the chain.
+    int (*dsp_get_profile) (ddb_dsp_profile_t *profile, int count);
+
+    void (*dsp_reset_profile) (void);
+
+    /// Get the statistics of the trigram search index of the playlist.
+    /// The index is built on the first search in a playlist with at least @c playlist.search_index_min_tracks tracks,
+    /// or with the @c search_index playlist property set.
+    /// @return 0 on success, -1 if the playlist has no search index.
+    int (*plt_get_search_index_stats) (ddb_playlist_t *plt, ddb_search_index_stats_t *stats);
+#endif
 } DB_functions_t;
 
 // NOTE: an item placement must be selected like this
@@ -1790,6 +1932,12 @@ enum {
 #if (DDB_API_LEVEL >= 15)
     DDB_PLUGIN_FLAG_ASYNC_STOP = 8,
 #endif
+
+#if (DDB_API_LEVEL >= 17)
+    // Tells that the decoder insert method can be called from multiple threads at the same time,
+    // e.g. when adding folders in parallel. Otherwise the calls are serialized.
+    DDB_PLUGIN_FLAG_CONCURRENT_INSERT = 16,
+#endif
 };
 #endif
 
@@ -1941,6 +2089,11 @@ enum {
     // Supposed to be used by converter, replaygain scanner, etc.
     DDB_DECODER_HINT_RAW_SIGNAL = 0x8,
 #endif
+#if (DDB_API_LEVEL >= 17)
+    // The stream is read as fast as possible, and not played back in real time, e.g. by converter or replaygain scanner.
+    // Decoders may use more memory and the shared thread pool to decode ahead when this flag is set.
+    DDB_DECODER_HINT_OFFLINE = 0x10,
+#endif
 };
 
 // decoder plugin
@@ -2010,7 +2163,31 @@ typedef struct ddb_decoder2_s {
     // if -1 is returned, that will mean that streamer must skip that song
     int (*seek_sample64) (DB_fileinfo_t *info, int64_t sample);
 
+#if (DDB_API_LEVEL >= 17)
+    // Optional seek checkpoints, for the formats which can't seek directly,
+    // e.g. VBR files without a seek table, or emulated formats.
+    // The streamer saves checkpoints periodically during playback, and restores the nearest one before seeking,
+    // so the following seek only needs to scan or decode forward from the checkpoint.
+    // Leave the 3 methods NULL if the plugin doesn't support checkpoints.
+
+    // Make a snapshot of the decoder state at the current read position.
+    // *sample receives the track sample which the checkpoint corresponds to,
+    // *size receives the memory size of the snapshot.
+    // The snapshot must be usable with any fileinfo of the same track opened by the plugin.
+    // Return NULL if a checkpoint can't be made at this time.
+    void *(*checkpoint_save) (DB_fileinfo_t *info, int64_t *sample, size_t *size);
+
+    // Restore the decoder state from the snapshot.
+    // The streamer calls seek_sample64 or seek after this, with a target at or after the checkpoint sample.
+    // return -1 if failed, or 0 on success
+    int (*checkpoint_restore) (DB_fileinfo_t *info, const void *checkpoint);
+
+    void (*checkpoint_free) (void *checkpoint);
+
+    void *padding[5];
+#else
     void *padding[8];
+#endif
 } ddb_decoder2_t;
 #endif
 
@@ -2161,6 +2338,14 @@ typedef struct DB_vfs_s {
     // Optional method to abort any file / stream operation on a file with specified identifier
     void (*abort_with_identifier) (uint64_t identifier);
 #endif
+
+#if (DDB_API_LEVEL >= 17)
+    // Optional method, which should return a read-only pointer to `size` bytes of the file at `offset`,
+    // e.g. from a memory mapping, without changing the read position.
+    // The pointer is valid until the next get_region call on the same file, or until the file is closed.
+    // Should return NULL if the range is out of the file bounds, or can't be accessed this way.
+    const uint8_t *(*get_region) (DB_FILE *f, int64_t offset, int64_t size);
+#endif
 } DB_vfs_t;
 
 // gui plugin
@@ -0,0 +1,381 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "decoderregistry.h"
+#include "plugins.h"
+#include "vfs.h"
+
+//#define trace(...) { fprintf(stderr, __VA_ARGS__); }
+#define trace(fmt,...)
+
+#define MAX_SIGNATURES 64
+#define MAX_SIGNATURE_SIZE 16
+
+typedef uint64_t decoder_mask_t;
+
+typedef struct {
+    char *ext; // lowercase, NULL in empty slots
+    decoder_mask_t mask;
+} ext_entry_t;
+
+typedef struct {
+    DB_decoder_t *decoder;
+    int offset;
+    int size;
+    uint8_t magic[MAX_SIGNATURE_SIZE];
+} signature_t;
+
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// state derived from the decoder list, valid while _built is set
+static int _built;
+static DB_decoder_t *_decoders[DECODER_REGISTRY_MAX_DECODERS];
+static int _decoder_count;
+static ext_entry_t *_ext_table;
+static int _ext_table_size;
+static decoder_mask_t _wildcard_mask;
+static decoder_mask_t _prefix_mask;
+
+static signature_t _signatures[MAX_SIGNATURES];
+static int _signature_count;
+
+// Serializes the insert calls of each decoder which doesn't support concurrent inserts.
+// The mutexes are recursive, since inserting a file may insert other files, e.g. from an archive.
+// The slots are kept until decoder_registry_free, and are not affected by rebuilding.
+typedef struct {
+    DB_decoder_t *decoder;
+    pthread_mutex_t mutex;
+} insert_lock_t;
+
+static insert_lock_t _insert_locks[DECODER_REGISTRY_MAX_DECODERS];
+static int _insert_lock_count;
+
+static uint32_t
+_hash (const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        uint8_t c = (uint8_t)*s;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        h = (h ^ c) * 16777619u;
+    }
+    return h;
+}
+
+static ext_entry_t *
+_ext_find (const char *ext) {
+    uint32_t mask = _ext_table_size - 1;
+    for (uint32_t i = _hash (ext) & mask; ; i = (i + 1) & mask) {
+        ext_entry_t *e = &_ext_table[i];
+        if (!e->ext || !strcasecmp (e->ext, ext)) {
+            return e;
+        }
+    }
+}
+
+static void
+_clear (void) {
+    for (int i = 0; i < _ext_table_size; i++) {
+        free (_ext_table[i].ext);
+    }
+    free (_ext_table);
+    _ext_table = NULL;
+    _ext_table_size = 0;
+    _decoder_count = 0;
+    _wildcard_mask = 0;
+    _prefix_mask = 0;
+    _built = 0;
+}
+
+static void
+_build (void) {
+    DB_decoder_t **decoders = plug_get_decoder_list ();
+
+    int ext_count = 0;
+    for (int i = 0; decoders[i] && i < DECODER_REGISTRY_MAX_DECODERS; i++) {
+        if (decoders[i]->exts) {
+            for (int e = 0; decoders[i]->exts[e]; e++) {
+                ext_count++;
+            }
+        }
+    }
+
+    _ext_table_size = 16;
+    while (_ext_table_size < ext_count * 2) {
+        _ext_table_size *= 2;
+    }
+    _ext_table = calloc (_ext_table_size, sizeof (ext_entry_t));
+
+    for (int i = 0; decoders[i]; i++) {
+        if (i >= DECODER_REGISTRY_MAX_DECODERS) {
+            trace ("decoder_registry: too many decoders, ignoring %s\n", decoders[i]->plugin.id);
+            break;
+        }
+        DB_decoder_t *dec = decoders[i];
+        _decoders[_decoder_count++] = dec;
+        if (!dec->insert) {
+            continue;
+        }
+        decoder_mask_t bit = (decoder_mask_t)1 << i;
+        if (dec->exts) {
+            for (int e = 0; dec->exts[e]; e++) {
+                if (!strcmp (dec->exts[e], "*")) {
+                    _wildcard_mask |= bit;
+                    continue;
+                }
+                ext_entry_t *entry = _ext_find (dec->exts[e]);
+                if (!entry->ext) {
+                    entry->ext = strdup (dec->exts[e]);
+                }
+                entry->mask |= bit;
+            }
+        }
+        if (dec->prefixes && dec->prefixes[0]) {
+            _prefix_mask |= bit;
+        }
+    }
+
+    _built = 1;
+}
+
+static int
+_decoder_index (DB_decoder_t *dec) {
+    for (int i = 0; i < _decoder_count; i++) {
+        if (_decoders[i] == dec) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int
+_prefix_matches (DB_decoder_t *dec, const char *fn) {
+    for (int e = 0; dec->prefixes[e]; e++) {
+        size_t l = strlen (dec->prefixes[e]);
+        if (!strncasecmp (dec->prefixes[e], fn, l) && fn[l] == '.') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns the size of the ID3v2 tag at the start of the header, or 0 if there's none
+static int64_t
+_id3v2_size (const uint8_t *header, int len) {
+    if (len < 10 || memcmp (header, "ID3", 3) || header[3] == 0xff || header[4] == 0xff) {
+        return 0;
+    }
+    for (int i = 6; i < 10; i++) {
+        if (header[i] & 0x80) {
+            return 0;
+        }
+    }
+    int64_t size = 10 + (((int64_t)header[6] << 21) | (header[7] << 14) | (header[8] << 7) | header[9]);
+    if (header[5] & 0x10) {
+        size += 10; // footer
+    }
+    return size;
+}
+
+// Reads just enough of the file to check all registered signatures.
+// The signatures are matched after the ID3v2 tag, which may precede the data of any format.
+static int
+_read_header (const char *fname, uint8_t *header, int size) {
+    DB_FILE *fp = vfs_fopen (fname);
+    if (!fp) {
+        return 0;
+    }
+    // enough for the ID3v2 header
+    size_t rb = vfs_fread (header, 1, size < 10 ? 10 : size, fp);
+    int64_t skip = _id3v2_size (header, (int)rb);
+    if (skip > 0) {
+        rb = 0;
+        if (vfs_fseek (fp, skip, SEEK_SET) == 0) {
+            rb = vfs_fread (header, 1, size, fp);
+        }
+    }
+    vfs_fclose (fp);
+    return (int)rb;
+}
+
+// Must be called with the lock held
+static decoder_mask_t
+_candidate_mask (const char *fn, const char *ext) {
+    if (!_built) {
+        _build ();
+    }
+    decoder_mask_t mask = _wildcard_mask;
+    if (*ext) {
+        mask |= _ext_find (ext)->mask;
+    }
+    for (decoder_mask_t m = _prefix_mask; m; m &= m - 1) {
+        int i = __builtin_ctzll (m);
+        if (_prefix_matches (_decoders[i], fn)) {
+            mask |= (decoder_mask_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+int
+decoder_registry_find (const char *fname, DB_decoder_t **decoders) {
+    const char *fn = strrchr (fname, '/');
+    fn = fn ? fn + 1 : fname;
+    const char *ext = strrchr (fname, '.');
+    ext = ext ? ext + 1 : "";
+
+    // The file is only sniffed when the name doesn't identify a single decoder,
+    // i.e. the extension is unknown, or claimed by several decoders.
+    int header_size = 0;
+    pthread_mutex_lock (&_mutex);
+    decoder_mask_t specific = _candidate_mask (fn, ext) & ~_wildcard_mask;
+    if (specific == 0 || (specific & (specific - 1)) != 0) {
+        for (int s = 0; s < _signature_count; s++) {
+            int end = _signatures[s].offset + _signatures[s].size;
+            if (end > header_size) {
+                header_size = end;
+            }
+        }
+    }
+    pthread_mutex_unlock (&_mutex);
+
+    // Only local files are sniffed, since opening a remote file may be expensive.
+    // The file is read without holding the lock.
+    uint8_t header[DECODER_REGISTRY_MAX_SIGNATURE_END];
+    int header_len = 0;
+    if (header_size > 0 && plug_is_local_file (fname)) {
+        header_len = _read_header (fname, header, header_size);
+    }
+
+    pthread_mutex_lock (&_mutex);
+    decoder_mask_t mask = _candidate_mask (fn, ext);
+    decoder_mask_t sniffed = 0;
+    for (int s = 0; s < _signature_count; s++) {
+        signature_t *sig = &_signatures[s];
+        if (sig->offset + sig->size > header_len || memcmp (header + sig->offset, sig->magic, sig->size)) {
+            continue;
+        }
+        int i = _decoder_index (sig->decoder);
+        if (i >= 0 && sig->decoder->insert) {
+            sniffed |= (decoder_mask_t)1 << i;
+        }
+    }
+
+    // decoders which recognized the content go first, then the rest in the decoder list order
+    int count = 0;
+    for (decoder_mask_t m = sniffed; m; m &= m - 1) {
+        decoders[count++] = _decoders[__builtin_ctzll (m)];
+    }
+    for (decoder_mask_t m = mask & ~sniffed; m; m &= m - 1) {
+        decoders[count++] = _decoders[__builtin_ctzll (m)];
+    }
+    pthread_mutex_unlock (&_mutex);
+
+    return count;
+}
+
+void
+decoder_registry_invalidate (void) {
+    pthread_mutex_lock (&_mutex);
+    _clear ();
+    pthread_mutex_unlock (&_mutex);
+}
+
+int
+decoder_registry_add_signature (DB_decoder_t *decoder, int offset, const char *magic, int size) {
+    if (offset < 0 || size <= 0 || size > MAX_SIGNATURE_SIZE || offset + size > DECODER_REGISTRY_MAX_SIGNATURE_END) {
+        return -1;
+    }
+    pthread_mutex_lock (&_mutex);
+    if (_signature_count >= MAX_SIGNATURES) {
+        pthread_mutex_unlock (&_mutex);
+        return -1;
+    }
+    signature_t *sig = &_signatures[_signature_count++];
+    sig->decoder = decoder;
+    sig->offset = offset;
+    sig->size = size;
+    memcpy (sig->magic, magic, size);
+    pthread_mutex_unlock (&_mutex);
+    return 0;
+}
+
+static pthread_mutex_t *
+_get_insert_lock (DB_decoder_t *decoder) {
+    pthread_mutex_t *res = NULL;
+    pthread_mutex_lock (&_mutex);
+    for (int i = 0; i < _insert_lock_count; i++) {
+        if (_insert_locks[i].decoder == decoder) {
+            res = &_insert_locks[i].mutex;
+            break;
+        }
+    }
+    if (!res && _insert_lock_count < DECODER_REGISTRY_MAX_DECODERS) {
+        insert_lock_t *lock = &_insert_locks[_insert_lock_count++];
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init (&attr);
+        pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init (&lock->mutex, &attr);
+        pthread_mutexattr_destroy (&attr);
+        lock->decoder = decoder;
+        res = &lock->mutex;
+    }
+    pthread_mutex_unlock (&_mutex);
+    return res;
+}
+
+DB_playItem_t *
+decoder_registry_insert (DB_decoder_t *decoder, ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
+    if (decoder->plugin.flags & DDB_PLUGIN_FLAG_CONCURRENT_INSERT) {
+        return decoder->insert (plt, after, fname);
+    }
+
+    pthread_mutex_t *lock = _get_insert_lock (decoder);
+    if (lock) {
+        pthread_mutex_lock (lock);
+    }
+    DB_playItem_t *it = decoder->insert (plt, after, fname);
+    if (lock) {
+        pthread_mutex_unlock (lock);
+    }
+    return it;
+}
+
+void
+decoder_registry_free (void) {
+    pthread_mutex_lock (&_mutex);
+    _clear ();
+    _signature_count = 0;
+    for (int i = 0; i < _insert_lock_count; i++) {
+        pthread_mutex_destroy (&_insert_locks[i].mutex);
+    }
+    _insert_lock_count = 0;
+    pthread_mutex_unlock (&_mutex);
+}
@@ -0,0 +1,63 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef decoderregistry_h
+#define decoderregistry_h
+
+#include "deadbeef.h"
+
+// Maps file names to the decoders which may be able to open them.
+// Extensions are looked up in a hash table built from the decoder list,
+// instead of comparing against every extension of every decoder.
+// Decoders may also register magic byte signatures, which allows to try the
+// right decoder first, and to open files with a wrong or misleading extension.
+// The files are only sniffed when the extension is unknown, or shared by several decoders.
+// The registry is rebuilt lazily after decoder_registry_invalidate.
+
+#define DECODER_REGISTRY_MAX_DECODERS 64
+#define DECODER_REGISTRY_MAX_SIGNATURE_END 64
+
+// Fills the decoders array with the candidates for the file, in the order they should be tried.
+// The array must have room for DECODER_REGISTRY_MAX_DECODERS entries.
+// Returns the number of candidates.
+int
+decoder_registry_find (const char *fname, DB_decoder_t **decoders);
+
+// Must be called after the decoder list, or the extensions of any decoder, change
+void
+decoder_registry_invalidate (void);
+
+// Registers the bytes at the given offset in the file header, which identify the format supported by the decoder.
+// Returns 0 on success, -1 if the signature is out of the supported range.
+int
+decoder_registry_add_signature (DB_decoder_t *decoder, int offset, const char *magic, int size);
+
+// Calls the insert method of the decoder.
+// The calls are serialized per decoder, unless the decoder has DDB_PLUGIN_FLAG_CONCURRENT_INSERT.
+DB_playItem_t *
+decoder_registry_insert (DB_decoder_t *decoder, ddb_playlist_t *plt, DB_playItem_t *after, const char *fname);
+
+void
+decoder_registry_free (void);
+
+#endif /* decoderregistry_h */
@@ -33,6 +33,23 @@
 #include "plugins.h"
 #include "conf.h"
 #include "premix.h"
+#include "streamertelemetry.h"
+
+// Profiling of the DSPs in the current chain, by position.
+// The block processing times are counted in a histogram with 4 buckets per octave,
+// from 1us to 2^24us, which is enough to find p99 with 20% precision.
+#define MAX_PROFILED_DSPS 32
+#define PROFILE_BUCKETS_PER_OCTAVE 4
+#define PROFILE_BUCKETS (24 * PROFILE_BUCKETS_PER_OCTAVE)
+
+typedef struct {
+    int64_t blocks;
+    int64_t total_time; // microseconds
+    double total_duration; // seconds of processed audio
+    uint32_t histogram[PROFILE_BUCKETS];
+} dsp_profile_t;
+
+static dsp_profile_t _profile[MAX_PROFILED_DSPS];
 
 static ddb_dsp_context_t *_current_dsp_chain;
 static DB_dsp_t *_eqplug;
@@ -114,6 +131,80 @@ free_dsp_buffers (void) {
     ensure_dsp_temp_buffer (0);
 }
 
+static int
+_profile_bucket (int64_t time) {
+    uint64_t t = time + 1;
+    int octave = 63 - __builtin_clzll (t);
+    int sub = octave >= 2 ? (int)((t >> (octave - 2)) & 3) : 0;
+    int bucket = octave * PROFILE_BUCKETS_PER_OCTAVE + sub;
+    return bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1;
+}
+
+// The largest time which falls into the bucket
+static float
+_profile_bucket_time (int bucket) {
+    int octave = bucket / PROFILE_BUCKETS_PER_OCTAVE;
+    int sub = bucket % PROFILE_BUCKETS_PER_OCTAVE;
+    if (octave < 2) {
+        return (float)((2 << octave) - 2);
+    }
+    return (float)(((int64_t)(4 + sub + 1) << (octave - 2)) - 2);
+}
+
+static void
+_profile_add (int idx, int64_t time, double duration) {
+    if (idx >= MAX_PROFILED_DSPS) {
+        return;
+    }
+    dsp_profile_t *p = &_profile[idx];
+    p->blocks++;
+    p->total_time += time;
+    p->total_duration += duration;
+    p->histogram[_profile_bucket (time)]++;
+}
+
+void
+dsp_reset_profile (void) {
+    streamer_lock ();
+    memset (_profile, 0, sizeof (_profile));
+    streamer_unlock ();
+}
+
+int
+dsp_get_profile (ddb_dsp_profile_t *profile, int count) {
+    streamer_lock ();
+    int idx = 0;
+    for (ddb_dsp_context_t *dsp = _current_dsp_chain; dsp; dsp = dsp->next, idx++) {
+        if (idx >= count) {
+            continue;
+        }
+        ddb_dsp_profile_t *out = &profile[idx];
+        memset (out, 0, sizeof (ddb_dsp_profile_t));
+        out->plugin = dsp->plugin;
+        out->enabled = dsp->enabled;
+        if (idx >= MAX_PROFILED_DSPS || !_profile[idx].blocks) {
+            continue;
+        }
+        dsp_profile_t *p = &_profile[idx];
+        out->blocks = p->blocks;
+        out->mean_time = (float)((double)p->total_time / p->blocks);
+        if (p->total_duration > 0) {
+            out->realtime_factor = (float)(p->total_time / 1000000.0 / p->total_duration);
+        }
+        int64_t p99_count = p->blocks - p->blocks / 100;
+        int64_t n = 0;
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            n += p->histogram[b];
+            if (n >= p99_count) {
+                out->p99_time = _profile_bucket_time (b);
+                break;
+            }
+        }
+    }
+    streamer_unlock ();
+    return idx;
+}
+
 ddb_dsp_context_t *
 streamer_get_dsp_chain (void) {
     return _current_dsp_chain;
@@ -291,6 +382,9 @@ streamer_dsp_chain_save (void) {
 
 void
 streamer_dsp_postinit (void) {
+    // the chain has changed, the positions don't match anymore
+    memset (_profile, 0, sizeof (_profile));
+
     // note about EQ hack:
     // we 1st check if there's an EQ in dsp chain, and just use it
     // if not -- we add our own
@@ -443,13 +537,18 @@ dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize,
     ddb_dsp_context_t *dsp = _current_dsp_chain;
     float ratio = 1.f;
     int maxframes = tempbuf_size / dspsamplesize;
+    int idx = 0;
     while (dsp) {
         if (dsp->enabled) {
             float r = 1;
+            double duration = dspfmt.samplerate > 0 ? (double)nframes / dspfmt.samplerate : 0;
+            int64_t start = streamer_telemetry_time ();
             nframes = dsp->plugin->process (dsp, (float *)tempbuf, nframes, maxframes, &dspfmt, &r);
+            _profile_add (idx, streamer_telemetry_time () - start, duration);
             ratio *= r;
         }
         dsp = dsp->next;
+        idx++;
     }
 
     *out_dsp_ratio = ratio;
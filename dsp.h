@@ -63,6 +63,14 @@ int
 dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize,
            ddb_waveformat_t *out_fmt, char **out_bytes, int *out_numbytes, float *out_dsp_ratio);
 
+// Processing time statistics of the DSPs in the current chain, which are reset when the chain changes.
+// Fills up to count entries, and returns the number of DSPs in the chain.
+int
+dsp_get_profile (ddb_dsp_profile_t *profile, int count);
+
+void
+dsp_reset_profile (void);
+
 void
 dsp_get_output_format (ddb_waveformat_t *in_fmt, ddb_waveformat_t *out_fmt);
 
@@ -0,0 +1,88 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "dspkernels.h"
+
+void
+dsp_kernel_scale_float (float *samples, int count, float gain) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 g = _mm_set1_ps (gain);
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_loadu_ps (samples + i);
+        __m128 b = _mm_loadu_ps (samples + i + 4);
+        _mm_storeu_ps (samples + i, _mm_mul_ps (a, g));
+        _mm_storeu_ps (samples + i + 4, _mm_mul_ps (b, g));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vld1q_f32 (samples + i);
+        float32x4_t b = vld1q_f32 (samples + i + 4);
+        vst1q_f32 (samples + i, vmulq_n_f32 (a, gain));
+        vst1q_f32 (samples + i + 4, vmulq_n_f32 (b, gain));
+    }
+#endif
+    for (; i < count; i++) {
+        samples[i] *= gain;
+    }
+}
+
+void
+dsp_kernel_scale_clamp_float (float *samples, int count, float gain) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 g = _mm_set1_ps (gain);
+    const __m128 hi = _mm_set1_ps (1.f);
+    const __m128 lo = _mm_set1_ps (-1.f);
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps (_mm_loadu_ps (samples + i), g);
+        __m128 b = _mm_mul_ps (_mm_loadu_ps (samples + i + 4), g);
+        _mm_storeu_ps (samples + i, _mm_max_ps (_mm_min_ps (a, hi), lo));
+        _mm_storeu_ps (samples + i + 4, _mm_max_ps (_mm_min_ps (b, hi), lo));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t hi = vdupq_n_f32 (1.f);
+    const float32x4_t lo = vdupq_n_f32 (-1.f);
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vmulq_n_f32 (vld1q_f32 (samples + i), gain);
+        float32x4_t b = vmulq_n_f32 (vld1q_f32 (samples + i + 4), gain);
+        vst1q_f32 (samples + i, vmaxq_f32 (vminq_f32 (a, hi), lo));
+        vst1q_f32 (samples + i + 4, vmaxq_f32 (vminq_f32 (b, hi), lo));
+    }
+#endif
+    for (; i < count; i++) {
+        float sample = samples[i] * gain;
+        if (sample > 1.f) {
+            sample = 1.f;
+        }
+        else if (sample < -1.f) {
+            sample = -1.f;
+        }
+        samples[i] = sample;
+    }
+}
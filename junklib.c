@@ -176,7 +176,7 @@ const char *ddb_internal_rg_keys[] = {
 static const char wmp_popm_email[] = "Windows Media Player 9 Series";
 
 static inline uint32_t
-extract_i32_le (unsigned char *buf)
+extract_i32_le (const unsigned char *buf)
 {
     uint32_t x;
     // little endian extract
@@ -1225,19 +1225,43 @@ junk_id3v1_read_int (playItem_t *it, char *buffer, const char **charset) {
     return 0;
 }
 
+// Returns the `size` bytes at `offset`, directly from the file data when the vfs supports it,
+// otherwise reads them into the buffer.
+// The read position is left right after the data, same as after fread.
+static const uint8_t *
+junk_read_at (DB_FILE *fp, int64_t offset, uint8_t *buffer, int64_t size) {
+    if (offset < 0) {
+        return NULL;
+    }
+    const uint8_t *data = deadbeef->fget_region (fp, offset, size);
+    if (data) {
+        if (deadbeef->fseek (fp, offset + size, SEEK_SET) == -1) {
+            return NULL;
+        }
+        return data;
+    }
+    if (!buffer) {
+        return NULL;
+    }
+    if (deadbeef->fseek (fp, offset, SEEK_SET) == -1) {
+        return NULL;
+    }
+    if (deadbeef->fread (buffer, 1, size, fp) != size) {
+        return NULL;
+    }
+    return buffer;
+}
+
 // should read both id3v1 and id3v1.1
 int
 junk_id3v1_read (playItem_t *it, DB_FILE *fp) {
-    uint8_t id3[128];
-
-    if (deadbeef->fseek (fp, -128, SEEK_END) == -1) {
-        return -1;
-    }
-    if (deadbeef->fread (id3, 1, 128, fp) != 128) {
+    uint8_t buffer[128];
+    const uint8_t *id3 = junk_read_at (fp, deadbeef->fgetlength (fp) - 128, buffer, 128);
+    if (!id3) {
         return -1;
     }
 
-    return junk_id3v1_read_int (it, id3, NULL);
+    return junk_id3v1_read_int (it, (char *)id3, NULL);
 }
 
 
@@ -1433,13 +1457,11 @@ junk_id3v1_write (FILE *fp, playItem_t *it, const char *enc) {
 int64_t
 junk_id3v1_find2 (DB_FILE *fp) {
     uint8_t buffer[3];
-    if (deadbeef->fseek (fp, -128, SEEK_END) == -1) {
-        return -1;
-    }
-    if (deadbeef->fread (buffer, 1, 3, fp) != 3) {
+    const uint8_t *tag = junk_read_at (fp, deadbeef->fgetlength (fp) - 128, buffer, 3);
+    if (!tag) {
         return -1;
     }
-    if (memcmp (buffer, "TAG", 3)) {
+    if (memcmp (tag, "TAG", 3)) {
         return -1; // no tag
     }
     return deadbeef->ftell (fp) - 3;
@@ -1455,28 +1477,38 @@ junk_id3v1_find (DB_FILE *fp) {
     return (int)pos;
 }
 
-int64_t
-junk_apev2_find2 (DB_FILE *fp, int32_t *psize, uint32_t *pflags, uint32_t *pnumitems) {
-    uint8_t header[32];
-    if (deadbeef->fseek (fp, -32, SEEK_END) == -1) {
-        return -1; // something bad happened
+// Reads the APEv2 footer, which is either at the end of the file, or right before id3v1.
+// The read position is left right after the footer.
+static const uint8_t *
+junk_apev2_read_footer (DB_FILE *fp, uint8_t *buffer) {
+    int64_t length = deadbeef->fgetlength (fp);
+    if (length < 0) {
+        return NULL; // something bad happened
     }
-
-    if (deadbeef->fread (header, 1, 32, fp) != 32) {
-        return -1; // something bad happened
+    const uint8_t *header = junk_read_at (fp, length - 32, buffer, 32);
+    if (!header) {
+        return NULL; // something bad happened
     }
-    if (strncmp (header, "APETAGEX", 8)) {
+    if (memcmp (header, "APETAGEX", 8)) {
         // try to skip 128 bytes backwards (id3v1)
-        if (deadbeef->fseek (fp, -128-32, SEEK_END) == -1) {
-            return -1; // something bad happened
-        }
-        if (deadbeef->fread (header, 1, 32, fp) != 32) {
-            return -1; // something bad happened
+        header = junk_read_at (fp, length - 128 - 32, buffer, 32);
+        if (!header) {
+            return NULL; // something bad happened
         }
-        if (strncmp (header, "APETAGEX", 8)) {
-            return -1; // no ape tag here
+        if (memcmp (header, "APETAGEX", 8)) {
+            return NULL; // no ape tag here
         }
     }
+    return header;
+}
+
+int64_t
+junk_apev2_find2 (DB_FILE *fp, int32_t *psize, uint32_t *pflags, uint32_t *pnumitems) {
+    uint8_t buffer[32];
+    const uint8_t *header = junk_apev2_read_footer (fp, buffer);
+    if (!header) {
+        return -1;
+    }
 
     // FIXME: version needs to be checked?
     uint32_t version = extract_i32_le (&header[8]);
@@ -1628,37 +1660,17 @@ junk_apev2_add_frame (playItem_t *it, DB_apev2_tag_t *tag_store, DB_apev2_frame_
     return 0;
 }
 
-int
-junk_apev2_read_full_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem, int memsize) {
-    char *end = mem+memsize;
 #define STEP(x,y) {mem+=(x);if(mem+(y)>end) {trace ("fail %d\n", (x));return -1;}}
 
-    char *header = mem;
-
+// Parses the items of APEv2 tag, the memory must include the footer
+static int
+junk_apev2_read_items_mem (playItem_t *it, DB_apev2_tag_t *tag_store, const char *mem, const char *end, uint32_t numitems) {
     DB_apev2_frame_t *tail = NULL;
 
-    // FIXME: version needs to be checked?
-    uint32_t version = extract_i32_le (&header[0]);
-    int32_t size = extract_i32_le (&header[4]);
-    uint32_t numitems = extract_i32_le (&header[8]);
-    uint32_t flags = extract_i32_le (&header[12]);
-#pragma unused(version)
-#pragma unused(size)
-#pragma unused(flags)
-
-    trace ("APEv%d, size=%d, items=%d, flags=%x\n", version, size, numitems, flags);
-    if (it) {
-        uint32_t f = pl_get_item_flags (it);
-        f |= DDB_TAG_APEV2;
-        pl_set_item_flags (it, f);
-    }
-
-    STEP(24, 8);
-
     int i;
     for (i = 0; i < numitems; i++) {
         trace ("reading item %d\n", i);
-        uint8_t *buffer = mem;
+        const uint8_t *buffer = (const uint8_t *)mem;
 
         uint32_t itemsize = extract_i32_le (&buffer[0]);
         uint32_t itemflags = extract_i32_le (&buffer[4]);
@@ -1707,6 +1719,33 @@ junk_apev2_read_full_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem,
     return 0;
 }
 
+int
+junk_apev2_read_full_mem (playItem_t *it, DB_apev2_tag_t *tag_store, char *mem, int memsize) {
+    char *end = mem+memsize;
+
+    char *header = mem;
+
+    // FIXME: version needs to be checked?
+    uint32_t version = extract_i32_le (&header[0]);
+    int32_t size = extract_i32_le (&header[4]);
+    uint32_t numitems = extract_i32_le (&header[8]);
+    uint32_t flags = extract_i32_le (&header[12]);
+#pragma unused(version)
+#pragma unused(size)
+#pragma unused(flags)
+
+    trace ("APEv%d, size=%d, items=%d, flags=%x\n", version, size, numitems, flags);
+    if (it) {
+        uint32_t f = pl_get_item_flags (it);
+        f |= DDB_TAG_APEV2;
+        pl_set_item_flags (it, f);
+    }
+
+    STEP(24, 8);
+
+    return junk_apev2_read_items_mem (it, tag_store, mem, end, numitems);
+}
+
 int
 junk_apev2_read_full (playItem_t *it, DB_apev2_tag_t *tag_store, DB_FILE *fp) {
     // try to read footer, position must be already at the EOF right before
@@ -1714,25 +1753,10 @@ junk_apev2_read_full (playItem_t *it, DB_apev2_tag_t *tag_store, DB_FILE *fp) {
 
     DB_apev2_frame_t *tail = NULL;
 
-    uint8_t header[32];
-    if (deadbeef->fseek (fp, -32, SEEK_END) == -1) {
-        return -1; // something bad happened
-    }
-
-    if (deadbeef->fread (header, 1, 32, fp) != 32) {
-        return -1; // something bad happened
-    }
-    if (strncmp (header, "APETAGEX", 8)) {
-        // try to skip 128 bytes backwards (id3v1)
-        if (deadbeef->fseek (fp, -128-32, SEEK_END) == -1) {
-            return -1; // something bad happened
-        }
-        if (deadbeef->fread (header, 1, 32, fp) != 32) {
-            return -1; // something bad happened
-        }
-        if (strncmp (header, "APETAGEX", 8)) {
-            return -1; // no ape tag here
-        }
+    uint8_t buffer[32];
+    const uint8_t *header = junk_apev2_read_footer (fp, buffer);
+    if (!header) {
+        return -1;
     }
 
     // end of footer must be 0
@@ -1756,6 +1780,12 @@ junk_apev2_read_full (playItem_t *it, DB_apev2_tag_t *tag_store, DB_FILE *fp) {
         pl_set_item_flags (it, f);
     }
 
+    // parse the whole tag in memory, if the vfs can provide it without reading
+    const uint8_t *items = deadbeef->fget_region (fp, deadbeef->ftell (fp) - size, size);
+    if (items) {
+        return junk_apev2_read_items_mem (it, tag_store, (const char *)items, (const char *)items + size, numitems);
+    }
+
     // now seek to beginning of the tag (exluding header)
     if (deadbeef->fseek (fp, -size, SEEK_CUR) == -1) {
         trace ("failed to seek to tag start (-%d)\n", size);
@@ -4301,13 +4331,25 @@ junk_id3v2_read_full (playItem_t *it, DB_id3v2_tag_t *tag_store, DB_FILE *fp) {
     // remove unsync flag
     tag_store->flags &= ~ (1<<7);
 
-    uint8_t *tag = malloc (size);
-    if (!tag) {
-        fprintf (stderr, "junklib: out of memory while reading id3v2, tried to alloc %d bytes\n", size);
-        goto error;
+    // the frames are parsed directly from the file data, if the vfs can provide it,
+    // except for the unsynchronized tags, which are modified in place
+    uint8_t *tag = NULL;
+    uint8_t *tag_mem = NULL;
+    if (!unsync) {
+        tag = (uint8_t *)deadbeef->fget_region (fp, 10, size);
+    }
+    if (tag) {
+        deadbeef->fseek (fp, 10 + size, SEEK_SET);
     }
-    if (deadbeef->fread (tag, 1, size, fp) != size) {
-        goto error; // bad size
+    else {
+        tag = tag_mem = malloc (size);
+        if (!tag) {
+            fprintf (stderr, "junklib: out of memory while reading id3v2, tried to alloc %d bytes\n", size);
+            goto error;
+        }
+        if (deadbeef->fread (tag, 1, size, fp) != size) {
+            goto error; // bad size
+        }
     }
     uint8_t *readptr = tag;
     trace ("version: 2.%d.%d, unsync: %d, extheader: %d, experimental: %d\n", version_major, version_minor, unsync, extheader, expindicator);
@@ -4561,8 +4603,8 @@ error:
         trace ("error parsing id3v2\n");
     }
 
-    if (tag) {
-        free (tag);
+    if (tag_mem) {
+        free (tag_mem);
     }
     if (tag_store && err != 0) {
         while (tag_store->frames) {
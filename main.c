@@ -74,6 +74,7 @@
 #include "playlist.h"
 #include "threading.h"
 #include "messagepump.h"
+#include "threadpool.h"
 #include "streamer.h"
 #include "playmodes.h"
 #include "conf.h"
@@ -81,6 +82,7 @@
 #include "plugins.h"
 #include "common.h"
 #include "junklib.h"
+#include "decoderregistry.h"
 #ifdef OSX_APPBUNDLE
 #include "cocoautil.h"
 #endif
@@ -892,6 +894,8 @@ player_mainloop (void) {
                     streamer_configchanged ();
                     pl_configchanged ();
                     junk_configchanged ();
+                    // decoders may have updated their extension lists
+                    decoder_registry_invalidate ();
                     break;
                 case DB_EV_SEEK:
                     {
@@ -1039,6 +1043,7 @@ main_cleanup_and_quit (void) {
     }
 
     // save config
+    pl_wait_background_load ();
     pl_save_all ();
     conf_save ();
 
@@ -1059,6 +1064,7 @@ main_cleanup_and_quit (void) {
     plug_disconnect_all ();
     plug_unload_all (^{
         // at this point we can simply do exit(0), but let's clean up for debugging
+        threadpool_free ();
         pl_free (); // may access conf_*
         conf_free ();
 
@@ -1489,6 +1495,7 @@ main (int argc, char *argv[]) {
     }
 
     messagepump_init (); // required to push messages while handling commandline
+    threadpool_init ();
     if (plug_load_all ()) { // required to add files to playlist from commandline
         exit (-1);
     }
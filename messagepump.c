@@ -27,27 +27,58 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include "messagepump.h"
-#include "threading.h"
 #include "playlist.h"
 #include "common.h"
 
+// The queue is an intrusive multi-producer single-consumer list (Dmitry Vyukov's algorithm):
+// producers only swap the head pointer and link the previous node, the consumer owns the tail.
+// Nodes are allocated per message, so the queue never fills up.
 typedef struct message_s {
     uint32_t id;
     uintptr_t ctx;
     uint32_t p1;
     uint32_t p2;
+    int coalesce_slot;
     struct message_s *next;
 } message_t;
 
-enum { MAX_MESSAGES = 100 };
-static message_t pool[MAX_MESSAGES];
-static message_t *mfree;
-static message_t *mqueue;
-static message_t *mqtail;
-static uintptr_t mutex;
-static uintptr_t cond;
+// Pure "something changed" notifications without payload can be coalesced:
+// while such a message is still in the queue, identical messages are not added again.
+// The consumer clears the pending flag before delivering the message, so the state it observes
+// includes all the changes which were coalesced into it.
+enum {
+    COALESCE_PLAYLISTCHANGED_FIRST = 0,
+    COALESCE_PLAYLISTCHANGED_COUNT = 8,
+    COALESCE_CONFIGCHANGED = COALESCE_PLAYLISTCHANGED_FIRST + COALESCE_PLAYLISTCHANGED_COUNT,
+    COALESCE_PLAYLISTSWITCHED,
+    COALESCE_VOLUMECHANGED,
+    COALESCE_SLOT_COUNT
+};
+
+static message_t _stub;
+static message_t *_head = &_stub; // last pushed node, swapped by producers
+static message_t *_tail = &_stub; // next node to pop, owned by the consumer
+static int _pending_coalesce[COALESCE_SLOT_COUNT];
+
+static messagepump_stats_t _stats;
+static int64_t _queued;
+
+// only used for sleeping in messagepump_wait
+static pthread_mutex_t _wait_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _wait_cond = PTHREAD_COND_INITIALIZER;
+static int _waiting;
+
+// Consumer only: the message count seen by messagepump_pop when it couldn't pop a node,
+// because a producer was in the middle of linking it.
+// The producer increments the count after linking, which is what messagepump_wait waits for.
+static int64_t _stalled_queued;
+
+// messagepump_wait yields this many times before sleeping, since a stalled producer is normally a few instructions away
+#define WAIT_SPIN_COUNT 64
 
 static void
 messagepump_reset (void);
@@ -55,17 +86,17 @@ messagepump_reset (void);
 int
 messagepump_init (void) {
     messagepump_reset ();
-    mutex = mutex_create ();
-    cond = cond_create ();
     return 0;
 }
 
+static message_t *
+_pop_node (void);
+
 void
 messagepump_free () {
-    mutex_lock (mutex);
-
     // this helps catching any ref leaks caused by messages sent at exit
-    for (message_t *m = mqueue; m; m = m->next) {
+    message_t *m;
+    while ((m = _pop_node ())) {
         switch (m->id) {
         case DB_EV_SONGCHANGED:
         case DB_EV_SONGSTARTED:
@@ -75,88 +106,174 @@ messagepump_free () {
         case DB_EV_SEEKED:
             assert (0);
         }
+        free (m);
     }
 
     messagepump_reset ();
-    mutex_unlock (mutex);
-    mutex_free (mutex);
-    cond_free (cond);
 }
 
 static void
 messagepump_reset (void) {
-    mqueue = NULL;
-    mfree = NULL;
-    mqtail = NULL;
-    memset (pool, 0, sizeof (pool));
-    for (int i = 0; i < MAX_MESSAGES; i++) {
-        pool[i].next = mfree;
-        mfree = &pool[i];
+    memset (&_stub, 0, sizeof (_stub));
+    _head = &_stub;
+    _tail = &_stub;
+    memset (_pending_coalesce, 0, sizeof (_pending_coalesce));
+    memset (&_stats, 0, sizeof (_stats));
+    _queued = 0;
+    _stalled_queued = 0;
+}
+
+static int
+_coalesce_slot (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    if (ctx || p2) {
+        return -1;
+    }
+    switch (id) {
+    case DB_EV_PLAYLISTCHANGED:
+        return p1 < COALESCE_PLAYLISTCHANGED_COUNT ? COALESCE_PLAYLISTCHANGED_FIRST + (int)p1 : -1;
+    case DB_EV_CONFIGCHANGED:
+        return p1 == 0 ? COALESCE_CONFIGCHANGED : -1;
+    case DB_EV_PLAYLISTSWITCHED:
+        return p1 == 0 ? COALESCE_PLAYLISTSWITCHED : -1;
+    case DB_EV_VOLUMECHANGED:
+        return p1 == 0 ? COALESCE_VOLUMECHANGED : -1;
     }
+    return -1;
+}
+
+static void
+_push_node (message_t *msg) {
+    msg->next = NULL;
+    message_t *prev = __atomic_exchange_n (&_head, msg, __ATOMIC_ACQ_REL);
+    __atomic_store_n (&prev->next, msg, __ATOMIC_RELEASE);
+}
+
+// Returns NULL when the queue is empty, or when a producer is in the middle of linking a node;
+// in the latter case the message count is not incremented yet, and messagepump_wait sleeps until it is.
+static message_t *
+_pop_node (void) {
+    message_t *tail = _tail;
+    message_t *next = __atomic_load_n (&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &_stub) {
+        if (!next) {
+            return NULL;
+        }
+        _tail = next;
+        tail = next;
+        next = __atomic_load_n (&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        _tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n (&_head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    _push_node (&_stub);
+    next = __atomic_load_n (&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        _tail = next;
+        return tail;
+    }
+    return NULL;
 }
 
 int
 messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
-    mutex_lock (mutex);
-    if (!mfree) {
-        mutex_unlock (mutex);
-        //fprintf (stderr, "WARNING: message queue is full! message ignored (%d %p %d %d)\n", id, (void*)ctx, p1, p2);
+    int slot = _coalesce_slot (id, ctx, p1, p2);
+    if (slot >= 0 && __atomic_exchange_n (&_pending_coalesce[slot], 1, __ATOMIC_SEQ_CST)) {
+        __atomic_add_fetch (&_stats.coalesced, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    message_t *msg = malloc (sizeof (message_t));
+    if (!msg) {
+        __atomic_add_fetch (&_stats.dropped, 1, __ATOMIC_RELAXED);
+        if (slot >= 0) {
+            __atomic_store_n (&_pending_coalesce[slot], 0, __ATOMIC_SEQ_CST);
+        }
         if (id >= DB_EV_FIRST && ctx) {
             messagepump_event_free ((ddb_event_t *)ctx);
         }
         return -1;
     }
-    message_t *msg = mfree;
-    mfree = mfree->next;
-    if (mqtail) {
-        mqtail->next = msg;
-    }
-    mqtail = msg;
-    if (!mqueue) {
-        mqueue = msg;
-    }
-
-    msg->next = NULL;
     msg->id = id;
     msg->ctx = ctx;
     msg->p1 = p1;
     msg->p2 = p2;
-    mutex_unlock (mutex);
-    cond_signal (cond);
+    msg->coalesce_slot = slot;
+    _push_node (msg);
+
+    __atomic_add_fetch (&_stats.pushed, 1, __ATOMIC_RELAXED);
+    int64_t queued = __atomic_add_fetch (&_queued, 1, __ATOMIC_SEQ_CST);
+    int64_t max_queued = __atomic_load_n (&_stats.max_queued, __ATOMIC_RELAXED);
+    while (queued > max_queued
+           && !__atomic_compare_exchange_n (&_stats.max_queued, &max_queued, queued, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    // only take the lock if the consumer is (about to be) sleeping
+    if (__atomic_load_n (&_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock (&_wait_mutex);
+        pthread_cond_signal (&_wait_cond);
+        pthread_mutex_unlock (&_wait_mutex);
+    }
     return 0;
 }
 
+// Returns when there's a message which messagepump_pop can take
 void
 messagepump_wait (void) {
-    cond_wait (cond, mutex);
-    mutex_unlock (mutex);
+    int64_t stalled = _stalled_queued;
+    _stalled_queued = 0;
+
+    if (stalled) {
+        for (int i = 0; i < WAIT_SPIN_COUNT; i++) {
+            if (__atomic_load_n (&_queued, __ATOMIC_SEQ_CST) > stalled) {
+                return;
+            }
+            sched_yield ();
+        }
+    }
+
+    pthread_mutex_lock (&_wait_mutex);
+    __atomic_store_n (&_waiting, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n (&_queued, __ATOMIC_SEQ_CST) <= stalled) {
+        pthread_cond_wait (&_wait_cond, &_wait_mutex);
+    }
+    __atomic_store_n (&_waiting, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock (&_wait_mutex);
 }
 
 int
 messagepump_pop (uint32_t *id, uintptr_t *ctx, uint32_t *p1, uint32_t *p2) {
-    mutex_lock (mutex);
-    if (!mqueue) {
-        mutex_unlock (mutex);
+    message_t *msg = _pop_node ();
+    if (!msg) {
+        _stalled_queued = __atomic_load_n (&_queued, __ATOMIC_SEQ_CST);
         return -1;
     }
-    *id = mqueue->id;
-    *ctx = mqueue->ctx;
-    *p1 = mqueue->p1;
-    *p2 = mqueue->p2;
-    message_t *next = mqueue->next;
-    mqueue->next = mfree;
-    mfree = mqueue;
-    mqueue = next;
-    if (!mqueue) {
-        mqtail = NULL;
-    }
-    mutex_unlock (mutex);
+    __atomic_sub_fetch (&_queued, 1, __ATOMIC_SEQ_CST);
+    if (msg->coalesce_slot >= 0) {
+        __atomic_store_n (&_pending_coalesce[msg->coalesce_slot], 0, __ATOMIC_SEQ_CST);
+    }
+    *id = msg->id;
+    *ctx = msg->ctx;
+    *p1 = msg->p1;
+    *p2 = msg->p2;
+    free (msg);
     return 0;
 }
 
 int
 messagepump_hasmessages (void) {
-    return mqueue ? 1 : 0;
+    return __atomic_load_n (&_queued, __ATOMIC_SEQ_CST) ? 1 : 0;
+}
+
+void
+messagepump_get_stats (messagepump_stats_t *stats) {
+    stats->pushed = __atomic_load_n (&_stats.pushed, __ATOMIC_RELAXED);
+    stats->coalesced = __atomic_load_n (&_stats.coalesced, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n (&_stats.dropped, __ATOMIC_RELAXED);
+    stats->max_queued = __atomic_load_n (&_stats.max_queued, __ATOMIC_RELAXED);
 }
 
 ddb_event_t *
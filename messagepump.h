@@ -30,11 +30,20 @@
 #include <stdint.h>
 #include "deadbeef.h"
 
+typedef struct {
+    int64_t pushed; // messages added to the queue
+    int64_t coalesced; // messages merged into an identical pending message
+    int64_t dropped; // messages lost due to allocation failure
+    int64_t max_queued; // the largest queue length seen
+} messagepump_stats_t;
+
 int messagepump_init (void);
 void messagepump_free (void);
 int messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2);
 int messagepump_pop (uint32_t *id, uintptr_t *ctx, uint32_t *p1, uint32_t *p2);
 void messagepump_wait (void);
+int messagepump_hasmessages (void);
+void messagepump_get_stats (messagepump_stats_t *stats);
 
 ddb_event_t *messagepump_event_alloc (uint32_t id);
 void messagepump_event_free (ddb_event_t *ev);
@@ -24,6 +24,7 @@
 
   Oleksiy Yakovenko waker@users.sourceforge.net
 */
+#include <pthread.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -47,6 +48,9 @@ typedef struct {
 
 static metacache_hash_t hash[HASH_SIZE];
 
+// metadata can be added from multiple threads at once, e.g. when probing files in parallel
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static uint32_t
 metacache_get_hash_sdbm (const char *str, size_t len) {
     uint32_t h = 0;
@@ -83,10 +87,12 @@ const char *
 metacache_add_value (const char *value, size_t len) {
     //    printf ("n_strings=%d, n_inserts=%d, n_buckets=%d\n", n_strings, n_inserts, n_buckets);
     uint32_t h = metacache_get_hash_sdbm (value, len);
+    pthread_mutex_lock (&_mutex);
     metacache_str_t *data = metacache_find_in_bucket (h & (HASH_SIZE-1), value, len);
     n_inserts++;
     if (data) {
         data->refcount++;
+        pthread_mutex_unlock (&_mutex);
         return data->str;
     }
     metacache_hash_t *bucket = &hash[h & (HASH_SIZE-1)];
@@ -101,6 +107,7 @@ metacache_add_value (const char *value, size_t len) {
     data->next = bucket->chain;
     bucket->chain = data;
     n_strings++;
+    pthread_mutex_unlock (&_mutex);
     return data->str;
 }
 
@@ -112,6 +119,7 @@ metacache_add_string (const char *str) {
 void
 metacache_remove_value (const char *value, size_t valuesize) {
     uint32_t h = metacache_get_hash_sdbm (value, valuesize);
+    pthread_mutex_lock (&_mutex);
     metacache_hash_t *bucket = &hash[h & (HASH_SIZE-1)];
     metacache_str_t *chain = bucket->chain;
     metacache_str_t *prev = NULL;
@@ -132,6 +140,7 @@ metacache_remove_value (const char *value, size_t valuesize) {
         prev = chain;
         chain = chain->next;
     }
+    pthread_mutex_unlock (&_mutex);
 }
 
 void
@@ -161,12 +170,15 @@ metacache_get_string (const char *str) {
 const char *
 metacache_get_value (const char *value, size_t len) {
     uint32_t h = metacache_get_hash_sdbm (value, len);
+    pthread_mutex_lock (&_mutex);
     metacache_str_t *data = metacache_find_in_bucket (h & (HASH_SIZE-1), value, len);
     n_inserts++;
     if (data) {
         data->refcount++;
+        pthread_mutex_unlock (&_mutex);
         return data->str;
     }
+    pthread_mutex_unlock (&_mutex);
 
     return NULL;
 }
@@ -0,0 +1,203 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#import <XCTest/XCTest.h>
+#include <math.h>
+#include "deadbeef.h"
+#include "dsp.h"
+#include "dspkernels.h"
+
+extern DB_functions_t *deadbeef;
+
+#define SAMPLERATE 44100
+#define BLOCK_FRAMES 4096
+#define BENCHMARK_SECONDS 60
+
+@interface DSPTests : XCTestCase {
+    ddb_dsp_context_t *_saved_chain;
+    float *_signal;
+    float *_buffer;
+}
+
+@end
+
+@implementation DSPTests
+
+- (void)setUp {
+    [super setUp];
+
+    ddb_dsp_context_t *tail = NULL;
+    for (ddb_dsp_context_t *dsp = deadbeef->streamer_get_dsp_chain (); dsp; dsp = dsp->next) {
+        ddb_dsp_context_t *copy = dsp_clone (dsp);
+        if (tail) {
+            tail->next = copy;
+        }
+        else {
+            _saved_chain = copy;
+        }
+        tail = copy;
+    }
+
+    // 1kHz sine, with room for the output of the DSPs which increase the channel count or samplerate
+    _signal = malloc (BLOCK_FRAMES * sizeof (float));
+    for (int i = 0; i < BLOCK_FRAMES; i++) {
+        _signal[i] = sinf ((float)(2 * M_PI * 1000 * i / SAMPLERATE)) * 0.8f;
+    }
+    _buffer = malloc (BLOCK_FRAMES * MAX_DSP_RATIO * sizeof (float));
+}
+
+- (void)tearDown {
+    streamer_set_dsp_chain_real (_saved_chain);
+    _saved_chain = NULL;
+    free (_signal);
+    free (_buffer);
+    [super tearDown];
+}
+
+- (ddb_dsp_context_t *)openDSP:(const char *)plugin_id {
+    DB_dsp_t *plugin = (DB_dsp_t *)deadbeef->plug_get_for_id (plugin_id);
+    XCTAssertTrue(plugin != NULL);
+    ddb_dsp_context_t *dsp = plugin->open ();
+    dsp->enabled = 1;
+    return dsp;
+}
+
+// Runs the chain offline over BENCHMARK_SECONDS of the mono test signal
+- (void)runChain:(ddb_dsp_context_t *)chain {
+    int blocks = BENCHMARK_SECONDS * SAMPLERATE / BLOCK_FRAMES;
+    for (int b = 0; b < blocks; b++) {
+        ddb_waveformat_t fmt = {
+            .bps = 32,
+            .channels = 1,
+            .samplerate = SAMPLERATE,
+            .channelmask = DDB_SPEAKER_FRONT_LEFT,
+            .is_float = 1,
+        };
+        memcpy (_buffer, _signal, BLOCK_FRAMES * sizeof (float));
+        int nframes = BLOCK_FRAMES;
+        for (ddb_dsp_context_t *dsp = chain; dsp; dsp = dsp->next) {
+            if (dsp->enabled) {
+                float ratio = 1;
+                nframes = dsp->plugin->process (dsp, _buffer, nframes, BLOCK_FRAMES * MAX_DSP_RATIO, &fmt, &ratio);
+            }
+        }
+    }
+}
+
+- (void)test_ScaleClampFloat_AllLengths_MatchesScalar {
+    float samples[67];
+    float expected[67];
+    for (int count = 0; count < 64; count++) {
+        for (int i = 0; i < count + 3; i++) {
+            samples[i] = expected[i] = (i - 32) / 20.f;
+        }
+        for (int i = 1; i <= count; i++) {
+            float sample = expected[i] * 1.7f;
+            expected[i] = sample > 1.f ? 1.f : (sample < -1.f ? -1.f : sample);
+        }
+        // unaligned start
+        dsp_kernel_scale_clamp_float (samples + 1, count, 1.7f);
+        XCTAssertTrue(!memcmp (samples, expected, (count + 3) * sizeof (float)));
+    }
+}
+
+- (void)test_Mono2Stereo_InPlace_MatchesScalar {
+    ddb_dsp_context_t *m2s = [self openDSP:"m2s"];
+    m2s->plugin->set_param (m2s, 0, "0.5");
+    m2s->plugin->set_param (m2s, 1, "0.25");
+
+    for (int nframes = 0; nframes < 20; nframes++) {
+        ddb_waveformat_t fmt = { .bps = 32, .channels = 1, .samplerate = SAMPLERATE, .channelmask = 1, .is_float = 1 };
+        float samples[40];
+        for (int i = 0; i < nframes; i++) {
+            samples[i] = i + 1;
+        }
+        float ratio = 1;
+        XCTAssertEqual(m2s->plugin->process (m2s, samples, nframes, 40, &fmt, &ratio), nframes);
+        XCTAssertEqual(fmt.channels, 2);
+        for (int i = 0; i < nframes; i++) {
+            XCTAssertEqual(samples[i*2], (i + 1) * 0.5f);
+            XCTAssertEqual(samples[i*2+1], (i + 1) * 0.25f);
+        }
+    }
+    m2s->plugin->close (m2s);
+}
+
+- (void)test_DspApply_RecordsProfile {
+    streamer_set_dsp_chain_real ([self openDSP:"m2s"]);
+
+    ddb_waveformat_t fmt = { .bps = 32, .channels = 1, .samplerate = SAMPLERATE, .channelmask = 1, .is_float = 1 };
+    for (int i = 0; i < 10; i++) {
+        ddb_waveformat_t out_fmt;
+        char *out_bytes;
+        int out_size;
+        float ratio;
+        XCTAssertEqual(dsp_apply (&fmt, (char *)_signal, BLOCK_FRAMES * sizeof (float), &out_fmt, &out_bytes, &out_size, &ratio), 1);
+        XCTAssertEqual(out_fmt.channels, 2);
+    }
+
+    ddb_dsp_profile_t profile[4];
+    int count = deadbeef->dsp_get_profile (profile, 4);
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        if (!strcmp (profile[i].plugin->plugin.id, "m2s")) {
+            found = 1;
+            XCTAssertEqual(profile[i].blocks, 10);
+            XCTAssertTrue(profile[i].p99_time >= 0);
+            XCTAssertTrue(profile[i].realtime_factor >= 0);
+        }
+        else {
+            // the hidden equalizer is disabled
+            XCTAssertEqual(profile[i].blocks, 0);
+        }
+    }
+    XCTAssertTrue(found);
+
+    deadbeef->dsp_reset_profile ();
+    deadbeef->dsp_get_profile (profile, 4);
+    XCTAssertEqual(profile[count - 1].blocks, 0);
+}
+
+- (void)test_Mono2StereoChain_Performance {
+    ddb_dsp_context_t *m2s = [self openDSP:"m2s"];
+    [self measureBlock:^{
+        [self runChain:m2s];
+    }];
+    m2s->plugin->close (m2s);
+}
+
+- (void)test_ScaleClampFloat_Performance {
+    int count = BENCHMARK_SECONDS * SAMPLERATE * 2;
+    float *samples = malloc (count * sizeof (float));
+    for (int i = 0; i < count; i++) {
+        samples[i] = _signal[i % BLOCK_FRAMES];
+    }
+    [self measureBlock:^{
+        for (int i = 0; i < 10; i++) {
+            dsp_kernel_scale_clamp_float (samples, count, 0.99f);
+        }
+    }];
+    free (samples);
+}
+
+@end
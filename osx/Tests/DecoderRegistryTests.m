@@ -0,0 +1,86 @@
+//
+//  DecoderRegistryTests.m
+//  Tests
+//
+//  Created by Oleksiy Yakovenko on 10/18/26.
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include "decoderregistry.h"
+
+#define TESTFILE "/tmp/ddb_test_sniff.dat"
+#define TESTFILE_MP3 "/tmp/ddb_test_sniff.mp3"
+
+@interface DecoderRegistryTests : XCTestCase
+
+@end
+
+@implementation DecoderRegistryTests
+
+- (void)tearDown {
+    unlink (TESTFILE);
+    unlink (TESTFILE_MP3);
+    [super tearDown];
+}
+
+static int
+_find_decoder (DB_decoder_t **decoders, int count, const char *id) {
+    for (int i = 0; i < count; i++) {
+        if (!strcmp (decoders[i]->plugin.id, id)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+- (void)test_Find_UppercaseExtension_ReturnsMp3Decoder {
+    DB_decoder_t *decoders[DECODER_REGISTRY_MAX_DECODERS];
+    int count = decoder_registry_find ("/nonexistent/file.MP3", decoders);
+    XCTAssertTrue(_find_decoder (decoders, count, "stdmpg") >= 0);
+}
+
+- (void)test_Find_UnknownExtension_ReturnsNoDecoders {
+    DB_decoder_t *decoders[DECODER_REGISTRY_MAX_DECODERS];
+    int count = decoder_registry_find ("/nonexistent/file.unknown-extension", decoders);
+    XCTAssertEqual(_find_decoder (decoders, count, "stdmpg"), -1);
+}
+
+- (void)test_Find_FlacWithUnknownExtension_FlacDecoderFirst {
+    FILE *fp = fopen (TESTFILE, "wb");
+    char header[64] = "fLaC";
+    fwrite (header, sizeof (header), 1, fp);
+    fclose (fp);
+
+    DB_decoder_t *decoders[DECODER_REGISTRY_MAX_DECODERS];
+    int count = decoder_registry_find (TESTFILE, decoders);
+    XCTAssertEqual(_find_decoder (decoders, count, "stdflac"), 0);
+}
+
+- (void)test_Find_FlacAfterId3v2Tag_FlacDecoderFirst {
+    FILE *fp = fopen (TESTFILE, "wb");
+    // 10 byte tag header, with the tag size of 20
+    char header[64] = "ID3\x03\x00\x00\x00\x00\x00\x14";
+    memcpy (header + 30, "fLaC", 4);
+    fwrite (header, sizeof (header), 1, fp);
+    fclose (fp);
+
+    DB_decoder_t *decoders[DECODER_REGISTRY_MAX_DECODERS];
+    int count = decoder_registry_find (TESTFILE, decoders);
+    XCTAssertEqual(_find_decoder (decoders, count, "stdflac"), 0);
+}
+
+- (void)test_Find_FlacWithMp3Extension_NotSniffed {
+    FILE *fp = fopen (TESTFILE_MP3, "wb");
+    char header[64] = "fLaC";
+    fwrite (header, sizeof (header), 1, fp);
+    fclose (fp);
+
+    // the extension identifies a single decoder, so the file is not read
+    DB_decoder_t *decoders[DECODER_REGISTRY_MAX_DECODERS];
+    int count = decoder_registry_find (TESTFILE_MP3, decoders);
+    XCTAssertEqual(_find_decoder (decoders, count, "stdmpg"), 0);
+    XCTAssertEqual(_find_decoder (decoders, count, "stdflac"), -1);
+}
+
+@end
@@ -0,0 +1,145 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#import <XCTest/XCTest.h>
+#include "deadbeef.h"
+#include "messagepump.h"
+#include "threading.h"
+
+#define NUM_PRODUCERS 4
+#define MESSAGES_PER_PRODUCER 100000
+
+static void
+_producer (void *ctx) {
+    for (int i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+        messagepump_push (DB_EV_NEXT, 0, i, 0);
+    }
+}
+
+@interface MessagePumpTests : XCTestCase
+
+@end
+
+@implementation MessagePumpTests
+
+- (void)setUp {
+    [super setUp];
+    messagepump_init ();
+}
+
+- (void)tearDown {
+    messagepump_free ();
+    [super tearDown];
+}
+
+- (void)test_Push1000Messages_NoneDropped {
+    for (int i = 0; i < 1000; i++) {
+        XCTAssertEqual (messagepump_push (DB_EV_NEXT, 0, i, 0), 0);
+    }
+
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    int count = 0;
+    while (messagepump_pop (&id, &ctx, &p1, &p2) != -1) {
+        XCTAssertEqual (p1, count);
+        count++;
+    }
+    XCTAssertEqual (count, 1000);
+
+    messagepump_stats_t stats;
+    messagepump_get_stats (&stats);
+    XCTAssertEqual (stats.dropped, 0);
+    XCTAssertEqual (stats.max_queued, 1000);
+}
+
+- (void)test_PushSamePlaylistChangedTwice_Coalesced {
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    messagepump_push (DB_EV_NEXT, 0, 0, 0);
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_TITLE, 0);
+
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    XCTAssertEqual (id, DB_EV_PLAYLISTCHANGED);
+    XCTAssertEqual (p1, DDB_PLAYLIST_CHANGE_CONTENT);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    XCTAssertEqual (id, DB_EV_NEXT);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    XCTAssertEqual (id, DB_EV_PLAYLISTCHANGED);
+    XCTAssertEqual (p1, DDB_PLAYLIST_CHANGE_TITLE);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), -1);
+
+    messagepump_stats_t stats;
+    messagepump_get_stats (&stats);
+    XCTAssertEqual (stats.coalesced, 1);
+}
+
+- (void)test_PushPlaylistChangedAfterPop_NotCoalesced {
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    XCTAssertEqual (id, DB_EV_PLAYLISTCHANGED);
+}
+
+- (void)test_PushSelectionChangeWithSender_NotCoalesced {
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 1, DDB_PLAYLIST_CHANGE_SELECTION, 0);
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 1, DDB_PLAYLIST_CHANGE_SELECTION, 0);
+
+    uint32_t id, p1, p2;
+    uintptr_t ctx;
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    XCTAssertEqual (messagepump_pop (&id, &ctx, &p1, &p2), -1);
+}
+
+- (void)test_ContendedPushPop_Performance {
+    [self measureBlock:^{
+        intptr_t tids[NUM_PRODUCERS];
+        for (int i = 0; i < NUM_PRODUCERS; i++) {
+            tids[i] = thread_start (_producer, NULL);
+        }
+
+        uint32_t id, p1, p2;
+        uintptr_t ctx;
+        int count = 0;
+        while (count < NUM_PRODUCERS * MESSAGES_PER_PRODUCER) {
+            while (messagepump_pop (&id, &ctx, &p1, &p2) != -1) {
+                count++;
+            }
+            if (count < NUM_PRODUCERS * MESSAGES_PER_PRODUCER) {
+                messagepump_wait ();
+            }
+        }
+
+        for (int i = 0; i < NUM_PRODUCERS; i++) {
+            thread_join (tids[i]);
+        }
+        XCTAssertEqual (count, NUM_PRODUCERS * MESSAGES_PER_PRODUCER);
+    }];
+}
+
+@end
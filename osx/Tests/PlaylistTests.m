@@ -10,7 +10,12 @@
 #include "deadbeef.h"
 #include "../../common.h"
 #include "plmeta.h"
+#include "pltmeta.h"
 #include "plugins.h"
+#include "conf.h"
+#include "threadpool.h"
+
+extern DB_functions_t *deadbeef;
 
 @interface PlaylistTests : XCTestCase
 
@@ -60,6 +65,166 @@
     plt_unref (plt);
 }
 
+- (void)test_SearchRefinedQuery_FindsSubsetOfPreviousResults {
+    playlist_t *plt = plt_alloc("test");
+    const char *titles[] = { "abc", "abd", "xyz" };
+    for (int i = 0; i < 3; i++) {
+        playItem_t *it = pl_item_alloc();
+        pl_add_meta(it, "title", titles[i]);
+        plt_insert_item(plt, plt->tail[PL_MAIN], it);
+        pl_item_unref (it);
+    }
+
+    plt_search_process2(plt, "ab", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 2);
+    plt_search_process2(plt, "abd", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 1);
+    plt_search_process2(plt, "ab", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 2);
+    plt_search_process2(plt, "x", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 1);
+
+    plt_unref (plt);
+}
+
+- (void)test_SearchAfterPlaylistChange_FindsNewItems {
+    playlist_t *plt = plt_alloc("test");
+    playItem_t *it = pl_item_alloc();
+    pl_add_meta(it, "title", "value");
+    plt_insert_item(plt, NULL, it);
+    pl_item_unref (it);
+
+    plt_search_process2(plt, "val", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 1);
+
+    it = pl_item_alloc();
+    pl_add_meta(it, "title", "value2");
+    plt_insert_item(plt, plt->tail[PL_MAIN], it);
+    pl_item_unref (it);
+
+    plt_search_process2(plt, "value", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 2);
+
+    plt_unref (plt);
+}
+
+- (void)test_SearchWithIndex_FindsSameItemsAsWithout {
+    playlist_t *plt = plt_alloc("test");
+    const char *titles[] = { "Track Title", "Another title", "Something else" };
+    for (int i = 0; i < 3; i++) {
+        playItem_t *it = pl_item_alloc();
+        pl_add_meta(it, "title", titles[i]);
+        plt_insert_item(plt, plt->tail[PL_MAIN], it);
+        pl_item_unref (it);
+    }
+    plt_add_meta(plt, "search_index", "1");
+
+    plt_search_process2(plt, "TITLE", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 2);
+    XCTAssertTrue(plt->search_index != NULL);
+
+    // changed items are re-indexed, without rebuilding the index
+    struct search_index_s *index = plt->search_index;
+    pl_replace_meta(plt->tail[PL_MAIN], "title", "Third title");
+    plt_search_process2(plt, "third", 0);
+    XCTAssertEqual(plt->count[PL_SEARCH], 1);
+    XCTAssertTrue(plt->search_index == index);
+    XCTAssertFalse(plt->tail[PL_MAIN]->search_dirty);
+
+    ddb_search_index_stats_t stats;
+    XCTAssertEqual(deadbeef->plt_get_search_index_stats ((ddb_playlist_t *)plt, &stats), 0);
+    XCTAssertEqual(stats.item_count, 3);
+    XCTAssertTrue(stats.memory_size > 0);
+
+    plt_unref (plt);
+}
+
+- (void)test_SearchTypingAndBackspace_Performance {
+    playlist_t *plt = plt_alloc("test");
+    for (int i = 0; i < 100000; i++) {
+        playItem_t *it = pl_item_alloc();
+        char value[100];
+        snprintf (value, sizeof (value), "Artist %d", i % 1000);
+        pl_add_meta(it, "artist", value);
+        snprintf (value, sizeof (value), "Track Title %d", i);
+        pl_add_meta(it, "title", value);
+        plt_insert_item(plt, plt->tail[PL_MAIN], it);
+        pl_item_unref (it);
+    }
+
+    const char *keystrokes[] = { "t", "tr", "tra", "trac", "track", "track ", "track t", "track ti", "track t", "track ", "track 1", "track 12", "track 1" };
+    [self measureBlock:^{
+        for (int i = 0; i < sizeof (keystrokes) / sizeof (keystrokes[0]); i++) {
+            plt_search_process2(plt, keystrokes[i], 0);
+        }
+    }];
+
+    plt_unref (plt);
+}
+
+#pragma mark - DBPL
+
+- (void)test_SaveAndLoadDBPL_RestoresItemsAndMetadata {
+    playlist_t *plt = plt_alloc("test");
+    for (int i = 0; i < 3; i++) {
+        playItem_t *it = pl_item_alloc();
+        char uri[20];
+        snprintf (uri, sizeof (uri), "/file%d.mp3", i);
+        pl_add_meta(it, ":URI", uri);
+        pl_add_meta(it, "title", "value");
+        plt_insert_item(plt, plt->tail[PL_MAIN], it);
+        pl_item_unref (it);
+    }
+    plt_add_meta(plt, "key", "plt_value");
+
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"test.dbpl"];
+    XCTAssertEqual(plt_save(plt, NULL, NULL, path.UTF8String, NULL, NULL, NULL), 0);
+
+    playlist_t *loaded = plt_alloc("loaded");
+    plt_load(loaded, NULL, path.UTF8String, NULL, NULL, NULL);
+
+    XCTAssertEqual(loaded->count[PL_MAIN], 3);
+    XCTAssertTrue(!strcmp (pl_find_meta_raw (loaded->tail[PL_MAIN], ":URI"), "/file2.mp3"));
+    XCTAssertTrue(!strcmp (pl_find_meta_raw (loaded->head[PL_MAIN], "title"), "value"));
+    XCTAssertTrue(!strcmp (plt_find_meta (loaded, "key"), "plt_value"));
+
+    plt_unref (loaded);
+    plt_unref (plt);
+    unlink (path.UTF8String);
+}
+
+#pragma mark - Add folder
+
+static playlist_t *
+_add_test_data_folder (int parallel) {
+    conf_set_int ("add_folders_parallel", parallel);
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData", dbplugindir);
+    playlist_t *plt = plt_alloc("test");
+    plt_insert_dir2 (0, plt, NULL, path, NULL, NULL, NULL);
+    conf_remove_items ("add_folders_parallel");
+    return plt;
+}
+
+- (void)test_AddFolderInParallel_AddsSameTracksInSameOrder {
+    threadpool_init ();
+    playlist_t *serial = _add_test_data_folder (0);
+    playlist_t *parallel = _add_test_data_folder (1);
+    threadpool_free ();
+
+    XCTAssertTrue(serial->count[PL_MAIN] > 0);
+    XCTAssertEqual(parallel->count[PL_MAIN], serial->count[PL_MAIN]);
+    playItem_t *a = serial->head[PL_MAIN];
+    playItem_t *b = parallel->head[PL_MAIN];
+    for (; a && b; a = a->next[PL_MAIN], b = b->next[PL_MAIN]) {
+        XCTAssertTrue(!strcmp (pl_find_meta_raw (a, ":URI"), pl_find_meta_raw (b, ":URI")));
+        XCTAssertEqual(pl_find_meta_raw (a, "title"), pl_find_meta_raw (b, "title"));
+    }
+
+    plt_unref (parallel);
+    plt_unref (serial);
+}
+
 #pragma mark - IsRelativePathPosix
 
 - (void)test_IsRelativePathPosix_AbsolutePath_False {
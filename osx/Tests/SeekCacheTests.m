@@ -0,0 +1,159 @@
+//
+//  SeekCacheTests.m
+//  Tests
+//
+//  Created by Oleksiy Yakovenko on 10/18/26.
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include "deadbeef.h"
+#include "../../common.h"
+#include "conf.h"
+#include "playlist.h"
+#include "seekcache.h"
+
+extern DB_functions_t *deadbeef;
+
+#define CHUNK_SIZE 16384
+
+@interface SeekCacheTests : XCTestCase {
+    playlist_t *_plt;
+    DB_playItem_t *_it;
+    ddb_decoder2_t *_dec;
+}
+
+@end
+
+@implementation SeekCacheTests
+
+- (void)setUp {
+    [super setUp];
+    conf_set_float ("streamer.seek_checkpoint_interval", 2);
+    seekcache_configchanged ();
+    seekcache_reset ();
+    deadbeef->conf_set_int ("mp3.backend", 0);
+}
+
+- (void)tearDown {
+    seekcache_reset ();
+    conf_remove_items ("streamer.seek_checkpoint_interval");
+    seekcache_configchanged ();
+    if (_plt) {
+        deadbeef->plt_unref ((ddb_playlist_t *)_plt);
+        _plt = NULL;
+    }
+    [super tearDown];
+}
+
+- (DB_fileinfo_t *)openPath:(const char *)name decoder:(const char *)decoder_id {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/%s", dbplugindir, name);
+
+    if (!_plt) {
+        _plt = plt_alloc ("testplt");
+        _it = deadbeef->plt_insert_file2 (0, (ddb_playlist_t *)_plt, NULL, path, NULL, NULL, NULL);
+        _dec = (ddb_decoder2_t *)deadbeef->plug_get_for_id (decoder_id);
+    }
+
+    DB_fileinfo_t *fi = _dec->decoder.open (0);
+    _dec->decoder.init (fi, _it);
+    return fi;
+}
+
+// Plays the whole track, saving the checkpoints
+- (void)playThrough:(DB_fileinfo_t *)fi {
+    char buffer[CHUNK_SIZE];
+    for (;;) {
+        seekcache_record ((playItem_t *)_it, fi);
+        if (_dec->decoder.read (fi, buffer, CHUNK_SIZE) != CHUNK_SIZE) {
+            break;
+        }
+    }
+}
+
+- (void)test_Mp3CheckpointRestore_DecodesSameAsSeek {
+    DB_fileinfo_t *fi = [self openPath:"mp3parser/vbr_rhytm_30sec.mp3" decoder:"stdmpg"];
+    XCTAssertTrue(seekcache_is_supported (fi));
+
+    char buffer[CHUNK_SIZE];
+    while (fi->readpos < 15) {
+        _dec->decoder.read (fi, buffer, CHUNK_SIZE);
+    }
+    int64_t sample = -1;
+    size_t size = 0;
+    void *checkpoint = _dec->checkpoint_save (fi, &sample, &size);
+    XCTAssertTrue(checkpoint != NULL);
+    XCTAssertTrue(sample > 0);
+
+    // seek back, then restore the checkpoint, and seek after it
+    int64_t target = sample + fi->fmt.samplerate * 5;
+    _dec->seek_sample64 (fi, 0);
+    XCTAssertEqual(_dec->checkpoint_restore (fi, checkpoint), 0);
+    _dec->seek_sample64 (fi, target);
+    char restored[CHUNK_SIZE];
+    XCTAssertEqual(_dec->decoder.read (fi, restored, CHUNK_SIZE), CHUNK_SIZE);
+    _dec->checkpoint_free (checkpoint);
+    _dec->decoder.free (fi);
+
+    fi = [self openPath:"mp3parser/vbr_rhytm_30sec.mp3" decoder:"stdmpg"];
+    _dec->seek_sample64 (fi, target);
+    char expected[CHUNK_SIZE];
+    XCTAssertEqual(_dec->decoder.read (fi, expected, CHUNK_SIZE), CHUNK_SIZE);
+    _dec->decoder.free (fi);
+
+    XCTAssertTrue(!memcmp (restored, expected, CHUNK_SIZE));
+}
+
+- (void)test_SeekCache_PlayThrough_RestoresNearestCheckpoint {
+    DB_fileinfo_t *fi = [self openPath:"mp3parser/vbr_rhytm_30sec.mp3" decoder:"stdmpg"];
+    [self playThrough:fi];
+
+    seekcache_stats_t stats;
+    seekcache_get_stats (&stats);
+    XCTAssertEqual(stats.track_count, 1);
+    XCTAssertTrue(stats.checkpoint_count >= 10);
+
+    // backward seek
+    XCTAssertEqual(seekcache_restore ((playItem_t *)_it, fi, fi->fmt.samplerate * 10), 1);
+    _dec->seek_sample64 (fi, fi->fmt.samplerate * 10);
+    XCTAssertEqual((int)fi->readpos, 10);
+
+    // forward seek within the checkpoint interval uses the current position
+    XCTAssertEqual(seekcache_restore ((playItem_t *)_it, fi, fi->fmt.samplerate * 10 + 100), 0);
+
+    seekcache_get_stats (&stats);
+    XCTAssertEqual(stats.restore_count, 1);
+    _dec->decoder.free (fi);
+}
+
+// Seek latency of a format, to random positions, optionally with the checkpoints saved during playback
+- (void)measureSeeksInPath:(const char *)name decoder:(const char *)decoder_id checkpoints:(BOOL)checkpoints {
+    DB_fileinfo_t *fi = [self openPath:name decoder:decoder_id];
+    if (checkpoints) {
+        [self playThrough:fi];
+    }
+    int64_t duration = (int64_t)(deadbeef->pl_get_item_duration (_it) * fi->fmt.samplerate);
+    [self measureBlock:^{
+        char buffer[CHUNK_SIZE];
+        uint32_t seed = 1;
+        for (int i = 0; i < 100; i++) {
+            seed = seed * 1103515245 + 12345;
+            int64_t target = (seed >> 8) % duration;
+            seekcache_restore ((playItem_t *)_it, fi, target);
+            self->_dec->seek_sample64 (fi, target);
+            self->_dec->decoder.read (fi, buffer, CHUNK_SIZE);
+        }
+    }];
+    _dec->decoder.free (fi);
+}
+
+- (void)test_Mp3Seek_WithoutCheckpoints_Performance {
+    [self measureSeeksInPath:"mp3parser/vbr_rhytm_30sec.mp3" decoder:"stdmpg" checkpoints:NO];
+}
+
+- (void)test_Mp3Seek_FromCheckpoints_Performance {
+    [self measureSeeksInPath:"mp3parser/vbr_rhytm_30sec.mp3" decoder:"stdmpg" checkpoints:YES];
+}
+
+@end
@@ -0,0 +1,134 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#import <XCTest/XCTest.h>
+#include <unistd.h>
+#include "deadbeef.h"
+#include "conf.h"
+#include "streamertelemetry.h"
+
+// must match RING_SIZE in streamertelemetry.c
+#define RING_SIZE 1024
+
+@interface StreamerTelemetryTests : XCTestCase
+
+@end
+
+@implementation StreamerTelemetryTests
+
+- (void)setUp {
+    [super setUp];
+    conf_set_int ("streamer.telemetry_interval", 1);
+    streamer_telemetry_init ();
+}
+
+- (void)tearDown {
+    conf_remove_items ("streamer.telemetry_interval");
+    streamer_telemetry_init ();
+    [super tearDown];
+}
+
+// Samples numbered by blocks_ready
+- (void)addSamples:(int)count {
+    for (int i = 0; i < count; i++) {
+        usleep (1100);
+        streamer_telemetry_sample (i, 48, 0, 0);
+    }
+}
+
+- (void)test_Read_ReturnsSamplesInOrder_AdvancesCursor {
+    [self addSamples:10];
+
+    ddb_streamer_telemetry_t samples[16];
+    uint64_t cursor = 0;
+    XCTAssertEqual(streamer_telemetry_read (samples, 4, &cursor), 4);
+    XCTAssertEqual(cursor, 4);
+    XCTAssertEqual(samples[0].blocks_ready, 0);
+    XCTAssertEqual(samples[3].blocks_ready, 3);
+    XCTAssertEqual(samples[3].block_count, 48);
+    XCTAssertTrue(samples[3].time > samples[0].time);
+
+    XCTAssertEqual(streamer_telemetry_read (samples, 16, &cursor), 6);
+    XCTAssertEqual(samples[0].blocks_ready, 4);
+    XCTAssertEqual(cursor, 10);
+
+    XCTAssertEqual(streamer_telemetry_read (samples, 16, &cursor), 0);
+}
+
+- (void)test_Read_AfterOverflow_StartsFromOldestAvailable {
+    [self addSamples:RING_SIZE + 10];
+
+    ddb_streamer_telemetry_t samples[4];
+    uint64_t cursor = 0;
+    XCTAssertEqual(streamer_telemetry_read (samples, 4, &cursor), 4);
+    XCTAssertEqual(samples[0].blocks_ready, 10);
+    XCTAssertEqual(cursor, 14);
+}
+
+- (void)test_Sample_WithinInterval_Skipped {
+    conf_set_int ("streamer.telemetry_interval", 1000);
+    streamer_telemetry_configchanged ();
+    streamer_telemetry_sample (1, 48, 0, 0);
+    streamer_telemetry_sample (2, 48, 0, 0);
+
+    ddb_streamer_telemetry_t samples[4];
+    uint64_t cursor = 0;
+    XCTAssertEqual(streamer_telemetry_read (samples, 4, &cursor), 1);
+}
+
+- (void)test_SampleDue_WithinInterval_False {
+    conf_set_int ("streamer.telemetry_interval", 1000);
+    streamer_telemetry_configchanged ();
+    XCTAssertTrue(streamer_telemetry_sample_due ());
+    streamer_telemetry_sample (1, 48, 0, 0);
+    XCTAssertFalse(streamer_telemetry_sample_due ());
+
+    conf_set_int ("streamer.telemetry_interval", 0);
+    streamer_telemetry_configchanged ();
+    XCTAssertFalse(streamer_telemetry_sample_due ());
+}
+
+- (void)test_Sample_IncludesCountersAndRates {
+    ddb_waveformat_t fmt = { .bps = 16, .channels = 2, .samplerate = 44100 };
+    playItem_t *track = pl_item_alloc ();
+    // 1 second decoded in 100ms
+    streamer_telemetry_block_decoded (track, 44100 * 4, &fmt, 100000);
+    streamer_telemetry_dsp_processed (300);
+    streamer_telemetry_dsp_processed (100);
+    streamer_telemetry_underrun ();
+    streamer_telemetry_buffering_changed ();
+    streamer_telemetry_sample (0, 48, 4096, 1);
+    pl_item_unref (track);
+
+    ddb_streamer_telemetry_t s;
+    uint64_t cursor = 0;
+    XCTAssertEqual(streamer_telemetry_read (&s, 1, &cursor), 1);
+    XCTAssertEqualWithAccuracy(s.decode_speed, 10, 0.01);
+    XCTAssertEqualWithAccuracy(s.dsp_time, 0.0002, 0.000001);
+    XCTAssertEqual(s.underruns, 1);
+    XCTAssertEqual(s.buffering_changes, 1);
+    XCTAssertEqual(s.output_buffer_bytes, 4096);
+    XCTAssertEqual(s.is_buffering, 1);
+}
+
+@end
@@ -0,0 +1,94 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#import <XCTest/XCTest.h>
+#include <unistd.h>
+#include "threadpool.h"
+
+@interface ThreadPoolTests : XCTestCase
+
+@end
+
+@implementation ThreadPoolTests
+
+static ddb_task_group_t *_group;
+static int _sum;
+
+static void
+_add_index (void *ctx, int index) {
+    __atomic_add_fetch (&_sum, index, __ATOMIC_RELAXED);
+}
+
+static void
+_nested_parallel_for (void *ctx) {
+    task_parallel_for (_group, 100, _add_index, NULL);
+}
+
+static void
+_sleep_task (void *ctx) {
+    usleep (300000);
+}
+
+static void
+_set_flag_task (void *ctx) {
+    __atomic_store_n ((int *)ctx, 1, __ATOMIC_RELEASE);
+}
+
+- (void)setUp {
+    [super setUp];
+    threadpool_init ();
+    _sum = 0;
+}
+
+- (void)tearDown {
+    threadpool_free ();
+    [super tearDown];
+}
+
+- (void)test_ParallelForFromTaskOfSameGroup_AtMaxConcurrency_RunsInline {
+    _group = task_group_create ("test", DDB_TASK_PRIORITY_NORMAL, 1);
+    task_group_submit (_group, _nested_parallel_for, NULL);
+    task_group_wait (_group);
+    XCTAssertEqual(_sum, 4950);
+    task_group_free (_group);
+}
+
+- (void)test_HighPriorityTask_AllWorkersBusy_StartsOnReservedWorker {
+    if (threadpool_get_worker_count () < 2) {
+        return;
+    }
+    ddb_task_group_t *low = task_group_create ("low", DDB_TASK_PRIORITY_LOW, 0);
+    ddb_task_group_t *high = task_group_create ("high", DDB_TASK_PRIORITY_HIGH, 1);
+    for (int i = 0; i < threadpool_get_worker_count () * 2; i++) {
+        task_group_submit (low, _sleep_task, NULL);
+    }
+    int done = 0;
+    task_group_submit (high, _set_flag_task, &done);
+    // way before the first low priority task finishes
+    usleep (100000);
+    XCTAssertTrue(__atomic_load_n (&done, __ATOMIC_ACQUIRE));
+    task_group_free (high);
+    task_group_free (low);
+}
+
+@end
@@ -0,0 +1,158 @@
+//
+//  VfsStdioTests.m
+//  Tests
+//
+//  Created by Oleksiy Yakovenko on 10/18/26.
+//  Copyright © 2026 Oleksiy Yakovenko. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#include "deadbeef.h"
+#include "vfs.h"
+
+extern DB_functions_t *deadbeef;
+
+#define TESTFILE "/tmp/ddb_test_vfs_stdio.bin"
+#define TESTFILE_SIZE (200*1024+17)
+
+@interface VfsStdioTests : XCTestCase
+
+@end
+
+@implementation VfsStdioTests
+
+- (void)setUp {
+    [super setUp];
+    FILE *fp = fopen (TESTFILE, "wb");
+    for (int i = 0; i < TESTFILE_SIZE; i++) {
+        fputc (i * 7 & 0xff, fp);
+    }
+    fclose (fp);
+}
+
+- (void)tearDown {
+    [self setMmap:0];
+    unlink (TESTFILE);
+    [super tearDown];
+}
+
+- (void)setMmap:(int)enabled {
+    deadbeef->conf_set_int ("vfs.stdio.mmap", enabled);
+    DB_FILE *fp = vfs_fopen (TESTFILE);
+    fp->vfs->plugin.message (DB_EV_CONFIGCHANGED, 0, 0, 0);
+    vfs_fclose (fp);
+}
+
+static int
+_check_data (const uint8_t *data, int64_t offset, int64_t size) {
+    for (int64_t i = 0; i < size; i++) {
+        if (data[i] != ((offset + i) * 7 & 0xff)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+- (void)_testSeekAndRead {
+    DB_FILE *fp = vfs_fopen (TESTFILE);
+    XCTAssertEqual(vfs_fgetlength (fp), TESTFILE_SIZE);
+
+    uint8_t buffer[100000];
+    XCTAssertEqual(vfs_fread (buffer, 1, 10, fp), 10);
+    XCTAssertTrue(_check_data (buffer, 0, 10));
+
+    // within the buffered data
+    XCTAssertEqual(vfs_fseek (fp, -5, SEEK_CUR), 0);
+    XCTAssertEqual(vfs_fread (buffer, 1, 3, fp), 3);
+    XCTAssertTrue(_check_data (buffer, 5, 3));
+
+    // larger than the buffer
+    XCTAssertEqual(vfs_fread (buffer, 1, sizeof (buffer), fp), sizeof (buffer));
+    XCTAssertTrue(_check_data (buffer, 8, sizeof (buffer)));
+    XCTAssertEqual(vfs_ftell (fp), 8 + sizeof (buffer));
+
+    // short read at the end
+    XCTAssertEqual(vfs_fseek (fp, -128, SEEK_END), 0);
+    XCTAssertEqual(vfs_fread (buffer, 1, 1000, fp), 128);
+    XCTAssertTrue(_check_data (buffer, TESTFILE_SIZE - 128, 128));
+    XCTAssertEqual(vfs_fread (buffer, 1, 1, fp), 0);
+
+    XCTAssertEqual(vfs_fseek (fp, -TESTFILE_SIZE - 1, SEEK_END), -1);
+    vfs_fclose (fp);
+}
+
+- (void)_testRegion {
+    DB_FILE *fp = vfs_fopen (TESTFILE);
+    XCTAssertEqual(vfs_fseek (fp, 1000, SEEK_SET), 0);
+
+    const uint8_t *data = vfs_get_region (fp, TESTFILE_SIZE - 128, 128);
+    XCTAssertTrue(data != NULL);
+    XCTAssertTrue(_check_data (data, TESTFILE_SIZE - 128, 128));
+
+    data = vfs_get_region (fp, 10, 150000);
+    XCTAssertTrue(data != NULL);
+    XCTAssertTrue(_check_data (data, 10, 150000));
+
+    // out of bounds
+    XCTAssertTrue(vfs_get_region (fp, TESTFILE_SIZE - 10, 11) == NULL);
+    XCTAssertTrue(vfs_get_region (fp, -1, 10) == NULL);
+
+    // the read position is not changed
+    XCTAssertEqual(vfs_ftell (fp), 1000);
+    uint8_t buffer[10];
+    XCTAssertEqual(vfs_fread (buffer, 1, 10, fp), 10);
+    XCTAssertTrue(_check_data (buffer, 1000, 10));
+    vfs_fclose (fp);
+}
+
+- (void)test_SeekAndRead_Buffered_ReturnsFileData {
+    [self _testSeekAndRead];
+}
+
+- (void)test_SeekAndRead_Mmap_ReturnsFileData {
+    [self setMmap:1];
+    [self _testSeekAndRead];
+}
+
+- (void)test_GetRegion_Buffered_ReturnsFileData {
+    [self _testRegion];
+}
+
+- (void)test_GetRegion_Mmap_ReturnsFileData {
+    [self setMmap:1];
+    [self _testRegion];
+}
+
+// the access pattern of tag readers: small reads at the head and at the tail of a file
+- (void)_measureTagScan {
+    [self measureBlock:^{
+        for (int n = 0; n < 1000; n++) {
+            DB_FILE *fp = vfs_fopen (TESTFILE);
+            uint8_t buffer[128];
+            vfs_fread (buffer, 1, 10, fp);
+            vfs_get_region (fp, 10, 4096);
+            vfs_fseek (fp, -128, SEEK_END);
+            vfs_fread (buffer, 1, 3, fp);
+            vfs_fseek (fp, -32, SEEK_END);
+            vfs_fread (buffer, 1, 32, fp);
+            vfs_fseek (fp, -128-32, SEEK_END);
+            vfs_fread (buffer, 1, 32, fp);
+            vfs_fseek (fp, 0, SEEK_SET);
+            for (int i = 0; i < 64; i++) {
+                vfs_fread (buffer, 1, 16, fp);
+            }
+            vfs_fclose (fp);
+        }
+    }];
+}
+
+- (void)test_TagScan_Buffered_Performance {
+    [self _measureTagScan];
+}
+
+- (void)test_TagScan_Mmap_Performance {
+    [self setMmap:1];
+    [self _measureTagScan];
+}
+
+@end
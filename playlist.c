@@ -39,6 +39,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#ifndef __MINGW32__
+#include <sys/mman.h>
+#endif
 #include <assert.h>
 #include <time.h>
 #include <sys/time.h>
@@ -48,6 +52,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include "buffered_file_writer.h"
 #include "gettext.h"
 #include "playlist.h"
@@ -71,6 +76,9 @@
 #include "sort.h"
 #include "cueutil.h"
 #include "playmodes.h"
+#include "threadpool.h"
+#include "searchindex.h"
+#include "decoderregistry.h"
 
 // disable custom title function, until we have new title formatting (0.7)
 #define DISABLE_CUSTOM_TITLE
@@ -107,6 +115,10 @@ static int _playlists_count = 0;
 static playlist_t *_playlists_head = NULL;
 static playlist_t *_current_playlist = NULL; // current playlist
 static int _plt_loading = 0; // disable sending event about playlist switch, config regen, etc
+static ddb_task_group_t *_background_load_group; // playlists being loaded after startup
+
+static void
+_plt_search_cache_free (playlist_t *playlist);
 
 #if !DISABLE_LOCKING
 static uintptr_t _playlist_mutex;
@@ -177,6 +189,10 @@ pl_init (void) {
 
 void
 pl_free (void) {
+    if (_background_load_group) {
+        task_group_free (_background_load_group);
+        _background_load_group = NULL;
+    }
     LOCK;
     playqueue_clear ();
     _plt_loading = 1;
@@ -692,6 +708,7 @@ void
 plt_modified (playlist_t *plt) {
     pl_lock ();
     plt->modification_idx++;
+    _plt_search_cache_free (plt);
     pl_unlock ();
 }
 
@@ -708,6 +725,11 @@ plt_free (playlist_t *plt) {
     LOCK;
 
     plt_clear (plt);
+    _plt_search_cache_free (plt);
+    if (plt->search_index) {
+        search_index_free (plt->search_index);
+        plt->search_index = NULL;
+    }
 
     if (plt->title) {
         free (plt->title);
@@ -920,6 +942,28 @@ plt_insert_dir_int (
 static playItem_t *
 plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data);
 
+// Internal insert flag: the file is being added to a private playlist by a folder import worker.
+// Filters have been applied by the caller, and the listeners get notified when the items are merged.
+#define INSERT_FILE_FLAG_PROBE (1u<<31)
+
+static void
+_plt_notify_file_added (int visibility, playlist_t *plt, playItem_t *it, int *pabort) {
+    if (!file_add_listeners) {
+        return;
+    }
+    ddb_fileadd_data_t d;
+    memset (&d, 0, sizeof (d));
+    d.visibility = visibility;
+    d.plt = (ddb_playlist_t *)plt;
+    d.track = (ddb_playItem_t *)it;
+    for (ddb_fileadd_listener_t *l = file_add_listeners; l; l = l->next) {
+        if (pabort && l->callback (&d, l->user_data) < 0) {
+            *pabort = 1;
+            break;
+        }
+    }
+}
+
 int
 fileadd_filter_test (ddb_file_found_data_t *data) {
     for (ddb_fileadd_filter_t *f = file_add_filters; f; f = f->next) {
@@ -968,14 +1012,6 @@ plt_insert_file_int (
         }
     }
 
-    const char *fn = strrchr (fname, '/');
-    if (!fn) {
-        fn = fname;
-    }
-    else {
-        fn++;
-    }
-
     // add all possible streams as special-case:
     // set decoder to NULL, and filetype to "content"
     // streamer is responsible to determine content type on 1st access and
@@ -1096,96 +1132,36 @@ plt_insert_file_int (
         return inserted;
     }
 
-    int filter_done = 0;
-    int file_recognized = 0;
+    // the filters are applied before the decoder lookup, which may need to read the file
+    if (!(flags & INSERT_FILE_FLAG_PROBE)) {
+        ddb_file_found_data_t dt;
+        dt.filename = fname;
+        dt.plt = (ddb_playlist_t *)plt;
+        dt.is_dir = 0;
+        if (fileadd_filter_test (&dt) < 0) {
+            return NULL;
+        }
+    }
 
-    DB_decoder_t **decoders = plug_get_decoder_list ();
-    // match by decoder
-    for (int i = 0; decoders[i]; i++) {
-        if (decoders[i]->exts && decoders[i]->insert) {
-            const char **exts = decoders[i]->exts;
-            for (int e = 0; exts[e]; e++) {
-                if (!strcasecmp (exts[e], eol) || !strcmp (exts[e], "*")) {
-                    if (!filter_done) {
-                        ddb_file_found_data_t dt;
-                        dt.filename = fname;
-                        dt.plt = (ddb_playlist_t *)plt;
-                        dt.is_dir = 0;
-                        if (fileadd_filter_test (&dt) < 0) {
-                            return NULL;
-                        }
-                        filter_done = 1;
-                    }
+    int file_recognized = 0;
 
-                    file_recognized = 1;
+    DB_decoder_t *decoders[DECODER_REGISTRY_MAX_DECODERS];
+    int decoder_count = decoder_registry_find (fname, decoders);
+    for (int i = 0; i < decoder_count; i++) {
+        file_recognized = 1;
 
-                    playItem_t *inserted = (playItem_t *)decoders[i]->insert ((ddb_playlist_t *)plt, DB_PLAYITEM (after), fname);
-                    if (inserted != NULL) {
-                        if (callback && callback (inserted, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        else if (callback_with_result && callback_with_result(DDB_INSERT_FILE_RESULT_SUCCESS, fname, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        if (file_add_listeners) {
-                            ddb_fileadd_data_t d;
-                            memset (&d, 0, sizeof (d));
-                            d.visibility = visibility;
-                            d.plt = (ddb_playlist_t *)plt;
-                            d.track = (ddb_playItem_t *)inserted;
-                            for (ddb_fileadd_listener_t *l = file_add_listeners; l; l = l->next) {
-                                if (pabort && l->callback (&d, l->user_data) < 0) {
-                                    *pabort = 1;
-                                    break;
-                                }
-                            }
-                        }
-                        return inserted;
-                    }
-                }
+        playItem_t *inserted = (playItem_t *)decoder_registry_insert (decoders[i], (ddb_playlist_t *)plt, DB_PLAYITEM (after), fname);
+        if (inserted != NULL) {
+            if (callback && callback (inserted, user_data) < 0) {
+                *pabort = 1;
             }
-        }
-        if (decoders[i]->prefixes && decoders[i]->insert) {
-            const char **prefixes = decoders[i]->prefixes;
-            for (int e = 0; prefixes[e]; e++) {
-                if (!strncasecmp (prefixes[e], fn, strlen(prefixes[e])) && *(fn + strlen (prefixes[e])) == '.') {
-                    if (!filter_done) {
-                        ddb_file_found_data_t dt;
-                        dt.filename = fname;
-                        dt.plt = (ddb_playlist_t *)plt;
-                        dt.is_dir = 0;
-                        if (fileadd_filter_test (&dt) < 0) {
-                            return NULL;
-                        }
-                        filter_done = 1;
-                    }
-
-                    file_recognized = 1;
-                    playItem_t *inserted = (playItem_t *)decoders[i]->insert ((ddb_playlist_t *)plt, DB_PLAYITEM (after), fname);
-                    if (inserted != NULL) {
-                        if (callback && callback (inserted, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        else if (callback_with_result && callback_with_result(DDB_INSERT_FILE_RESULT_SUCCESS, fname, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        if (file_add_listeners) {
-                            ddb_fileadd_data_t d;
-                            memset (&d, 0, sizeof (d));
-                            d.visibility = visibility;
-                            d.plt = (ddb_playlist_t *)plt;
-                            d.track = (ddb_playItem_t *)inserted;
-                            for (ddb_fileadd_listener_t *l = file_add_listeners; l; l = l->next) {
-                                if (l->callback (&d, l->user_data) < 0) {
-                                    *pabort = 1;
-                                    break;
-                                }
-                            }
-                        }
-                        return inserted;
-                    }
-                }
+            else if (callback_with_result && callback_with_result(DDB_INSERT_FILE_RESULT_SUCCESS, fname, user_data) < 0) {
+                *pabort = 1;
             }
+            if (!(flags & INSERT_FILE_FLAG_PROBE)) {
+                _plt_notify_file_added (visibility, plt, inserted, pabort);
+            }
+            return inserted;
         }
     }
     if (file_recognized) {
@@ -1289,63 +1265,31 @@ _get_fullname_and_dir (char *fullname, int sz, char *dir, int dirsz, DB_vfs_t *v
     #endif
 }
 
-static playItem_t *
-plt_insert_dir_int (
-                    int visibility,
-                    uint32_t flags,
-                    playlist_t *plt,
-                    DB_vfs_t *vfs,
-                    playItem_t *after,
-                    const char *dirname,
-                    int *pabort,
-                    int (*callback)(playItem_t *it, void *data),
-                    int (*callback_with_result)(ddb_insert_file_result_t result, const char *fname, void *user_data),
-                    void *user_data
-                    ) {
-    plt->follow_symlinks = (flags&DDB_INSERT_FILE_FLAG_FOLLOW_SYMLINKS) ? 1 : 0;
-    plt->ignore_archives = (flags&DDB_INSERT_FILE_FLAG_ENTER_ARCHIVES) ? 1 : 0;
-
-    if (!strncmp (dirname, "file://", 7)) {
-        dirname += 7;
-    }
-
-    #ifdef __MINGW32__
-    // replace backslashes with normal slashes
-    char dirname_conv[strlen(dirname)+1];
-    if (strchr(dirname, '\\')) {
-        trace ("plt_insert_dir_int: backslash(es) detected: %s\n", dirname);
-        strcpy (dirname_conv, dirname);
-        char *slash_p = dirname_conv;
-        while (slash_p = strchr(slash_p, '\\')) {
-            *slash_p = '/';
-            slash_p++;
-        }
-        dirname = dirname_conv;
-    }
-    // path should start with "X:/", not "/X:/", fixing to avoid file opening problems
-    if (dirname[0] == '/' && isalpha(dirname[1]) && dirname[2] == ':') {
-        dirname++;
-    }
-    #endif
+// Returns the number of directory entries, or -1 if the directory can't be added
+static int
+_plt_scandir (playlist_t *plt, DB_vfs_t *vfs, uint32_t flags, const char *dirname, struct dirent ***pnamelist) {
+    *pnamelist = NULL;
 
     if (is_relative_path (dirname)) {
-        return NULL;
+        return -1;
     }
 
     if (!plt->follow_symlinks && !vfs) {
         struct stat buf;
         lstat (dirname, &buf);
         if (S_ISLNK(buf.st_mode)) {
-            return NULL;
+            return -1;
         }
     }
 
-    ddb_file_found_data_t dt;
-    dt.filename = dirname;
-    dt.plt = (ddb_playlist_t *)plt;
-    dt.is_dir = 1;
-    if (fileadd_filter_test (&dt) < 0) {
-        return NULL;
+    if (!(flags & INSERT_FILE_FLAG_PROBE)) {
+        ddb_file_found_data_t dt;
+        dt.filename = dirname;
+        dt.plt = (ddb_playlist_t *)plt;
+        dt.is_dir = 1;
+        if (fileadd_filter_test (&dt) < 0) {
+            return -1;
+        }
     }
 
     struct dirent **namelist = NULL;
@@ -1368,11 +1312,15 @@ plt_insert_dir_int (
         if (namelist) {
             free (namelist);
         }
-        return NULL;	// not a dir or no read access
+        return -1;	// not a dir or no read access
     }
+    *pnamelist = namelist;
+    return n;
+}
 
-    // find all cue files in the folder
-    int cuefiles[n];
+// Stores the indexes of the cue files in the cuefiles array, returns their count
+static int
+_plt_find_cuefiles (struct dirent **namelist, int n, int *cuefiles) {
     int ncuefiles = 0;
 
     for (int i = 0; i < n; i++) {
@@ -1391,180 +1339,565 @@ plt_insert_dir_int (
             cuefiles[ncuefiles++] = i;
         }
     }
+    return ncuefiles;
+}
 
-    char fullname[PATH_MAX];
-    char fulldir[PATH_MAX];
-
-    // try loading cuesheets first
-    for (int c = 0; c < ncuefiles; c++) {
-        int i = cuefiles[c];
-        _get_fullname_and_dir (fullname, sizeof (fullname), fulldir, sizeof(fulldir), vfs, dirname, namelist[i]->d_name);
+// Parallel folder import:
+// The calling thread walks the directory tree, applies the filters, and loads the cuesheets.
+// Meanwhile the files are probed by the thread pool workers, each into a private playlist.
+// The decoders which don't set DDB_PLUGIN_FLAG_CONCURRENT_INSERT probe one file at a time.
+// The calling thread moves the probed items to the target playlist in the original order,
+// and reports them to the callbacks and listeners, as if the files were added one by one.
 
-        playItem_t *inserted = plt_load_cue_file (plt, after, fullname, fulldir, namelist, n);
-        namelist[i]->d_name[0] = 0;
+// how many probed files can wait for the merge
+#define IMPORT_MAX_PENDING_JOBS 1024
 
-        if (inserted) {
-            after = inserted;
-        }
-        if (pabort && *pabort) {
-            break;
-        }
-    }
+typedef struct import_result_s {
+    ddb_insert_file_result_t result;
+    char *fname;
+    struct import_result_s *next;
+} import_result_t;
 
-    // load the rest of the files
-    if (!pabort || !*pabort) {
-        for (int i = 0; i < n; i++) {
-            // no hidden files
-            if (!namelist[i]->d_name[0] || namelist[i]->d_name[0] == '.') {
-                continue;
-            }
-            _get_fullname_and_dir (fullname, sizeof (fullname), NULL, 0, vfs, dirname, namelist[i]->d_name);
-            playItem_t *inserted = NULL;
-            if (!vfs) {
-                inserted = plt_insert_dir_int (visibility, flags, plt, vfs, after, fullname, pabort, callback, callback_with_result, user_data);
-            }
-            if (!inserted) {
-                inserted = plt_insert_file_int (visibility, flags, plt, after, fullname, pabort, callback, callback_with_result, user_data);
-            }
+typedef struct import_job_s {
+    struct import_s *import;
+    char *fname; // NULL for cuesheets, which are loaded by the walker
+    playlist_t *plt; // private playlist receiving the items
+    import_result_t *results; // reported by plt_insert_file_int during probing
+    import_result_t *results_tail;
+    int done;
+    struct import_job_s *next;
+} import_job_t;
 
-            if (inserted) {
-                after = inserted;
-            }
+typedef struct import_s {
+    int visibility;
+    uint32_t flags;
+    playlist_t *plt;
+    playItem_t *after;
+    int *pabort;
+    int (*callback)(playItem_t *it, void *data);
+    int (*callback_with_result)(ddb_insert_file_result_t result, const char *fname, void *user_data);
+    void *user_data;
 
-            if (pabort && *pabort) {
-                break;
-            }
-        }
-    }
+    ddb_task_group_t *group;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    import_job_t *head; // oldest job which is not merged yet
+    import_job_t *tail;
+    int pending_count;
 
-    // free data
-    for (int i = 0; i < n; i++) {
-        free (namelist[i]);
-    }
-    free (namelist);
+    int file_count;
+    int item_count;
+} import_t;
 
-    return after;
+static int
+_plt_parallel_import_enabled (void) {
+    return conf_get_int ("add_folders_parallel", 1) && threadpool_get_worker_count () > 0;
 }
 
-playItem_t *
-plt_insert_dir (playlist_t *playlist, playItem_t *after, const char *dirname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
-
-    playItem_t *ret = plt_insert_dir_int (0, _get_insert_file_flags_from_config(), playlist, NULL, after, dirname, pabort, cb, NULL, user_data);
-
-    return ret;
+static int
+_import_aborted (import_t *imp) {
+    return imp->pabort && *imp->pabort;
 }
 
 static int
-plt_add_file_int (int visibility, uint32_t flags, playlist_t *plt, const char *fname, int (*cb)(playItem_t *it, void *data), void *user_data) {
-    int abort = 0;
-    playItem_t *it = plt_insert_file_int (visibility, flags, plt, plt->tail[PL_MAIN], fname, &abort, cb, NULL, user_data);
-    if (it) {
-        // pl_insert_file doesn't hold reference, don't unref here
-        return 0;
+_import_record_result (ddb_insert_file_result_t result, const char *fname, void *user_data) {
+    import_job_t *job = user_data;
+    import_result_t *res = calloc (1, sizeof (import_result_t));
+    res->result = result;
+    res->fname = strdup (fname ? fname : "");
+    if (job->results_tail) {
+        job->results_tail->next = res;
     }
-    return -1;
-}
-
-int
-plt_add_file (playlist_t *plt, const char *fname, int (*cb)(playItem_t *it, void *data), void *user_data) {
-    return plt_add_file_int (0, _get_insert_file_flags_from_config(), plt, fname, cb, user_data);
+    else {
+        job->results = res;
+    }
+    job->results_tail = res;
+    return 0;
 }
 
-int
-plt_add_dir (playlist_t *plt, const char *dirname, int (*cb)(playItem_t *it, void *data), void *user_data) {
-    int abort = 0;
-    playItem_t *it = plt_insert_dir (plt, plt->tail[PL_MAIN], dirname, &abort, cb, user_data);
-    if (it) {
-        // pl_insert_file doesn't hold reference, don't unref here
-        return 0;
+static void
+_import_probe (void *ctx) {
+    import_job_t *job = ctx;
+    import_t *imp = job->import;
+    if (!_import_aborted (imp)) {
+        int abort = 0;
+        plt_insert_file_int (imp->visibility, imp->flags | INSERT_FILE_FLAG_PROBE, job->plt, NULL, job->fname, &abort, NULL, _import_record_result, job);
+    }
+    pthread_mutex_lock (&imp->mutex);
+    job->done = 1;
+    pthread_cond_broadcast (&imp->cond);
+    pthread_mutex_unlock (&imp->mutex);
+}
+
+static import_job_t *
+_import_job_alloc (import_t *imp, const char *fname) {
+    import_job_t *job = calloc (1, sizeof (import_job_t));
+    job->import = imp;
+    job->fname = fname ? strdup (fname) : NULL;
+    job->plt = plt_alloc ("");
+    job->plt->follow_symlinks = imp->plt->follow_symlinks;
+    job->plt->ignore_archives = imp->plt->ignore_archives;
+
+    if (imp->tail) {
+        imp->tail->next = job;
     }
-    return -1;
+    else {
+        imp->head = job;
+    }
+    imp->tail = job;
+    imp->pending_count++;
+    return job;
 }
 
-int
-pl_add_files_begin (playlist_t *plt) {
-    return plt_add_files_begin (plt, 0);
+static void
+_import_job_free (import_job_t *job) {
+    while (job->results) {
+        import_result_t *next = job->results->next;
+        free (job->results->fname);
+        free (job->results);
+        job->results = next;
+    }
+    plt_unref (job->plt);
+    free (job->fname);
+    free (job);
 }
 
-void
-pl_add_files_end (void) {
-    return plt_add_files_end (addfiles_playlist, 0);
-}
+// Moves the items of the oldest job to the target playlist.
+// Returns 0 if the job was merged, -1 if it's not done yet and wait is 0.
+static int
+_import_merge_head (import_t *imp, int wait) {
+    import_job_t *job = imp->head;
 
-int
-plt_remove_item (playlist_t *playlist, playItem_t *it) {
-    if (!it)
+    pthread_mutex_lock (&imp->mutex);
+    while (!job->done && wait) {
+        pthread_cond_wait (&imp->cond, &imp->mutex);
+    }
+    int done = job->done;
+    pthread_mutex_unlock (&imp->mutex);
+    if (!done) {
         return -1;
+    }
 
-    if (!no_remove_notify) {
-        streamer_song_removed_notify (it);
-        playqueue_remove (it);
+    imp->head = job->next;
+    if (!imp->head) {
+        imp->tail = NULL;
     }
+    imp->pending_count--;
 
-    // remove from both lists
+    // the items keep the reference held by the private playlist, until inserted into the target
     LOCK;
-    for (int iter = PL_MAIN; iter <= PL_SEARCH; iter++) {
-        if (it->prev[iter] || it->next[iter] || playlist->head[iter] == it || playlist->tail[iter] == it) {
-            playlist->count[iter]--;
-        }
-
-        playItem_t *next = it->next[iter];
-        playItem_t *prev = it->prev[iter];
-
-        if (prev) {
-            prev->next[iter] = next;
-        }
-        else {
-            playlist->head[iter] = next;
-        }
+    playItem_t *last = NULL;
+    playItem_t *it = job->plt->head[PL_MAIN];
+    job->plt->head[PL_MAIN] = job->plt->tail[PL_MAIN] = NULL;
+    job->plt->count[PL_MAIN] = 0;
+    while (it) {
+        playItem_t *next = it->next[PL_MAIN];
+        it->next[PL_MAIN] = it->prev[PL_MAIN] = NULL;
+        plt_insert_item (imp->plt, imp->after, it);
+        imp->after = last = it;
+        imp->item_count++;
         if (next) {
-            next->prev[iter] = prev;
-        }
-        else {
-            playlist->tail[iter] = prev;
+            pl_item_unref (it);
         }
-
-        it->next[iter] = NULL;
-        it->prev[iter] = NULL;
+        it = next;
     }
+    UNLOCK;
 
-    float dur = pl_get_item_duration (it);
-    if (dur > 0) {
-        // totaltime
-        playlist->totaltime -= dur;
-        if (playlist->totaltime < 0) {
-            playlist->totaltime = 0;
+    // cuesheets found in the folder are not reported, same as when adding the files one by one
+    if (job->fname) {
+        imp->file_count++;
+        if (last && imp->callback && imp->callback (last, imp->user_data) < 0) {
+            if (imp->pabort) {
+                *imp->pabort = 1;
+            }
         }
-
-        // selected time
-        if (it->selected) {
-            playlist->seltime -= dur;
-            if (playlist->seltime < 0) {
-                playlist->seltime = 0;
+        for (import_result_t *res = job->results; res; res = res->next) {
+            if (res->result == DDB_INSERT_FILE_RESULT_SUCCESS && imp->callback) {
+                continue;
+            }
+            if (imp->callback_with_result && imp->callback_with_result (res->result, res->fname, imp->user_data) < 0 && res->result == DDB_INSERT_FILE_RESULT_SUCCESS) {
+                if (imp->pabort) {
+                    *imp->pabort = 1;
+                }
             }
         }
+        if (last) {
+            _plt_notify_file_added (imp->visibility, imp->plt, last, imp->pabort);
+        }
+    }
+    if (last) {
+        pl_item_unref (last);
     }
 
-    plt_modified (playlist);
-    pl_item_unref (it);
-    UNLOCK;
+    _import_job_free (job);
     return 0;
 }
 
-int
-plt_get_item_count (playlist_t *plt, int iter) {
-    return plt->count[iter];
-}
+static void
+_import_enqueue_file (import_t *imp, const char *fname) {
+    // same as plt_insert_file_int, the filters are applied before probing
+    if (file_add_filters) {
+        ddb_file_found_data_t dt;
+        dt.filename = fname;
+        dt.plt = (ddb_playlist_t *)imp->plt;
+        dt.is_dir = 0;
+        if (fileadd_filter_test (&dt) < 0) {
+            return;
+        }
+    }
 
-int
-pl_getcount (int iter) {
-    LOCK;
-    if (!_current_playlist) {
-        UNLOCK;
-        return 0;
+    import_job_t *job = _import_job_alloc (imp, fname);
+    if (task_group_submit (imp->group, _import_probe, job) < 0) {
+        _import_probe (job);
     }
 
-    int cnt = _current_playlist->count[iter];
+    // merge what's ready, and don't let the walker run too far ahead
+    while (imp->head && !_import_aborted (imp)) {
+        if (_import_merge_head (imp, imp->pending_count > IMPORT_MAX_PENDING_JOBS) < 0) {
+            break;
+        }
+    }
+}
+
+// Returns -1 if dirname is not a directory which can be added
+static int
+_import_walk_dir (import_t *imp, const char *dirname) {
+    struct dirent **namelist = NULL;
+    int n = _plt_scandir (imp->plt, NULL, imp->flags, dirname, &namelist);
+    if (n < 0) {
+        return -1;
+    }
+
+    char fullname[PATH_MAX];
+    char fulldir[PATH_MAX];
+
+    // resolve the directory once for all entries
+    _get_fullname_and_dir (fullname, sizeof (fullname), fulldir, sizeof (fulldir), NULL, dirname, "");
+
+    // try loading cuesheets first
+    int cuefiles[n];
+    int ncuefiles = _plt_find_cuefiles (namelist, n, cuefiles);
+    for (int c = 0; c < ncuefiles && !_import_aborted (imp); c++) {
+        int i = cuefiles[c];
+        snprintf (fullname, sizeof (fullname), "%s/%s", fulldir, namelist[i]->d_name);
+
+        import_job_t *job = _import_job_alloc (imp, NULL);
+        plt_load_cue_file (job->plt, NULL, fullname, fulldir, namelist, n);
+        job->done = 1;
+        namelist[i]->d_name[0] = 0;
+    }
+
+    // the rest of the files
+    for (int i = 0; i < n && !_import_aborted (imp); i++) {
+        // no hidden files
+        if (!namelist[i]->d_name[0] || namelist[i]->d_name[0] == '.') {
+            continue;
+        }
+        snprintf (fullname, sizeof (fullname), "%s/%s", fulldir, namelist[i]->d_name);
+        #if !defined(__MINGW32__) && !defined(__SVR4)
+        if (namelist[i]->d_type == DT_REG) {
+            // no need to try opening regular files as directories
+            _import_enqueue_file (imp, fullname);
+            continue;
+        }
+        #endif
+        if (_import_walk_dir (imp, fullname) < 0) {
+            _import_enqueue_file (imp, fullname);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        free (namelist[i]);
+    }
+    free (namelist);
+    return 0;
+}
+
+static playItem_t *
+_plt_import_dir (
+                 int visibility,
+                 uint32_t flags,
+                 playlist_t *plt,
+                 playItem_t *after,
+                 const char *dirname,
+                 int *pabort,
+                 int (*callback)(playItem_t *it, void *data),
+                 int (*callback_with_result)(ddb_insert_file_result_t result, const char *fname, void *user_data),
+                 void *user_data
+                 ) {
+    import_t imp = {
+        .visibility = visibility,
+        .flags = flags,
+        .plt = plt,
+        .after = after,
+        .pabort = pabort,
+        .callback = callback,
+        .callback_with_result = callback_with_result,
+        .user_data = user_data,
+    };
+    imp.group = task_group_create ("folder import", DDB_TASK_PRIORITY_NORMAL, 0);
+    pthread_mutex_init (&imp.mutex, NULL);
+    pthread_cond_init (&imp.cond, NULL);
+
+    struct timeval tm1, tm2;
+    gettimeofday (&tm1, NULL);
+
+    int res = _import_walk_dir (&imp, dirname);
+
+    while (imp.head && !_import_aborted (&imp)) {
+        _import_merge_head (&imp, 1);
+    }
+
+    // drops the remaining probes, if aborted
+    task_group_free (imp.group);
+    while (imp.head) {
+        import_job_t *next = imp.head->next;
+        _import_job_free (imp.head);
+        imp.head = next;
+    }
+    pthread_cond_destroy (&imp.cond);
+    pthread_mutex_destroy (&imp.mutex);
+
+    gettimeofday (&tm2, NULL);
+    int64_t ms = (int64_t)(tm2.tv_sec - tm1.tv_sec) * 1000 + (tm2.tv_usec - tm1.tv_usec) / 1000;
+    trace ("folder import: %s: %d files, %d tracks in %lld ms\n", dirname, imp.file_count, imp.item_count, (long long)ms);
+
+    if (res < 0) {
+        return NULL;
+    }
+    return imp.after;
+}
+
+static playItem_t *
+plt_insert_dir_int (
+                    int visibility,
+                    uint32_t flags,
+                    playlist_t *plt,
+                    DB_vfs_t *vfs,
+                    playItem_t *after,
+                    const char *dirname,
+                    int *pabort,
+                    int (*callback)(playItem_t *it, void *data),
+                    int (*callback_with_result)(ddb_insert_file_result_t result, const char *fname, void *user_data),
+                    void *user_data
+                    ) {
+    plt->follow_symlinks = (flags&DDB_INSERT_FILE_FLAG_FOLLOW_SYMLINKS) ? 1 : 0;
+    plt->ignore_archives = (flags&DDB_INSERT_FILE_FLAG_ENTER_ARCHIVES) ? 1 : 0;
+
+    if (!strncmp (dirname, "file://", 7)) {
+        dirname += 7;
+    }
+
+    #ifdef __MINGW32__
+    // replace backslashes with normal slashes
+    char dirname_conv[strlen(dirname)+1];
+    if (strchr(dirname, '\\')) {
+        trace ("plt_insert_dir_int: backslash(es) detected: %s\n", dirname);
+        strcpy (dirname_conv, dirname);
+        char *slash_p = dirname_conv;
+        while (slash_p = strchr(slash_p, '\\')) {
+            *slash_p = '/';
+            slash_p++;
+        }
+        dirname = dirname_conv;
+    }
+    // path should start with "X:/", not "/X:/", fixing to avoid file opening problems
+    if (dirname[0] == '/' && isalpha(dirname[1]) && dirname[2] == ':') {
+        dirname++;
+    }
+    #endif
+
+    if (!vfs && !(flags & INSERT_FILE_FLAG_PROBE) && _plt_parallel_import_enabled ()) {
+        return _plt_import_dir (visibility, flags, plt, after, dirname, pabort, callback, callback_with_result, user_data);
+    }
+
+    struct dirent **namelist = NULL;
+    int n = _plt_scandir (plt, vfs, flags, dirname, &namelist);
+    if (n < 0) {
+        return NULL;
+    }
+
+    // find all cue files in the folder
+    int cuefiles[n];
+    int ncuefiles = _plt_find_cuefiles (namelist, n, cuefiles);
+
+    char fullname[PATH_MAX];
+    char fulldir[PATH_MAX];
+
+    // try loading cuesheets first
+    for (int c = 0; c < ncuefiles; c++) {
+        int i = cuefiles[c];
+        _get_fullname_and_dir (fullname, sizeof (fullname), fulldir, sizeof(fulldir), vfs, dirname, namelist[i]->d_name);
+
+        playItem_t *inserted = plt_load_cue_file (plt, after, fullname, fulldir, namelist, n);
+        namelist[i]->d_name[0] = 0;
+
+        if (inserted) {
+            after = inserted;
+        }
+        if (pabort && *pabort) {
+            break;
+        }
+    }
+
+    // load the rest of the files
+    if (!pabort || !*pabort) {
+        for (int i = 0; i < n; i++) {
+            // no hidden files
+            if (!namelist[i]->d_name[0] || namelist[i]->d_name[0] == '.') {
+                continue;
+            }
+            _get_fullname_and_dir (fullname, sizeof (fullname), NULL, 0, vfs, dirname, namelist[i]->d_name);
+            playItem_t *inserted = NULL;
+            if (!vfs) {
+                inserted = plt_insert_dir_int (visibility, flags, plt, vfs, after, fullname, pabort, callback, callback_with_result, user_data);
+            }
+            if (!inserted) {
+                inserted = plt_insert_file_int (visibility, flags, plt, after, fullname, pabort, callback, callback_with_result, user_data);
+            }
+
+            if (inserted) {
+                after = inserted;
+            }
+
+            if (pabort && *pabort) {
+                break;
+            }
+        }
+    }
+
+    // free data
+    for (int i = 0; i < n; i++) {
+        free (namelist[i]);
+    }
+    free (namelist);
+
+    return after;
+}
+
+playItem_t *
+plt_insert_dir (playlist_t *playlist, playItem_t *after, const char *dirname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
+
+    playItem_t *ret = plt_insert_dir_int (0, _get_insert_file_flags_from_config(), playlist, NULL, after, dirname, pabort, cb, NULL, user_data);
+
+    return ret;
+}
+
+static int
+plt_add_file_int (int visibility, uint32_t flags, playlist_t *plt, const char *fname, int (*cb)(playItem_t *it, void *data), void *user_data) {
+    int abort = 0;
+    playItem_t *it = plt_insert_file_int (visibility, flags, plt, plt->tail[PL_MAIN], fname, &abort, cb, NULL, user_data);
+    if (it) {
+        // pl_insert_file doesn't hold reference, don't unref here
+        return 0;
+    }
+    return -1;
+}
+
+int
+plt_add_file (playlist_t *plt, const char *fname, int (*cb)(playItem_t *it, void *data), void *user_data) {
+    return plt_add_file_int (0, _get_insert_file_flags_from_config(), plt, fname, cb, user_data);
+}
+
+int
+plt_add_dir (playlist_t *plt, const char *dirname, int (*cb)(playItem_t *it, void *data), void *user_data) {
+    int abort = 0;
+    playItem_t *it = plt_insert_dir (plt, plt->tail[PL_MAIN], dirname, &abort, cb, user_data);
+    if (it) {
+        // pl_insert_file doesn't hold reference, don't unref here
+        return 0;
+    }
+    return -1;
+}
+
+int
+pl_add_files_begin (playlist_t *plt) {
+    return plt_add_files_begin (plt, 0);
+}
+
+void
+pl_add_files_end (void) {
+    return plt_add_files_end (addfiles_playlist, 0);
+}
+
+int
+plt_remove_item (playlist_t *playlist, playItem_t *it) {
+    if (!it)
+        return -1;
+
+    if (!no_remove_notify) {
+        streamer_song_removed_notify (it);
+        playqueue_remove (it);
+    }
+
+    // remove from both lists
+    LOCK;
+    _plt_search_cache_free (playlist);
+    if (playlist->search_index) {
+        search_index_remove_item (playlist->search_index, it);
+    }
+    for (int iter = PL_MAIN; iter <= PL_SEARCH; iter++) {
+        if (it->prev[iter] || it->next[iter] || playlist->head[iter] == it || playlist->tail[iter] == it) {
+            playlist->count[iter]--;
+        }
+
+        playItem_t *next = it->next[iter];
+        playItem_t *prev = it->prev[iter];
+
+        if (prev) {
+            prev->next[iter] = next;
+        }
+        else {
+            playlist->head[iter] = next;
+        }
+        if (next) {
+            next->prev[iter] = prev;
+        }
+        else {
+            playlist->tail[iter] = prev;
+        }
+
+        it->next[iter] = NULL;
+        it->prev[iter] = NULL;
+    }
+
+    float dur = pl_get_item_duration (it);
+    if (dur > 0) {
+        // totaltime
+        playlist->totaltime -= dur;
+        if (playlist->totaltime < 0) {
+            playlist->totaltime = 0;
+        }
+
+        // selected time
+        if (it->selected) {
+            playlist->seltime -= dur;
+            if (playlist->seltime < 0) {
+                playlist->seltime = 0;
+            }
+        }
+    }
+
+    plt_modified (playlist);
+    pl_item_unref (it);
+    UNLOCK;
+    return 0;
+}
+
+int
+plt_get_item_count (playlist_t *plt, int iter) {
+    return plt->count[iter];
+}
+
+int
+pl_getcount (int iter) {
+    LOCK;
+    if (!_current_playlist) {
+        UNLOCK;
+        return 0;
+    }
+
+    int cnt = _current_playlist->count[iter];
     UNLOCK;
     return cnt;
 }
@@ -1654,6 +1987,7 @@ pl_get_idx_of_iter (playItem_t *it, int iter) {
 playItem_t *
 plt_insert_item (playlist_t *playlist, playItem_t *after, playItem_t *it) {
     LOCK;
+    _plt_search_cache_free (playlist);
     pl_item_ref (it);
     if (!after) {
         it->next[PL_MAIN] = playlist->head[PL_MAIN];
@@ -1681,6 +2015,10 @@ plt_insert_item (playlist_t *playlist, playItem_t *after, playItem_t *it) {
 
     playlist->count[PL_MAIN]++;
 
+    if (playlist->search_index) {
+        search_index_add_item (playlist->search_index, it);
+    }
+
     // shuffle
     playItem_t *prev = it->prev[PL_MAIN];
     const char *aa = NULL, *prev_aa = NULL;
@@ -1865,42 +2203,187 @@ length_to_uint8 (size_t len) {
     return (uint8_t)min(0xff, len);
 }
 
-int
-plt_save (playlist_t *plt, playItem_t *first, playItem_t *last, const char *fname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
-    LOCK;
-    plt->last_save_modification_idx = plt->modification_idx;
-    const char *ext = strrchr (fname, '.');
-    if (ext) {
-        DB_playlist_t **plug = deadbeef->plug_get_playlist_list ();
-        for (int i = 0; plug[i]; i++) {
-            if (plug[i]->extensions && plug[i]->load) {
-                const char **exts = plug[i]->extensions;
-                if (exts && plug[i]->save) {
-                    for (int e = 0; exts[e]; e++) {
-                        if (!strcasecmp (exts[e], ext+1)) {
-                            int res = plug[i]->save ((ddb_playlist_t *)plt, fname, (DB_playItem_t *)_current_playlist->head[PL_MAIN], NULL);
-                            UNLOCK;
-                            return res;
-                        }
-                    }
-                }
+// The playlist items at the time of the snapshot, and a copy of the playlist metadata.
+// The items are referenced, not copied: their metadata is serialized one item at a time,
+// each under a short playlist lock, so the lock is not held for the whole playlist.
+typedef struct {
+    playItem_t **items;
+    uint32_t count;
+    DB_metaInfo_t *meta;
+} plt_contents_t;
+
+// Must be called with the playlist locked.
+static void
+_plt_contents_copy (playlist_t *plt, plt_contents_t *contents, int (*cb)(playItem_t *it, void *data), void *user_data) {
+    memset (contents, 0, sizeof (plt_contents_t));
+    contents->items = malloc (plt->count[PL_MAIN] * sizeof (playItem_t *) + 1);
+    for (playItem_t *it = plt->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
+        if (cb) {
+            cb(it, user_data);
+        }
+        pl_item_ref (it);
+        contents->items[contents->count++] = it;
+    }
+
+    DB_metaInfo_t *tail = NULL;
+    for (DB_metaInfo_t *m = plt->meta; m; m = m->next) {
+        DB_metaInfo_t *copy = calloc (1, sizeof (DB_metaInfo_t));
+        copy->key = metacache_add_string (m->key);
+        copy->value = metacache_add_string (m->value);
+        if (tail) {
+            tail->next = copy;
+        }
+        else {
+            contents->meta = copy;
+        }
+        tail = copy;
+    }
+}
+
+static void
+_plt_contents_free (plt_contents_t *contents) {
+    for (uint32_t i = 0; i < contents->count; i++) {
+        pl_item_unref (contents->items[i]);
+    }
+    free (contents->items);
+    while (contents->meta) {
+        DB_metaInfo_t *m = contents->meta;
+        contents->meta = m->next;
+        metacache_remove_string (m->key);
+        metacache_remove_string (m->value);
+        free (m);
+    }
+    memset (contents, 0, sizeof (plt_contents_t));
+}
+
+// Serialize one playlist item.
+// Must be called with the playlist locked.
+static int
+_plt_save_item (buffered_file_writer_t *writer, playItem_t *it) {
+    uint16_t l;
+    uint8_t ll;
+#if (PLAYLIST_MINOR_VER==2)
+    const char *item_uri = pl_find_meta_raw (it, ":URI");
+    l = length_to_uint16(strlen (item_uri));
+    if (buffered_file_writer_write(writer, &l, 2) < 0) {
+        return -1;
+    }
+    if (buffered_file_writer_write(writer, item_uri, l) < 0) {
+        return -1;
+    }
+    const char *decoder_id = pl_find_meta_raw (it, ":DECODER");
+    if (decoder_id) {
+        ll = length_to_uint8(strlen (decoder_id));
+        if (buffered_file_writer_write(writer, &ll, 1) < 0) {
+            return -1;
+        }
+        if (buffered_file_writer_write(writer, decoder_id, ll) < 0) {
+            return -1;
+        }
+    }
+    else
+    {
+        ll = 0;
+        if (buffered_file_writer_write(writer, &ll, 1) < 0) {
+            return -1;
+        }
+    }
+    l = length_to_uint8(pl_find_meta_int (it, ":TRACKNUM", 0));
+    if (buffered_file_writer_write(writer, &l, 2) < 0) {
+        return -1;
+    }
+#endif
+    if (buffered_file_writer_write(writer, &it->startsample, 4) < 0) {
+        return -1;
+    }
+    if (buffered_file_writer_write(writer, &it->endsample, 4) < 0) {
+        return -1;
+    }
+    if (buffered_file_writer_write(writer, &it->_duration, 4) < 0) {
+        return -1;
+    }
+#if (PLAYLIST_MINOR_VER==2)
+    const char *filetype = pl_find_meta_raw (it, ":FILETYPE");
+    if (!filetype) {
+        filetype = "";
+    }
+    uint8_t ft = length_to_uint8(strlen (filetype));
+    if (buffered_file_writer_write(writer, &ft, 1) < 0) {
+        return -1;
+    }
+    if (ft) {
+        if (buffered_file_writer_write(writer, filetype, ft) < 0) {
+            return -1;
+        }
+    }
+    float rg_albumgain = pl_get_item_replaygain (it, DDB_REPLAYGAIN_ALBUMGAIN);
+    float rg_albumpeak = pl_get_item_replaygain (it, DDB_REPLAYGAIN_ALBUMPEAK);
+    float rg_trackgain = pl_get_item_replaygain (it, DDB_REPLAYGAIN_TRACKGAIN);
+    float rg_trackpeak = pl_get_item_replaygain (it, DDB_REPLAYGAIN_TRACKPEAK);
+    if (buffered_file_writer_write(writer, &rg_albumgain, 4) < 0) {
+        return -1;
+    }
+    if (buffered_file_writer_write(writer, &rg_albumpeak, 4) < 0) {
+        return -1;
+    }
+    if (buffered_file_writer_write(writer, &rg_trackgain, 4) < 0) {
+        return -1;
+    }
+    if (buffered_file_writer_write(writer, &rg_trackpeak, 4) < 0) {
+        return -1;
+    }
+#endif
+    if (buffered_file_writer_write(writer, &it->_flags, 4) < 0) {
+        return -1;
+    }
+
+    int16_t nm = 0;
+    DB_metaInfo_t *m;
+    for (m = it->meta; m; m = m->next) {
+        if (m->key[0] == '_' || m->key[0] == '!') {
+            continue; // skip reserved names
+        }
+        nm++;
+    }
+    if (buffered_file_writer_write(writer, &nm, 2) < 0) {
+        return -1;
+    }
+    for (m = it->meta; m; m = m->next) {
+        if (m->key[0] == '_' || m->key[0] == '!') {
+            continue; // skip reserved names
+        }
+
+        l = length_to_uint16(strlen (m->key));
+        if (buffered_file_writer_write(writer, &l, 2) < 0) {
+            return -1;
+        }
+        if (l) {
+            if (buffered_file_writer_write(writer, m->key, l) < 0) {
+                return -1;
+            }
+        }
+        int value_length = max(0, m->valuesize - 1);
+        l = length_to_uint16(value_length);
+        if (buffered_file_writer_write(writer, &l, 2) < 0) {
+            return -1;
+        }
+        if (l) {
+            if (buffered_file_writer_write(writer, m->value, l) < 0) {
+                return -1;
             }
         }
     }
+    return 0;
+}
 
-    char tempfile[PATH_MAX];
-    snprintf (tempfile, sizeof (tempfile), "%s.tmp", fname);
+// Serialize the playlist snapshot into memory.
+// Must be called without the playlist lock, which is only taken for each item.
+static buffered_file_writer_t *
+_plt_save_snapshot (plt_contents_t *contents) {
     const char magic[] = "DBPL";
     uint8_t majorver = PLAYLIST_MAJOR_VER;
     uint8_t minorver = PLAYLIST_MINOR_VER;
-    buffered_file_writer_t *writer = NULL;
-    FILE *fp = fopen (tempfile, "w+b");
-    if (!fp) {
-        UNLOCK;
-        return -1;
-    }
-
-    writer = buffered_file_writer_new(fp, 64*1024);
+    buffered_file_writer_t *writer = buffered_file_writer_new (NULL, 64*1024);
 
     if (buffered_file_writer_write(writer, magic, 4) < 0) {
         goto save_fail;
@@ -1911,140 +2394,30 @@ plt_save (playlist_t *plt, playItem_t *first, playItem_t *last, const char *fnam
     if (buffered_file_writer_write(writer, &minorver, 1) < 0) {
         goto save_fail;
     }
-    uint32_t cnt = plt->count[PL_MAIN];
+    uint32_t cnt = contents->count;
     if (buffered_file_writer_write(writer, &cnt, 4) < 0) {
         goto save_fail;
     }
-    for (playItem_t *it = plt->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
-        uint16_t l;
-        uint8_t ll;
-        if (cb) {
-            cb(it, user_data);
-        }
-#if (PLAYLIST_MINOR_VER==2)
-        const char *item_uri = pl_find_meta_raw (it, ":URI");
-        l = length_to_uint16(strlen (item_uri));
-        if (buffered_file_writer_write(writer, &l, 2) < 0) {
-            goto save_fail;
-        }
-        if (buffered_file_writer_write(writer, item_uri, l) < 0) {
-            goto save_fail;
-        }
-        const char *decoder_id = pl_find_meta_raw (it, ":DECODER");
-        if (decoder_id) {
-            ll = length_to_uint8(strlen (decoder_id));
-            if (buffered_file_writer_write(writer, &ll, 1) < 0) {
-                goto save_fail;
-            }
-            if (buffered_file_writer_write(writer, decoder_id, ll) < 0) {
-                goto save_fail;
-            }
-        }
-        else
-        {
-            ll = 0;
-            if (buffered_file_writer_write(writer, &ll, 1) < 0) {
-                goto save_fail;
-            }
-        }
-        l = length_to_uint8(pl_find_meta_int (it, ":TRACKNUM", 0));
-        if (buffered_file_writer_write(writer, &l, 2) < 0) {
-            goto save_fail;
-        }
-#endif
-        if (buffered_file_writer_write(writer, &it->startsample, 4) < 0) {
-            goto save_fail;
-        }
-        if (buffered_file_writer_write(writer, &it->endsample, 4) < 0) {
-            goto save_fail;
-        }
-        if (buffered_file_writer_write(writer, &it->_duration, 4) < 0) {
-            goto save_fail;
-        }
-#if (PLAYLIST_MINOR_VER==2)
-        const char *filetype = pl_find_meta_raw (it, ":FILETYPE");
-        if (!filetype) {
-            filetype = "";
-        }
-        uint8_t ft = length_to_uint8(strlen (filetype));
-        if (buffered_file_writer_write(writer, &ft, 1) < 0) {
-            goto save_fail;
-        }
-        if (ft) {
-            if (buffered_file_writer_write(writer, filetype, ft) < 0) {
-                goto save_fail;
-            }
-        }
-        float rg_albumgain = pl_get_item_replaygain (it, DDB_REPLAYGAIN_ALBUMGAIN);
-        float rg_albumpeak = pl_get_item_replaygain (it, DDB_REPLAYGAIN_ALBUMPEAK);
-        float rg_trackgain = pl_get_item_replaygain (it, DDB_REPLAYGAIN_TRACKGAIN);
-        float rg_trackpeak = pl_get_item_replaygain (it, DDB_REPLAYGAIN_TRACKPEAK);
-        if (buffered_file_writer_write(writer, &rg_albumgain, 4) < 0) {
-            goto save_fail;
-        }
-        if (buffered_file_writer_write(writer, &rg_albumpeak, 4) < 0) {
-            goto save_fail;
-        }
-        if (buffered_file_writer_write(writer, &rg_trackgain, 4) < 0) {
-            goto save_fail;
-        }
-        if (buffered_file_writer_write(writer, &rg_trackpeak, 4) < 0) {
-            goto save_fail;
-        }
-#endif
-        if (buffered_file_writer_write(writer, &it->_flags, 4) < 0) {
-            goto save_fail;
-        }
-
-        int16_t nm = 0;
-        DB_metaInfo_t *m;
-        for (m = it->meta; m; m = m->next) {
-            if (m->key[0] == '_' || m->key[0] == '!') {
-                continue; // skip reserved names
-            }
-            nm++;
-        }
-        if (buffered_file_writer_write(writer, &nm, 2) < 0) {
+    for (uint32_t i = 0; i < contents->count; i++) {
+        pl_lock ();
+        int res = _plt_save_item (writer, contents->items[i]);
+        pl_unlock ();
+        if (res < 0) {
             goto save_fail;
         }
-        for (m = it->meta; m; m = m->next) {
-            if (m->key[0] == '_' || m->key[0] == '!') {
-                continue; // skip reserved names
-            }
-
-            l = length_to_uint16(strlen (m->key));
-            if (buffered_file_writer_write(writer, &l, 2) < 0) {
-                goto save_fail;
-            }
-            if (l) {
-                if (buffered_file_writer_write(writer, m->key, l) < 0) {
-                    goto save_fail;
-                }
-            }
-            int value_length = max(0, m->valuesize - 1);
-            l = length_to_uint16(value_length);
-            if (buffered_file_writer_write(writer, &l, 2) < 0) {
-                goto save_fail;
-            }
-            if (l) {
-                if (buffered_file_writer_write(writer, m->value, l) < 0) {
-                    goto save_fail;
-                }
-            }
-        }
     }
 
     // write playlist metadata
     int16_t nm = 0;
     DB_metaInfo_t *m;
-    for (m = plt->meta; m; m = m->next) {
+    for (m = contents->meta; m; m = m->next) {
         nm++;
     }
     if (buffered_file_writer_write(writer, &nm, 2) < 0) {
         goto save_fail;
     }
 
-    for (m = plt->meta; m; m = m->next) {
+    for (m = contents->meta; m; m = m->next) {
         uint16_t l;
         l = length_to_uint16(strlen (m->key));
         if (buffered_file_writer_write(writer, &l, 2) < 0) {
@@ -2066,31 +2439,174 @@ plt_save (playlist_t *plt, playItem_t *first, playItem_t *last, const char *fnam
         }
     }
 
-    if (buffered_file_writer_flush(writer) < 0) {
-        goto save_fail;
-    }
+    return writer;
+save_fail:
     buffered_file_writer_free(writer);
-    writer = NULL;
+    return NULL;
+}
+
+// Write the snapshot to a temporary file, and make sure it reaches the disk before it replaces the original.
+static int
+_plt_write_snapshot (buffered_file_writer_t *writer, const char *tempfile) {
+    FILE *fp = fopen (tempfile, "w+b");
+    if (!fp) {
+        return -1;
+    }
+    int res = buffered_file_writer_write_to_file (writer, fp);
+    if (res == 0 && fflush (fp) != 0) {
+        res = -1;
+    }
+#ifndef _WIN32
+    if (res == 0 && fsync (fileno (fp)) != 0) {
+        res = -1;
+    }
+#endif
     if (EOF == fclose (fp)) {
-        fp = NULL;
-        goto save_fail;
+        res = -1;
+    }
+    if (res < 0) {
+        unlink (tempfile);
+    }
+    return res;
+}
+
+int
+plt_save (playlist_t *plt, playItem_t *first, playItem_t *last, const char *fname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
+    LOCK;
+    plt->last_save_modification_idx = plt->modification_idx;
+    const char *ext = strrchr (fname, '.');
+    if (ext) {
+        DB_playlist_t **plug = deadbeef->plug_get_playlist_list ();
+        for (int i = 0; plug[i]; i++) {
+            if (plug[i]->extensions && plug[i]->load) {
+                const char **exts = plug[i]->extensions;
+                if (exts && plug[i]->save) {
+                    for (int e = 0; exts[e]; e++) {
+                        if (!strcasecmp (exts[e], ext+1)) {
+                            int res = plug[i]->save ((ddb_playlist_t *)plt, fname, (DB_playItem_t *)_current_playlist->head[PL_MAIN], NULL);
+                            UNLOCK;
+                            return res;
+                        }
+                    }
+                }
+            }
+        }
     }
+
+    plt_contents_t contents;
+    _plt_contents_copy (plt, &contents, cb, user_data);
     UNLOCK;
+
+    buffered_file_writer_t *writer = _plt_save_snapshot (&contents);
+    _plt_contents_free (&contents);
+    if (!writer) {
+        return -1;
+    }
+
+    char tempfile[PATH_MAX];
+    snprintf (tempfile, sizeof (tempfile), "%s.tmp", fname);
+    int res = _plt_write_snapshot (writer, tempfile);
+    buffered_file_writer_free (writer);
+    if (res < 0) {
+        return -1;
+    }
     if (rename (tempfile, fname) != 0) {
         fprintf (stderr, "playlist rename %s -> %s failed: %s\n", tempfile, fname, strerror (errno));
         return -1;
     }
     return 0;
-save_fail:
+}
+
+// Snapshot of a playlist stored in the config folder, which is serialized and written after releasing the playlist lock.
+typedef struct {
+    playlist_t *plt;
+    plt_contents_t contents;
+    int modification_idx;
+    int serial;
+} plt_save_snapshot_t;
+
+static int _save_serial; // incremented for each snapshot, to drop outdated ones
+
+// Must be called with the playlist locked.
+static int
+_plt_snapshot_for_save (playlist_t *plt, plt_save_snapshot_t *snapshot) {
+    _plt_contents_copy (plt, &snapshot->contents, NULL, NULL);
+    plt_ref (plt);
+    snapshot->plt = plt;
+    snapshot->modification_idx = plt->modification_idx;
+    snapshot->serial = ++_save_serial;
+    plt->last_save_modification_idx = plt->modification_idx;
+    return 0;
+}
+
+// Serialize and write the snapshot, and move it in place of the playlist file.
+// The file name is resolved at the very end under the lock, since the playlists could be added, removed or moved meanwhile.
+static int
+_plt_commit_snapshot (plt_save_snapshot_t *snapshot) {
+    playlist_t *plt = snapshot->plt;
+    char tempfile[PATH_MAX];
+    int res = -1;
+    buffered_file_writer_t *writer = _plt_save_snapshot (&snapshot->contents);
+    _plt_contents_free (&snapshot->contents);
+    if (writer && snprintf (tempfile, sizeof (tempfile), "%s/playlists/save-%d.tmp", dbconfdir, snapshot->serial) < sizeof (tempfile)) {
+        res = _plt_write_snapshot (writer, tempfile);
+    }
+
+    LOCK;
+    if (res == 0) {
+        char path[PATH_MAX];
+        int idx = plt_get_idx (plt);
+        if (idx < 0 || snapshot->serial < plt->last_written_save_serial) {
+            // the playlist was deleted, or a newer snapshot was written already
+            unlink (tempfile);
+        }
+        else if (snprintf (path, sizeof (path), "%s/playlists/%d.dbpl", dbconfdir, idx) > sizeof (path)) {
+            fprintf (stderr, "error: failed to make path string for playlist file\n");
+            unlink (tempfile);
+            res = -1;
+        }
+        else if (rename (tempfile, path) != 0) {
+            fprintf (stderr, "playlist rename %s -> %s failed: %s\n", tempfile, path, strerror (errno));
+            unlink (tempfile);
+            res = -1;
+        }
+        else {
+            plt->last_written_save_serial = snapshot->serial;
+        }
+    }
+    if (res < 0 && plt->last_save_modification_idx == snapshot->modification_idx) {
+        // try again on the next save
+        plt->last_save_modification_idx = -1;
+    }
     UNLOCK;
-    if (writer != NULL) {
-        buffered_file_writer_free(writer);
+
+    if (writer) {
+        buffered_file_writer_free (writer);
+    }
+    plt_unref (plt);
+    return res;
+}
+
+// The temporary files of the saves which were interrupted by a crash or a power loss
+static void
+_plt_remove_stale_save_files (void) {
+    char path[PATH_MAX];
+    if (snprintf (path, sizeof (path), "%s/playlists", dbconfdir) >= sizeof (path)) {
+        return;
     }
-    if (fp != NULL) {
-        fclose (fp);
+    DIR *dir = opendir (path);
+    if (!dir) {
+        return;
     }
-    unlink (tempfile);
-    return -1;
+    struct dirent *entry;
+    while ((entry = readdir (dir))) {
+        char fname[PATH_MAX];
+        if (!fnmatch ("save-*.tmp", entry->d_name, 0)
+            && snprintf (fname, sizeof (fname), "%s/%s", path, entry->d_name) < sizeof (fname)) {
+            unlink (fname);
+        }
+    }
+    closedir (dir);
 }
 
 int
@@ -2104,22 +2620,21 @@ plt_save_n (int n) {
     mkdir (path, 0755);
 
     LOCK;
-    int err = 0;
-
-    _plt_loading = 1;
-    if (snprintf (path, sizeof (path), "%s/playlists/%d.dbpl", dbconfdir, n) > sizeof (path)) {
-        fprintf (stderr, "error: failed to make path string for playlist file\n");
-        UNLOCK;
-        return -1;
-    }
-
     int i;
     playlist_t *plt;
     for (i = 0, plt = _playlists_head; plt && i < n; i++, plt = plt->next);
-    err = plt_save (plt, NULL, NULL, path, NULL, NULL, NULL);
-    _plt_loading = 0;
+    if (!plt || plt->loading) {
+        // a playlist which is still being loaded has its file up to date
+        UNLOCK;
+        return plt ? 0 : -1;
+    }
+    plt_save_snapshot_t snapshot;
+    int err = _plt_snapshot_for_save (plt, &snapshot);
     UNLOCK;
-    return err;
+    if (err < 0) {
+        return -1;
+    }
+    return _plt_commit_snapshot (&snapshot);
 }
 
 int
@@ -2144,90 +2659,129 @@ pl_save_all (void) {
     int err = 0;
 
     plt_gen_conf ();
-    _plt_loading = 1;
+
+    // only the snapshots are made under the lock, the files are written afterwards
+    plt_save_snapshot_t *snapshots = calloc (cnt, sizeof (plt_save_snapshot_t));
+    int snapshot_count = 0;
     for (i = 0; i < cnt; i++, p = p->next) {
-        if (snprintf (path, sizeof (path), "%s/playlists/%d.dbpl", dbconfdir, i) > sizeof (path)) {
-            fprintf (stderr, "error: failed to make path string for playlist file\n");
-            err = -1;
-            break;
-        }
-        if (p->last_save_modification_idx == p->modification_idx) {
+        if (p->last_save_modification_idx == p->modification_idx || p->loading) {
             continue;
         }
-        err = plt_save (p, NULL, NULL, path, NULL, NULL, NULL);
+        err = _plt_snapshot_for_save (p, &snapshots[snapshot_count]);
         if (err < 0) {
             break;
         }
+        snapshot_count++;
     }
-    _plt_loading = 0;
     UNLOCK;
+
+    for (i = 0; i < snapshot_count; i++) {
+        if (_plt_commit_snapshot (&snapshots[i]) < 0) {
+            err = -1;
+        }
+    }
+    free (snapshots);
     return err;
 }
 
-static playItem_t *
-plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
-    playItem_t *it = NULL;
-    playItem_t *last_added = NULL;
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} dbpl_reader_t;
 
-    #ifdef __MINGW32__
-    if (!strncmp (fname, "file://", 7)) {
-        fname += 7;
-    }
-    // replace backslashes with normal slashes
-    char fname_conv[strlen(fname)+1];
-    if (strchr(fname, '\\')) {
-        trace ("plt_load_int: backslash(es) detected: %s\n", fname);
-        strcpy (fname_conv, fname);
-        char *slash_p = fname_conv;
-        while (slash_p = strchr(slash_p, '\\')) {
-            *slash_p = '/';
-            slash_p++;
-        }
-        fname = fname_conv;
-    }
-    // path should start with "X:/", not "/X:/", fixing to avoid file opening problems
-    if (fname[0] == '/' && isalpha(fname[1]) && fname[2] == ':') {
-        fname++;
+static int
+_dbpl_read (dbpl_reader_t *r, void *out, size_t size) {
+    if (size > r->size - r->pos) {
+        r->pos = r->size;
+        return -1;
     }
-    #endif
+    memcpy (out, r->data + r->pos, size);
+    r->pos += size;
+    return 0;
+}
 
-    // try plugins 1st
-    char *escaped = uri_unescape (fname, (int)strlen (fname));
-    if (escaped) {
-        fname = strdupa (escaped);
-        free (escaped);
+static void
+_dbpl_skip (dbpl_reader_t *r, size_t size) {
+    r->pos = size > r->size - r->pos ? r->size : r->pos + size;
+}
+
+// The whole playlist file is mapped (or read) at once, and parsed from memory in a single pass.
+// The mapping stays valid if the file gets renamed or deleted, which allows parsing it in background.
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    int mapped;
+} dbpl_file_t;
+
+static int
+_dbpl_file_open (dbpl_file_t *file, const char *fname) {
+    memset (file, 0, sizeof (dbpl_file_t));
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+    int fd = open (fname, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat (fd, &st) < 0 || st.st_size <= 0) {
+        close (fd);
+        return -1;
+    }
+    file->size = (size_t)st.st_size;
+    void *data = mmap (NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+        file->data = data;
+        file->mapped = 1;
+        close (fd);
+        return 0;
     }
 
-    const char *ext = strrchr (fname, '.');
-    if (ext) {
-        ext++;
-        DB_playlist_t **plug = plug_get_playlist_list ();
-        int p, e;
-        for (p = 0; plug[p]; p++) {
-            for (e = 0; plug[p]->extensions[e]; e++) {
-                if (plug[p]->load && !strcasecmp (ext, plug[p]->extensions[e])) {
-                    DB_playItem_t *loaded_it = NULL;
-                    if (cb || (plug[p]->load && !plug[p]->load2)) {
-                        loaded_it = plug[p]->load ((ddb_playlist_t *)plt, (DB_playItem_t *)after, fname, pabort, (int (*)(DB_playItem_t *, void *))cb, user_data);
-                    }
-                    else if (plug[p]->plugin.api_vminor >= 5 && plug[p]->load2) {
-                        loaded_it = plug[p]->load2 (visibility, (ddb_playlist_t *)plt, (DB_playItem_t *)after, fname, pabort);
-                    }
-                    return (playItem_t *)loaded_it;
-                }
-            }
+    uint8_t *buffer = malloc (file->size);
+    size_t total = 0;
+    while (buffer && total < file->size) {
+        ssize_t rb = read (fd, buffer + total, file->size - total);
+        if (rb <= 0) {
+            break;
         }
+        total += rb;
     }
-    FILE *fp = fopen (fname, "rb");
-    if (!fp) {
-//        trace ("plt_load: failed to open %s\n", fname);
-        return NULL;
+    close (fd);
+    if (!buffer || total != file->size) {
+        free (buffer);
+        return -1;
+    }
+    file->data = buffer;
+    return 0;
+}
+
+static void
+_dbpl_file_close (dbpl_file_t *file) {
+    if (file->mapped) {
+        munmap ((void *)file->data, file->size);
     }
+    else {
+        free ((void *)file->data);
+    }
+    memset (file, 0, sizeof (dbpl_file_t));
+}
+
+// Parses DBPL data, and appends the items to the end of the playlist.
+// Each item is inserted under the lock, so this can run concurrently with the UI accessing the playlist.
+static playItem_t *
+_plt_load_dbpl (playlist_t *plt, const uint8_t *data, size_t size, int *pabort) {
+    playItem_t *it = NULL;
+    playItem_t *last_added = NULL;
+    dbpl_reader_t r = {
+        .data = data,
+        .size = size,
+    };
 
     uint8_t majorver;
     uint8_t minorver;
     char magic[4];
-    if (fread (magic, 1, 4, fp) != 4) {
+    if (_dbpl_read (&r, magic, 4) < 0) {
 //        trace ("failed to read magic\n");
         goto load_fail;
     }
@@ -2235,14 +2789,14 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
 //        trace ("bad signature\n");
         goto load_fail;
     }
-    if (fread (&majorver, 1, 1, fp) != 1) {
+    if (_dbpl_read (&r, &majorver, 1) < 0) {
         goto load_fail;
     }
     if (majorver != PLAYLIST_MAJOR_VER) {
 //        trace ("bad majorver=%d\n", majorver);
         goto load_fail;
     }
-    if (fread (&minorver, 1, 1, fp) != 1) {
+    if (_dbpl_read (&r, &minorver, 1) < 0) {
         goto load_fail;
     }
     if (minorver < 1) {
@@ -2250,11 +2804,14 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
         goto load_fail;
     }
     uint32_t cnt;
-    if (fread (&cnt, 1, 4, fp) != 4) {
+    if (_dbpl_read (&r, &cnt, 4) < 0) {
         goto load_fail;
     }
 
     for (uint32_t i = 0; i < cnt; i++) {
+        if (pabort && *pabort) {
+            break;
+        }
         it = pl_item_alloc ();
         if (!it) {
             goto load_fail;
@@ -2263,18 +2820,18 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
         int16_t tracknum = 0;
         if (minorver <= 2) {
             // fname
-            if (fread (&l, 1, 2, fp) != 2) {
+            if (_dbpl_read (&r, &l, 2) < 0) {
                 goto load_fail;
             }
             char uri[l+1];
-            if (fread (uri, 1, l, fp) != l) {
+            if (_dbpl_read (&r, uri, l) < 0) {
                 goto load_fail;
             }
             uri[l] = 0;
             pl_add_meta (it, ":URI", uri);
             // decoder
             uint8_t ll;
-            if (fread (&ll, 1, 1, fp) != 1) {
+            if (_dbpl_read (&r, &ll, 1) < 0) {
                 goto load_fail;
             }
             if (ll >= 20) {
@@ -2282,28 +2839,28 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
             }
             char decoder_id[20] = "";
             if (ll) {
-                if (fread (decoder_id, 1, ll, fp) != ll) {
+                if (_dbpl_read (&r, decoder_id, ll) < 0) {
                     goto load_fail;
                 }
                 decoder_id[ll] = 0;
                 pl_add_meta (it, ":DECODER", decoder_id);
             }
             // tracknum
-            if (fread (&tracknum, 1, 2, fp) != 2) {
+            if (_dbpl_read (&r, &tracknum, 2) < 0) {
                 goto load_fail;
             }
             pl_set_meta_int (it, ":TRACKNUM", tracknum);
         }
         // startsample
-        if (fread (&it->startsample, 1, 4, fp) != 4) {
+        if (_dbpl_read (&r, &it->startsample, 4) < 0) {
             goto load_fail;
         }
         // endsample
-        if (fread (&it->endsample, 1, 4, fp) != 4) {
+        if (_dbpl_read (&r, &it->endsample, 4) < 0) {
             goto load_fail;
         }
         // duration
-        if (fread (&it->_duration, 1, 4, fp) != 4) {
+        if (_dbpl_read (&r, &it->_duration, 4) < 0) {
             goto load_fail;
         }
         char s[100];
@@ -2313,12 +2870,12 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
         if (minorver <= 2) {
             // legacy filetype support
             uint8_t ft;
-            if (fread (&ft, 1, 1, fp) != 1) {
+            if (_dbpl_read (&r, &ft, 1) < 0) {
                 goto load_fail;
             }
             if (ft) {
                 char ftype[ft+1];
-                if (fread (ftype, 1, ft, fp) != ft) {
+                if (_dbpl_read (&r, ftype, ft) < 0) {
                     goto load_fail;
                 }
                 ftype[ft] = 0;
@@ -2327,14 +2884,14 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
 
             float f;
 
-            if (fread (&f, 1, 4, fp) != 4) {
+            if (_dbpl_read (&r, &f, 4) < 0) {
                 goto load_fail;
             }
             if (f != 0) {
                 pl_set_item_replaygain (it, DDB_REPLAYGAIN_ALBUMGAIN, f);
             }
 
-            if (fread (&f, 1, 4, fp) != 4) {
+            if (_dbpl_read (&r, &f, 4) < 0) {
                 goto load_fail;
             }
             if (f == 0) {
@@ -2344,14 +2901,14 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
                 pl_set_item_replaygain (it, DDB_REPLAYGAIN_ALBUMPEAK, f);
             }
 
-            if (fread (&f, 1, 4, fp) != 4) {
+            if (_dbpl_read (&r, &f, 4) < 0) {
                 goto load_fail;
             }
             if (f != 0) {
                 pl_set_item_replaygain (it, DDB_REPLAYGAIN_TRACKGAIN, f);
             }
 
-            if (fread (&f, 1, 4, fp) != 4) {
+            if (_dbpl_read (&r, &f, 4) < 0) {
                 goto load_fail;
             }
             if (f == 0) {
@@ -2364,7 +2921,7 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
 
         uint32_t flg = 0;
         if (minorver >= 2) {
-            if (fread (&flg, 1, 4, fp) != 4) {
+            if (_dbpl_read (&r, &flg, 4) < 0) {
                 goto load_fail;
             }
         }
@@ -2376,33 +2933,32 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
         pl_set_item_flags (it, flg);
 
         int16_t nm = 0;
-        if (fread (&nm, 1, 2, fp) != 2) {
+        if (_dbpl_read (&r, &nm, 2) < 0) {
             goto load_fail;
         }
         for (int j = 0; j < nm; j++) {
-            if (fread (&l, 1, 2, fp) != 2) {
+            if (_dbpl_read (&r, &l, 2) < 0) {
                 goto load_fail;
             }
             if (l >= 20000) {
                 goto load_fail;
             }
             char key[l+1];
-            if (fread (key, 1, l, fp) != l) {
+            if (_dbpl_read (&r, key, l) < 0) {
                 goto load_fail;
             }
             key[l] = 0;
-            if (fread (&l, 1, 2, fp) != 2) {
+            if (_dbpl_read (&r, &l, 2) < 0) {
                 goto load_fail;
             }
             if (l >= 20000) {
                 // skip
-                fseek (fp, l, SEEK_CUR);
+                _dbpl_skip (&r, l);
             }
             else {
                 char value[l+1];
-                int res = (int)fread (value, 1, l, fp);
-                if (res != l) {
-//                    trace ("playlist read error: requested %d, got %d\n", l, res);
+                if (_dbpl_read (&r, value, l) < 0) {
+//                    trace ("playlist read error: requested %d\n", l);
                     goto load_fail;
                 }
                 value[l] = 0;
@@ -2425,7 +2981,9 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
                 }
             }
         }
+        LOCK;
         plt_insert_item (plt, plt->tail[PL_MAIN], it);
+        UNLOCK;
         if (last_added) {
             pl_item_unref (last_added);
         }
@@ -2436,32 +2994,31 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
     // load playlist metadata
     int16_t nm = 0;
     // for backwards format compatibility, don't fail if metadata is not found
-    if (fread (&nm, 1, 2, fp) == 2) {
+    if (_dbpl_read (&r, &nm, 2) == 0) {
         for (int i = 0; i < nm; i++) {
             int16_t l;
-            if (fread (&l, 1, 2, fp) != 2) {
+            if (_dbpl_read (&r, &l, 2) < 0) {
                 goto load_fail;
             }
             if (l < 0 || l >= 20000) {
                 goto load_fail;
             }
             char key[l+1];
-            if (fread (key, 1, l, fp) != l) {
+            if (_dbpl_read (&r, key, l) < 0) {
                 goto load_fail;
             }
             key[l] = 0;
-            if (fread (&l, 1, 2, fp) != 2) {
+            if (_dbpl_read (&r, &l, 2) < 0) {
                 goto load_fail;
             }
             if (l<0 || l >= 20000) {
                 // skip
-                fseek (fp, l, SEEK_CUR);
+                _dbpl_skip (&r, l);
             }
             else {
                 char value[l+1];
-                int res = (int)fread (value, 1, l, fp);
-                if (res != l) {
-//                    trace ("playlist read error: requested %d, got %d\n", l, res);
+                if (_dbpl_read (&r, value, l) < 0) {
+//                    trace ("playlist read error: requested %d\n", l);
                     goto load_fail;
                 }
                 value[l] = 0;
@@ -2471,9 +3028,6 @@ plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fn
         }
     }
 
-    if (fp) {
-        fclose (fp);
-    }
     if (last_added) {
         pl_item_unref (last_added);
     }
@@ -2483,27 +3037,161 @@ load_fail:
         pl_item_unref (it);
         it = NULL;
     }
-//    trace ("playlist load fail (%s)!\n", fname);
-    if (fp) {
-        fclose (fp);
-    }
+//    trace ("playlist load fail!\n");
     if (last_added) {
         pl_item_unref (last_added);
     }
     return last_added;
 }
 
+static playItem_t *
+plt_load_int (int visibility, playlist_t *plt, playItem_t *after, const char *fname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
+    #ifdef __MINGW32__
+    if (!strncmp (fname, "file://", 7)) {
+        fname += 7;
+    }
+    // replace backslashes with normal slashes
+    char fname_conv[strlen(fname)+1];
+    if (strchr(fname, '\\')) {
+        trace ("plt_load_int: backslash(es) detected: %s\n", fname);
+        strcpy (fname_conv, fname);
+        char *slash_p = fname_conv;
+        while (slash_p = strchr(slash_p, '\\')) {
+            *slash_p = '/';
+            slash_p++;
+        }
+        fname = fname_conv;
+    }
+    // path should start with "X:/", not "/X:/", fixing to avoid file opening problems
+    if (fname[0] == '/' && isalpha(fname[1]) && fname[2] == ':') {
+        fname++;
+    }
+    #endif
+
+    // try plugins 1st
+    char *escaped = uri_unescape (fname, (int)strlen (fname));
+    if (escaped) {
+        fname = strdupa (escaped);
+        free (escaped);
+    }
+
+    const char *ext = strrchr (fname, '.');
+    if (ext) {
+        ext++;
+        DB_playlist_t **plug = plug_get_playlist_list ();
+        int p, e;
+        for (p = 0; plug[p]; p++) {
+            for (e = 0; plug[p]->extensions[e]; e++) {
+                if (plug[p]->load && !strcasecmp (ext, plug[p]->extensions[e])) {
+                    DB_playItem_t *loaded_it = NULL;
+                    if (cb || (plug[p]->load && !plug[p]->load2)) {
+                        loaded_it = plug[p]->load ((ddb_playlist_t *)plt, (DB_playItem_t *)after, fname, pabort, (int (*)(DB_playItem_t *, void *))cb, user_data);
+                    }
+                    else if (plug[p]->plugin.api_vminor >= 5 && plug[p]->load2) {
+                        loaded_it = plug[p]->load2 (visibility, (ddb_playlist_t *)plt, (DB_playItem_t *)after, fname, pabort);
+                    }
+                    return (playItem_t *)loaded_it;
+                }
+            }
+        }
+    }
+    dbpl_file_t file;
+    if (_dbpl_file_open (&file, fname) < 0) {
+//        trace ("plt_load: failed to open %s\n", fname);
+        return NULL;
+    }
+    playItem_t *last_added = _plt_load_dbpl (plt, file.data, file.size, pabort);
+    _dbpl_file_close (&file);
+    return last_added;
+}
 
 playItem_t *
 plt_load (playlist_t *plt, playItem_t *after, const char *fname, int *pabort, int (*cb)(playItem_t *it, void *data), void *user_data) {
     return plt_load_int (0, plt, after, fname, pabort, cb, user_data);
 }
 
+typedef struct {
+    playlist_t *plt;
+    dbpl_file_t file;
+} plt_background_load_t;
+
+// The file is parsed into a private playlist, and the items are moved to the target at once,
+// in front of anything the user has added meanwhile, so they don't interleave with the edits.
+static void
+_plt_background_load (void *ctx) {
+    plt_background_load_t *load = ctx;
+    playlist_t *loaded = plt_alloc ("");
+    _plt_load_dbpl (loaded, load->file.data, load->file.size, NULL);
+    _dbpl_file_close (&load->file);
+
+    LOCK;
+    // the items keep the reference held by the private playlist, until inserted into the target
+    playItem_t *after = NULL;
+    playItem_t *it = loaded->head[PL_MAIN];
+    loaded->head[PL_MAIN] = loaded->tail[PL_MAIN] = NULL;
+    loaded->count[PL_MAIN] = 0;
+    while (it) {
+        playItem_t *next = it->next[PL_MAIN];
+        it->next[PL_MAIN] = it->prev[PL_MAIN] = NULL;
+        plt_insert_item (load->plt, after, it);
+        pl_item_unref (it);
+        after = it;
+        it = next;
+    }
+    for (DB_metaInfo_t *m = loaded->meta; m; m = m->next) {
+        plt_add_meta (load->plt, m->key, m->value);
+    }
+    load->plt->loading = 0;
+    UNLOCK;
+    plt_unref (loaded);
+    messagepump_push (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+
+    plt_unref (load->plt);
+    free (load);
+}
+
+// Map the playlist file, and parse it on a background thread.
+// Returns -1 if the playlist needs to be loaded synchronously instead.
+static int
+_plt_load_in_background (playlist_t *plt, const char *fname) {
+    if (!_background_load_group) {
+        // one at a time, since each insertion takes the playlist lock
+        _background_load_group = task_group_create ("playlist loader", DDB_TASK_PRIORITY_NORMAL, 1);
+        if (!_background_load_group) {
+            return -1;
+        }
+    }
+    plt_background_load_t *load = calloc (1, sizeof (plt_background_load_t));
+    if (_dbpl_file_open (&load->file, fname) < 0) {
+        free (load);
+        return -1;
+    }
+    load->plt = plt;
+    plt_ref (plt);
+    plt->loading = 1;
+    if (task_group_submit (_background_load_group, _plt_background_load, load) < 0) {
+        plt->loading = 0;
+        plt_unref (plt);
+        _dbpl_file_close (&load->file);
+        free (load);
+        return -1;
+    }
+    return 0;
+}
+
+void
+pl_wait_background_load (void) {
+    if (_background_load_group) {
+        task_group_wait (_background_load_group);
+    }
+}
+
 int
 pl_load_all (void) {
     int i = 0;
     int err = 0;
     char path[1024];
+    _plt_remove_stale_save_files ();
     DB_conf_item_t *it = conf_find ("playlist.tab.", NULL);
     if (!it) {
         // legacy (0.3.3 and earlier)
@@ -2521,6 +3209,13 @@ pl_load_all (void) {
         plt_unref (plt);
         return 0;
     }
+
+    // The current playlist, and the one to resume playback from, are loaded right away.
+    // The rest are parsed in background, and send DB_EV_PLAYLISTCHANGED when done.
+    int curr_idx = conf_get_int ("playlist.current", 0);
+    int resume_idx = conf_get_int ("resume.playlist", -1);
+    int background = conf_get_int ("playlist.load_in_background", 1);
+
     LOCK;
     _plt_loading = 1;
     while (it) {
@@ -2539,7 +3234,9 @@ pl_load_all (void) {
             fprintf (stderr, "INFO: from file %s\n", path);
 
             playlist_t *plt = plt_get_curr ();
-            /* playItem_t *trk = */ plt_load (plt, NULL, path, NULL, NULL, NULL);
+            if (!background || i == curr_idx || i == resume_idx || _plt_load_in_background (plt, path) < 0) {
+                /* playItem_t *trk = */ plt_load (plt, NULL, path, NULL, NULL, NULL);
+            }
             char conf[100];
             snprintf (conf, sizeof (conf), "playlist.cursor.%d", i);
             plt->current_row[PL_MAIN] = deadbeef->conf_get_int (conf, -1);
@@ -3583,6 +4280,226 @@ _plsearch_append (playlist_t *plt, playItem_t *it, int select_results) {
     plt->count[PL_SEARCH]++;
 }
 
+#define SEARCH_CACHE_SIZE 16
+// total number of cached results in a playlist, the larger results are not cached
+#define SEARCH_CACHE_MAX_ITEMS 65536
+
+// Results of the recent searches in a playlist.
+// When a query contains one of the previous queries, only the results of that query need to be checked,
+// and the repeated queries (e.g. after backspace) are reused as is.
+// Dropped on any change of the playlist contents.
+// The entries are keyed by the query and the metadata generation, so the results found before
+// a metadata change are never reused, e.g. when the search is re-run on DB_EV_TRACKINFOCHANGED.
+// The metadata generation is global (see pl_get_meta_generation), so a metadata change
+// in any playlist drops the cached results of all playlists.
+typedef struct plt_search_cache_s {
+    struct {
+        char *text;
+        unsigned meta_generation;
+        playItem_t **items;
+        int count;
+    } entries[SEARCH_CACHE_SIZE];
+    int count;
+    int item_count; // sum of the entries' count
+} plt_search_cache_t;
+
+static void
+_plt_search_cache_free (playlist_t *playlist) {
+    plt_search_cache_t *cache = playlist->search_cache;
+    if (!cache) {
+        return;
+    }
+    for (int i = 0; i < cache->count; i++) {
+        free (cache->entries[i].text);
+        free (cache->entries[i].items);
+    }
+    free (cache);
+    playlist->search_cache = NULL;
+}
+
+// Returns the index of the longest cached query contained in text, or -1
+static int
+_plt_search_cache_find (playlist_t *playlist, const char *text) {
+    plt_search_cache_t *cache = playlist->search_cache;
+    if (!cache) {
+        return -1;
+    }
+    unsigned generation = pl_get_meta_generation ();
+    int best = -1;
+    size_t best_len = 0;
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->entries[i].meta_generation != generation) {
+            continue;
+        }
+        size_t len = strlen (cache->entries[i].text);
+        if ((best < 0 || len > best_len) && strstr (text, cache->entries[i].text)) {
+            best = i;
+            best_len = len;
+        }
+    }
+    return best;
+}
+
+static void
+_plt_search_cache_drop_oldest (plt_search_cache_t *cache) {
+    free (cache->entries[0].text);
+    free (cache->entries[0].items);
+    cache->item_count -= cache->entries[0].count;
+    memmove (&cache->entries[0], &cache->entries[1], (SEARCH_CACHE_SIZE - 1) * sizeof (cache->entries[0]));
+    cache->count--;
+}
+
+static void
+_plt_search_cache_add (playlist_t *playlist, const char *text) {
+    if (playlist->count[PL_SEARCH] > SEARCH_CACHE_MAX_ITEMS) {
+        return;
+    }
+    if (!playlist->search_cache) {
+        playlist->search_cache = calloc (1, sizeof (plt_search_cache_t));
+    }
+    plt_search_cache_t *cache = playlist->search_cache;
+    unsigned generation = pl_get_meta_generation ();
+    if (cache->count > 0 && cache->entries[cache->count - 1].meta_generation != generation) {
+        // the older entries can't match anymore
+        _plt_search_cache_free (playlist);
+        playlist->search_cache = cache = calloc (1, sizeof (plt_search_cache_t));
+    }
+    while (cache->count == SEARCH_CACHE_SIZE || (cache->count > 0 && cache->item_count + playlist->count[PL_SEARCH] > SEARCH_CACHE_MAX_ITEMS)) {
+        _plt_search_cache_drop_oldest (cache);
+    }
+    int i = cache->count++;
+    cache->entries[i].text = strdup (text);
+    cache->entries[i].meta_generation = generation;
+    cache->entries[i].count = playlist->count[PL_SEARCH];
+    cache->item_count += playlist->count[PL_SEARCH];
+    cache->entries[i].items = malloc (max (1, playlist->count[PL_SEARCH]) * sizeof (playItem_t *));
+    int n = 0;
+    for (playItem_t *it = playlist->head[PL_SEARCH]; it; it = it->next[PL_SEARCH]) {
+        cache->entries[i].items[n++] = it;
+    }
+}
+
+// Refined searches don't check every string of the playlist,
+// so the comparison results need to be reset before search_cmpidx values get reused.
+static void
+_plt_search_reset_cmpidx (playlist_t *playlist) {
+    for (playItem_t *it = playlist->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
+        for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+            *((char *)m->value-1) = 0;
+        }
+    }
+}
+
+static int
+_plt_search_match (playlist_t *playlist, playItem_t *it, const u8_casestr_needle_t *needle, int lc_is_valid_u8) {
+    DB_metaInfo_t *m = NULL;
+    for (m = it->meta; m; m = m->next) {
+        int is_uri = !strcmp (m->key, ":URI");
+        if ((m->key[0] == ':' && !is_uri) || m->key[0] == '_' || m->key[0] == '!') {
+            break;
+        }
+        if (!strcasecmp(m->key, "cuesheet") || !strcasecmp (m->key, "log")) {
+            continue;
+        }
+
+        const char *value = m->value;
+        const char *end = value + m->valuesize;
+
+        if (is_uri) {
+            value = strrchr (value, '/');
+            if (value) {
+                value++;
+            }
+            else {
+                value = m->value;
+            }
+        }
+
+        char cmp = *(m->value-1);
+
+        if (abs (cmp) == playlist->search_cmpidx) { // string was already compared in this search
+            if (cmp > 0) { // it's a match
+                return 1;
+            }
+        }
+        else {
+            int match = -playlist->search_cmpidx; // assume no match
+            do {
+                int len = (int)strlen(value);
+                if (lc_is_valid_u8 && u8_valid(value, len, NULL) && utfcasestr_needle (value, needle)) {
+                    match = playlist->search_cmpidx; // it's a match
+                    break;
+                }
+                value += len+1;
+            } while (value < end);
+            *((char *)m->value-1) = (int8_t)match;
+            if (match > 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// The per-playlist "search_index" metadata value overrides the automatic choice based on the track count
+static int
+_plt_search_index_enabled (playlist_t *playlist) {
+    int enabled = plt_find_meta_int (playlist, "search_index", -1);
+    if (enabled >= 0) {
+        return enabled;
+    }
+    int min_tracks = conf_get_int ("playlist.search_index_min_tracks", 20000);
+    return min_tracks > 0 && playlist->count[PL_MAIN] >= min_tracks;
+}
+
+// Returns the up to date search index of the playlist, or NULL if it's not enabled
+static search_index_t *
+_plt_get_search_index (playlist_t *playlist) {
+    if (!_plt_search_index_enabled (playlist)) {
+        if (playlist->search_index) {
+            search_index_free (playlist->search_index);
+            playlist->search_index = NULL;
+        }
+        return NULL;
+    }
+    if (playlist->search_index) {
+        search_index_sync (playlist->search_index, playlist->head[PL_MAIN]);
+        if (!search_index_is_outdated (playlist->search_index)) {
+            return playlist->search_index;
+        }
+    }
+    if (playlist->search_index) {
+        search_index_free (playlist->search_index);
+    }
+
+    struct timeval tm1, tm2;
+    gettimeofday (&tm1, NULL);
+    playlist->search_index = search_index_alloc ();
+    for (playItem_t *it = playlist->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
+        search_index_add_item (playlist->search_index, it);
+    }
+    gettimeofday (&tm2, NULL);
+    int64_t us = (int64_t)(tm2.tv_sec - tm1.tv_sec) * 1000000 + (tm2.tv_usec - tm1.tv_usec);
+    search_index_set_build_time (playlist->search_index, us);
+
+    search_index_stats_t stats;
+    search_index_get_stats (playlist->search_index, &stats);
+    trace ("search index for %s: %d tracks, %d trigrams, %d KB, built in %d ms\n", playlist->title, stats.item_count, stats.trigram_count, (int)(stats.memory_size / 1024), (int)(us / 1000));
+    return playlist->search_index;
+}
+
+int
+plt_get_search_index_stats (playlist_t *playlist, ddb_search_index_stats_t *stats) {
+    LOCK;
+    int res = -1;
+    if (playlist->search_index) {
+        search_index_get_stats (playlist->search_index, stats);
+        res = 0;
+    }
+    UNLOCK;
+    return res;
+}
+
 void
 plt_search_process2 (playlist_t *playlist, const char *text, int select_results) {
     LOCK;
@@ -3609,66 +4526,55 @@ plt_search_process2 (playlist_t *playlist, const char *text, int select_results)
     *out = 0;
 
     int lc_is_valid_u8 = u8_valid (lc, (int)strlen (lc), NULL);
+    u8_casestr_needle_t needle;
+    u8_casestr_needle_init (&needle, lc);
 
     playlist->search_cmpidx++;
     if (playlist->search_cmpidx > 127) {
         playlist->search_cmpidx = 1;
+        _plt_search_reset_cmpidx (playlist);
     }
 
-    for (playItem_t *it = playlist->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
-        if (select_results) {
+    if (select_results) {
+        for (playItem_t *it = playlist->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
             pl_set_selected_in_playlist(playlist, it, 0);
         }
-        if (*text) {
-            DB_metaInfo_t *m = NULL;
-            for (m = it->meta; m; m = m->next) {
-                int is_uri = !strcmp (m->key, ":URI");
-                if ((m->key[0] == ':' && !is_uri) || m->key[0] == '_' || m->key[0] == '!') {
-                    break;
-                }
-                if (!strcasecmp(m->key, "cuesheet") || !strcasecmp (m->key, "log")) {
-                    continue;
-                }
-
-                const char *value = m->value;
-                const char *end = value + m->valuesize;
+    }
 
-                if (is_uri) {
-                    value = strrchr (value, '/');
-                    if (value) {
-                        value++;
-                    }
-                    else {
-                        value = m->value;
-                    }
+    if (*text) {
+        int cached = _plt_search_cache_find (playlist, lc);
+        if (cached >= 0) {
+            plt_search_cache_t *cache = playlist->search_cache;
+            int exact = !strcmp (cache->entries[cached].text, lc);
+            for (int i = 0; i < cache->entries[cached].count; i++) {
+                playItem_t *it = cache->entries[cached].items[i];
+                if (exact || _plt_search_match (playlist, it, &needle, lc_is_valid_u8)) {
+                    _plsearch_append (playlist, it, select_results);
                 }
-
-                char cmp = *(m->value-1);
-
-                if (abs (cmp) == playlist->search_cmpidx) { // string was already compared in this search
-                    if (cmp > 0) { // it's a match -- append to search results
-                        _plsearch_append (playlist, it, select_results);
-                        break;
+            }
+            if (exact) {
+                UNLOCK;
+                return;
+            }
+        }
+        else {
+            // the index narrows down the items to check, and they're still visited in the playlist order
+            search_index_t *index = _plt_get_search_index (playlist);
+            playItem_t **candidates = NULL;
+            int candidate_count = index ? search_index_find_candidates (index, lc, &candidates) : -1;
+            if (candidate_count != 0) {
+                for (playItem_t *it = playlist->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
+                    if (candidate_count > 0 && !search_index_is_candidate (candidates, candidate_count, it)) {
+                        continue;
                     }
-                }
-                else {
-                    int match = -playlist->search_cmpidx; // assume no match
-                    do {
-                        int len = (int)strlen(value);
-                        if (lc_is_valid_u8 && u8_valid(value, len, NULL) && utfcasestr_fast (value, lc)) {
-                            _plsearch_append (playlist, it, select_results);
-                            match = playlist->search_cmpidx; // it's a match
-                            break;
-                        }
-                        value += len+1;
-                    } while (value < end);
-                    *((char *)m->value-1) = (int8_t)match;
-                    if (match > 0) {
-                        break;
+                    if (_plt_search_match (playlist, it, &needle, lc_is_valid_u8)) {
+                        _plsearch_append (playlist, it, select_results);
                     }
                 }
             }
+            free (candidates);
         }
+        _plt_search_cache_add (playlist, lc);
     }
     UNLOCK;
 }
@@ -59,6 +59,7 @@ typedef struct playItem_s {
     unsigned in_playlist : 1; // 1 if item is in playlist
     unsigned has_startsample64 : 1;
     unsigned has_endsample64 : 1;
+    unsigned search_dirty : 1; // searchable metadata changed since the item was added to the search index
 } playItem_t;
 
 typedef struct playlist_s {
@@ -69,6 +70,7 @@ typedef struct playlist_s {
     float seltime;
     int modification_idx; // this value gets incremented each time playlist changes, and requires to be saved
     int last_save_modification_idx; // a value of modification_idx at the time when the playlist was saved last time
+    int last_written_save_serial; // serial number of the last save snapshot written to disk
     playItem_t *head[PL_MAX_ITERATORS]; // head of linked list
     playItem_t *tail[PL_MAX_ITERATORS]; // tail of linked list
     int current_row[PL_MAX_ITERATORS]; // current row (cursor)
@@ -81,6 +83,8 @@ typedef struct playlist_s {
     int cue_samplerate;
 
     int search_cmpidx;
+    struct plt_search_cache_s *search_cache; // results of the recent searches
+    struct search_index_s *search_index; // trigram index, used by the search in large playlists
     
     unsigned fast_mode : 1;
     unsigned files_adding : 1;
@@ -88,6 +92,7 @@ typedef struct playlist_s {
     unsigned loading_cue : 1;
     unsigned ignore_archives : 1;
     unsigned follow_symlinks : 1;
+    unsigned loading : 1; // the playlist file is being loaded in background
 } playlist_t;
 
 // global playlist control functions
@@ -310,6 +315,10 @@ plt_load (playlist_t *plt, playItem_t *after, const char *fname, int *pabort, in
 int
 pl_load_all (void);
 
+// wait until the playlists scheduled by pl_load_all are loaded
+void
+pl_wait_background_load (void);
+
 void
 plt_select_all (playlist_t *plt);
 
@@ -412,6 +421,10 @@ plt_search_process (playlist_t *plt, const char *text);
 void
 plt_search_process2 (playlist_t *plt, const char *text, int select_results);
 
+// Returns -1 if the playlist has no search index
+int
+plt_get_search_index_stats (playlist_t *plt, ddb_search_index_stats_t *stats);
+
 void
 plt_sort (playlist_t *plt, int iter, int id, const char *format, int order);
 
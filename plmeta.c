@@ -34,6 +34,23 @@
 #define LOCK {pl_lock();}
 #define UNLOCK {pl_unlock();}
 
+static unsigned _meta_generation;
+
+// Called when searchable metadata of an item in a playlist changes.
+// The item gets re-indexed by the search index of its playlist on the next search.
+static void
+_meta_changed (playItem_t *it, const char *key) {
+    if (it->in_playlist && (key[0] != ':' || !strcmp (key, ":URI")) && key[0] != '_' && key[0] != '!') {
+        it->search_dirty = 1;
+        __atomic_fetch_add (&_meta_generation, 1, __ATOMIC_RELAXED);
+    }
+}
+
+unsigned
+pl_get_meta_generation (void) {
+    return __atomic_load_n (&_meta_generation, __ATOMIC_RELAXED);
+}
+
 DB_metaInfo_t *
 pl_meta_for_key_with_override (playItem_t *it, const char *key) {
     pl_ensure_lock ();
@@ -102,6 +119,7 @@ pl_add_empty_meta_for_key (playItem_t *it, const char *key) {
         m = m->next;
     }
     // add
+    _meta_changed (it, key);
     m = calloc (1, sizeof (DB_metaInfo_t));
     m->key = metacache_add_string (key);
 
@@ -262,6 +280,7 @@ pl_append_meta_full (playItem_t *it, const char *key, const char *value, int siz
         return;
     }
 
+    _meta_changed (it, key);
     metacache_remove_value (m->value, m->valuesize);
     m->value = metacache_add_value (buf, buflen);
     m->valuesize = (int)buflen;
@@ -281,6 +300,7 @@ pl_replace_meta (playItem_t *it, const char *key, const char *value) {
     DB_metaInfo_t *m = pl_meta_for_key (it, key);
 
     if (m) {
+        _meta_changed (it, key);
         pl_meta_free_values (m);
         int l = (int)strlen (value) + 1;
         m->value = metacache_add_value(value, l);
@@ -322,6 +342,7 @@ pl_delete_meta (playItem_t *it, const char *key) {
     DB_metaInfo_t *m = it->meta;
     while (m) {
         if (!strcasecmp (key, m->key)) {
+            _meta_changed (it, key);
             if (prev) {
                 prev->next = m->next;
             }
@@ -419,6 +440,7 @@ pl_delete_metadata (playItem_t *it, DB_metaInfo_t *meta) {
     DB_metaInfo_t *m = it->meta;
     while (m) {
         if (m == meta) {
+            _meta_changed (it, m->key);
             if (prev) {
                 prev->next = m->next;
             }
@@ -447,6 +469,7 @@ pl_delete_all_meta (playItem_t *it) {
             prev = m;
         }
         else {
+            _meta_changed (it, m->key);
             if (prev) {
                 prev->next = next;
             }
@@ -6,6 +6,12 @@
 void
 pl_add_meta_full (playItem_t *it, const char *key, const char *value, int valuesize);
 
+// Incremented on every change of searchable metadata of the items which are in a playlist.
+// The changed items also get their search_dirty flag set.
+// The generation is global: it changes with the metadata of any playlist.
+unsigned
+pl_get_meta_generation (void);
+
 // if it already exists, append new value(s)
 // otherwise, call pl_add_meta
 void
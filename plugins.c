@@ -57,6 +57,7 @@
 #include "vfs.h"
 #include "premix.h"
 #include "dsppreset.h"
+#include "dsp.h"
 #include "pltmeta.h"
 #include "metacache.h"
 #include "tf.h"
@@ -69,6 +70,9 @@
 #include "cocoautil.h"
 #endif
 #include "viz.h"
+#include "threadpool.h"
+#include "streamertelemetry.h"
+#include "decoderregistry.h"
 
 DB_plugin_t main_plugin = {
     .type = DB_PLUGIN_MISC,
@@ -533,6 +537,23 @@ static DB_functions_t deadbeef_api = {
     .plt_insert_dir3 = (ddb_playItem_t *(*) (int visibility, uint32_t flags, ddb_playlist_t *plt, ddb_playItem_t *after, const char *dirname, int *pabort, int (*callback)(ddb_insert_file_result_t result, const char *fname, void *user_data), void *user_data))plt_insert_dir3,
 
     .streamer_get_playing_track_safe = (DB_playItem_t *(*) (void))streamer_get_playing_track,
+
+    .task_group_create = task_group_create,
+    .task_group_free = task_group_free,
+    .task_group_submit = task_group_submit,
+    .task_group_cancel = task_group_cancel,
+    .task_group_is_cancelled = task_group_is_cancelled,
+    .task_group_wait = task_group_wait,
+    .task_parallel_for = task_parallel_for,
+    .threadpool_get_worker_count = threadpool_get_worker_count,
+    .plug_register_decoder_signature = decoder_registry_add_signature,
+    .streamer_set_output_latency = streamer_set_output_latency,
+    .fget_region = vfs_get_region,
+    .streamer_telemetry_read = streamer_telemetry_read,
+    .streamer_telemetry_dump = streamer_telemetry_dump,
+    .dsp_get_profile = dsp_get_profile,
+    .dsp_reset_profile = dsp_reset_profile,
+    .plt_get_search_index_stats = (int (*)(ddb_playlist_t *plt, ddb_search_index_stats_t *stats))plt_get_search_index_stats,
 };
 
 DB_functions_t *deadbeef = &deadbeef_api;
@@ -748,6 +769,7 @@ plug_remove_plugin (void *p) {
     for (i = 0; g_decoder_plugins[i]; i++) {
         if (g_decoder_plugins[i] == p) {
             memmove (&g_decoder_plugins[i], &g_decoder_plugins[i+1], (MAX_DECODER_PLUGINS+1-i-1) * sizeof (void*));
+            decoder_registry_invalidate ();
             break;
         }
     }
@@ -1235,6 +1257,7 @@ plug_load_all (void) {
     g_output_plugins[numoutput] = NULL;
     g_dsp_plugins[numdsp] = NULL;
     g_playlist_plugins[numplaylist] = NULL;
+    decoder_registry_invalidate ();
 
     // select output plugin
 #ifndef XCTEST
@@ -1349,6 +1372,7 @@ _plug_unload_stop_complete (void) {
     memset (g_gui_names, 0, sizeof (g_gui_names));
     g_num_gui_names = 0;
     memset (g_decoder_plugins, 0, sizeof (g_decoder_plugins));
+    decoder_registry_free ();
     memset (g_vfs_plugins, 0, sizeof (g_vfs_plugins));
     memset (g_dsp_plugins, 0, sizeof (g_dsp_plugins));
     memset (g_output_plugins, 0, sizeof (g_output_plugins));
@@ -1701,6 +1725,7 @@ plug_register_in (DB_plugin_t *inplug) {
     for (i = 0; g_decoder_plugins[i]; i++);
     g_decoder_plugins[i++] = (DB_decoder_t *)inplug;
     g_decoder_plugins[i] = NULL;
+    decoder_registry_invalidate ();
 }
 
 // for tests
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include "../../deadbeef.h"
 #include "../../strdupa.h"
+#include "../../shared/lengthcache.h"
 #include "adplug.h"
 #include "emuopl.h"
 #include "kemuopl.h"
@@ -43,6 +44,9 @@ extern "C" {
 extern DB_decoder_t adplug_plugin;
 DB_functions_t *deadbeef;
 
+// song lengths in milliseconds, measured by emulating the whole song
+static ddb_lengthcache_t *lengthcache;
+
 const char *adplug_exts[] = { "A2M", "ADL", "AMD", "BAM", "CFF", "CMF", "D00", "DFM", "DMO", "DRO", "DTM", "HSC", "HSP", "IMF", "KSM", "LAA", "LDS", "M", "MAD", "MKJ", "MSC", "MTK", "RAD", "RAW", "RIX", "ROL", "S3M", "SA2", "SAT", "SCI", "SNG", "XAD", "XMS", "XSM", "JBM", NULL };
 
 const char *adplug_filetypes[] = { "A2M", "ADL", "AMD", "BAM", "CFF", "CMF", "D00", "DFM", "DMO", "DRO", "DTM", "HSC", "HSP", "IMF", "KSM", "LAA", "LDS", "M", "MAD", "MKJ", "MSC", "MTK", "RAD", "RAW", "RIX", "ROL", "S3M", "SA2", "SAT", "SCI", "SNG", "XAD", "XMS", "XSM", "JBM", NULL };
@@ -273,10 +277,20 @@ adplug_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         return NULL;
     }
 
+    uint8_t digest[16];
+    int have_digest = lengthcache && !ddb_lengthcache_digest_file (fname, digest);
+
     int subsongs = p->getsubsongs ();
     for (int i = 0; i < subsongs; i++) {
         // prepare track for addition
-        float dur = p->songlength (i)/1000.f;
+        int64_t length;
+        if (!have_digest || ddb_lengthcache_get (lengthcache, digest, i, &length) < 0) {
+            length = p->songlength (i);
+            if (have_digest) {
+                ddb_lengthcache_set (lengthcache, digest, i, length);
+            }
+        }
+        float dur = length/1000.f;
         if (dur < 0.1) {
             continue;
         }
@@ -318,6 +332,7 @@ adplug_start (void) {
     // e.g. starting threads for background processing, subscribing to events, etc
     // return 0 on success
     // return -1 on failure
+    lengthcache = ddb_lengthcache_open ("adplug_lengths");
     return 0;
 }
 
@@ -326,6 +341,10 @@ adplug_stop (void) {
     // undo everything done in _start here
     // return 0 on success
     // return -1 on failure
+    if (lengthcache) {
+        ddb_lengthcache_close (lengthcache);
+        lengthcache = NULL;
+    }
     return 0;
 }
 
@@ -21,12 +21,14 @@
 #include <unistd.h>
 #include <sys/prctl.h>
 #include <pthread.h>
+#include <poll.h>
 #include "../../deadbeef.h"
+#include "alsa.h"
 #ifdef HAVE_CONFIG_H
 #include "../../config.h"
 #endif
 
-#define trace(...) { deadbeef->log_detailed (&plugin.plugin, 0, __VA_ARGS__); }
+#define trace(...) { deadbeef->log_detailed (&plugin.plugin.plugin, 0, __VA_ARGS__); }
 
 #define min(x,y) ((x)<(y)?(x):(y))
 
@@ -38,7 +40,7 @@
 #define DEFAULT_BUFFER_SIZE_STR "8192"
 #define DEFAULT_PERIOD_SIZE_STR "1024"
 
-static DB_output_t plugin;
+static ddb_alsa_output_t plugin;
 DB_functions_t *deadbeef;
 
 static snd_pcm_t *audio;
@@ -58,6 +60,10 @@ static snd_pcm_uframes_t req_period_size;
 
 static int conf_alsa_resample = 1;
 static char conf_alsa_soundcard[100] = "default";
+static int conf_alsa_mmap = 0;
+
+static int use_mmap; // mmap access was accepted by the device
+static ddb_alsa_stats_t stats;
 
 static int
 palsa_callback (char *stream, int len);
@@ -103,14 +109,14 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
     snd_pcm_hw_params_t *hw_params = NULL;
     int err = 0;
 
-    memcpy (&plugin.fmt, fmt, sizeof (ddb_waveformat_t));
-    if (!plugin.fmt.channels) {
+    memcpy (&plugin.plugin.fmt, fmt, sizeof (ddb_waveformat_t));
+    if (!plugin.plugin.fmt.channels) {
         // generic format
-        plugin.fmt.bps = 16;
-        plugin.fmt.is_float = 0;
-        plugin.fmt.channels = 2;
-        plugin.fmt.samplerate = 44100;
-        plugin.fmt.channelmask = 3;
+        plugin.plugin.fmt.bps = 16;
+        plugin.plugin.fmt.is_float = 0;
+        plugin.plugin.fmt.channels = 2;
+        plugin.plugin.fmt.samplerate = 44100;
+        plugin.plugin.fmt.channelmask = 3;
     }
 
     snd_pcm_nonblock(audio, 0);
@@ -129,14 +135,25 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
         goto error;
     }
 
-    if ((err = snd_pcm_hw_params_set_access (audio, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+    use_mmap = 0;
+    if (conf_alsa_mmap) {
+        if ((err = snd_pcm_hw_params_set_access (audio, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0) {
+            fprintf (stderr, "cannot set mmap access type (%s), falling back to read/write\n",
+                    snd_strerror (err));
+        }
+        else {
+            use_mmap = 1;
+        }
+    }
+
+    if (!use_mmap && (err = snd_pcm_hw_params_set_access (audio, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
         fprintf (stderr, "cannot set access type (%s)\n",
                 snd_strerror (err));
         goto error;
     }
 
     snd_pcm_format_t sample_fmt;
-    switch (plugin.fmt.bps) {
+    switch (plugin.plugin.fmt.bps) {
     case 8:
         sample_fmt = SND_PCM_FORMAT_S8;
         break;
@@ -155,7 +172,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
 #endif
         break;
     case 32:
-        if (plugin.fmt.is_float) {
+        if (plugin.plugin.fmt.is_float) {
 #if WORDS_BIGENDIAN
             sample_fmt = SND_PCM_FORMAT_FLOAT_BE;
 #else
@@ -173,7 +190,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
     }
 
     if ((err = snd_pcm_hw_params_set_format (audio, hw_params, sample_fmt)) < 0) {
-        fprintf (stderr, "cannot set sample format to %d bps (error: %s), trying all supported formats\n", plugin.fmt.bps, snd_strerror (err));
+        fprintf (stderr, "cannot set sample format to %d bps (error: %s), trying all supported formats\n", plugin.plugin.fmt.bps, snd_strerror (err));
 
         int fmt_cnt[] = { 16, 24, 32, 32, 8 };
 #if WORDS_BIGENDIAN
@@ -185,7 +202,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
         // 1st try formats with higher bps
         int i = 0;
         for (i = 0; fmt[i] != -1; i++) {
-            if (fmt[i] != sample_fmt && fmt_cnt[i] > plugin.fmt.bps) {
+            if (fmt[i] != sample_fmt && fmt_cnt[i] > plugin.plugin.fmt.bps) {
                 if (snd_pcm_hw_params_set_format (audio, hw_params, fmt[i]) >= 0) {
                     fprintf (stderr, "Found compatible format %d bps\n", fmt_cnt[i]);
                     sample_fmt = fmt[i];
@@ -197,7 +214,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
             // next try formats with lower bps
             i = 0;
             for (i = 0; fmt[i] != -1; i++) {
-                if (fmt[i] != sample_fmt && fmt_cnt[i] < plugin.fmt.bps) {
+                if (fmt[i] != sample_fmt && fmt_cnt[i] < plugin.plugin.fmt.bps) {
                     if (snd_pcm_hw_params_set_format (audio, hw_params, fmt[i]) >= 0) {
                         fprintf (stderr, "Found compatible format %d bps\n", fmt_cnt[i]);
                         sample_fmt = fmt[i];
@@ -216,7 +233,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
     snd_pcm_hw_params_get_format (hw_params, &sample_fmt);
     trace ("chosen sample format: %04Xh\n", (int)sample_fmt);
 
-    unsigned val = (unsigned)plugin.fmt.samplerate;
+    unsigned val = (unsigned)plugin.plugin.fmt.samplerate;
     int ret = 0;
 
     if ((err = snd_pcm_hw_params_set_rate_resample (audio, hw_params, conf_alsa_resample)) < 0) {
@@ -230,7 +247,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
                 snd_strerror (err));
         goto error;
     }
-    plugin.fmt.samplerate = val;
+    plugin.plugin.fmt.samplerate = val;
     trace ("chosen samplerate: %d Hz\n", val);
 
     unsigned chanmin, chanmax;
@@ -238,7 +255,7 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
     snd_pcm_hw_params_get_channels_max (hw_params, &chanmax);
 
     trace ("minchan: %d, maxchan: %d\n", chanmin, chanmax);
-    unsigned nchan = (unsigned)plugin.fmt.channels;
+    unsigned nchan = (unsigned)plugin.plugin.fmt.channels;
     if (nchan > chanmax) {
         nchan = chanmax;
     }
@@ -271,64 +288,68 @@ palsa_set_hw_params (ddb_waveformat_t *fmt) {
         goto error;
     }
 
-    plugin.fmt.is_float = 0;
+    stats.buffer_size = (int)buffer_size;
+    stats.period_size = (int)period_size;
+    stats.mmap = use_mmap;
+
+    plugin.plugin.fmt.is_float = 0;
     switch (sample_fmt) {
     case SND_PCM_FORMAT_S8:
-        plugin.fmt.bps = 8;
+        plugin.plugin.fmt.bps = 8;
         break;
     case SND_PCM_FORMAT_S16_BE:
     case SND_PCM_FORMAT_S16_LE:
-        plugin.fmt.bps = 16;
+        plugin.plugin.fmt.bps = 16;
         break;
     case SND_PCM_FORMAT_S24_3BE:
     case SND_PCM_FORMAT_S24_3LE:
-        plugin.fmt.bps = 24;
+        plugin.plugin.fmt.bps = 24;
         break;
     case SND_PCM_FORMAT_S32_BE:
     case SND_PCM_FORMAT_S32_LE:
-        plugin.fmt.bps = 32;
+        plugin.plugin.fmt.bps = 32;
         break;
     case SND_PCM_FORMAT_FLOAT_LE:
     case SND_PCM_FORMAT_FLOAT_BE:
-        plugin.fmt.bps = 32;
-        plugin.fmt.is_float = 1;
+        plugin.plugin.fmt.bps = 32;
+        plugin.plugin.fmt.is_float = 1;
         break;
     default:
         fprintf (stderr, "Unsupported sample format %d\n", sample_fmt);
         goto error;
     }
 
-    trace ("chosen bps: %d (%s)\n", plugin.fmt.bps, plugin.fmt.is_float ? "float" : "int");
+    trace ("chosen bps: %d (%s)\n", plugin.plugin.fmt.bps, plugin.plugin.fmt.is_float ? "float" : "int");
 
-    plugin.fmt.channels = nchan;
-    plugin.fmt.channelmask = 0;
+    plugin.plugin.fmt.channels = nchan;
+    plugin.plugin.fmt.channelmask = 0;
     if (nchan == 1) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT;
     }
     if (nchan == 2) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT;
     }
     if (nchan == 3) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_LOW_FREQUENCY;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_LOW_FREQUENCY;
     }
     if (nchan == 4) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT;
     }
     if (nchan == 5) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER;
     }
     if (nchan == 6) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER | DDB_SPEAKER_LOW_FREQUENCY;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER | DDB_SPEAKER_LOW_FREQUENCY;
     }
     if (nchan == 7) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER | DDB_SPEAKER_SIDE_LEFT | DDB_SPEAKER_SIDE_RIGHT;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER | DDB_SPEAKER_SIDE_LEFT | DDB_SPEAKER_SIDE_RIGHT;
     }
     if (nchan == 8) {
-        plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER | DDB_SPEAKER_SIDE_LEFT | DDB_SPEAKER_SIDE_RIGHT | DDB_SPEAKER_LOW_FREQUENCY;
+        plugin.plugin.fmt.channelmask = DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT | DDB_SPEAKER_BACK_LEFT | DDB_SPEAKER_BACK_RIGHT | DDB_SPEAKER_FRONT_CENTER | DDB_SPEAKER_SIDE_LEFT | DDB_SPEAKER_SIDE_RIGHT | DDB_SPEAKER_LOW_FREQUENCY;
     }
 error:
     if (err < 0) {
-        memset (&plugin.fmt, 0, sizeof (ddb_waveformat_t));
+        memset (&plugin.plugin.fmt, 0, sizeof (ddb_waveformat_t));
     }
     if (hw_params) {
         snd_pcm_hw_params_free (hw_params);
@@ -342,9 +363,13 @@ palsa_init (void) {
 
     // get and cache conf variables
     conf_alsa_resample = deadbeef->conf_get_int ("alsa.resample", 1);
+    conf_alsa_mmap = deadbeef->conf_get_int ("alsa.mmap", 0);
     deadbeef->conf_get_str ("alsa_soundcard", "default", conf_alsa_soundcard, sizeof (conf_alsa_soundcard));
     trace ("alsa_soundcard: %s\n", conf_alsa_soundcard);
 
+    memset (&stats, 0, sizeof (stats));
+    stats.min_fill_level = -1;
+
     snd_pcm_sw_params_t *sw_params = NULL;
     state = DDB_PLAYBACK_STATE_STOPPED;
     //const char *conf_alsa_soundcard = conf_get_str ("alsa_soundcard", "default");
@@ -355,10 +380,10 @@ palsa_init (void) {
     }
 
     if (requested_fmt.samplerate != 0) {
-        memcpy (&plugin.fmt, &requested_fmt, sizeof (ddb_waveformat_t));
+        memcpy (&plugin.plugin.fmt, &requested_fmt, sizeof (ddb_waveformat_t));
     }
 
-    if (palsa_set_hw_params (&plugin.fmt) < 0) {
+    if (palsa_set_hw_params (&plugin.plugin.fmt) < 0) {
         goto open_error;
     }
 
@@ -436,7 +461,7 @@ _setformat_apply (void) {
 
     trace ("palsa_setformat %dbit %s %dch %dHz channelmask=%X\n", requested_fmt.bps, requested_fmt.is_float ? "float" : "int", requested_fmt.channels, requested_fmt.samplerate, requested_fmt.channelmask);
     if (!audio
-        || !memcmp (&requested_fmt, &plugin.fmt, sizeof (ddb_waveformat_t))) {
+        || !memcmp (&requested_fmt, &plugin.plugin.fmt, sizeof (ddb_waveformat_t))) {
         return 0;
     }
     else {
@@ -446,21 +471,21 @@ _setformat_apply (void) {
         "channels %d -> %d\n"
         "samplerate %d -> %d\n"
         "channelmask %d -> %d\n"
-        , requested_fmt.bps, plugin.fmt.bps
-        , requested_fmt.is_float, plugin.fmt.is_float
-        , requested_fmt.channels, plugin.fmt.channels
-        , requested_fmt.samplerate, plugin.fmt.samplerate
-        , requested_fmt.channelmask, plugin.fmt.channelmask
+        , requested_fmt.bps, plugin.plugin.fmt.bps
+        , requested_fmt.is_float, plugin.plugin.fmt.is_float
+        , requested_fmt.channels, plugin.plugin.fmt.channels
+        , requested_fmt.samplerate, plugin.plugin.fmt.samplerate
+        , requested_fmt.channelmask, plugin.plugin.fmt.channelmask
         );
     }
     int ret = palsa_set_hw_params (&requested_fmt);
     if (ret < 0) {
         trace ("palsa_setformat: impossible to set requested format\n");
         // even if it failed -- copy the format
-        memcpy (&plugin.fmt, &requested_fmt, sizeof (ddb_waveformat_t));
+        memcpy (&plugin.plugin.fmt, &requested_fmt, sizeof (ddb_waveformat_t));
         return -1;
     }
-    trace ("new format %dbit %s %dch %dHz channelmask=%X\n", plugin.fmt.bps, plugin.fmt.is_float ? "float" : "int", plugin.fmt.channels, plugin.fmt.samplerate, plugin.fmt.channelmask);
+    trace ("new format %dbit %s %dch %dHz channelmask=%X\n", plugin.plugin.fmt.bps, plugin.plugin.fmt.is_float ? "float" : "int", plugin.plugin.fmt.channels, plugin.plugin.fmt.samplerate, plugin.plugin.fmt.channelmask);
     return 0;
 }
 
@@ -601,6 +626,12 @@ alsa_recover (int err) {
     // these errors are auto-fixed by snd_pcm_recover
     if (err == -EINTR || err == -EPIPE || err == -ESTRPIPE) {
         trace ("alsa_recover: %d: %s\n", err, snd_strerror (err));
+        if (err == -EPIPE) {
+            stats.xruns++;
+        }
+        else if (err == -ESTRPIPE) {
+            stats.suspends++;
+        }
         err = snd_pcm_recover (audio, err, 1);
         if (err < 0) {
             trace ("snd_pcm_recover: %d: %s\n", err, snd_strerror (err));
@@ -614,6 +645,140 @@ alsa_recover (int err) {
     return err;
 }
 
+// must be called with the mutex locked
+static void
+_update_fill_level (snd_pcm_sframes_t avail) {
+    stats.wakeups++;
+    int fill = (int)buffer_size - (int)avail;
+    if (fill < 0) {
+        fill = 0;
+    }
+    stats.fill_level = fill;
+    if (stats.min_fill_level < 0 || fill < stats.min_fill_level) {
+        stats.min_fill_level = fill;
+    }
+}
+
+// Fills the free space in the device buffer directly from the streamer.
+// Must be called with the mutex locked.
+static void
+_mmap_fill (void) {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update (audio);
+    if (avail < 0) {
+        alsa_recover ((int)avail);
+        return;
+    }
+    _update_fill_level (avail);
+
+    int framesize = (plugin.plugin.fmt.bps>>3) * plugin.plugin.fmt.channels;
+    int filled = 0;
+    while (avail >= (snd_pcm_sframes_t)period_size) {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t frames = avail;
+        int err = snd_pcm_mmap_begin (audio, &areas, &offset, &frames);
+        if (err < 0) {
+            alsa_recover (err);
+            return;
+        }
+
+        // interleaved access: all channels are in the first area
+        char *ptr = (char *)areas[0].addr + (areas[0].first >> 3) + offset * (areas[0].step >> 3);
+        palsa_callback (ptr, (int)frames * framesize);
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit (audio, offset, frames);
+        if (committed < 0) {
+            alsa_recover ((int)committed);
+            return;
+        }
+        stats.frames_written += committed;
+        filled = 1;
+        if ((snd_pcm_uframes_t)committed != frames) {
+            break;
+        }
+        avail -= committed;
+    }
+    if (filled) {
+        stats.fills++;
+    }
+
+    // the start threshold may not be reached when the buffer is filled in one go
+    if (snd_pcm_state (audio) == SND_PCM_STATE_PREPARED && snd_pcm_avail_update (audio) < (snd_pcm_sframes_t)period_size) {
+        snd_pcm_start (audio);
+    }
+}
+
+// Waits for the device to request more data, instead of sleeping for a fixed time.
+// Returns when terminating, or when the device doesn't accept mmap access after a format change.
+static void
+palsa_thread_mmap (void) {
+    for (;;) {
+        if (alsa_terminate) {
+            break;
+        }
+
+        LOCK;
+
+        if (state != DDB_PLAYBACK_STATE_PLAYING) {
+            UNLOCK;
+            usleep (10000);
+            continue;
+        }
+
+        // setformat
+        int res = 0;
+        if (_setformat_requested) {
+            res = _setformat_apply ();
+        }
+
+        if (res != 0) {
+            deadbeef->thread_detach (alsa_tid);
+            alsa_terminate = 1;
+            UNLOCK;
+            break;
+        }
+
+        if (!use_mmap) {
+            UNLOCK;
+            break;
+        }
+
+        _mmap_fill ();
+
+        int nfds = snd_pcm_poll_descriptors_count (audio);
+        int timeout = (int)(period_size * 2 * 1000 / plugin.plugin.fmt.samplerate) + 1;
+        UNLOCK;
+
+        if (nfds <= 0) {
+            usleep (timeout * 1000);
+            continue;
+        }
+
+        struct pollfd fds[nfds];
+        LOCK;
+        nfds = snd_pcm_poll_descriptors (audio, fds, nfds);
+        UNLOCK;
+
+        // the timeout allows to react to termination and state changes
+        if (poll (fds, nfds, timeout) > 0) {
+            unsigned short revents = 0;
+            LOCK;
+            snd_pcm_poll_descriptors_revents (audio, fds, nfds, &revents);
+            if (revents & POLLERR) {
+                // underrun or suspend, the state tells which one
+                snd_pcm_state_t st = snd_pcm_state (audio);
+                if (st == SND_PCM_STATE_XRUN) {
+                    alsa_recover (-EPIPE);
+                }
+                else if (st == SND_PCM_STATE_SUSPENDED) {
+                    alsa_recover (-ESTRPIPE);
+                }
+            }
+            UNLOCK;
+        }
+    }
+}
+
 static void
 palsa_thread (void *context) {
     prctl (PR_SET_NAME, "deadbeef-alsa", 0, 0, 0, 0);
@@ -623,6 +788,11 @@ palsa_thread (void *context) {
         if (alsa_terminate) {
             break;
         }
+        // the access type can change with the format
+        if (use_mmap) {
+            palsa_thread_mmap ();
+            continue;
+        }
 
         LOCK;
 
@@ -645,6 +815,11 @@ palsa_thread (void *context) {
             break;
         }
 
+        if (use_mmap) {
+            UNLOCK;
+            continue;
+        }
+
         res = 0;
         // wait for buffer
         avail = snd_pcm_avail_update (audio);
@@ -657,9 +832,9 @@ palsa_thread (void *context) {
             usleep (10000);
             continue;
         }
-        int maxwait = period_size * 1000 / plugin.fmt.samplerate;
+        _update_fill_level (avail);
         if (avail >= period_size) {
-            int sz = avail * (plugin.fmt.bps>>3) * plugin.fmt.channels;
+            int sz = avail * (plugin.plugin.fmt.bps>>3) * plugin.plugin.fmt.channels;
             char buf[sz];
 
             int br = palsa_callback (buf, sz);
@@ -668,6 +843,10 @@ palsa_thread (void *context) {
             int frames = snd_pcm_bytes_to_frames(audio, br);
 
             err = snd_pcm_writei (audio, buf, frames);
+            if (err > 0) {
+                stats.fills++;
+                stats.frames_written += err;
+            }
 
             if (err < 0) {
                 err = alsa_recover (err);
@@ -693,7 +872,7 @@ palsa_thread (void *context) {
         }
 
         int frames = period_size - avail;
-        int ms = frames * 1000 / plugin.fmt.samplerate;
+        int ms = frames * 1000 / plugin.plugin.fmt.samplerate;
         usleep (ms * 1000);
     }
 
@@ -730,8 +909,10 @@ alsa_configchanged (void) {
     const char *alsa_soundcard = deadbeef->conf_get_str_fast ("alsa_soundcard", "default");
     int buffer = deadbeef->conf_get_int ("alsa.buffer", DEFAULT_BUFFER_SIZE);
     int period = deadbeef->conf_get_int ("alsa.period", DEFAULT_PERIOD_SIZE);
+    int alsa_mmap = deadbeef->conf_get_int ("alsa.mmap", 0);
     if (audio &&
             (alsa_resample != conf_alsa_resample
+            || alsa_mmap != conf_alsa_mmap
             || strcmp (alsa_soundcard, conf_alsa_soundcard)
             || buffer != req_buffer_size
             || period != req_period_size)) {
@@ -786,6 +967,25 @@ alsa_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
     return 0;
 }
 
+static void
+alsa_get_stats (ddb_alsa_stats_t *out) {
+    LOCK;
+    memcpy (out, &stats, sizeof (ddb_alsa_stats_t));
+    UNLOCK;
+}
+
+static void
+alsa_reset_stats (void) {
+    LOCK;
+    stats.xruns = 0;
+    stats.suspends = 0;
+    stats.wakeups = 0;
+    stats.fills = 0;
+    stats.frames_written = 0;
+    stats.min_fill_level = -1;
+    UNLOCK;
+}
+
 static int
 alsa_start (void) {
     mutex = deadbeef->mutex_create ();
@@ -811,19 +1011,21 @@ static const char settings_dlg[] =
     "property \"Use ALSA resampling\" checkbox alsa.resample 1;\n"
     "property \"Preferred buffer size\" entry alsa.buffer " DEFAULT_BUFFER_SIZE_STR ";\n"
     "property \"Preferred period size\" entry alsa.period " DEFAULT_PERIOD_SIZE_STR ";\n"
+    "property \"Write directly to the device buffer (mmap)\" checkbox alsa.mmap 0;\n"
 ;
 
 // define plugin interface
-static DB_output_t plugin = {
-    DDB_PLUGIN_SET_API_VERSION
-    .plugin.version_major = 1,
-    .plugin.version_minor = 0,
-    .plugin.type = DB_PLUGIN_OUTPUT,
-//    .plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
-    .plugin.id = "alsa",
-    .plugin.name = "ALSA output plugin",
-    .plugin.descr = "plays sound through linux standard alsa library",
-    .plugin.copyright =
+static ddb_alsa_output_t plugin = {
+    .plugin.plugin.api_vmajor = DB_API_VERSION_MAJOR,
+    .plugin.plugin.api_vminor = DB_API_VERSION_MINOR,
+    .plugin.plugin.version_major = DDB_ALSA_MAJOR_VERSION,
+    .plugin.plugin.version_minor = DDB_ALSA_MINOR_VERSION,
+    .plugin.plugin.type = DB_PLUGIN_OUTPUT,
+//    .plugin.plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
+    .plugin.plugin.id = "alsa",
+    .plugin.plugin.name = "ALSA output plugin",
+    .plugin.plugin.descr = "plays sound through linux standard alsa library",
+    .plugin.plugin.copyright =
         "Copyright (C) 2009-2013 Oleksiy Yakovenko <waker@users.sourceforge.net>\n"
         "\n"
         "This program is free software; you can redistribute it and/or\n"
@@ -840,18 +1042,20 @@ static DB_output_t plugin = {
         "along with this program; if not, write to the Free Software\n"
         "Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.\n"
     ,
-    .plugin.website = "http://deadbeef.sf.net",
-    .plugin.start = alsa_start,
-    .plugin.stop = alsa_stop,
-    .plugin.configdialog = settings_dlg,
-    .plugin.message = alsa_message,
-    .init = palsa_init,
-    .free = palsa_free,
-    .setformat = palsa_setformat,
-    .play = palsa_play,
-    .stop = palsa_stop,
-    .pause = palsa_pause,
-    .unpause = palsa_unpause,
-    .state = palsa_get_state,
-    .enum_soundcards = palsa_enum_soundcards,
+    .plugin.plugin.website = "http://deadbeef.sf.net",
+    .plugin.plugin.start = alsa_start,
+    .plugin.plugin.stop = alsa_stop,
+    .plugin.plugin.configdialog = settings_dlg,
+    .plugin.plugin.message = alsa_message,
+    .plugin.init = palsa_init,
+    .plugin.free = palsa_free,
+    .plugin.setformat = palsa_setformat,
+    .plugin.play = palsa_play,
+    .plugin.stop = palsa_stop,
+    .plugin.pause = palsa_pause,
+    .plugin.unpause = palsa_unpause,
+    .plugin.state = palsa_get_state,
+    .plugin.enum_soundcards = palsa_enum_soundcards,
+    .get_stats = alsa_get_stats,
+    .reset_stats = alsa_reset_stats,
 };
@@ -0,0 +1,52 @@
+/*
+    DeaDBeeF - The Ultimate Music Player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko <waker@users.sourceforge.net>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __ALSA_H
+#define __ALSA_H
+
+#include <stdint.h>
+#include "../../deadbeef.h"
+
+#define DDB_ALSA_MAJOR_VERSION 1
+#define DDB_ALSA_MINOR_VERSION 1
+
+// Output statistics, collected since the device was opened, or since reset_stats was called
+typedef struct {
+    uint64_t xruns; // buffer underruns, recovered with snd_pcm_recover
+    uint64_t suspends; // the device was suspended, e.g. on system sleep
+    uint64_t wakeups; // output thread wakeups during playback
+    uint64_t fills; // wakeups which wrote data to the device
+    uint64_t frames_written;
+    int buffer_size; // device buffer size, frames
+    int period_size; // frames
+    int fill_level; // frames queued in the device buffer at the last wakeup
+    int min_fill_level; // lowest fill level, -1 if no wakeups yet
+    int mmap; // 1 if the device buffer is filled directly, via snd_pcm_mmap_begin/commit
+} ddb_alsa_stats_t;
+
+// Get it with plug_get_for_id ("alsa"), and check that plugin.version_minor >= 1
+typedef struct {
+    DB_output_t plugin;
+
+    void
+    (*get_stats) (ddb_alsa_stats_t *stats);
+
+    void
+    (*reset_stats) (void);
+} ddb_alsa_output_t;
+
+#endif /*__ALSA_H*/
@@ -29,6 +29,7 @@
 #import "scriptable_encoder.h"
 #include "converter.h"
 #include "deadbeef.h"
+#include "rg_scanner.h"
 
 extern DB_functions_t *deadbeef;
 static NSString *default_format = @"[%tracknumber%. ][%artist% - ]%title%";
@@ -502,6 +503,12 @@ static NSMutableArray *g_converterControllers;
         .rewrite_tags_after_copy = (self.retagAfterCopyState == NSControlStateValueOn),
     };
 
+    // shares the setting with the GTK converter UI
+    ddb_converter_replaygain_t *rg = NULL;
+    if (deadbeef->conf_get_int ("converter.compute_replaygain", 0) && PLUG_TEST_COMPAT(&self.converter_plugin->misc.plugin, 1, 6)) {
+        rg = self.converter_plugin->replaygain_alloc (DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS);
+    }
+
     for (int n = 0; n < self.convert_items_count; n++) {
         deadbeef->pl_lock ();
         NSString *text = [NSString stringWithUTF8String:deadbeef->pl_find_meta (_convert_items[n], ":URI")];
@@ -547,12 +554,23 @@ static NSMutableArray *g_converterControllers;
         }
 
         if (!skip) {
-            self.converter_plugin->convert2 (&settings, self.convert_items[n], outpath, &_cancelled);
+            if (rg) {
+                self.converter_plugin->convert3 (&settings, self.convert_items[n], outpath, rg, &_cancelled);
+            }
+            else {
+                self.converter_plugin->convert2 (&settings, self.convert_items[n], outpath, &_cancelled);
+            }
         }
         if (self.cancelled) {
             break;
         }
     }
+    if (rg) {
+        if (!self.cancelled) {
+            self.converter_plugin->replaygain_write_album_tags (rg);
+        }
+        self.converter_plugin->replaygain_free (rg);
+    }
     dispatch_async(dispatch_get_main_queue(), ^{
         [self.progressPanel close];
         [self converterFinished:self withResult:1];
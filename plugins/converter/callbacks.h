@@ -135,6 +135,10 @@ void
 on_retag_after_copy_toggled            (GtkToggleButton *togglebutton,
                                         gpointer         user_data);
 
+void
+on_compute_replaygain_toggled          (GtkToggleButton *togglebutton,
+                                        gpointer         user_data);
+
 void
 on_minimize_on_startup_clicked         (GtkButton       *button,
                                         gpointer         user_data);
@@ -42,6 +42,7 @@
 #include <errno.h>
 #include "../../deadbeef.h"
 #include "converter.h"
+#include "../rg_scanner/rg_scanner.h"
 #include "../../strdupa.h"
 #include "../../shared/mp4tagutil.h"
 
@@ -855,8 +856,149 @@ static const unsigned char format_id_pcm[] = {
     0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
 };
 
+typedef struct {
+    DB_playItem_t *it;
+    char *out;
+    ddb_encoder_preset_t *encoder_preset;
+    int track_index; // in the analyzer
+    int rg_only; // only the ReplayGain values are written, see _converter_write_tags
+} converter_rg_track_t;
+
+struct ddb_converter_replaygain_s {
+    ddb_rg_scanner_t *rg_scanner;
+    ddb_rg_analyzer_t *analyzer;
+    int mode;
+    int num_analyzed; // number of tracks added to the analyzer
+
+    // successfully converted tracks, which need the album values
+    converter_rg_track_t *tracks;
+    int num_tracks;
+    int tracks_allocated;
+};
+
+static ddb_converter_replaygain_t *
+replaygain_alloc (int mode) {
+    ddb_rg_scanner_t *rg_scanner = (ddb_rg_scanner_t *)deadbeef->plug_get_for_id ("rg_scanner");
+    if (!rg_scanner || !PLUG_TEST_COMPAT(&rg_scanner->misc.plugin, 1, 1)) {
+        trace ("converter: ReplayGain Scanner 1.1 is not available\n");
+        return NULL;
+    }
+
+    ddb_converter_replaygain_t *rg = calloc (1, sizeof (ddb_converter_replaygain_t));
+    rg->rg_scanner = rg_scanner;
+    rg->mode = mode;
+    rg->analyzer = rg_scanner->analyzer_alloc (mode, deadbeef->conf_get_float ("rg_scanner.target_db", DDB_RG_SCAN_DEFAULT_LOUDNESS));
+    return rg;
+}
+
+static void
+replaygain_free (ddb_converter_replaygain_t *rg) {
+    for (int i = 0; i < rg->num_tracks; i++) {
+        deadbeef->pl_item_unref (rg->tracks[i].it);
+        free (rg->tracks[i].out);
+        encoder_preset_free (rg->tracks[i].encoder_preset);
+    }
+    free (rg->tracks);
+    rg->rg_scanner->analyzer_free (rg->analyzer);
+    free (rg);
+}
+
+static void
+_replaygain_append_track (ddb_converter_replaygain_t *rg, DB_playItem_t *it, const char *out, ddb_encoder_preset_t *encoder_preset, int track_index, int rg_only) {
+    if (rg->num_tracks == rg->tracks_allocated) {
+        rg->tracks_allocated = rg->tracks_allocated ? rg->tracks_allocated * 2 : 16;
+        rg->tracks = realloc (rg->tracks, rg->tracks_allocated * sizeof (converter_rg_track_t));
+    }
+    converter_rg_track_t *track = &rg->tracks[rg->num_tracks++];
+    deadbeef->pl_item_ref (it);
+    track->it = it;
+    track->out = strdup (out);
+    track->encoder_preset = encoder_preset_alloc ();
+    encoder_preset_copy (track->encoder_preset, encoder_preset);
+    track->track_index = track_index;
+    track->rg_only = rg_only;
+}
+
+// Tee float32 audio into the analyzer.
+// The track is added with the format of the first block; *track_index is -1 before that, and -2 on error.
+static void
+_replaygain_add_frames (ddb_converter_replaygain_t *rg, DB_playItem_t *it, const ddb_waveformat_t *fmt, const float *samples, int frames, int *track_index, ddb_waveformat_t *track_fmt) {
+    if (*track_index == -1) {
+        *track_index = rg->rg_scanner->analyzer_add_track (rg->analyzer, it, fmt);
+        if (*track_index < 0) {
+            *track_index = -2;
+            return;
+        }
+        rg->num_analyzed = *track_index + 1;
+        memcpy (track_fmt, fmt, sizeof (ddb_waveformat_t));
+    }
+    if (*track_index < 0) {
+        return;
+    }
+    // the dsp chain may change the format on the fly, which the analyzer can't follow
+    if (fmt->channels != track_fmt->channels || fmt->samplerate != track_fmt->samplerate) {
+        return;
+    }
+    rg->rg_scanner->analyzer_add_frames (rg->analyzer, *track_index, samples, frames);
+}
+
+// Decode the source file only for the analysis, when it's not decoded for conversion
+static int
+_replaygain_analyze_source (ddb_converter_replaygain_t *rg, DB_playItem_t *it, int *abort) {
+    int track_index = -1;
+
+    deadbeef->pl_lock ();
+    DB_decoder_t *dec = (DB_decoder_t *)deadbeef->plug_get_for_id (deadbeef->pl_find_meta (it, ":DECODER"));
+    deadbeef->pl_unlock ();
+    if (!dec) {
+        return -1;
+    }
+
+    DB_fileinfo_t *fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL | DDB_DECODER_HINT_OFFLINE);
+    if (!fileinfo) {
+        return -1;
+    }
+    if (dec->init (fileinfo, DB_PLAYITEM (it)) != 0) {
+        dec->free (fileinfo);
+        return -1;
+    }
+
+    ddb_waveformat_t fmt;
+    memcpy (&fmt, &fileinfo->fmt, sizeof (fmt));
+    fmt.bps = 32;
+    fmt.is_float = 1;
+    ddb_waveformat_t track_fmt;
+
+    int samplesize = fileinfo->fmt.channels * fileinfo->fmt.bps / 8;
+    int bs = 2000 * samplesize;
+    char *buffer = malloc (bs);
+    float *bufferf = malloc (2000 * sizeof (float) * fileinfo->fmt.channels);
+
+    for (;;) {
+        if (abort && *abort) {
+            break;
+        }
+        int sz = dec->read (fileinfo, buffer, bs);
+        deadbeef->pcm_convert (&fileinfo->fmt, buffer, &fmt, (char *)bufferf, sz);
+        _replaygain_add_frames (rg, it, &fmt, bufferf, sz / samplesize, &track_index, &track_fmt);
+        if (sz != bs) {
+            break;
+        }
+    }
+
+    free (buffer);
+    free (bufferf);
+    dec->free (fileinfo);
+
+    if (abort && *abort && track_index >= 0) {
+        rg->rg_scanner->analyzer_remove_track (rg->analyzer, track_index);
+        return -1;
+    }
+    return track_index;
+}
+
 static int64_t
-_write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_dsp_preset_t *dsp_preset, ddb_encoder_preset_t *encoder_preset, int *abort, int fd, int output_bps, int output_is_float) {
+_write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_dsp_preset_t *dsp_preset, ddb_encoder_preset_t *encoder_preset, int *abort, int fd, int output_bps, int output_is_float, ddb_converter_replaygain_t *rg, int *rg_track_index) {
     int64_t res = -1;
     char *buffer = NULL;
     char *dspbuffer = NULL;
@@ -880,6 +1022,7 @@ _write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_d
     buffer = malloc (dspsize);
     // account for up to float32 7.1 resampled to 48x ratio
     dspbuffer = malloc (dspsize);
+    ddb_waveformat_t rg_fmt;
     int eof = 0;
     for (;;) {
         if (eof) {
@@ -893,6 +1036,15 @@ _write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_d
         if (sz != bs) {
             eof = 1;
         }
+        if (rg && !dsp_preset) {
+            // analyze the decoded audio, using dspbuffer for float conversion
+            ddb_waveformat_t fmt;
+            memcpy (&fmt, &fileinfo->fmt, sizeof (fmt));
+            fmt.bps = 32;
+            fmt.is_float = 1;
+            deadbeef->pcm_convert (&fileinfo->fmt, buffer, &fmt, dspbuffer, sz);
+            _replaygain_add_frames (rg, it, &fmt, (float *)dspbuffer, sz / samplesize, rg_track_index, &rg_fmt);
+        }
         if (dsp_preset) {
             ddb_waveformat_t fmt;
             ddb_waveformat_t outfmt;
@@ -916,6 +1068,11 @@ _write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_d
                 goto error;
             }
 
+            if (rg) {
+                // analyze the dsp output, which goes to the encoder
+                _replaygain_add_frames (rg, it, &fmt, (float *)dspbuffer, frames, rg_track_index, &rg_fmt);
+            }
+
             outsr = fmt.samplerate;
             outch = fmt.channels;
 
@@ -1193,8 +1350,10 @@ static const char *ddb_internal_rg_keys[] = {
     NULL
 };
 
+// rg_flags: which of the rg_result values to write, each bit is 1 shifted left by DDB_REPLAYGAIN_* constant
+// rg_only: keep the tags read from the output file, and only set the rg_result values
 static int
-_converter_write_tags (ddb_encoder_preset_t *encoder_preset, DB_playItem_t *it, const char *out) {
+_converter_write_tags (ddb_encoder_preset_t *encoder_preset, DB_playItem_t *it, const char *out, const ddb_rg_scanner_result_t *rg_result, uint32_t rg_flags, int rg_only) {
     int err = 0;
 
     DB_playItem_t *out_it = NULL;
@@ -1211,13 +1370,18 @@ _converter_write_tags (ddb_encoder_preset_t *encoder_preset, DB_playItem_t *it,
 
     out_it = deadbeef->pl_item_init (out);
 
-    if (!out_it) {
+    if (!out_it && rg_only) {
+        // the existing tags can't be preserved
+        trace ("converter: Failed to read the tags of %s\n", out);
+        return -1;
+    }
+    else if (!out_it) {
         // can't initialize the converted file, just copy metadata from source
         out_it = deadbeef->pl_item_alloc ();
         deadbeef->pl_item_copy (out_it, it);
         deadbeef->pl_set_item_flags (out_it, 0);
     }
-    else {
+    else if (!rg_only) {
         // merge metadata
         deadbeef->pl_lock ();
 
@@ -1251,6 +1415,22 @@ _converter_write_tags (ddb_encoder_preset_t *encoder_preset, DB_playItem_t *it,
         }
         m = next;
     }
+
+    if (rg_result) {
+        if (rg_flags & (1<<DDB_REPLAYGAIN_TRACKGAIN)) {
+            deadbeef->pl_set_item_replaygain (out_it, DDB_REPLAYGAIN_TRACKGAIN, rg_result->track_gain);
+        }
+        if (rg_flags & (1<<DDB_REPLAYGAIN_TRACKPEAK)) {
+            deadbeef->pl_set_item_replaygain (out_it, DDB_REPLAYGAIN_TRACKPEAK, rg_result->track_peak);
+        }
+        if (rg_flags & (1<<DDB_REPLAYGAIN_ALBUMGAIN)) {
+            deadbeef->pl_set_item_replaygain (out_it, DDB_REPLAYGAIN_ALBUMGAIN, rg_result->album_gain);
+        }
+        if (rg_flags & (1<<DDB_REPLAYGAIN_ALBUMPEAK)) {
+            deadbeef->pl_set_item_replaygain (out_it, DDB_REPLAYGAIN_ALBUMPEAK, rg_result->album_peak);
+        }
+    }
+
     deadbeef->pl_replace_meta (out_it, ":URI", out);
 
     uint32_t tagflags = 0;
@@ -1342,8 +1522,36 @@ ddb_mktemp(char *template, size_t template_size, char *suffix) {
 #endif
 }
 
+// Write the track values of a converted track, and remember it for the album values
+static void
+_replaygain_finish_track (ddb_converter_replaygain_t *rg, DB_playItem_t *it, const char *out, ddb_encoder_preset_t *encoder_preset, int track_index, int rg_only) {
+    ddb_rg_scanner_result_t result;
+    rg->rg_scanner->analyzer_get_track_result (rg->analyzer, track_index, &result);
+    (void)_converter_write_tags (encoder_preset, it, out, &result, (1<<DDB_REPLAYGAIN_TRACKGAIN)|(1<<DDB_REPLAYGAIN_TRACKPEAK), rg_only);
+    _replaygain_append_track (rg, it, out, encoder_preset, track_index, rg_only);
+}
+
 static int
-convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out, int *pabort) {
+replaygain_write_album_tags (ddb_converter_replaygain_t *rg) {
+    if (rg->mode == DDB_RG_SCAN_MODE_TRACK || !rg->num_tracks) {
+        return 0;
+    }
+
+    ddb_rg_scanner_result_t *results = calloc (rg->num_analyzed, sizeof (ddb_rg_scanner_result_t));
+    rg->rg_scanner->analyzer_get_results (rg->analyzer, results);
+
+    uint32_t flags = (1<<DDB_REPLAYGAIN_TRACKGAIN)|(1<<DDB_REPLAYGAIN_TRACKPEAK)|(1<<DDB_REPLAYGAIN_ALBUMGAIN)|(1<<DDB_REPLAYGAIN_ALBUMPEAK);
+    for (int i = 0; i < rg->num_tracks; i++) {
+        converter_rg_track_t *track = &rg->tracks[i];
+        (void)_converter_write_tags (track->encoder_preset, track->it, track->out, &results[track->track_index], flags, track->rg_only);
+    }
+
+    free (results);
+    return 0;
+}
+
+static int
+convert3 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out, ddb_converter_replaygain_t *rg, int *pabort) {
     int output_bps = settings->output_bps;
     int output_is_float = settings->output_is_float;
     ddb_encoder_preset_t *encoder_preset = settings->encoder_preset;
@@ -1377,8 +1585,16 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
         if (res) {
             return res;
         }
+        if (rg) {
+            int rg_track_index = _replaygain_analyze_source (rg, it, pabort);
+            if (rg_track_index >= 0) {
+                // without rewriting the tags, the copied file only gets the ReplayGain values
+                _replaygain_finish_track (rg, it, out, encoder_preset, rg_track_index, !rewrite_tags_after_copy);
+                return res;
+            }
+        }
         if (rewrite_tags_after_copy) {
-            (void)_converter_write_tags (encoder_preset, it, out);
+            (void)_converter_write_tags (encoder_preset, it, out, NULL, 0, 0);
         }
         return res;
     }
@@ -1389,6 +1605,7 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
     DB_decoder_t *dec = NULL;
     DB_fileinfo_t *fileinfo = NULL;
     char input_file_name[PATH_MAX] = "";
+    int rg_track_index = -1;
 
     char *final_path = strdupa (out);
     char *sep = strrchr (final_path, '/');
@@ -1409,7 +1626,7 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
         deadbeef->pl_unlock ();
 
         if (dec) {
-            fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL);
+            fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL | DDB_DECODER_HINT_OFFLINE);
             if (fileinfo && dec->init (fileinfo, DB_PLAYITEM (it)) != 0) {
                 trace ("Failed to decode file %s\n", fname);
                 goto error;
@@ -1482,7 +1699,7 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
                 }
 
                 if (temp_file > 0) {
-                    int64_t outsize = _write_wav (it, dec, fileinfo, dsp_preset, encoder_preset, pabort, temp_file, output_bps, output_is_float);
+                    int64_t outsize = _write_wav (it, dec, fileinfo, dsp_preset, encoder_preset, pabort, temp_file, output_bps, output_is_float, rg, &rg_track_index);
 
                     if (outsize < 0) {
                         goto error;
@@ -1538,14 +1755,32 @@ error:
         unlink (input_file_name);
     }
     if (err != 0) {
+        if (rg && rg_track_index >= 0) {
+            rg->rg_scanner->analyzer_remove_track (rg->analyzer, rg_track_index);
+        }
         return err;
     }
 
-    (void)_converter_write_tags (encoder_preset, it, out);
+    if (rg && rg_track_index == -1) {
+        // the encoder has read the source file by itself
+        rg_track_index = _replaygain_analyze_source (rg, it, pabort);
+    }
+
+    if (rg && rg_track_index >= 0) {
+        _replaygain_finish_track (rg, it, out, encoder_preset, rg_track_index, 0);
+    }
+    else {
+        (void)_converter_write_tags (encoder_preset, it, out, NULL, 0, 0);
+    }
 
     return err;
 }
 
+static int
+convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out, int *pabort) {
+    return convert3 (settings, it, out, NULL, pabort);
+}
+
 static int
 convert (DB_playItem_t *it, const char *out, int output_bps, int output_is_float, ddb_encoder_preset_t *encoder_preset, ddb_dsp_preset_t *dsp_preset, int *abort) {
     ddb_converter_settings_t settings = {
@@ -1590,7 +1825,7 @@ static ddb_converter_t plugin = {
     .misc.plugin.api_vmajor = DB_API_VERSION_MAJOR,
     .misc.plugin.api_vminor = DB_API_VERSION_MINOR,
     .misc.plugin.version_major = 1,
-    .misc.plugin.version_minor = 5,
+    .misc.plugin.version_minor = 6,
     .misc.plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .misc.plugin.type = DB_PLUGIN_MISC,
     .misc.plugin.name = "Converter",
@@ -1657,6 +1892,11 @@ static ddb_converter_t plugin = {
     .get_output_path2 = get_output_path2,
     // 1.5 entry points
     .convert2 = convert2,
+    // 1.6 entry points
+    .replaygain_alloc = replaygain_alloc,
+    .replaygain_free = replaygain_free,
+    .replaygain_write_album_tags = replaygain_write_album_tags,
+    .convert3 = convert3,
 };
 
 DB_plugin_t *
@@ -25,6 +25,9 @@
 
 #include <stdint.h>
 
+// changes in 1.6:
+//   added ReplayGain computation during conversion: `replaygain_alloc`, `replaygain_free`,
+//   `replaygain_write_album_tags` and `convert3`
 // changes in 1.5:
 //   added mp4 tagging support
 //   added converter option to copy files without conversion, if file format isn't changing
@@ -101,6 +104,9 @@ typedef struct ddb_converter_settings_s {
     int rewrite_tags_after_copy;
 } ddb_converter_settings_t;
 
+// ReplayGain state of a batch of converted tracks
+typedef struct ddb_converter_replaygain_s ddb_converter_replaygain_t;
+
 typedef struct {
     DB_misc_t misc;
 
@@ -265,6 +271,35 @@ typedef struct {
          // *pabort will be checked regularly, conversion will be interrupted if it's non-zero
          int *pabort
     );
+
+    // since 1.6
+    // ReplayGain can be computed from the audio decoded for the conversion,
+    // instead of scanning the converted files again.
+    // mode: one of DDB_RG_SCAN_MODE_* from rg_scanner.h, which defines how the album values are computed.
+    // Returns NULL if the ReplayGain Scanner plugin is not available.
+    ddb_converter_replaygain_t *
+    (*replaygain_alloc) (int mode);
+
+    void
+    (*replaygain_free) (ddb_converter_replaygain_t *rg);
+
+    // Should be called after all tracks of the batch have been converted.
+    // Writes the album gain and peak into the tags of the converted files.
+    int
+    (*replaygain_write_album_tags) (ddb_converter_replaygain_t *rg);
+
+    // Same as convert2, but also computes the track gain and peak, and writes them into the output file tags.
+    // rg can be NULL.
+    // Tracks which are not decoded for conversion (copied, or passed to the encoder by file name)
+    // are decoded separately, to keep the album values correct.
+    int
+    (*convert3) (
+         ddb_converter_settings_t *settings,
+         DB_playItem_t *it,
+         const char *outpath,
+         ddb_converter_replaygain_t *rg,
+         int *pabort
+    );
 } ddb_converter_t;
 
 #endif
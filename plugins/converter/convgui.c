@@ -35,6 +35,7 @@
 #include <unistd.h>
 #include "../../deadbeef.h"
 #include "converter.h"
+#include "../rg_scanner/rg_scanner.h"
 #include "support.h"
 #include "interface.h"
 #include "../gtkui/gtkui_api.h"
@@ -61,6 +62,7 @@ typedef struct {
     int write_to_source_folder;
     int bypass_same_format;
     int retag_after_copy;
+    int compute_replaygain;
     int output_bps;
     int output_is_float;
     int overwrite_action;
@@ -219,6 +221,11 @@ converter_worker (void *ctx) {
         .rewrite_tags_after_copy = conv->retag_after_copy,
     };
 
+    ddb_converter_replaygain_t *rg = NULL;
+    if (conv->compute_replaygain && PLUG_TEST_COMPAT(&converter_plugin->misc.plugin, 1, 6)) {
+        rg = converter_plugin->replaygain_alloc (DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS);
+    }
+
     for (int n = 0; n < conv->convert_items_count; n++) {
         update_progress_info_t *info = malloc (sizeof (update_progress_info_t));
         info->entry = conv->progress_entry;
@@ -251,7 +258,12 @@ converter_worker (void *ctx) {
         }
 
         if (!skip) {
-            converter_plugin->convert2 (&settings, conv->convert_items[n], outpath, &conv->cancelled);
+            if (rg) {
+                converter_plugin->convert3 (&settings, conv->convert_items[n], outpath, rg, &conv->cancelled);
+            }
+            else {
+                converter_plugin->convert2 (&settings, conv->convert_items[n], outpath, &conv->cancelled);
+            }
         }
         if (conv->cancelled) {
             for (; n < conv->convert_items_count; n++) {
@@ -261,6 +273,12 @@ converter_worker (void *ctx) {
         }
         deadbeef->pl_item_unref (conv->convert_items[n]);
     }
+    if (rg) {
+        if (!conv->cancelled) {
+            converter_plugin->replaygain_write_album_tags (rg);
+        }
+        converter_plugin->replaygain_free (rg);
+    }
     g_idle_add (destroy_progress_cb, conv->progress);
     if (conv->convert_items) {
         free (conv->convert_items);
@@ -293,6 +311,7 @@ converter_process (converter_ctx_t *conv)
     conv->write_to_source_folder = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (lookup_widget (conv->converter, "write_to_source_folder")));
     conv->bypass_same_format = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (lookup_widget (conv->converter, "bypass_same_format")));
     conv->retag_after_copy = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (lookup_widget (conv->converter, "retag_after_copy")));
+    conv->compute_replaygain = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (lookup_widget (conv->converter, "compute_replaygain")));
     conv->overwrite_action = gtk_combo_box_get_active (GTK_COMBO_BOX (lookup_widget (conv->converter, "overwrite_action")));
 
     GtkComboBox *combo = GTK_COMBO_BOX (lookup_widget (conv->converter, "output_format"));
@@ -594,6 +613,10 @@ converter_show_cb (void *data) {
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (lookup_widget (conv->converter, "retag_after_copy")), retag_after_copy);
     gtk_widget_set_sensitive (lookup_widget (conv->converter, "retag_after_copy"), bypass_same_format);
 
+    int compute_replaygain = deadbeef->conf_get_int ("converter.compute_replaygain", 0);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (lookup_widget (conv->converter, "compute_replaygain")), compute_replaygain);
+    gtk_widget_set_sensitive (lookup_widget (conv->converter, "compute_replaygain"), PLUG_TEST_COMPAT(&converter_plugin->misc.plugin, 1, 6) && deadbeef->plug_get_for_id ("rg_scanner") != NULL);
+
     g_signal_connect ((gpointer) lookup_widget (conv->converter, "write_to_source_folder"), "toggled",
             G_CALLBACK (on_write_to_source_folder_toggled),
             conv);
@@ -867,6 +890,15 @@ on_retag_after_copy_toggled            (GtkToggleButton *togglebutton,
     deadbeef->conf_save ();
 }
 
+void
+on_compute_replaygain_toggled          (GtkToggleButton *togglebutton,
+                                        gpointer         user_data)
+{
+    int active = gtk_toggle_button_get_active (togglebutton);
+    deadbeef->conf_set_int ("converter.compute_replaygain", active);
+    deadbeef->conf_save ();
+}
+
 DB_decoder_t *
 plug_get_decoder_for_id (const char *id) {
     DB_decoder_t **plugins = deadbeef->plug_get_decoder_list ();
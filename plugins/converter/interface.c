@@ -42,6 +42,7 @@ create_converterdlg (void)
   GtkWidget *preserve_folders;
   GtkWidget *bypass_same_format;
   GtkWidget *retag_after_copy;
+  GtkWidget *compute_replaygain;
   GtkWidget *hbox100;
   GtkWidget *label122;
   GtkWidget *hbox101;
@@ -133,6 +134,10 @@ create_converterdlg (void)
   gtk_widget_show (retag_after_copy);
   gtk_box_pack_start (GTK_BOX (vbox26), retag_after_copy, FALSE, FALSE, 0);
 
+  compute_replaygain = gtk_check_button_new_with_mnemonic (_("Compute ReplayGain while converting"));
+  gtk_widget_show (compute_replaygain);
+  gtk_box_pack_start (GTK_BOX (vbox26), compute_replaygain, FALSE, FALSE, 0);
+
   hbox100 = gtk_hbox_new (FALSE, 8);
   gtk_widget_show (hbox100);
   gtk_box_pack_start (GTK_BOX (vbox26), hbox100, FALSE, TRUE, 0);
@@ -290,6 +295,9 @@ create_converterdlg (void)
   g_signal_connect ((gpointer) retag_after_copy, "toggled",
                     G_CALLBACK (on_retag_after_copy_toggled),
                     NULL);
+  g_signal_connect ((gpointer) compute_replaygain, "toggled",
+                    G_CALLBACK (on_compute_replaygain_toggled),
+                    NULL);
   g_signal_connect ((gpointer) encoder, "changed",
                     G_CALLBACK (on_converter_encoder_changed),
                     NULL);
@@ -326,6 +334,7 @@ create_converterdlg (void)
   GLADE_HOOKUP_OBJECT (converterdlg, preserve_folders, "preserve_folders");
   GLADE_HOOKUP_OBJECT (converterdlg, bypass_same_format, "bypass_same_format");
   GLADE_HOOKUP_OBJECT (converterdlg, retag_after_copy, "retag_after_copy");
+  GLADE_HOOKUP_OBJECT (converterdlg, compute_replaygain, "compute_replaygain");
   GLADE_HOOKUP_OBJECT (converterdlg, hbox100, "hbox100");
   GLADE_HOOKUP_OBJECT (converterdlg, label122, "label122");
   GLADE_HOOKUP_OBJECT (converterdlg, hbox101, "hbox101");
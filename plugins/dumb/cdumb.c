@@ -32,18 +32,26 @@
 #include "modloader.h"
 #include "../../deadbeef.h"
 #include "../../strdupa.h"
+#include "../../shared/lengthcache.h"
 
 //#define trace(...) { fprintf(stderr, __VA_ARGS__); }
 #define trace(fmt,...)
 
+// seconds between the renderer checkpoints made by dumb_it_do_initial_runthrough
+#define CHECKPOINT_INTERVAL 30
+
 static DB_decoder_t plugin;
 DB_functions_t *deadbeef;
 
+// module lengths in 1/65536 seconds, found by playing through the module
+static ddb_lengthcache_t *lengthcache;
+
 typedef struct {
     DB_fileinfo_t info;
     DUH *duh;
     DUH_SIGRENDERER *renderer;
     int can_loop;
+    int has_checkpoints; // the module was run through, see cdumb_seek
 } dumb_info_t;
 
 //#define DUMB_RQ_ALIASING
@@ -61,7 +69,7 @@ static int conf_global_volume = 64;
 static int conf_play_forever = 0;
 
 static int
-cdumb_startrenderer (DB_fileinfo_t *_info);
+cdumb_startrenderer (DB_fileinfo_t *_info, long pos);
 
 static DB_fileinfo_t *
 cdumb_open (uint32_t hints) {
@@ -86,8 +94,12 @@ cdumb_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     ext++;
     const char *ftype;
     info->duh = g_open_module (uri, &is_it, &is_dos, &is_ptcompat, 0, &ftype);
+    if (!info->duh) {
+        return -1;
+    }
 
-    dumb_it_do_initial_runthrough (info->duh);
+    // The length is known from the insert, and the playback doesn't need the checkpoints
+    // made by the initial runthrough, so it's postponed until the first seek.
 
     _info->plugin = &plugin;
     _info->fmt.bps = conf_bps;
@@ -96,7 +108,7 @@ cdumb_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     _info->readpos = 0;
     _info->fmt.channelmask = _info->fmt.channels == 1 ? DDB_SPEAKER_FRONT_LEFT : (DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT);
 
-    if (cdumb_startrenderer (_info) < 0) {
+    if (cdumb_startrenderer (_info, 0) < 0) {
         return -1;
     }
 
@@ -104,15 +116,16 @@ cdumb_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     return 0;
 }
 
+// pos is in 1/65536 seconds; with the checkpoints, the renderer starts from the nearest one before pos
 static int
-cdumb_startrenderer (DB_fileinfo_t *_info) {
+cdumb_startrenderer (DB_fileinfo_t *_info, long pos) {
     dumb_info_t *info = (dumb_info_t *)_info;
     // reopen
     if (info->renderer) {
         duh_end_sigrenderer (info->renderer);
         info->renderer = NULL;
     }
-    info->renderer = duh_start_sigrenderer (info->duh, 0, 2, 0);
+    info->renderer = duh_start_sigrenderer (info->duh, 0, 2, pos);
     if (!info->renderer) {
         return -1;
     }
@@ -193,17 +206,21 @@ static int
 cdumb_seek (DB_fileinfo_t *_info, float time) {
     trace ("cdumb_read seek %f\n", time);
     dumb_info_t *info = (dumb_info_t *)_info;
-    float skiptime = time;
-    if (skiptime < _info->readpos) {
-        if (cdumb_startrenderer (_info) < 0) {
+    float skiptime = time - _info->readpos;
+    if (skiptime < 0 || skiptime >= CHECKPOINT_INTERVAL) {
+        // jump to the nearest checkpoint, instead of rendering from the current position or the start
+        if (!info->has_checkpoints) {
+            dumb_it_do_initial_runthrough (info->duh);
+            info->has_checkpoints = 1;
+        }
+        if (cdumb_startrenderer (_info, (long)(time * 65536)) < 0) {
             return -1;
-        }       
+        }
     }
     else {
-        skiptime -= _info->readpos;
+        int pos = skiptime * _info->fmt.samplerate;
+        duh_sigrenderer_generate_samples (info->renderer, 0, 65536.0f / _info->fmt.samplerate, pos, NULL);
     }
-    int pos = skiptime * _info->fmt.samplerate;
-    duh_sigrenderer_generate_samples (info->renderer, 0, 65536.0f / _info->fmt.samplerate, pos, NULL);
     _info->readpos = time;
     return 0;
 }
@@ -363,8 +380,17 @@ cdumb_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
     read_metadata_internal (it, itsd);
 
-    dumb_it_do_initial_runthrough (duh);
-    deadbeef->plt_set_item_duration (plt, it, duh_get_length (duh)/65536.0f);
+    uint8_t digest[16];
+    int have_digest = lengthcache && !ddb_lengthcache_digest_file (fname, digest);
+    int64_t length;
+    if (!have_digest || ddb_lengthcache_get (lengthcache, digest, 0, &length) < 0) {
+        dumb_it_do_initial_runthrough (duh);
+        length = duh_get_length (duh);
+        if (have_digest) {
+            ddb_lengthcache_set (lengthcache, digest, 0, length);
+        }
+    }
+    deadbeef->plt_set_item_duration (plt, it, length/65536.0f);
     deadbeef->pl_add_meta (it, ":FILETYPE", ftype);
 //    printf ("duration: %f\n", _info->duration);
     after = deadbeef->plt_insert_item (plt, after, it);
@@ -439,12 +465,17 @@ dumb_register_db_vfs (void) {
 int
 cdumb_start (void) {
     dumb_register_db_vfs ();
+    lengthcache = ddb_lengthcache_open ("dumb_lengths");
     return 0;
 }
 
 int
 cdumb_stop (void) {
     dumb_exit ();
+    if (lengthcache) {
+        ddb_lengthcache_close (lengthcache);
+        lengthcache = NULL;
+    }
     return 0;
 }
 
@@ -39,6 +39,9 @@
 #include <math.h>
 #include "../../deadbeef.h"
 #include "../../strdupa.h"
+#if HAVE_SSE2 && !ARCH_UNKNOWN && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 #ifdef TARGET_ANDROID
 int posix_memalign (void **memptr, size_t alignment, size_t size) {
@@ -267,14 +270,27 @@ typedef struct APEContext {
     int filterbuf_size[APE_FILTER_LEVELS];
 } APEContext;
 
+typedef struct ape_mt_s ape_mt_t;
+
 typedef struct {
     DB_fileinfo_t info;
     int64_t startsample;
     int64_t endsample;
     APEContext ape_ctx;
     DB_FILE *fp;
+    uint32_t hints;
+    ape_mt_t *mt; // frame-parallel decoding state, only used with DDB_DECODER_HINT_OFFLINE
 } ape_info_t;
 
+static ape_mt_t *
+ape_mt_create (ape_info_t *info);
+
+static void
+ape_mt_free (ape_mt_t *mt);
+
+static void
+ape_mt_reset (ape_mt_t *mt, int frame);
+
 
 inline static int
 read_uint16(DB_FILE *fp, uint16_t* x)
@@ -657,10 +673,29 @@ ape_free_ctx (APEContext *ape_ctx) {
     memset (ape_ctx, 0, sizeof (APEContext));
 }
 
+static int
+ape_alloc_filterbufs (APEContext *ctx) {
+    for (int i = 0; i < APE_FILTER_LEVELS; i++) {
+        if (!ape_filter_orders[ctx->fset][i])
+            break;
+        ctx->filterbuf_size[i] = (ape_filter_orders[ctx->fset][i] * 3 + HISTORY_SIZE) * 4;
+        int err = posix_memalign ((void **)&ctx->filterbuf[i], 16, ctx->filterbuf_size[i]);
+        if (err) {
+            trace ("ffap: out of memory (posix_memalign)\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
 static void
 ffap_free (DB_fileinfo_t *_info)
 {
     ape_info_t *info = (ape_info_t *)_info;
+    if (info->mt) {
+        ape_mt_free (info->mt);
+        info->mt = NULL;
+    }
     ape_free_ctx (&info->ape_ctx);
     if (info->fp) {
         deadbeef->fclose (info->fp);
@@ -671,6 +706,7 @@ ffap_free (DB_fileinfo_t *_info)
 static DB_fileinfo_t *
 ffap_open (uint32_t hints) {
     ape_info_t *info = calloc (1, sizeof (ape_info_t));
+    info->hints = hints;
     return &info->info;
 }
 
@@ -697,7 +733,6 @@ ffap_init (DB_fileinfo_t *_info, DB_playItem_t *it)
     if (ape_read_header (info->fp, &info->ape_ctx)) {
         return -1;
     }
-    int i;
 
     if (info->ape_ctx.channels > 2) {
         fprintf (stderr, "ape: Only mono and stereo is supported\n");
@@ -712,15 +747,8 @@ ffap_init (DB_fileinfo_t *_info, DB_playItem_t *it)
         return -1;
     }
     info->ape_ctx.fset = info->ape_ctx.compressiontype / 1000 - 1;
-    for (i = 0; i < APE_FILTER_LEVELS; i++) {
-        if (!ape_filter_orders[info->ape_ctx.fset][i])
-            break;
-        info->ape_ctx.filterbuf_size[i] = (ape_filter_orders[info->ape_ctx.fset][i] * 3 + HISTORY_SIZE) * 4;
-        int err = posix_memalign ((void **)&info->ape_ctx.filterbuf[i], 16, info->ape_ctx.filterbuf_size[i]);
-        if (err) {
-            trace ("ffap: out of memory (posix_memalign)\n");
-            return -1;
-        }
+    if (ape_alloc_filterbufs (&info->ape_ctx) < 0) {
+        return -1;
     }
 
     _info->plugin = &plugin;
@@ -736,6 +764,10 @@ ffap_init (DB_fileinfo_t *_info, DB_playItem_t *it)
         return -1;
     }
 
+    if ((info->hints & DDB_DECODER_HINT_OFFLINE) && info->ape_ctx.totalframes > 1) {
+        info->mt = ape_mt_create (info);
+    }
+
     int64_t endsample = deadbeef->pl_item_get_endsample (it);
     if (endsample > 0) {
         info->startsample = deadbeef->pl_item_get_startsample (it);
@@ -1273,6 +1305,29 @@ static int32_t scalarproduct_and_madd_int16_c(int16_t *v1, const int16_t *v2, co
     return res;
 }
 
+#if HAVE_SSE2 && !ARCH_UNKNOWN && defined(__GNUC__)
+#define HAVE_AVX2_INTRINSICS 1
+// Same as ff_scalarproduct_and_madd_int16_sse2, but 16 coefficients at a time.
+// The filter orders are multiples of 16, and the buffers are only 16-byte aligned.
+__attribute__((target("avx2")))
+static int32_t scalarproduct_and_madd_int16_avx2(int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul)
+{
+    __m256i vmul = _mm256_set1_epi16 ((int16_t)mul);
+    __m256i sum = _mm256_setzero_si256 ();
+    for (int i = 0; i < order; i += 16) {
+        __m256i a = _mm256_loadu_si256 ((const __m256i *)(v1 + i));
+        __m256i b = _mm256_loadu_si256 ((const __m256i *)(v2 + i));
+        __m256i c = _mm256_loadu_si256 ((const __m256i *)(v3 + i));
+        sum = _mm256_add_epi32 (sum, _mm256_madd_epi16 (a, b));
+        _mm256_storeu_si256 ((__m256i *)(v1 + i), _mm256_add_epi16 (a, _mm256_mullo_epi16 (c, vmul)));
+    }
+    __m128i res = _mm_add_epi32 (_mm256_castsi256_si128 (sum), _mm256_extracti128_si256 (sum, 1));
+    res = _mm_add_epi32 (res, _mm_shuffle_epi32 (res, 0x4e));
+    res = _mm_add_epi32 (res, _mm_shuffle_epi32 (res, 0xb1));
+    return _mm_cvtsi128_si32 (res);
+}
+#endif
+
 static int32_t
 (*scalarproduct_and_madd_int16)(int16_t *v1, const int16_t *v2, const int16_t *v3, int order, int mul);
 
@@ -1444,6 +1499,61 @@ static void ape_unpack_stereo(APEContext * ctx, int count)
     }
 }
 
+// Converts the decoded blocks from..end-1 to the output format, returns the end of the written data
+static char *
+ape_output_samples (APEContext *s, int bps, int from, int end, char *samples)
+{
+    int i = from;
+    if (bps == 32) {
+        for (; i < end; i++) {
+            *((int32_t*)samples) = s->decoded0[i];
+            samples += 4;
+            if(s->channels > 1) {
+                *((int32_t*)samples) = s->decoded1[i];
+                samples += 4;
+            }
+        }
+    }
+    else if (bps == 24) {
+        for (; i < end; i++) {
+            int32_t sample = s->decoded0[i];
+
+            samples[0] = sample&0xff;
+            samples[1] = (sample&0xff00)>>8;
+            samples[2] = (sample&0xff0000)>>16;
+            samples += 3;
+            if(s->channels > 1) {
+                sample = s->decoded1[i];
+                samples[0] = sample&0xff;
+                samples[1] = (sample&0xff00)>>8;
+                samples[2] = (sample&0xff0000)>>16;
+                samples += 3;
+            }
+        }
+    }
+    else if (bps == 16) {
+        for (; i < end; i++) {
+            *((int16_t*)samples) = (int16_t)s->decoded0[i];
+            samples += 2;
+            if(s->channels > 1) {
+                *((int16_t*)samples) = (int16_t)s->decoded1[i];
+                samples += 2;
+            }
+        }
+    }
+    else if (bps == 8) {
+        for (; i < end; i++) {
+            *samples = (int16_t)s->decoded0[i];
+            samples++;
+            if(s->channels > 1) {
+                *samples = (int16_t)s->decoded1[i];
+                samples++;
+            }
+        }
+    }
+    return samples;
+}
+
 static int
 ape_decode_frame(DB_fileinfo_t *_info, void *data, int *data_size)
 {
@@ -1451,7 +1561,7 @@ ape_decode_frame(DB_fileinfo_t *_info, void *data, int *data_size)
     APEContext *s = &info->ape_ctx;
     char *samples = data;
     int nblocks;
-    int i, n;
+    int n;
     int blockstodecode;
     long bytes_used;
     int samplesize = _info->fmt.bps/8 * s->channels;;
@@ -1552,56 +1662,8 @@ ape_decode_frame(DB_fileinfo_t *_info, void *data, int *data_size)
     }
 
     int skip = min (s->samplestoskip, blockstodecode);
-    i = skip;
+    ape_output_samples (s, _info->fmt.bps, skip, blockstodecode, samples);
 
-    if (_info->fmt.bps == 32) {
-        for (; i < blockstodecode; i++) {
-            *((int32_t*)samples) = s->decoded0[i];
-            samples += 4;
-            if(s->channels > 1) {
-                *((int32_t*)samples) = s->decoded1[i];
-                samples += 4;
-            }
-        }
-    }
-    else if (_info->fmt.bps == 24) {
-        for (; i < blockstodecode; i++) {
-            int32_t sample = s->decoded0[i];
-
-            samples[0] = sample&0xff;
-            samples[1] = (sample&0xff00)>>8;
-            samples[2] = (sample&0xff0000)>>16;
-            samples += 3;
-            if(s->channels > 1) {
-                sample = s->decoded1[i];
-                samples[0] = sample&0xff;
-                samples[1] = (sample&0xff00)>>8;
-                samples[2] = (sample&0xff0000)>>16;
-                samples += 3;
-            }
-        }
-    }
-    else if (_info->fmt.bps == 16) {
-        for (; i < blockstodecode; i++) {
-            *((int16_t*)samples) = (int16_t)s->decoded0[i];
-            samples += 2;
-            if(s->channels > 1) {
-                *((int16_t*)samples) = (int16_t)s->decoded1[i];
-                samples += 2;
-            }
-        }
-    }
-    else if (_info->fmt.bps == 8) {
-        for (; i < blockstodecode; i++) {
-            *samples = (int16_t)s->decoded0[i];
-            samples++;
-            if(s->channels > 1) {
-                *samples = (int16_t)s->decoded1[i];
-                samples++;
-            }
-        }
-    }
-    
     s->samplestoskip -= skip;
     s->samples -= blockstodecode;
 
@@ -1621,6 +1683,326 @@ error:
     return (int)bytes_used;
 }
 
+/**
+ * @defgroup mt Frame-parallel decoding
+ * Used with DDB_DECODER_HINT_OFFLINE, e.g. by the converter and the replaygain scanner.
+ * APE frames don't depend on each other, so the frames ahead of the read position are read
+ * from the file on the calling thread, and decoded on the shared thread pool, each into its own buffer.
+ * The reader decodes a frame itself if its task didn't start yet, so it never waits for a busy pool.
+ * @{
+ */
+
+#define MT_MAX_SLOTS 16
+
+enum {
+    SLOT_FREE,
+    SLOT_PENDING, // packet is loaded, waiting for decoding
+    SLOT_DECODING,
+    SLOT_DONE,
+    SLOT_ERROR,
+};
+
+typedef struct {
+    ape_mt_t *mt;
+    APEContext ctx; // decoder state of this slot
+    int state;
+    int frame;
+    uint8_t *packet;
+    int packet_size;
+    int packet_alloc;
+    char *pcm;
+    int pcm_size;
+} ape_mt_slot_t;
+
+struct ape_mt_s {
+    ddb_task_group_t *group;
+    uintptr_t mutex;
+    uintptr_t cond;
+    int bps;
+    int samplesize;
+    int nslots;
+    ape_mt_slot_t *slots;
+    int next_frame; // next frame to read from the file
+    int out_frame; // frame being returned to the caller
+    int out_pos; // read position in the pcm buffer of out_frame
+};
+
+// Reads a whole frame into memory, prefixed with the block count and the skip, as done by ape_read_packet
+static int
+ape_read_packet_mem (DB_FILE *fp, APEContext *ape, int frame, ape_mt_slot_t *slot) {
+    int size = ape->frames[frame].size;
+    if (size <= 0 || size > INT_MAX - 8) {
+        return -1;
+    }
+    if (slot->packet_alloc < size + 8) {
+        free (slot->packet);
+        slot->packet = malloc (size + 8);
+        if (!slot->packet) {
+            slot->packet_alloc = 0;
+            return -1;
+        }
+        slot->packet_alloc = size + 8;
+    }
+    if (deadbeef->fseek (fp, ape->frames[frame].pos + ape->skip_header, SEEK_SET) != 0) {
+        return -1;
+    }
+    int nblocks = frame == ape->totalframes - 1 ? ape->finalframeblocks : ape->blocksperframe;
+    AV_WL32(slot->packet    , nblocks);
+    AV_WL32(slot->packet + 4, ape->frames[frame].skip);
+    size_t rb = deadbeef->fread (slot->packet + 8, 1, size, fp);
+    slot->packet_size = (int)rb + 8;
+    return 0;
+}
+
+// Decodes a whole frame read by ape_read_packet_mem.
+// Returns the number of decoded blocks, or -1 on error.
+static int
+ape_decode_frame_mem (APEContext *s, int bps, uint8_t *packet, int packet_size, char *samples)
+{
+    bswap_buf((uint32_t*)packet, (const uint32_t*)packet, packet_size >> 2);
+
+    s->ptr = s->last_ptr = packet;
+    s->data_end = packet + packet_size;
+
+    int nblocks = s->samples = bytestream_get_be32(&s->ptr);
+    int n = bytestream_get_be32(&s->ptr);
+    if(n < 0 || n > 3){
+        trace ("ape: Incorrect offset passed\n");
+        return -1;
+    }
+    s->ptr += n;
+    if (nblocks <= 0) {
+        return 0;
+    }
+    if (nblocks > s->blocksperframe) {
+        return -1;
+    }
+    s->currentframeblocks = nblocks;
+
+    memset(s->decoded0,  0, sizeof(s->decoded0));
+    memset(s->decoded1,  0, sizeof(s->decoded1));
+    init_frame_decoder(s);
+
+    while (s->samples > 0) {
+        int blockstodecode = min(BLOCKS_PER_LOOP, s->samples);
+        s->error = 0;
+        if ((s->channels == 1) || (s->frameflags & APE_FRAMECODE_PSEUDO_STEREO))
+            ape_unpack_mono(s, blockstodecode);
+        else
+            ape_unpack_stereo(s, blockstodecode);
+
+        if (s->error || s->ptr >= s->data_end) {
+            fprintf (stderr, "ape: Error decoding frame, error=%d\n", s->error);
+            return -1;
+        }
+        samples = ape_output_samples (s, bps, 0, blockstodecode, samples);
+        s->samples -= blockstodecode;
+    }
+    return nblocks;
+}
+
+static void
+ape_mt_decode_slot (ape_mt_slot_t *slot) {
+    ape_mt_t *mt = slot->mt;
+    int nblocks = ape_decode_frame_mem (&slot->ctx, mt->bps, slot->packet, slot->packet_size, slot->pcm);
+
+    deadbeef->mutex_lock (mt->mutex);
+    if (nblocks < 0) {
+        slot->state = SLOT_ERROR;
+    }
+    else {
+        slot->pcm_size = nblocks * mt->samplesize;
+        slot->state = SLOT_DONE;
+    }
+    deadbeef->cond_broadcast (mt->cond);
+    deadbeef->mutex_unlock (mt->mutex);
+}
+
+static void
+ape_mt_task (void *ctx) {
+    ape_mt_slot_t *slot = ctx;
+    ape_mt_t *mt = slot->mt;
+    deadbeef->mutex_lock (mt->mutex);
+    if (slot->state != SLOT_PENDING) {
+        // already taken by the reader, or dropped by a seek
+        deadbeef->mutex_unlock (mt->mutex);
+        return;
+    }
+    slot->state = SLOT_DECODING;
+    deadbeef->mutex_unlock (mt->mutex);
+
+    ape_mt_decode_slot (slot);
+}
+
+static ape_mt_t *
+ape_mt_create (ape_info_t *info) {
+    APEContext *ape = &info->ape_ctx;
+    int workers = deadbeef->threadpool_get_worker_count ();
+    if (workers <= 0) {
+        return NULL;
+    }
+
+    ape_mt_t *mt = calloc (1, sizeof (ape_mt_t));
+    mt->bps = info->info.fmt.bps;
+    mt->samplesize = info->info.fmt.bps / 8 * ape->channels;
+    mt->nslots = min (MT_MAX_SLOTS, (workers + 1) * 2);
+    mt->slots = calloc (mt->nslots, sizeof (ape_mt_slot_t));
+    mt->mutex = deadbeef->mutex_create ();
+    mt->cond = deadbeef->cond_create ();
+    mt->group = deadbeef->task_group_create ("ffap", DDB_TASK_PRIORITY_NORMAL, 0);
+    if (!mt->slots || !mt->group) {
+        goto error;
+    }
+
+    for (int i = 0; i < mt->nslots; i++) {
+        ape_mt_slot_t *slot = &mt->slots[i];
+        slot->mt = mt;
+        slot->ctx.fileversion = ape->fileversion;
+        slot->ctx.channels = ape->channels;
+        slot->ctx.fset = ape->fset;
+        slot->ctx.blocksperframe = ape->blocksperframe;
+        if (ape_alloc_filterbufs (&slot->ctx) < 0) {
+            goto error;
+        }
+        slot->pcm = malloc (ape->blocksperframe * mt->samplesize);
+        if (!slot->pcm) {
+            goto error;
+        }
+    }
+    trace ("ffap: frame-parallel decoding with %d slots\n", mt->nslots);
+    return mt;
+
+error:
+    ape_mt_free (mt);
+    return NULL;
+}
+
+static void
+ape_mt_free (ape_mt_t *mt) {
+    if (mt->group) {
+        deadbeef->mutex_lock (mt->mutex);
+        for (int i = 0; i < mt->nslots; i++) {
+            if (mt->slots[i].state == SLOT_PENDING) {
+                mt->slots[i].state = SLOT_FREE;
+            }
+        }
+        deadbeef->mutex_unlock (mt->mutex);
+        deadbeef->task_group_free (mt->group);
+    }
+    if (mt->slots) {
+        for (int i = 0; i < mt->nslots; i++) {
+            ape_mt_slot_t *slot = &mt->slots[i];
+            for (int l = 0; l < APE_FILTER_LEVELS; l++) {
+                free (slot->ctx.filterbuf[l]);
+            }
+            free (slot->packet);
+            free (slot->pcm);
+        }
+        free (mt->slots);
+    }
+    deadbeef->cond_free (mt->cond);
+    deadbeef->mutex_free (mt->mutex);
+    free (mt);
+}
+
+// Drops the decoded and pending frames, and restarts from the specified frame
+static void
+ape_mt_reset (ape_mt_t *mt, int frame) {
+    deadbeef->mutex_lock (mt->mutex);
+    for (;;) {
+        int busy = 0;
+        for (int i = 0; i < mt->nslots; i++) {
+            if (mt->slots[i].state == SLOT_DECODING) {
+                busy = 1;
+            }
+            else {
+                mt->slots[i].state = SLOT_FREE;
+            }
+        }
+        if (!busy) {
+            break;
+        }
+        deadbeef->cond_wait (mt->cond, mt->mutex);
+    }
+    deadbeef->mutex_unlock (mt->mutex);
+    mt->next_frame = mt->out_frame = frame;
+    mt->out_pos = 0;
+}
+
+// Reads and submits the frames which fit into the free slots
+static void
+ape_mt_fill (ape_info_t *info) {
+    ape_mt_t *mt = info->mt;
+    APEContext *ape = &info->ape_ctx;
+    while (mt->next_frame < ape->totalframes && mt->next_frame < mt->out_frame + mt->nslots) {
+        ape_mt_slot_t *slot = &mt->slots[mt->next_frame % mt->nslots];
+        int state = SLOT_PENDING;
+        if (ape_read_packet_mem (info->fp, ape, mt->next_frame, slot) < 0) {
+            state = SLOT_ERROR;
+        }
+        deadbeef->mutex_lock (mt->mutex);
+        slot->frame = mt->next_frame;
+        slot->state = state;
+        deadbeef->mutex_unlock (mt->mutex);
+        if (state == SLOT_PENDING) {
+            deadbeef->task_group_submit (mt->group, ape_mt_task, slot);
+        }
+        mt->next_frame++;
+    }
+}
+
+// Returns the number of bytes written to the buffer
+static int
+ape_mt_read (ape_info_t *info, char *buffer, int size) {
+    ape_mt_t *mt = info->mt;
+    APEContext *ape = &info->ape_ctx;
+    int initsize = size;
+    while (size > 0 && mt->out_frame < ape->totalframes) {
+        ape_mt_fill (info);
+
+        ape_mt_slot_t *slot = &mt->slots[mt->out_frame % mt->nslots];
+        deadbeef->mutex_lock (mt->mutex);
+        if (slot->state == SLOT_PENDING) {
+            slot->state = SLOT_DECODING;
+            deadbeef->mutex_unlock (mt->mutex);
+            ape_mt_decode_slot (slot);
+            deadbeef->mutex_lock (mt->mutex);
+        }
+        while (slot->state == SLOT_DECODING) {
+            deadbeef->cond_wait (mt->cond, mt->mutex);
+        }
+        int state = slot->state;
+        deadbeef->mutex_unlock (mt->mutex);
+
+        if (state != SLOT_DONE) {
+            fprintf (stderr, "ape: error decoding frame %d\n", mt->out_frame);
+            break;
+        }
+
+        if (ape->samplestoskip > 0) {
+            mt->out_pos = min (slot->pcm_size, ape->samplestoskip * mt->samplesize);
+            ape->samplestoskip = 0;
+        }
+
+        int sz = min (size, slot->pcm_size - mt->out_pos);
+        memcpy (buffer, slot->pcm + mt->out_pos, sz);
+        buffer += sz;
+        size -= sz;
+        mt->out_pos += sz;
+
+        if (mt->out_pos >= slot->pcm_size) {
+            deadbeef->mutex_lock (mt->mutex);
+            slot->state = SLOT_FREE;
+            deadbeef->mutex_unlock (mt->mutex);
+            mt->out_frame++;
+            mt->out_pos = 0;
+        }
+    }
+    return initsize - size;
+}
+
+/** @} */
+
 static DB_playItem_t *
 ffap_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     APEContext ape_ctx;
@@ -1723,8 +2105,32 @@ ffap_read (DB_fileinfo_t *_info, char *buffer, int size) {
         }
     }
     int inits = size;
-    while (size > 0) {
-        if (info->ape_ctx.remaining > 0) {
+    if (info->mt) {
+        size -= ape_mt_read (info, buffer, size);
+    }
+    else {
+        while (size > 0) {
+            if (info->ape_ctx.remaining > 0) {
+                int sz = min (size, info->ape_ctx.remaining);
+                memcpy (buffer, info->ape_ctx.buffer, sz);
+                buffer += sz;
+                size -= sz;
+                if (info->ape_ctx.remaining > sz) {
+                    memmove (info->ape_ctx.buffer, info->ape_ctx.buffer + sz, info->ape_ctx.remaining-sz);
+                }
+                info->ape_ctx.remaining -= sz;
+                continue;
+            }
+            int s = BLOCKS_PER_LOOP * 2 * 2 * 2;
+            assert (info->ape_ctx.remaining <= s/2);
+            s -= info->ape_ctx.remaining;
+            uint8_t *buf = info->ape_ctx.buffer + info->ape_ctx.remaining;
+            int n = ape_decode_frame (_info, buf, &s);
+            if (n == -1) {
+                break;
+            }
+            info->ape_ctx.remaining += s;
+
             int sz = min (size, info->ape_ctx.remaining);
             memcpy (buffer, info->ape_ctx.buffer, sz);
             buffer += sz;
@@ -1733,26 +2139,7 @@ ffap_read (DB_fileinfo_t *_info, char *buffer, int size) {
                 memmove (info->ape_ctx.buffer, info->ape_ctx.buffer + sz, info->ape_ctx.remaining-sz);
             }
             info->ape_ctx.remaining -= sz;
-            continue;
-        }
-        int s = BLOCKS_PER_LOOP * 2 * 2 * 2;
-        assert (info->ape_ctx.remaining <= s/2);
-        s -= info->ape_ctx.remaining;
-        uint8_t *buf = info->ape_ctx.buffer + info->ape_ctx.remaining;
-        int n = ape_decode_frame (_info, buf, &s);
-        if (n == -1) {
-            break;
         }
-        info->ape_ctx.remaining += s;
-
-        int sz = min (size, info->ape_ctx.remaining);
-        memcpy (buffer, info->ape_ctx.buffer, sz);
-        buffer += sz;
-        size -= sz;
-        if (info->ape_ctx.remaining > sz) {
-            memmove (info->ape_ctx.buffer, info->ape_ctx.buffer + sz, info->ape_ctx.remaining-sz);
-        }
-        info->ape_ctx.remaining -= sz;
     }
     info->ape_ctx.currentsample += (inits - size) / samplesize;
     _info->readpos = (info->ape_ctx.currentsample-info->startsample) / (float)_info->fmt.samplerate;
@@ -1778,6 +2165,9 @@ ffap_seek_sample (DB_fileinfo_t *_info, int sample) {
     info->ape_ctx.samplestoskip = newsample - nframe * info->ape_ctx.blocksperframe;
     trace ("seek to sample %d at blockstart\n", nframe * info->ape_ctx.blocksperframe);
     trace ("samples to skip: %d\n", info->ape_ctx.samplestoskip);
+    if (info->mt) {
+        ape_mt_reset (info->mt, nframe);
+    }
 
     // reset decoder
     info->ape_ctx.CRC = 0;
@@ -1871,7 +2261,7 @@ static const char *exts[] = { "ape", NULL };
 static DB_decoder_t plugin = {
     DDB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 1,
     .plugin.type = DB_PLUGIN_DECODER,
     .plugin.id = "ffap",
     .plugin.name = "Monkey's Audio (APE) decoder",
@@ -2041,10 +2431,17 @@ ffap_load (DB_functions_t *api) {
         trace ("ffap: sse2 is not supported by CPU\n");
         scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_c;
     }
+#if HAVE_AVX2_INTRINSICS
+    if (__builtin_cpu_supports ("avx2")) {
+        trace ("ffap: avx2 support detected\n");
+        scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_avx2;
+    }
+#endif
 #else
 //    trace ("ffap: sse2 support was not compiled in\n");
     scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_c;
 #endif
     deadbeef = api;
+    deadbeef->plug_register_decoder_signature (&plugin, 0, "MAC ", 4);
     return DB_PLUGIN (&plugin);
 }
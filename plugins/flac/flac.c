@@ -693,10 +693,47 @@ cflac_add_metadata (DB_playItem_t *it, const char *s, int length) {
     }
 }
 
+static void
+cflac_set_stream_info (flac_info_t *info, int samplerate, int channels, int bps, int64_t totalsamples, const uint8_t md5[16]) {
+    trace ("flac: samplerate=%d, channels=%d, totalsamples=%lld\n", samplerate, channels, totalsamples);
+    info->info.fmt.samplerate = samplerate;
+    info->info.fmt.channels = channels;
+    info->info.fmt.bps = fix_bps (bps);
+    info->totalsamples = totalsamples;
+    if (totalsamples > 0) {
+        deadbeef->plt_set_item_duration (info->plt, info->it, totalsamples / (float)samplerate);
+    }
+    else {
+        deadbeef->plt_set_item_duration (info->plt, info->it, -1);
+    }
+
+    // MD5 of the decoded audio, all zeroes if the encoder didn't compute it.
+    // Used by the ReplayGain scanner cache to find retagged and renamed files.
+    static const uint8_t zero_md5[16];
+    if (memcmp (md5, zero_md5, 16)) {
+        char str[33];
+        deadbeef->md5_to_str (str, md5);
+        deadbeef->pl_replace_meta (info->it, ":AUDIO_MD5", str);
+    }
+}
+
+// called after all entries of a vorbis comment block were added using cflac_add_metadata
+static void
+cflac_end_vorbis_comments (flac_info_t *info, int num_comments) {
+    DB_playItem_t *it = info->it;
+    deadbeef->pl_add_meta (it, "title", NULL);
+    if (num_comments > 0) {
+        uint32_t f = deadbeef->pl_get_item_flags (it);
+        f &= ~DDB_TAG_MASK;
+        f |= DDB_TAG_VORBISCOMMENTS;
+        deadbeef->pl_set_item_flags (it, f);
+    }
+    info->got_vorbis_comments = 1;
+}
+
 static void
 cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data) {
     flac_info_t *info = (flac_info_t *)client_data;
-    DB_fileinfo_t *_info = &info->info;
     if (info->init_stop_decoding) {
         trace ("error flag is set, ignoring init_metadata callback..\n");
         return;
@@ -704,17 +741,8 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
     DB_playItem_t *it = info->it;
     //it->tracknum = 0;
     if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
-        trace ("flac: samplerate=%d, channels=%d, totalsamples=%d\n", metadata->data.stream_info.sample_rate, metadata->data.stream_info.channels, metadata->data.stream_info.total_samples);
-        _info->fmt.samplerate = metadata->data.stream_info.sample_rate;
-        _info->fmt.channels = metadata->data.stream_info.channels;
-        _info->fmt.bps = fix_bps (metadata->data.stream_info.bits_per_sample);
-        info->totalsamples = metadata->data.stream_info.total_samples;
-        if (metadata->data.stream_info.total_samples > 0) {
-            deadbeef->plt_set_item_duration (info->plt, it, metadata->data.stream_info.total_samples / (float)metadata->data.stream_info.sample_rate);
-        }
-        else {
-            deadbeef->plt_set_item_duration (info->plt, it, -1);
-        }
+        const FLAC__StreamMetadata_StreamInfo *si = &metadata->data.stream_info;
+        cflac_set_stream_info (info, si->sample_rate, si->channels, si->bits_per_sample, si->total_samples, si->md5sum);
     }
     else if (metadata->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
         const FLAC__StreamMetadata_VorbisComment *vc = &metadata->data.vorbis_comment;
@@ -725,14 +753,7 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
                 cflac_add_metadata (it, s, c->length);
             }
         }
-        deadbeef->pl_add_meta (it, "title", NULL);
-        if (vc->num_comments > 0) {
-            uint32_t f = deadbeef->pl_get_item_flags (it);
-            f &= ~DDB_TAG_MASK;
-            f |= DDB_TAG_VORBISCOMMENTS;
-            deadbeef->pl_set_item_flags (it, f);
-        }
-        info->got_vorbis_comments = 1;
+        cflac_end_vorbis_comments (info, vc->num_comments);
     }
     else if (metadata->type == FLAC__METADATA_TYPE_CUESHEET) {
         if (!info->flac_cue_sheet) {
@@ -833,6 +854,120 @@ cflac_free_temp (DB_fileinfo_t *_info) {
     }
 }
 
+#define PROBE_MAX_COMMENT_SIZE (16*1024*1024)
+
+static uint32_t
+_read_le32 (const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int
+cflac_probe_vorbis_comments (flac_info_t *info, uint8_t *data, uint32_t size) {
+    if (size < 8) {
+        return -1;
+    }
+    uint32_t vendor_length = _read_le32 (data);
+    if (vendor_length > size - 8) {
+        return -1;
+    }
+    uint8_t *p = data + 4 + vendor_length;
+    uint8_t *end = data + size;
+    uint32_t num_comments = _read_le32 (p);
+    p += 4;
+    for (uint32_t i = 0; i < num_comments; i++) {
+        if (end - p < 4) {
+            return -1;
+        }
+        uint32_t length = _read_le32 (p);
+        p += 4;
+        if (length > end - p) {
+            return -1;
+        }
+        if (length > 0) {
+            // the entries are not terminated, borrow the first byte of the next one
+            uint8_t saved = p[length];
+            p[length] = 0;
+            cflac_add_metadata (info->it, (const char *)p, length);
+            p[length] = saved;
+        }
+        p += length;
+    }
+    cflac_end_vorbis_comments (info, num_comments);
+    return 0;
+}
+
+// Reads the metadata blocks of a native flac file in one forward pass, without creating a decoder.
+// The file must be positioned at the fLaC signature.
+// Pictures, padding and seektables are skipped over without reading.
+// Returns the offset of the first audio frame, or -1 if the file needs to be handled by libFLAC,
+// e.g. when it has a CUESHEET block, which is kept as a libFLAC object.
+static int64_t
+cflac_probe_metadata (flac_info_t *info) {
+    DB_FILE *fp = info->file;
+    uint8_t hdr[4];
+    if (deadbeef->fread (hdr, 1, 4, fp) != 4 || memcmp (hdr, "fLaC", 4)) {
+        return -1;
+    }
+    int got_streaminfo = 0;
+    int last = 0;
+    while (!last) {
+        if (deadbeef->fread (hdr, 1, 4, fp) != 4) {
+            return -1;
+        }
+        last = hdr[0] & 0x80;
+        int type = hdr[0] & 0x7f;
+        uint32_t length = (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+
+        if (type == FLAC__METADATA_TYPE_STREAMINFO) {
+            uint8_t si[34];
+            if (got_streaminfo || length != sizeof (si) || deadbeef->fread (si, 1, sizeof (si), fp) != sizeof (si)) {
+                return -1;
+            }
+            // 20 bits samplerate, 3 bits channels-1, 5 bits bps-1, 36 bits total samples
+            int samplerate = (si[10] << 12) | (si[11] << 4) | (si[12] >> 4);
+            int channels = ((si[12] >> 1) & 7) + 1;
+            int bps = (((si[12] & 1) << 4) | (si[13] >> 4)) + 1;
+            int64_t totalsamples = ((int64_t)(si[13] & 0x0f) << 32) | ((uint32_t)si[14] << 24) | (si[15] << 16) | (si[16] << 8) | si[17];
+            cflac_set_stream_info (info, samplerate, channels, bps, totalsamples, si + 18);
+            got_streaminfo = 1;
+        }
+        else if (!got_streaminfo || type == FLAC__METADATA_TYPE_CUESHEET || type >= FLAC__METADATA_TYPE_UNDEFINED) {
+            return -1;
+        }
+        else if (type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
+            if (length > PROBE_MAX_COMMENT_SIZE) {
+                return -1;
+            }
+            uint8_t *data = malloc (length + 1);
+            if (!data) {
+                return -1;
+            }
+            int res = -1;
+            if (deadbeef->fread (data, 1, length, fp) == length) {
+                data[length] = 0;
+                res = cflac_probe_vorbis_comments (info, data, length);
+            }
+            free (data);
+            if (res < 0) {
+                return -1;
+            }
+        }
+        else if (deadbeef->fseek (fp, length, SEEK_CUR)) {
+            return -1;
+        }
+    }
+    if (!info->got_vorbis_comments) {
+        // no tags: finish the item the same way as cflac_read_metadata does,
+        // so that the tags get written as vorbis comments
+        cflac_end_vorbis_comments (info, 0);
+        uint32_t f = deadbeef->pl_get_item_flags (info->it);
+        f &= ~DDB_TAG_MASK;
+        f |= DDB_TAG_VORBISCOMMENTS;
+        deadbeef->pl_set_item_flags (info->it, f);
+    }
+    return deadbeef->ftell (fp);
+}
+
 static int
 cflac_read_metadata (DB_playItem_t *it);
 
@@ -886,40 +1021,58 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     }
     info.init_stop_decoding = 0;
 
-    // open decoder for metadata reading
-    FLAC__StreamDecoderInitStatus status;
-    decoder = FLAC__stream_decoder_new();
-    if (!decoder) {
-        trace ("flac: failed to create decoder\n");
-        goto cflac_insert_fail;
+    int64_t fsize = deadbeef->fgetlength (info.file);
+    int is_streaming = info.file->vfs->is_streaming ();
+    int64_t audio_offset = -1;
+
+    it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
+
+    if (!isogg && !is_streaming) {
+        audio_offset = cflac_probe_metadata (&info);
+        if (audio_offset < 0) {
+            // start over with libFLAC
+            trace ("flac: probe failed, reading metadata using the decoder\n");
+            deadbeef->pl_item_unref (it);
+            it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
+            memset (&info.info.fmt, 0, sizeof (info.info.fmt));
+            info.totalsamples = 0;
+            info.got_vorbis_comments = 0;
+            deadbeef->fseek (info.file, skip, SEEK_SET);
+        }
     }
 
-    // read all metadata
-    FLAC__stream_decoder_set_md5_checking(decoder, 0);
-    FLAC__stream_decoder_set_metadata_respond_all (decoder);
+    if (audio_offset < 0) {
+        // open decoder for metadata reading
+        FLAC__StreamDecoderInitStatus status;
+        decoder = FLAC__stream_decoder_new();
+        if (!decoder) {
+            trace ("flac: failed to create decoder\n");
+            goto cflac_insert_fail;
+        }
 
-    it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);;
+        // read all metadata
+        FLAC__stream_decoder_set_md5_checking(decoder, 0);
+        FLAC__stream_decoder_set_metadata_respond_all (decoder);
 
-    if (isogg) {
-        status = FLAC__stream_decoder_init_ogg_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
-    }
-    else {
-        status = FLAC__stream_decoder_init_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
-    }
-    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK || info.init_stop_decoding) {
-        trace ("flac: FLAC__stream_decoder_init_stream [2] failed\n");
-        goto cflac_insert_fail;
-    }
-    if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder) || info.init_stop_decoding) {
-        trace ("flac: FLAC__stream_decoder_process_until_end_of_metadata [2] failed\n");
-        goto cflac_insert_fail;
+        if (isogg) {
+            status = FLAC__stream_decoder_init_ogg_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+        }
+        else {
+            status = FLAC__stream_decoder_init_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+        }
+        if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK || info.init_stop_decoding) {
+            trace ("flac: FLAC__stream_decoder_init_stream [2] failed\n");
+            goto cflac_insert_fail;
+        }
+        if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder) || info.init_stop_decoding) {
+            trace ("flac: FLAC__stream_decoder_process_until_end_of_metadata [2] failed\n");
+            goto cflac_insert_fail;
+        }
     }
 
     if (info.info.fmt.samplerate <= 0) {
         goto cflac_insert_fail;
     }
-    int64_t fsize = deadbeef->fgetlength (info.file);
-    int is_streaming = info.file->vfs->is_streaming ();
 
     deadbeef->pl_add_meta (it, ":FILETYPE", isogg ? "OggFLAC" : "FLAC");
 
@@ -935,7 +1088,9 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     if ( deadbeef->pl_get_item_duration (it) > 0) {
         if (!isogg) {
             FLAC__uint64 position;
-            if (FLAC__stream_decoder_get_decode_position (decoder, &position))
+            if (audio_offset >= 0)
+                fsize -= audio_offset;
+            else if (FLAC__stream_decoder_get_decode_position (decoder, &position))
                 fsize -= position;
         }
 #if USE_OGGEDIT
@@ -947,13 +1102,16 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 #endif
         deadbeef->pl_set_meta_int (it, ":BITRATE", (int)roundf(fsize / deadbeef->pl_get_item_duration (it) * 8 / 1000));
     }
-    FLAC__stream_decoder_delete(decoder);
-    decoder = NULL;
+    if (decoder) {
+        FLAC__stream_decoder_delete(decoder);
+        decoder = NULL;
+    }
 
     deadbeef->fclose (info.file);
     info.file = NULL;
 
-    if (!info.got_vorbis_comments && !is_streaming) {
+    // the probe has seen all the metadata blocks already
+    if (!info.got_vorbis_comments && !is_streaming && audio_offset < 0) {
         cflac_read_metadata (it);
     }
 
@@ -1309,7 +1467,7 @@ static ddb_decoder2_t plugin = {
     .decoder.plugin.version_major = 1,
     .decoder.plugin.version_minor = 0,
     .decoder.plugin.type = DB_PLUGIN_DECODER,
-    .decoder.plugin.flags = DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2,
+    .decoder.plugin.flags = DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2 | DDB_PLUGIN_FLAG_CONCURRENT_INSERT,
     .decoder.plugin.id = "stdflac",
     .decoder.plugin.name = "FLAC decoder",
     .decoder.plugin.descr = "FLAC decoder using libFLAC",
@@ -1364,5 +1522,6 @@ static ddb_decoder2_t plugin = {
 DB_plugin_t *
 flac_load (DB_functions_t *api) {
     deadbeef = api;
+    deadbeef->plug_register_decoder_signature (&plugin.decoder, 0, "fLaC", 4);
     return DB_PLUGIN (&plugin);
 }
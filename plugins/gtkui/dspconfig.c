@@ -40,9 +40,12 @@
 #include "gtkui.h"
 #include "pluginconf.h"
 
+#define MAX_PROFILED_DSPS 32
+
 static ddb_dsp_context_t *chain;
 static GtkWidget *prefwin;
 static GtkWidget *dsp_popup;
+static guint profile_timer;
 
 static ddb_dsp_context_t *
 dsp_clone (ddb_dsp_context_t *from) {
@@ -59,6 +62,39 @@ dsp_clone (ddb_dsp_context_t *from) {
     return dsp;
 }
 
+static void
+format_dsp_profile (const ddb_dsp_profile_t *profile, char *text, size_t size) {
+    if (!profile->enabled || !profile->blocks) {
+        *text = 0;
+        return;
+    }
+    snprintf (text, size, _("%.0f µs, p99 %.0f µs, %.2f%% of real time"), profile->mean_time, profile->p99_time, profile->realtime_factor * 100);
+}
+
+// The list matches the streamer chain, since every change is applied immediately
+static void
+update_dsp_profile (GtkListStore *mdl) {
+    ddb_dsp_profile_t profile[MAX_PROFILED_DSPS];
+    int count = deadbeef->dsp_get_profile (profile, MAX_PROFILED_DSPS);
+    GtkTreeIter iter;
+    gboolean valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (mdl), &iter);
+    for (int i = 0; valid; i++) {
+        char text[100] = "";
+        if (i < count && i < MAX_PROFILED_DSPS) {
+            format_dsp_profile (&profile[i], text, sizeof (text));
+        }
+        gtk_list_store_set (mdl, &iter, 1, text, -1);
+        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (mdl), &iter);
+    }
+}
+
+static gboolean
+dsp_profile_timer_cb (gpointer user_data) {
+    GtkWidget *listview = lookup_widget (prefwin, "dsp_listview");
+    update_dsp_profile (GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (listview))));
+    return TRUE;
+}
+
 static void
 fill_dsp_chain (GtkListStore *mdl) {
     ddb_dsp_context_t *dsp = chain;
@@ -68,6 +104,7 @@ fill_dsp_chain (GtkListStore *mdl) {
         gtk_list_store_set (mdl, &iter, 0, dsp->plugin->plugin.name, -1);
         dsp = dsp->next;
     }
+    update_dsp_profile (mdl);
 }
 
 static int dirent_alphasort (const struct dirent **a, const struct dirent **b) {
@@ -292,7 +329,10 @@ dsp_setup_init (GtkWidget *_prefwin) {
     GtkCellRenderer *title_cell = gtk_cell_renderer_text_new ();
     GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes (_("Plugin"), title_cell, "text", 0, NULL);
     gtk_tree_view_append_column (GTK_TREE_VIEW (listview), GTK_TREE_VIEW_COLUMN (col));
-    GtkListStore *mdl = gtk_list_store_new (1, G_TYPE_STRING);
+    GtkCellRenderer *profile_cell = gtk_cell_renderer_text_new ();
+    col = gtk_tree_view_column_new_with_attributes (_("Processing time per block"), profile_cell, "text", 1, NULL);
+    gtk_tree_view_append_column (GTK_TREE_VIEW (listview), GTK_TREE_VIEW_COLUMN (col));
+    GtkListStore *mdl = gtk_list_store_new (2, G_TYPE_STRING, G_TYPE_STRING);
     gtk_tree_view_set_model (GTK_TREE_VIEW (listview), GTK_TREE_MODEL (mdl));
 
     fill_dsp_chain (mdl);
@@ -300,6 +340,8 @@ dsp_setup_init (GtkWidget *_prefwin) {
     gtk_tree_view_set_cursor (GTK_TREE_VIEW (listview), path, NULL, FALSE);
     gtk_tree_path_free (path);
 
+    profile_timer = g_timeout_add_seconds (1, dsp_profile_timer_cb, NULL);
+
     GtkWidget *combobox = lookup_widget (prefwin, "dsp_preset");
     dsp_fill_preset_list (combobox);
 
@@ -319,6 +361,10 @@ dsp_setup_init (GtkWidget *_prefwin) {
 
 void
 dsp_setup_free (void) {
+    if (profile_timer) {
+        g_source_remove (profile_timer);
+        profile_timer = 0;
+    }
     while (chain) {
         ddb_dsp_context_t *next = chain->next;
         chain->plugin->close (chain);
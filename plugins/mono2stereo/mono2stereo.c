@@ -25,6 +25,11 @@
 #include <string.h>
 #include <assert.h>
 #include "../../deadbeef.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 enum {
     M2S_PARAM_LEFTMIX,
@@ -39,8 +44,6 @@ typedef struct {
     ddb_dsp_context_t ctx;
     float leftmix;
     float rightmix;
-    float *buffer;
-    int buffer_nframes;
 } ddb_m2s_t;
 
 ddb_dsp_context_t*
@@ -60,8 +63,6 @@ m2s_close (ddb_dsp_context_t *ctx) {
     ddb_m2s_t *m2s = (ddb_m2s_t *)ctx;
 
     // free instance-specific allocations
-    free (m2s->buffer);
-
     free (m2s);
 }
 
@@ -70,15 +71,6 @@ m2s_reset (ddb_dsp_context_t *ctx) {
     // use this method to flush dsp buffers, reset filters, etc
 }
 
-static void
-_m2s_alloc_buffer (ddb_m2s_t *m2s, int nframes) {
-    if (m2s->buffer_nframes < nframes) {
-        free (m2s->buffer);
-        m2s->buffer = malloc (nframes * 2 * sizeof (float));
-        m2s->buffer_nframes = nframes;
-    }
-}
-
 int
 m2s_process (ddb_dsp_context_t *ctx, float * restrict samples, int nframes, int maxframes, ddb_waveformat_t * restrict fmt, float * restrict r) {
     if (fmt->channels >= 2) {
@@ -86,15 +78,45 @@ m2s_process (ddb_dsp_context_t *ctx, float * restrict samples, int nframes, int
     }
     ddb_m2s_t *m2s = (ddb_m2s_t *)ctx;
 
-    _m2s_alloc_buffer(m2s, nframes);
-    float *input = samples;
-    float *output = m2s->buffer;
-    for (int i = 0; i < nframes; i++) {
-        float sample = *input++;
-        *output++ = sample * m2s->leftmix;
-        *output++ = sample * m2s->rightmix;
+    // In place, from the end: the output of frame i takes the positions 2i and 2i+1,
+    // so it never overwrites the input which wasn't read yet.
+    float leftmix = m2s->leftmix;
+    float rightmix = m2s->rightmix;
+    int i = nframes;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    while (i & 3) {
+        i--;
+        float sample = samples[i];
+        samples[i*2] = sample * leftmix;
+        samples[i*2+1] = sample * rightmix;
+    }
+#if defined(__SSE2__)
+    const __m128 vleft = _mm_set1_ps (leftmix);
+    const __m128 vright = _mm_set1_ps (rightmix);
+    for (i -= 4; i >= 0; i -= 4) {
+        __m128 v = _mm_loadu_ps (samples + i);
+        __m128 left = _mm_mul_ps (v, vleft);
+        __m128 right = _mm_mul_ps (v, vright);
+        _mm_storeu_ps (samples + i*2, _mm_unpacklo_ps (left, right));
+        _mm_storeu_ps (samples + i*2 + 4, _mm_unpackhi_ps (left, right));
+    }
+#else
+    for (i -= 4; i >= 0; i -= 4) {
+        float32x4_t v = vld1q_f32 (samples + i);
+        float32x4x2_t lr;
+        lr.val[0] = vmulq_n_f32 (v, leftmix);
+        lr.val[1] = vmulq_n_f32 (v, rightmix);
+        vst2q_f32 (samples + i*2, lr);
+    }
+#endif
+#else
+    while (i > 0) {
+        i--;
+        float sample = samples[i];
+        samples[i*2] = sample * leftmix;
+        samples[i*2+1] = sample * rightmix;
     }
-    memcpy (samples, m2s->buffer, nframes * 2 * sizeof (float));
+#endif
 
     fmt->channels = 2;
     fmt->channelmask = 3;
@@ -160,7 +182,7 @@ static DB_dsp_t plugin = {
     .close = m2s_close,
     .process = m2s_process,
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 1,
     .plugin.type = DB_PLUGIN_DSP,
     .plugin.id = "m2s",
     .plugin.name = "Mono to stereo",
@@ -38,7 +38,7 @@
 #include "mp3_mpg123.h"
 #endif
 
-#define trace(...) { deadbeef->log_detailed (&plugin.plugin, 0, __VA_ARGS__); }
+#define trace(...) { deadbeef->log_detailed (&plugin.decoder.plugin, 0, __VA_ARGS__); }
 
 //#define WRITE_DUMP 1
 
@@ -54,11 +54,14 @@ FILE *out;
 #define likely(x)       __builtin_expect((x),1)
 #define unlikely(x)     __builtin_expect((x),0)
 
-static DB_decoder_t plugin;
+static ddb_decoder2_t plugin;
 DB_functions_t *deadbeef;
 
-int
-cmp3_seek_stream (DB_fileinfo_t *_info, int sample) {
+static int
+cmp3_seek_sample64 (DB_fileinfo_t *_info, int64_t sample);
+
+static int
+cmp3_seek_stream (DB_fileinfo_t *_info, int64_t sample) {
     mp3_info_t *info = (mp3_info_t *)_info;
 
 #if WRITE_DUMP
@@ -69,7 +72,19 @@ cmp3_seek_stream (DB_fileinfo_t *_info, int sample) {
 #endif
 
     mp3info_t mp3info;
-    int res = mp3_parse_file(&mp3info, info->mp3flags, info->file, deadbeef->fgetlength(info->file), info->startoffs, info->endoffs, sample);
+    int64_t fsize = deadbeef->fgetlength(info->file);
+
+    // scan from the last known packet position if it's before the seek target
+    const mp3seekpoint_t *seekpoint = NULL;
+    if (info->have_seekpoint && info->seekpoint.seek_to_sample <= sample) {
+        seekpoint = &info->seekpoint;
+    }
+    int res = mp3_parse_file_from(&mp3info, info->mp3flags, info->file, fsize, info->startoffs, info->endoffs, sample, seekpoint);
+    if (res && seekpoint) {
+        trace ("mp3: seekpoint is not valid, scanning from the beginning\n");
+        info->have_seekpoint = 0;
+        res = mp3_parse_file(&mp3info, info->mp3flags, info->file, fsize, info->startoffs, info->endoffs, sample);
+    }
 
     if (!res) {
         deadbeef->fseek (info->file, mp3info.packet_offs, SEEK_SET);
@@ -80,6 +95,7 @@ cmp3_seek_stream (DB_fileinfo_t *_info, int sample) {
         else {
             info->skipsamples = 0;
         }
+        info->have_seekpoint = !mp3_get_seekpoint (&mp3info, info->startoffs, sample, &info->seekpoint);
     }
 
 
@@ -255,7 +271,7 @@ cmp3_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
 #endif
 #endif
 
-    _info->plugin = &plugin;
+    _info->plugin = &plugin.decoder;
     deadbeef->pl_lock ();
     const char *uri = strdupa (deadbeef->pl_find_meta (it, ":URI"));
     deadbeef->pl_unlock ();
@@ -347,7 +363,7 @@ cmp3_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     }
 
     info->dec->init (info);
-    plugin.seek_sample (_info, 0);
+    cmp3_seek_sample64 (_info, 0);
     return 0;
 }
 
@@ -512,7 +528,7 @@ cmp3_read (DB_fileinfo_t *_info, char *bytes, int size) {
 }
 
 static int
-cmp3_seek_sample (DB_fileinfo_t *_info, int sample) {
+cmp3_seek_sample64 (DB_fileinfo_t *_info, int64_t sample) {
     mp3_info_t *info = (mp3_info_t *)_info;
     if (!info->file) {
         return -1;
@@ -520,7 +536,7 @@ cmp3_seek_sample (DB_fileinfo_t *_info, int sample) {
 
     sample += info->startsample;
     if (sample > info->endsample) {
-        sample = (int)info->endsample;
+        sample = info->endsample;
     }
 
 
@@ -564,7 +580,7 @@ cmp3_seek_sample (DB_fileinfo_t *_info, int sample) {
 //    struct timeval tm1;
 //    gettimeofday (&tm1, NULL);
     if (cmp3_seek_stream (_info, sample) == -1) {
-        trace ("failed to seek to sample %d\n", sample);
+        trace ("failed to seek to sample %lld\n", sample);
         _info->readpos = 0;
         return -1;
     }
@@ -580,11 +596,68 @@ cmp3_seek_sample (DB_fileinfo_t *_info, int sample) {
     return 0;
 }
 
+static int
+cmp3_seek_sample (DB_fileinfo_t *_info, int sample) {
+    return cmp3_seek_sample64 (_info, sample);
+}
+
 static int
 cmp3_seek (DB_fileinfo_t *_info, float time) {
     mp3_info_t *info = (mp3_info_t *)_info;
-    int sample = time * info->mp3info.ref_packet.samplerate;
-    return cmp3_seek_sample (_info, sample);
+    int64_t sample = (int64_t)((double)time * info->mp3info.ref_packet.samplerate);
+    return cmp3_seek_sample64 (_info, sample);
+}
+
+// The checkpoints are packet positions, found by continuing the scan from the previous one,
+// so the headers are scanned only once during playback, and the seeks don't need to start from the beginning.
+static void *
+cmp3_checkpoint_save (DB_fileinfo_t *_info, int64_t *sample, size_t *size) {
+    mp3_info_t *info = (mp3_info_t *)_info;
+    if (!info->file || info->file->vfs->is_streaming () || (info->mp3flags & MP3_PARSE_ESTIMATE_DURATION)) {
+        return NULL;
+    }
+
+    const mp3seekpoint_t *seekpoint = NULL;
+    if (info->have_seekpoint && info->seekpoint.seek_to_sample <= info->currentsample) {
+        seekpoint = &info->seekpoint;
+    }
+
+    mp3info_t mp3info;
+    int64_t pos = deadbeef->ftell (info->file);
+    int res = mp3_parse_file_from (&mp3info, info->mp3flags, info->file, deadbeef->fgetlength (info->file), info->startoffs, info->endoffs, info->currentsample, seekpoint);
+    deadbeef->fseek (info->file, pos, SEEK_SET);
+    if (res) {
+        return NULL;
+    }
+
+    mp3seekpoint_t *checkpoint = malloc (sizeof (mp3seekpoint_t));
+    if (mp3_get_seekpoint (&mp3info, info->startoffs, info->currentsample, checkpoint)) {
+        free (checkpoint);
+        return NULL;
+    }
+    memcpy (&info->seekpoint, checkpoint, sizeof (mp3seekpoint_t));
+    info->have_seekpoint = 1;
+
+    *sample = info->currentsample - info->startsample;
+    *size = sizeof (mp3seekpoint_t);
+    return checkpoint;
+}
+
+static int
+cmp3_checkpoint_restore (DB_fileinfo_t *_info, const void *checkpoint) {
+    mp3_info_t *info = (mp3_info_t *)_info;
+    if (!info->file || info->file->vfs->is_streaming () || (info->mp3flags & MP3_PARSE_ESTIMATE_DURATION)) {
+        return -1;
+    }
+    // the following seek will scan from here
+    memcpy (&info->seekpoint, checkpoint, sizeof (mp3seekpoint_t));
+    info->have_seekpoint = 1;
+    return 0;
+}
+
+static void
+cmp3_checkpoint_free (void *checkpoint) {
+    free (checkpoint);
 }
 
 static DB_playItem_t *
@@ -596,7 +669,7 @@ cmp3_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         return NULL;
     }
     if (fp->vfs->is_streaming ()) {
-        DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.plugin.id);
+        DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
         deadbeef->fclose (fp);
         deadbeef->pl_add_meta (it, "title", NULL);
         deadbeef->plt_set_item_duration (plt, it, -1);
@@ -625,7 +698,7 @@ cmp3_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         return NULL;
     }
 
-    DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.plugin.id);
+    DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
 
     deadbeef->rewind (fp);
     // reset tags
@@ -726,15 +799,16 @@ static const char settings_dlg[] =
 ;
 
 // define plugin interface
-static DB_decoder_t plugin = {
-    DDB_PLUGIN_SET_API_VERSION
-    .plugin.version_major = 1,
-    .plugin.version_minor = 0,
-    .plugin.type = DB_PLUGIN_DECODER,
-    .plugin.flags = DDB_PLUGIN_FLAG_REPLAYGAIN,
-    .plugin.id = "stdmpg",
-    .plugin.name = "MP3 player",
-    .plugin.descr = "MPEG v1/2 layer1/2/3 decoder\n\n"
+static ddb_decoder2_t plugin = {
+    .decoder.plugin.api_vmajor = DB_API_VERSION_MAJOR,
+    .decoder.plugin.api_vminor = DB_API_VERSION_MINOR,
+    .decoder.plugin.version_major = 1,
+    .decoder.plugin.version_minor = 1,
+    .decoder.plugin.type = DB_PLUGIN_DECODER,
+    .decoder.plugin.flags = DDB_PLUGIN_FLAG_REPLAYGAIN | DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2 | DDB_PLUGIN_FLAG_CONCURRENT_INSERT,
+    .decoder.plugin.id = "stdmpg",
+    .decoder.plugin.name = "MP3 player",
+    .decoder.plugin.descr = "MPEG v1/2 layer1/2/3 decoder\n\n"
 #if defined(USE_LIBMPG123) && defined(USE_LIBMAD)
     "Can use libmad and libmpg123 backends.\n"
     "Changing the backend will take effect when the next track starts.\n"
@@ -744,7 +818,7 @@ static DB_decoder_t plugin = {
     "Using libmpg123 backend.\n"
 #endif
     ,
-    .plugin.copyright = 
+    .decoder.plugin.copyright = 
         "MPEG decoder plugin for DeaDBeeF Player\n"
         "Copyright (C) 2009-2014 Oleksiy Yakovenko\n"
         "\n"
@@ -766,18 +840,22 @@ static DB_decoder_t plugin = {
         "\n"
         "3. This notice may not be removed or altered from any source distribution.\n"
     ,
-    .plugin.website = "http://deadbeef.sf.net",
-    .plugin.configdialog = settings_dlg,
-    .open = cmp3_open,
-    .init = cmp3_init,
-    .free = cmp3_free,
-    .read = cmp3_read,
-    .seek = cmp3_seek,
-    .seek_sample = cmp3_seek_sample,
-    .insert = cmp3_insert,
-    .read_metadata = cmp3_read_metadata,
-    .write_metadata = cmp3_write_metadata,
-    .exts = exts,
+    .decoder.plugin.website = "http://deadbeef.sf.net",
+    .decoder.plugin.configdialog = settings_dlg,
+    .decoder.open = cmp3_open,
+    .decoder.init = cmp3_init,
+    .decoder.free = cmp3_free,
+    .decoder.read = cmp3_read,
+    .decoder.seek = cmp3_seek,
+    .decoder.seek_sample = cmp3_seek_sample,
+    .decoder.insert = cmp3_insert,
+    .decoder.read_metadata = cmp3_read_metadata,
+    .decoder.write_metadata = cmp3_write_metadata,
+    .decoder.exts = exts,
+    .seek_sample64 = cmp3_seek_sample64,
+    .checkpoint_save = cmp3_checkpoint_save,
+    .checkpoint_restore = cmp3_checkpoint_restore,
+    .checkpoint_free = cmp3_checkpoint_free,
 };
 
 DB_plugin_t *
@@ -55,6 +55,10 @@ typedef struct {
     int64_t currentsample;
     int64_t skipsamples; // how many samples to skip after seek, usually "seek_sample - mp3info.pcmsample"
 
+    // the last known packet position, from a seek or a checkpoint, where the following seeks can start scanning from
+    mp3seekpoint_t seekpoint;
+    int have_seekpoint;
+
     DB_FILE *file;
     DB_playItem_t *it;
 
@@ -402,6 +402,23 @@ _packet_same_fmt (mp3packet_t *ref_packet, mp3packet_t *packet) {
 
 int
 mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample) {
+    return mp3_parse_file_from (info, flags, fp, fsize, startoffs, endoffs, seek_to_sample, NULL);
+}
+
+int
+mp3_get_seekpoint (mp3info_t *info, int startoffs, int64_t seek_to_sample, mp3seekpoint_t *seekpoint) {
+    if (!info->seek_found) {
+        return -1;
+    }
+    seekpoint->packet_offs = info->packet_offs - startoffs;
+    seekpoint->pcmsample = info->pcmsample;
+    seekpoint->seek_to_sample = seek_to_sample;
+    memcpy (&seekpoint->ref_packet, &info->ref_packet, sizeof (mp3packet_t));
+    return 0;
+}
+
+int
+mp3_parse_file_from (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample, const mp3seekpoint_t *seekpoint) {
 #if PERFORMANCE_STATS
     struct timeval start_tv;
     struct timeval end_tv;
@@ -412,6 +429,10 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
     info->fsize = fsize;
     info->datasize = fsize-startoffs-endoffs;
 
+    if (seekpoint && (seek_to_sample < 0 || seek_to_sample < seekpoint->seek_to_sample)) {
+        seekpoint = NULL; // the seekpoint leaves no room for the bit-reservoir packets
+    }
+
     if (seek_to_sample > 0) {
         // add 9 extra packets to fill bit-reservoir
         seek_to_sample -= MAX_PACKET_SAMPLES*10;
@@ -422,7 +443,24 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
 
     int err = -1;
 
-    deadbeef->fseek (fp, startoffs, SEEK_SET);
+    int64_t offs = startoffs;
+    if (seekpoint) {
+        if (seekpoint->packet_offs < 0) {
+            return -1;
+        }
+        // continue from the seekpoint, as if all the packets before it were scanned
+        offs += seekpoint->packet_offs;
+        if (fsize > 0 && offs >= fsize - endoffs) {
+            return -1;
+        }
+        info->pcmsample = seekpoint->pcmsample;
+        memcpy (&info->ref_packet, &seekpoint->ref_packet, sizeof (mp3packet_t));
+        info->checked_xing_header = 1;
+        info->valid_packets = 1;
+        info->npackets = 1;
+    }
+
+    deadbeef->fseek (fp, offs, SEEK_SET);
     info->num_seeks++;
 
     int64_t datasize = fsize;
@@ -438,8 +476,7 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
 
     mp3packet_t packet;
 
-    int64_t offs = startoffs;
-    int64_t fileoffs = startoffs;
+    int64_t fileoffs = offs;
 
     int prev_br = -1;
     int prev_length = -1;
@@ -472,6 +509,10 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
 
         int res = _parse_packet (&packet, fhdr);
         if (res < 0 || (info->npackets && !_packet_same_fmt (&info->ref_packet, &packet))) {
+            if (seekpoint && offs == startoffs + seekpoint->packet_offs) {
+                goto error; // the seekpoint doesn't match the file
+            }
+
             if (res == -2 && info->valid_packets == 0) {
                 freeformat_packets++;
             }
@@ -562,10 +603,12 @@ mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int
             if (!got_xing) {
                 // interrupt if the current packet contains the sample being seeked to
                 if (seek_to_sample > 0 && info->pcmsample+packet.samples_per_frame >= seek_to_sample) {
+                    info->seek_found = 1;
                     goto end;
                 }
 
                 if (_process_packet (info, &packet, seek_to_sample) > 0) {
+                    info->seek_found = seek_to_sample == 0;
                     goto end;
                 }
                 memcpy (&info->prev_packet, &packet, sizeof (packet));
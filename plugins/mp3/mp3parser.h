@@ -58,6 +58,7 @@ typedef struct {
     // outputs
     int64_t packet_offs; // stream position of the packet corresponding to the requested seek position
     int64_t pcmsample; // sample position corresponding to packet_offs
+    int seek_found; // set to 1 if the seek stopped at the packet, rather than at the end of the stream
     int64_t npackets;
 
     int have_duration; // set to 1 if totalsamples has final value (e.g. from Xing packet)
@@ -99,6 +100,14 @@ typedef struct {
     uint64_t bytes_read;
 } mp3info_t;
 
+// A known packet position, which allows to seek without scanning the stream from the beginning
+typedef struct {
+    int64_t packet_offs; // relative to startoffs, so that it stays valid when the tags are rewritten
+    int64_t pcmsample; // sample position corresponding to packet_offs
+    int64_t seek_to_sample; // the seekpoint can be used for seeking to this sample or later, which leaves room for the bit reservoir
+    mp3packet_t ref_packet;
+} mp3seekpoint_t;
+
 // Params:
 // seek_to_sample: -1 means to the end (scan whole file), otherwise a sample to seek to
 // When seeking, the packet offset returned will be the one containing seek_to_sample, not accounting for delay.
@@ -114,4 +123,16 @@ typedef struct {
 int
 mp3_parse_file (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample);
 
+// Same as mp3_parse_file with seek_to_sample >= 0, but starts scanning from the seekpoint.
+// The whole stream is scanned if seek_to_sample is before seekpoint->seek_to_sample.
+// Returns -1 if there's no valid packet at the seekpoint, e.g. because the file has changed.
+// Passing NULL seekpoint is the same as calling mp3_parse_file.
+int
+mp3_parse_file_from (mp3info_t *info, uint32_t flags, DB_FILE *fp, int64_t fsize, int startoffs, int endoffs, int64_t seek_to_sample, const mp3seekpoint_t *seekpoint);
+
+// Gets the seekpoint of the packet found by a seek.
+// Returns -1 if the seek has reached the end of the stream, and the found position can't be used as a seekpoint.
+int
+mp3_get_seekpoint (mp3info_t *info, int startoffs, int64_t seek_to_sample, mp3seekpoint_t *seekpoint);
+
 #endif /* mp3parser_h */
@@ -537,5 +537,8 @@ static DB_decoder_t plugin = {
 DB_plugin_t *
 musepack_load (DB_functions_t *api) {
     deadbeef = api;
+    // SV8 and SV7 stream headers
+    deadbeef->plug_register_decoder_signature (&plugin, 0, "MPCK", 4);
+    deadbeef->plug_register_decoder_signature (&plugin, 0, "MP+", 3);
     return DB_PLUGIN (&plugin);
 }
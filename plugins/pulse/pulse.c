@@ -22,18 +22,14 @@
 #  include "../../config.h"
 #endif
 
-#include <pulse/simple.h>
-#include <pulse/error.h>
+#include <pulse/pulseaudio.h>
 
+#include <pthread.h>
 #include <stdint.h>
-#include <unistd.h>
-
-#ifdef __linux__
-    #include <sys/prctl.h>
-#endif
-
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/prctl.h>
 #include "../../deadbeef.h"
 
 #define trace(...) { deadbeef->log_detailed (&plugin.plugin, 0, __VA_ARGS__); }
@@ -44,26 +40,110 @@ DB_functions_t * deadbeef;
 // serveraddr2 is a version bump, since the handling has changed, and "default"
 // value has different meaning.
 #define CONFSTR_PULSE_SERVERADDR "pulse.serveraddr2"
-#define CONFSTR_PULSE_BUFFERSIZE "pulse.buffersize"
-#define PULSE_DEFAULT_BUFFERSIZE 4096
-
-static intptr_t pulse_tid;
-static int pulse_terminate;
+#define CONFSTR_PULSE_DEVICE "pulse.device"
+#define CONFSTR_PULSE_TLENGTH "pulse.tlength_ms"
+#define CONFSTR_PULSE_MINREQ "pulse.minreq_ms"
+#define PULSE_DEFAULT_TLENGTH 150
+#define PULSE_DEFAULT_MINREQ 20
+#define BUFFERING_RECHECK_MS 10
+
+// The stream runs on the pa_threaded_mainloop thread.
+// The server requests the data via the write callback, which wakes up the writer thread,
+// so the amount of buffered audio is controlled by tlength/minreq.
+// Pause and unpause are done by corking the stream.
+// All the pulseaudio objects are accessed with the mainloop lock held,
+// which is implicitly held in the callbacks.
+// The writer thread reads from the streamer without holding the mainloop lock,
+// because the streamer calls the output plugin with the streamer lock held,
+// and the mainloop callbacks never wait for the streamer.
+static pa_threaded_mainloop *mainloop;
+static pa_context *context;
+static pa_stream *stream;
+static unsigned stream_generation; // incremented when the stream is re-created
 
-static pa_simple *s;
 static pa_sample_spec ss;
-static int _setformat_requested;
-static ddb_waveformat_t requested_fmt;
+static pa_channel_map channel_map;
 static ddb_playback_state_t state = DDB_PLAYBACK_STATE_STOPPED;
+
+static intptr_t writer_tid;
+static int writer_terminate;
+
+// wakes up the writer while the streamer is buffering
+static pa_time_event *buffering_recheck_event;
+
+// serializes pulse_init and pulse_free, never taken by the mainloop callbacks or the writer
+static uintptr_t init_mutex;
+
+// protects requested_fmt, which can be set from any thread.
+// Only held to copy the format, no other lock may be taken while holding it.
 static uintptr_t mutex;
-static int in_callback;
+static int _setformat_requested; // atomic
+static ddb_waveformat_t requested_fmt;
+static int _setformat_scheduled; // with the mainloop lock held
+static int _waiting_ready; // pulse_init is waiting for the stream to connect
+
+static int conf_tlength_ms;
+static int conf_minreq_ms;
+static char conf_server[1000];
+static char conf_device[1000];
+
+static void
+_read_config (void) {
+    conf_tlength_ms = deadbeef->conf_get_int (CONFSTR_PULSE_TLENGTH, PULSE_DEFAULT_TLENGTH);
+    conf_minreq_ms = deadbeef->conf_get_int (CONFSTR_PULSE_MINREQ, PULSE_DEFAULT_MINREQ);
+    if (conf_tlength_ms < 10) {
+        conf_tlength_ms = 10;
+    }
+    if (conf_minreq_ms <= 0 || conf_minreq_ms > conf_tlength_ms / 2) {
+        conf_minreq_ms = conf_tlength_ms / 2;
+    }
 
-static int buffer_size;
+    // migrate from 0.7.x
+    deadbeef->conf_lock ();
+    int has_server2 = deadbeef->conf_get_str_fast (CONFSTR_PULSE_SERVERADDR, NULL) != NULL;
+    deadbeef->conf_unlock ();
+
+    if (!has_server2) {
+        deadbeef->conf_get_str ("pulse.serveraddr", "", conf_server, sizeof (conf_server));
+        // convert default
+        if (!strcasecmp (conf_server, "default")) {
+            *conf_server = 0;
+        }
+    }
+    else {
+        deadbeef->conf_get_str (CONFSTR_PULSE_SERVERADDR, "", conf_server, sizeof (conf_server));
+    }
 
-static void pulse_thread(void *context);
+    deadbeef->conf_get_str (CONFSTR_PULSE_DEVICE, "", conf_device, sizeof (conf_device));
+}
 
-static int pulse_set_spec(ddb_waveformat_t *fmt)
-{
+static int
+_in_mainloop_thread (void) {
+    return mainloop && pa_threaded_mainloop_in_thread (mainloop);
+}
+
+static int
+_in_writer_thread (void) {
+    return writer_tid && pthread_equal ((pthread_t)writer_tid, pthread_self ());
+}
+
+// the mainloop lock must not be taken in the mainloop thread, where it's already held
+static void
+_lock (void) {
+    if (!_in_mainloop_thread ()) {
+        pa_threaded_mainloop_lock (mainloop);
+    }
+}
+
+static void
+_unlock (void) {
+    if (!_in_mainloop_thread ()) {
+        pa_threaded_mainloop_unlock (mainloop);
+    }
+}
+
+static int
+pulse_set_spec (ddb_waveformat_t *fmt) {
     memcpy (&plugin.fmt, fmt, sizeof (ddb_waveformat_t));
     if (!plugin.fmt.channels) {
         // generic format
@@ -78,13 +158,8 @@ static int pulse_set_spec(ddb_waveformat_t *fmt)
 
     ss.channels = plugin.fmt.channels;
     // Try to auto-configure the channel map, see <pulse/channelmap.h> for details
-    pa_channel_map channel_map;
     pa_channel_map_init_extend(&channel_map, ss.channels, PA_CHANNEL_MAP_WAVEEX);
-    trace ("pulse: channels: %d\n", ss.channels);
-
-    // Read samplerate from config
     ss.rate = plugin.fmt.samplerate;
-    trace ("pulse: samplerate: %d\n", ss.rate);
 
     switch (plugin.fmt.bps) {
     case 8:
@@ -108,287 +183,522 @@ static int pulse_set_spec(ddb_waveformat_t *fmt)
         return -1;
     };
 
-    if (s) {
-        pa_simple_free(s);
-    }
+    return 0;
+}
 
-    pa_buffer_attr * attr = NULL;
-    //attr->maxlength = Maximum length of the buffer.
-    //attr->tlength = Playback only: target length of the buffer.
-    //attr->prebuf = Playback only: pre-buffering.
-    //attr->minreq = Playback only: minimum request.
-    //attr->fragsize = Recording only: fragment size.
+// Returns -1 if the latency is not known yet, the mainloop lock must be held.
+// The result is passed to the streamer after releasing the lock,
+// since the streamer calls into the plugin with the streamer lock held.
+static int
+_get_latency (float *latency) {
+    pa_usec_t usec;
+    int negative;
+    if (pa_stream_get_latency (stream, &usec, &negative) != 0) {
+        return -1;
+    }
+    *latency = negative ? 0 : usec / 1000000.f;
+    return 0;
+}
 
-    buffer_size = deadbeef->conf_get_int(CONFSTR_PULSE_BUFFERSIZE, PULSE_DEFAULT_BUFFERSIZE);
+static void
+_context_state_cb (pa_context *c, void *userdata) {
+    pa_threaded_mainloop_signal (mainloop, 0);
+}
 
-    // TODO: where list of all available devices? add this option to config too..
-    char * dev = NULL;
+static void _stream_create (void);
+
+static void
+_stream_destroy (void) {
+    if (stream) {
+        pa_stream_set_state_callback (stream, NULL, NULL);
+        pa_stream_set_write_callback (stream, NULL, NULL);
+        pa_stream_disconnect (stream);
+        pa_stream_unref (stream);
+        stream = NULL;
+        stream_generation++;
+    }
+}
 
-    int error;
+// Copies the requested format, returns 0 if there was no request
+static int
+_take_requested_format (ddb_waveformat_t *fmt) {
+    if (!__atomic_exchange_n (&_setformat_requested, 0, __ATOMIC_ACQ_REL)) {
+        return 0;
+    }
+    deadbeef->mutex_lock (mutex);
+    memcpy (fmt, &requested_fmt, sizeof (ddb_waveformat_t));
+    deadbeef->mutex_unlock (mutex);
+    return 1;
+}
 
-    // Read serveraddr from config
-    char server[1000];
+// Re-creates the stream from the mainloop thread, after the format has changed
+static void
+_stream_restart_cb (pa_mainloop_api *api, void *userdata) {
+    _setformat_scheduled = 0;
+    // wake up the writer, which waits for the format change to be applied
+    pa_threaded_mainloop_signal (mainloop, 0);
 
-    // migrate from 0.7.x
-    deadbeef->conf_lock ();
-    int has_server2 = deadbeef->conf_get_str_fast (CONFSTR_PULSE_SERVERADDR, NULL) != NULL;
-    deadbeef->conf_unlock ();
+    ddb_waveformat_t fmt;
+    int setformat = _take_requested_format (&fmt);
 
-    if (!has_server2) {
-        deadbeef->conf_get_str ("pulse.serveraddr", "", server, sizeof (server));
-        // convert default
-        if (!strcasecmp (server, "default")) {
-            *server = 0;
-        }
+    if (setformat && !memcmp (&fmt, &plugin.fmt, sizeof (ddb_waveformat_t)) && stream) {
+        return;
     }
-    else {
-        deadbeef->conf_get_str (CONFSTR_PULSE_SERVERADDR, "", server, sizeof (server));
+    if (setformat && pulse_set_spec (&fmt) < 0) {
+        _stream_destroy ();
+        state = DDB_PLAYBACK_STATE_STOPPED;
+        return;
     }
+    _stream_destroy ();
+    _stream_create ();
+}
 
-    for (;;) {
-        s = pa_simple_new(*server ? server : NULL, "Deadbeef", PA_STREAM_PLAYBACK, dev, "Music", &ss, &channel_map, attr, &error);
-
-        if (s != NULL || ss.rate <= 192000) {
-            break;
-        }
-
+static void
+_stream_state_cb (pa_stream *s, void *userdata) {
+    if (pa_stream_get_state (s) == PA_STREAM_FAILED && s == stream && ss.rate > 192000 && !_waiting_ready) {
         // Older pulseaudio versions couldn't handle more than 192KHz,
         // so try to lower it down
+        trace ("pulse: %dHz is not supported, trying 192000Hz\n", ss.rate);
         ss.rate = plugin.fmt.samplerate = 192000;
+        pa_mainloop_api_once (pa_threaded_mainloop_get_api (mainloop), _stream_restart_cb, NULL);
+        return;
     }
+    pa_threaded_mainloop_signal (mainloop, 0);
+}
 
-    if (s == NULL)
-    {
-        const char *strerr = pa_strerror (error);
-        fprintf (stderr, "pa_simple_new failed: %s\n", strerr);
-        return -1;
+static void
+_stream_write_cb (pa_stream *s, size_t nbytes, void *userdata) {
+    // the data is written by the writer thread
+    pa_threaded_mainloop_signal (mainloop, 0);
+}
+
+// Schedules re-creating the stream after a format change, the mainloop lock must be held
+static void
+_schedule_restart (void) {
+    if (!_setformat_scheduled) {
+        _setformat_scheduled = 1;
+        pa_mainloop_api_once (pa_threaded_mainloop_get_api (mainloop), _stream_restart_cb, NULL);
     }
+}
 
-    return 0;
+static void
+_buffering_recheck_cb (pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    pa_threaded_mainloop_signal (mainloop, 0);
 }
 
-static int
-pulse_init(void) {
-    trace ("pulse_init\n");
-    deadbeef->mutex_lock (mutex);
-    state = DDB_PLAYBACK_STATE_STOPPED;
-    trace ("pulse_terminate=%d\n", pulse_terminate);
-    if (pulse_terminate) {
-        deadbeef->mutex_unlock (mutex);
-        return -1;
+// Wakes up the writer after a while, to check whether the streamer has finished buffering.
+// The mainloop lock must be held.
+static void
+_schedule_buffering_recheck (void) {
+    pa_usec_t usec = pa_rtclock_now () + BUFFERING_RECHECK_MS * PA_USEC_PER_MSEC;
+    if (buffering_recheck_event) {
+        pa_context_rttime_restart (context, buffering_recheck_event, usec);
+    }
+    else {
+        buffering_recheck_event = pa_context_rttime_new (context, usec, _buffering_recheck_cb, NULL);
     }
+}
+
+static void
+_writer_thread (void *ctx) {
+    prctl (PR_SET_NAME, "deadbeef-pulse-writer", 0, 0, 0, 0);
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+
+    pa_threaded_mainloop_lock (mainloop);
+    while (!writer_terminate) {
+        if (__atomic_load_n (&_setformat_requested, __ATOMIC_ACQUIRE)) {
+            _schedule_restart ();
+            pa_threaded_mainloop_wait (mainloop);
+            continue;
+        }
 
-    if (requested_fmt.samplerate != 0) {
-        memcpy (&plugin.fmt, &requested_fmt, sizeof (ddb_waveformat_t));
+        size_t size = 0;
+        if (stream && pa_stream_get_state (stream) == PA_STREAM_READY) {
+            size = pa_stream_writable_size (stream);
+            if (size == (size_t)-1) {
+                size = 0;
+            }
+        }
+        int sample_size = plugin.fmt.channels * (plugin.fmt.bps / 8);
+        if (sample_size <= 0 || size < (size_t)sample_size) {
+            pa_threaded_mainloop_wait (mainloop);
+            continue;
+        }
+        size -= size % sample_size;
+
+        // nothing is written while paused or stopped, pulse_play and pulse_unpause wake the writer up
+        if (state != DDB_PLAYBACK_STATE_PLAYING) {
+            pa_threaded_mainloop_wait (mainloop);
+            continue;
+        }
+
+        unsigned generation = stream_generation;
+        pa_threaded_mainloop_unlock (mainloop);
+
+        // takes the streamer lock, so it must be called without the mainloop lock
+        if (!deadbeef->streamer_ok_to_read (-1)) {
+            pa_threaded_mainloop_lock (mainloop);
+            _schedule_buffering_recheck ();
+            pa_threaded_mainloop_wait (mainloop);
+            continue;
+        }
+
+        if (size > buffer_size) {
+            free (buffer);
+            buffer = malloc (size);
+            buffer_size = size;
+        }
+
+        // streamer_read returns less than requested only at the end of the decoded data, read until filled
+        size_t written = 0;
+        while (written < size) {
+            int rb = deadbeef->streamer_read (buffer + written, (int)(size - written));
+            if (rb <= 0) {
+                break;
+            }
+            written += rb;
+        }
+        if (written < size) {
+            memset (buffer + written, 0, size - written);
+        }
+
+        pa_threaded_mainloop_lock (mainloop);
+        // drop the data if the stream was re-created for another format in the meantime
+        float latency;
+        int have_latency = 0;
+        if (stream && generation == stream_generation) {
+            if (pa_stream_write (stream, buffer, size, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+                trace ("pulse: pa_stream_write failed: %s\n", pa_strerror (pa_context_errno (context)));
+            }
+            else {
+                have_latency = _get_latency (&latency) == 0;
+            }
+        }
+        if (have_latency) {
+            pa_threaded_mainloop_unlock (mainloop);
+            deadbeef->streamer_set_output_latency (latency);
+            pa_threaded_mainloop_lock (mainloop);
+        }
     }
+    pa_threaded_mainloop_unlock (mainloop);
+    free (buffer);
+}
 
-    if (0 != pulse_set_spec(&plugin.fmt)) {
-        deadbeef->mutex_unlock (mutex);
-        return -1;
+// Creates the stream with the current spec, the mainloop lock must be held.
+// Connecting is asynchronous, wait for the stream state to get the result.
+static void
+_stream_create (void) {
+    stream = pa_stream_new (context, "Music", &ss, &channel_map);
+    if (!stream) {
+        trace ("pulse: pa_stream_new failed: %s\n", pa_strerror (pa_context_errno (context)));
+        return;
+    }
+    pa_stream_set_state_callback (stream, _stream_state_cb, NULL);
+    pa_stream_set_write_callback (stream, _stream_write_cb, NULL);
+
+    pa_buffer_attr attr;
+    attr.maxlength = (uint32_t)-1;
+    attr.tlength = (uint32_t)pa_usec_to_bytes (conf_tlength_ms * PA_USEC_PER_MSEC, &ss);
+    attr.prebuf = (uint32_t)-1;
+    attr.minreq = (uint32_t)pa_usec_to_bytes (conf_minreq_ms * PA_USEC_PER_MSEC, &ss);
+    attr.fragsize = (uint32_t)-1;
+
+    pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE | PA_STREAM_ADJUST_LATENCY;
+    if (state != DDB_PLAYBACK_STATE_PLAYING) {
+        flags |= PA_STREAM_START_CORKED;
     }
 
-    pulse_tid = deadbeef->thread_start(pulse_thread, NULL);
-    deadbeef->mutex_unlock (mutex);
+    if (pa_stream_connect_playback (stream, *conf_device ? conf_device : NULL, &attr, flags, NULL, NULL) < 0) {
+        trace ("pulse: pa_stream_connect_playback failed: %s\n", pa_strerror (pa_context_errno (context)));
+        _stream_destroy ();
+    }
+}
 
-    return 0;
+// Waits until the stream is connected, must be called with the mainloop lock held, outside of the mainloop thread
+static int
+_stream_wait_ready (void) {
+    _waiting_ready = 1;
+    for (;;) {
+        if (!stream) {
+            _waiting_ready = 0;
+            return -1;
+        }
+        pa_stream_state_t st = pa_stream_get_state (stream);
+        if (st == PA_STREAM_READY) {
+            _waiting_ready = 0;
+            return 0;
+        }
+        if (!PA_STREAM_IS_GOOD (st)) {
+            if (ss.rate > 192000) {
+                // Older pulseaudio versions couldn't handle more than 192KHz,
+                // so try to lower it down
+                ss.rate = plugin.fmt.samplerate = 192000;
+                _stream_destroy ();
+                _stream_create ();
+                continue;
+            }
+            fprintf (stderr, "pulse: failed to connect the stream: %s\n", pa_strerror (pa_context_errno (context)));
+            _waiting_ready = 0;
+            return -1;
+        }
+        pa_threaded_mainloop_wait (mainloop);
+    }
 }
 
-static int pulse_free(void);
-static int pulse_play(void);
-static int pulse_pause(void);
+static void
+_pulse_teardown (void) {
+    if (!mainloop) {
+        return;
+    }
+    if (writer_tid) {
+        pa_threaded_mainloop_lock (mainloop);
+        writer_terminate = 1;
+        pa_threaded_mainloop_signal (mainloop, 0);
+        pa_threaded_mainloop_unlock (mainloop);
+        deadbeef->thread_join (writer_tid);
+        writer_tid = 0;
+        writer_terminate = 0;
+    }
+    pa_threaded_mainloop_lock (mainloop);
+    _stream_destroy ();
+    if (buffering_recheck_event) {
+        pa_threaded_mainloop_get_api (mainloop)->time_free (buffering_recheck_event);
+        buffering_recheck_event = NULL;
+    }
+    if (context) {
+        pa_context_set_state_callback (context, NULL, NULL);
+        pa_context_disconnect (context);
+        pa_context_unref (context);
+        context = NULL;
+    }
+    _setformat_scheduled = 0;
+    pa_threaded_mainloop_unlock (mainloop);
+    pa_threaded_mainloop_stop (mainloop);
+    pa_threaded_mainloop_free (mainloop);
+    mainloop = NULL;
+    deadbeef->streamer_set_output_latency (0);
+}
 
 static int
-_setformat_apply (void) {
-    _setformat_requested = 0;
-    if (!memcmp (&requested_fmt, &plugin.fmt, sizeof (ddb_waveformat_t))) {
+pulse_init (void) {
+    trace ("pulse_init\n");
+    if (_in_writer_thread ()) {
         return 0;
     }
+    deadbeef->mutex_lock (init_mutex);
+    if (mainloop) {
+        deadbeef->mutex_unlock (init_mutex);
+        return 0;
+    }
+    state = DDB_PLAYBACK_STATE_STOPPED;
 
-    return pulse_set_spec(&requested_fmt);
+    _read_config ();
+
+    _take_requested_format (&plugin.fmt);
+    if (0 != pulse_set_spec (&plugin.fmt)) {
+        deadbeef->mutex_unlock (init_mutex);
+        return -1;
+    }
+
+    mainloop = pa_threaded_mainloop_new ();
+    if (!mainloop || pa_threaded_mainloop_start (mainloop) < 0) {
+        fprintf (stderr, "pulse: failed to start the mainloop\n");
+        if (mainloop) {
+            pa_threaded_mainloop_free (mainloop);
+            mainloop = NULL;
+        }
+        deadbeef->mutex_unlock (init_mutex);
+        return -1;
+    }
+    pa_threaded_mainloop_set_name (mainloop, "deadbeef-pulse");
+
+    pa_threaded_mainloop_lock (mainloop);
+    int res = -1;
+    context = pa_context_new (pa_threaded_mainloop_get_api (mainloop), "Deadbeef");
+    if (context) {
+        pa_context_set_state_callback (context, _context_state_cb, NULL);
+        if (pa_context_connect (context, *conf_server ? conf_server : NULL, PA_CONTEXT_NOFLAGS, NULL) >= 0) {
+            for (;;) {
+                pa_context_state_t st = pa_context_get_state (context);
+                if (st == PA_CONTEXT_READY) {
+                    res = 0;
+                    break;
+                }
+                if (!PA_CONTEXT_IS_GOOD (st)) {
+                    break;
+                }
+                pa_threaded_mainloop_wait (mainloop);
+            }
+        }
+        if (res < 0) {
+            fprintf (stderr, "pulse: failed to connect to the server: %s\n", pa_strerror (pa_context_errno (context)));
+        }
+    }
+    if (res == 0) {
+        _stream_create ();
+        res = _stream_wait_ready ();
+    }
+    pa_threaded_mainloop_unlock (mainloop);
+
+    if (res == 0) {
+        writer_tid = deadbeef->thread_start (_writer_thread, NULL);
+        if (!writer_tid) {
+            res = -1;
+        }
+    }
+    if (res < 0) {
+        _pulse_teardown ();
+    }
+    deadbeef->mutex_unlock (init_mutex);
+    return res;
 }
 
 static int
-pulse_setformat (ddb_waveformat_t *fmt)
-{
-    deadbeef->mutex_lock(mutex);
-    _setformat_requested = 1;
+pulse_setformat (ddb_waveformat_t *fmt) {
+    // applied by the mainloop thread on the next write request, or when the playback starts
+    deadbeef->mutex_lock (mutex);
     memcpy (&requested_fmt, fmt, sizeof (ddb_waveformat_t));
-    deadbeef->mutex_unlock(mutex);
+    deadbeef->mutex_unlock (mutex);
+    __atomic_store_n (&_setformat_requested, 1, __ATOMIC_RELEASE);
+    if (mainloop && !_in_mainloop_thread ()) {
+        // wake up the writer
+        pa_threaded_mainloop_lock (mainloop);
+        pa_threaded_mainloop_signal (mainloop, 0);
+        pa_threaded_mainloop_unlock (mainloop);
+    }
     return 0;
 }
 
-static int pulse_free(void)
-{
-    trace("pulse_free\n");
+static int
+pulse_free (void) {
+    trace ("pulse_free\n");
+    if (_in_writer_thread ()) {
+        // called from within streamer_read, the writer can't join itself, so just silence the stream
+        state = DDB_PLAYBACK_STATE_STOPPED;
+        _lock ();
+        if (stream) {
+            pa_operation *o = pa_stream_cork (stream, 1, NULL, NULL);
+            if (o) {
+                pa_operation_unref (o);
+            }
+        }
+        _unlock ();
+        return 0;
+    }
 
+    deadbeef->mutex_lock (init_mutex);
     state = DDB_PLAYBACK_STATE_STOPPED;
-    deadbeef->mutex_lock(mutex);
+    _pulse_teardown ();
+    deadbeef->mutex_unlock (init_mutex);
+    return 0;
+}
 
-    if (!pulse_tid || pulse_terminate == 1) {
-        deadbeef->mutex_unlock(mutex);
-        return 0;
+static void
+_cork (int cork, int flush) {
+    _lock ();
+    if (!stream && !cork) {
+        // the previous stream failed to connect, e.g. after a format change
+        _stream_create ();
     }
-
-    if (in_callback) {
-        pulse_terminate = 1;
-        deadbeef->mutex_unlock(mutex);
-        return 0;
+    if (stream) {
+        pa_operation *o;
+        if (flush) {
+            o = pa_stream_flush (stream, NULL, NULL);
+            if (o) {
+                pa_operation_unref (o);
+            }
+        }
+        o = pa_stream_cork (stream, cork, NULL, NULL);
+        if (o) {
+            pa_operation_unref (o);
+        }
     }
-
-    pulse_terminate = 1;
-    deadbeef->mutex_unlock(mutex);
-
-    deadbeef->thread_join(pulse_tid);
-    pulse_terminate = 0;
-
-    return 0;
+    // wake up the writer, which doesn't write while paused
+    pa_threaded_mainloop_signal (mainloop, 0);
+    _unlock ();
 }
 
-static int pulse_play(void)
-{
+static int
+pulse_play (void) {
     trace ("pulse_play\n");
-    deadbeef->mutex_lock (mutex);
-    if (!pulse_tid)
-    {
-        if (pulse_init () < 0)
-        {
-            deadbeef->mutex_unlock (mutex);
-            return -1;
-        }
+    if (!mainloop && pulse_init () < 0) {
+        return -1;
     }
 
-    pa_simple_flush (s, NULL);
     state = DDB_PLAYBACK_STATE_PLAYING;
-    deadbeef->mutex_unlock (mutex);
-
+    // drop the data buffered before seeking or switching tracks
+    _cork (0, 1);
     return 0;
 }
 
-static int pulse_stop(void)
-{
+static int
+pulse_stop (void) {
     trace ("pulse_stop\n");
-    pulse_free();
+    pulse_free ();
     return 0;
 }
 
-static int pulse_pause(void)
-{
+static int
+pulse_pause (void) {
     trace ("pulse_pause\n");
-    pulse_free();
+    if (!mainloop && pulse_init () < 0) {
+        return -1;
+    }
     state = DDB_PLAYBACK_STATE_PAUSED;
+    _cork (1, 0);
     return 0;
 }
 
-static int pulse_unpause(void)
-{
+static int
+pulse_unpause (void) {
     trace ("pulse_unpause\n");
-    deadbeef->mutex_lock (mutex);
-    if (state == DDB_PLAYBACK_STATE_PAUSED)
-    {
-        if (pulse_init () < 0)
-        {
-            deadbeef->mutex_unlock (mutex);
-            return -1;
-        }
-        state = DDB_PLAYBACK_STATE_PLAYING;
+    if (state != DDB_PLAYBACK_STATE_PAUSED) {
+        return 0;
     }
-
-    deadbeef->mutex_unlock (mutex);
-
+    if (!mainloop && pulse_init () < 0) {
+        return -1;
+    }
+    state = DDB_PLAYBACK_STATE_PLAYING;
+    _cork (0, 0);
     return 0;
 }
 
-static void pulse_thread(void *context)
-{
-#ifdef __linux__
-    prctl(PR_SET_NAME, "deadbeef-pulse", 0, 0, 0, 0);
-#endif
-
-    trace ("pulse thread started \n");
-    while (!pulse_terminate)
-    {
-        if (state != DDB_PLAYBACK_STATE_PLAYING || !deadbeef->streamer_ok_to_read (-1))
-        {
-            usleep(10000);
-            continue;
-        }
-
-        // setformat
-        deadbeef->mutex_lock (mutex);
-        int res = 0;
-        if (_setformat_requested) {
-            res = _setformat_apply ();
-        }
-        if (res != 0) {
-            deadbeef->thread_detach (pulse_tid);
-            pulse_terminate = 1;
-            deadbeef->mutex_unlock(mutex);
-            break;
-        }
-        deadbeef->mutex_unlock(mutex);
-
-        int sample_size = plugin.fmt.channels * (plugin.fmt.bps / 8);
-        char buf[buffer_size];
-
-        in_callback = 1;
-        int bytesread = deadbeef->streamer_read(buf, buffer_size);
-        in_callback = 0;
-        if (pulse_terminate) {
-            break;
-        }
-        if (bytesread < 0) {
-            bytesread = 0;
-        }
-
-        int error;
-
-        res = 0;
-        if (bytesread > 0) {
-            deadbeef->mutex_lock (mutex);
-            res = pa_simple_write(s, buf, bytesread, &error);
-            deadbeef->mutex_unlock(mutex);
-        }
-
-        if (pulse_terminate) {
-            break;
-        }
+static ddb_playback_state_t
+pulse_get_state (void) {
+    return state;
+}
 
-        if (res < 0)
-        {
-            usleep(10000);
+static int
+pulse_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    switch (id) {
+    case DB_EV_CONFIGCHANGED:
+        if (mainloop) {
+            int tlength = deadbeef->conf_get_int (CONFSTR_PULSE_TLENGTH, PULSE_DEFAULT_TLENGTH);
+            int minreq = deadbeef->conf_get_int (CONFSTR_PULSE_MINREQ, PULSE_DEFAULT_MINREQ);
+            char device[1000];
+            deadbeef->conf_get_str (CONFSTR_PULSE_DEVICE, "", device, sizeof (device));
+            if (tlength != conf_tlength_ms || minreq != conf_minreq_ms || strcmp (device, conf_device)) {
+                trace ("pulse: config option changed, restarting\n");
+                deadbeef->sendmessage (DB_EV_REINIT_SOUND, 0, 0, 0);
+            }
         }
+        break;
     }
-
-    deadbeef->mutex_lock (mutex);
-    state = DDB_PLAYBACK_STATE_STOPPED;
-    if (s)
-    {
-        pa_simple_drain (s, NULL);
-        pa_simple_free(s);
-        s = NULL;
-    }
-    pulse_terminate = 0;
-    pulse_tid = 0;
-    deadbeef->mutex_unlock (mutex);
-    trace ("pulse_thread finished\n");
-}
-
-static ddb_playback_state_t pulse_get_state(void)
-{
-    return state;
+    return 0;
 }
 
-static int pulse_plugin_start(void)
-{
+static int
+pulse_plugin_start (void) {
     mutex = deadbeef->mutex_create();
-
+    init_mutex = deadbeef->mutex_create();
     return 0;
 }
 
-static int pulse_plugin_stop(void)
-{
+static int
+pulse_plugin_stop (void) {
     deadbeef->mutex_free(mutex);
-
+    deadbeef->mutex_free(init_mutex);
     return 0;
 }
 
@@ -403,13 +713,15 @@ DB_plugin_t * pulse_load(DB_functions_t *api)
 
 static const char settings_dlg[] =
     "property \"PulseAudio server (leave empty for default)\" entry " CONFSTR_PULSE_SERVERADDR " \"\";\n"
-    "property \"Preferred buffer size\" entry " CONFSTR_PULSE_BUFFERSIZE " " STR(PULSE_DEFAULT_BUFFERSIZE) ";\n";
+    "property \"Sink name (leave empty for default)\" entry " CONFSTR_PULSE_DEVICE " \"\";\n"
+    "property \"Target latency (ms)\" entry " CONFSTR_PULSE_TLENGTH " " STR(PULSE_DEFAULT_TLENGTH) ";\n"
+    "property \"Minimum request (ms)\" entry " CONFSTR_PULSE_MINREQ " " STR(PULSE_DEFAULT_MINREQ) ";\n";
 
 static DB_output_t plugin =
 {
     DDB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 0,
-    .plugin.version_minor = 1,
+    .plugin.version_minor = 2,
     .plugin.type = DB_PLUGIN_OUTPUT,
 //    .plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .plugin.id = "pulseaudio",
@@ -438,6 +750,7 @@ static DB_output_t plugin =
     .plugin.start = pulse_plugin_start,
     .plugin.stop = pulse_plugin_stop,
     .plugin.configdialog = settings_dlg,
+    .plugin.message = pulse_message,
     .init = pulse_init,
     .free = pulse_free,
     .setformat = pulse_setformat,
@@ -0,0 +1,630 @@
+/*
+ * ReplayGain Scanner plugin for DeaDBeeF Player
+ *
+ * Copyright (c) 2026 Oleksiy Yakovenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "rg_cache.h"
+
+#define RG_CACHE_MAGIC "DDB_RGC"
+#define RG_CACHE_VERSION 1
+
+// the entries which were not used for this long are dropped when saving
+#define RG_CACHE_EXPIRE_DAYS 365
+
+#define RG_CACHE_FLAG_AUDIO_MD5 1
+
+// File layout: header, rg_cache_track_t[track_count], rg_cache_album_t[album_count], paths (strings_size bytes)
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t track_count;
+    uint32_t album_count;
+    uint32_t strings_size;
+} rg_cache_header_t;
+
+typedef struct {
+    uint32_t path_offset;
+    uint32_t path_len;
+    uint64_t size;
+    int64_t mtime;
+    int64_t startsample;
+    int64_t endsample;
+    int32_t tracknum;
+    uint16_t flags;
+    uint16_t last_used; // days since epoch
+    uint8_t audio_md5[16];
+    float loudness;
+    float peak;
+} rg_cache_track_t;
+
+typedef struct {
+    uint8_t digest[16];
+    float loudness;
+    float peak;
+    uint16_t last_used; // days since epoch
+    uint16_t reserved;
+} rg_cache_album_t;
+
+// Open addressing hash table of record indexes + 1, 0 is an empty slot.
+// Records are never removed, so there are no tombstones.
+typedef struct {
+    uint32_t *slots;
+    uint32_t size;
+    uint32_t count;
+} rg_cache_index_t;
+
+static DB_functions_t *deadbeef;
+static uintptr_t mutex;
+static int loaded;
+static int dirty;
+
+static rg_cache_track_t *tracks;
+static uint32_t track_count;
+static uint32_t tracks_allocated;
+
+static rg_cache_album_t *albums;
+static uint32_t album_count;
+static uint32_t albums_allocated;
+
+static char *strings;
+static uint32_t strings_size;
+static uint32_t strings_allocated;
+
+static rg_cache_index_t path_index;
+static rg_cache_index_t md5_index;
+static rg_cache_index_t album_index;
+
+static uint16_t
+_today (void) {
+    return (uint16_t)(time (NULL) / 86400);
+}
+
+static uint64_t
+_hash_bytes (const void *data, size_t len) {
+    // FNV-1a
+    const uint8_t *p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t
+_hash_digest (const uint8_t digest[16]) {
+    uint64_t h;
+    memcpy (&h, digest, sizeof (h));
+    return h;
+}
+
+static uint64_t
+_track_path_hash (uint32_t idx) {
+    return _hash_bytes (strings + tracks[idx].path_offset, tracks[idx].path_len);
+}
+
+static uint64_t
+_track_md5_hash (uint32_t idx) {
+    return _hash_digest (tracks[idx].audio_md5);
+}
+
+static uint64_t
+_album_hash (uint32_t idx) {
+    return _hash_digest (albums[idx].digest);
+}
+
+static void
+_index_insert (rg_cache_index_t *index, uint64_t hash, uint32_t idx, uint64_t (*hash_of) (uint32_t idx)) {
+    if ((index->count + 1) * 2 > index->size) {
+        rg_cache_index_t grown;
+        grown.size = index->size ? index->size * 2 : 1024;
+        grown.count = 0;
+        grown.slots = calloc (grown.size, sizeof (uint32_t));
+        for (uint32_t i = 0; i < index->size; i++) {
+            if (index->slots[i]) {
+                uint32_t v = index->slots[i] - 1;
+                uint32_t s = (uint32_t)hash_of (v) & (grown.size - 1);
+                while (grown.slots[s]) {
+                    s = (s + 1) & (grown.size - 1);
+                }
+                grown.slots[s] = v + 1;
+                grown.count++;
+            }
+        }
+        free (index->slots);
+        *index = grown;
+    }
+    uint32_t s = (uint32_t)hash & (index->size - 1);
+    while (index->slots[s]) {
+        s = (s + 1) & (index->size - 1);
+    }
+    index->slots[s] = idx + 1;
+    index->count++;
+}
+
+static void
+_index_free (rg_cache_index_t *index) {
+    free (index->slots);
+    memset (index, 0, sizeof (rg_cache_index_t));
+}
+
+static void
+_index_track (uint32_t idx) {
+    _index_insert (&path_index, _track_path_hash (idx), idx, _track_path_hash);
+    if (tracks[idx].flags & RG_CACHE_FLAG_AUDIO_MD5) {
+        _index_insert (&md5_index, _track_md5_hash (idx), idx, _track_md5_hash);
+    }
+}
+
+static int
+_cache_path (char *path, size_t size) {
+    const char *cache_root = deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    if (!cache_root) {
+        return -1;
+    }
+    size_t res = snprintf (path, size, "%s/rg_scanner.cache", cache_root);
+    if (res >= size) {
+        return -1;
+    }
+    return 0;
+}
+
+static void
+_cache_load (void) {
+    char path[PATH_MAX];
+    if (_cache_path (path, sizeof (path)) < 0) {
+        return;
+    }
+    FILE *fp = fopen (path, "rb");
+    if (!fp) {
+        return;
+    }
+
+    rg_cache_header_t hdr;
+    if (fread (&hdr, sizeof (hdr), 1, fp) != 1
+        || memcmp (hdr.magic, RG_CACHE_MAGIC, sizeof (hdr.magic))
+        || hdr.version != RG_CACHE_VERSION) {
+        goto error;
+    }
+
+    tracks = malloc (hdr.track_count * sizeof (rg_cache_track_t));
+    albums = malloc (hdr.album_count * sizeof (rg_cache_album_t));
+    strings = malloc (hdr.strings_size);
+    if ((hdr.track_count && !tracks) || (hdr.album_count && !albums) || (hdr.strings_size && !strings)) {
+        goto error;
+    }
+    if (fread (tracks, sizeof (rg_cache_track_t), hdr.track_count, fp) != hdr.track_count
+        || fread (albums, sizeof (rg_cache_album_t), hdr.album_count, fp) != hdr.album_count
+        || fread (strings, 1, hdr.strings_size, fp) != hdr.strings_size) {
+        goto error;
+    }
+    for (uint32_t i = 0; i < hdr.track_count; i++) {
+        if ((uint64_t)tracks[i].path_offset + tracks[i].path_len > hdr.strings_size) {
+            goto error;
+        }
+    }
+    fclose (fp);
+
+    track_count = tracks_allocated = hdr.track_count;
+    album_count = albums_allocated = hdr.album_count;
+    strings_size = strings_allocated = hdr.strings_size;
+
+    for (uint32_t i = 0; i < track_count; i++) {
+        _index_track (i);
+    }
+    for (uint32_t i = 0; i < album_count; i++) {
+        _index_insert (&album_index, _album_hash (i), i, _album_hash);
+    }
+    return;
+
+error:
+    fclose (fp);
+    free (tracks);
+    tracks = NULL;
+    free (albums);
+    albums = NULL;
+    free (strings);
+    strings = NULL;
+}
+
+void
+rg_cache_save (void) {
+    if (!dirty) {
+        return;
+    }
+    char path[PATH_MAX];
+    if (_cache_path (path, sizeof (path)) < 0) {
+        return;
+    }
+    char tmp_path[PATH_MAX];
+    if ((size_t)snprintf (tmp_path, sizeof (tmp_path), "%s.part", path) >= sizeof (tmp_path)) {
+        return;
+    }
+
+    // drop the expired entries, and compact the paths
+    uint16_t today = _today ();
+    rg_cache_track_t *out_tracks = malloc (track_count * sizeof (rg_cache_track_t) + 1);
+    rg_cache_album_t *out_albums = malloc (album_count * sizeof (rg_cache_album_t) + 1);
+    char *out_strings = malloc (strings_size + 1);
+    uint32_t out_track_count = 0;
+    uint32_t out_album_count = 0;
+    uint32_t out_strings_size = 0;
+
+    for (uint32_t i = 0; i < track_count; i++) {
+        if ((uint16_t)(today - tracks[i].last_used) > RG_CACHE_EXPIRE_DAYS) {
+            continue;
+        }
+        rg_cache_track_t *t = &out_tracks[out_track_count++];
+        *t = tracks[i];
+        memcpy (out_strings + out_strings_size, strings + tracks[i].path_offset, tracks[i].path_len);
+        t->path_offset = out_strings_size;
+        out_strings_size += tracks[i].path_len;
+    }
+    for (uint32_t i = 0; i < album_count; i++) {
+        if ((uint16_t)(today - albums[i].last_used) > RG_CACHE_EXPIRE_DAYS) {
+            continue;
+        }
+        out_albums[out_album_count++] = albums[i];
+    }
+
+    rg_cache_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, RG_CACHE_MAGIC, sizeof (RG_CACHE_MAGIC));
+    hdr.version = RG_CACHE_VERSION;
+    hdr.track_count = out_track_count;
+    hdr.album_count = out_album_count;
+    hdr.strings_size = out_strings_size;
+
+    int res = 0;
+    FILE *fp = fopen (tmp_path, "w+b");
+    if (fp) {
+        res = fwrite (&hdr, sizeof (hdr), 1, fp) == 1
+            && fwrite (out_tracks, sizeof (rg_cache_track_t), out_track_count, fp) == out_track_count
+            && fwrite (out_albums, sizeof (rg_cache_album_t), out_album_count, fp) == out_album_count
+            && fwrite (out_strings, 1, out_strings_size, fp) == out_strings_size;
+        if (fclose (fp) != 0) {
+            res = 0;
+        }
+    }
+
+    free (out_tracks);
+    free (out_albums);
+    free (out_strings);
+
+    if (!res || rename (tmp_path, path) != 0) {
+        fprintf (stderr, "rg_scanner: failed to write cache %s\n", path);
+        unlink (tmp_path);
+        return;
+    }
+    dirty = 0;
+}
+
+void
+rg_cache_init (DB_functions_t *api) {
+    deadbeef = api;
+    mutex = deadbeef->mutex_create ();
+}
+
+void
+rg_cache_free (void) {
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    if (loaded) {
+        rg_cache_save ();
+    }
+    _index_free (&path_index);
+    _index_free (&md5_index);
+    _index_free (&album_index);
+    free (tracks);
+    tracks = NULL;
+    track_count = tracks_allocated = 0;
+    free (albums);
+    albums = NULL;
+    album_count = albums_allocated = 0;
+    free (strings);
+    strings = NULL;
+    strings_size = strings_allocated = 0;
+    loaded = 0;
+    deadbeef->mutex_unlock (mutex);
+    deadbeef->mutex_free (mutex);
+    mutex = 0;
+}
+
+void
+rg_cache_lock (void) {
+    deadbeef->mutex_lock (mutex);
+    if (!loaded) {
+        _cache_load ();
+        loaded = 1;
+    }
+}
+
+void
+rg_cache_unlock (void) {
+    deadbeef->mutex_unlock (mutex);
+}
+
+static int
+_parse_md5 (const char *str, uint8_t md5[16]) {
+    if (strlen (str) != 32) {
+        return -1;
+    }
+    for (int i = 0; i < 16; i++) {
+        unsigned int byte;
+        if (sscanf (str + i * 2, "%2x", &byte) != 1) {
+            return -1;
+        }
+        md5[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+int
+rg_cache_key_init (rg_cache_key_t *key, DB_playItem_t *it) {
+    memset (key, 0, sizeof (rg_cache_key_t));
+
+    deadbeef->pl_lock ();
+    const char *uri = deadbeef->pl_find_meta (it, ":URI");
+    if (uri) {
+        key->path = strdup (uri);
+    }
+    const char *md5 = deadbeef->pl_find_meta (it, ":AUDIO_MD5");
+    if (md5 && !_parse_md5 (md5, key->audio_md5)) {
+        key->has_audio_md5 = 1;
+    }
+    key->tracknum = deadbeef->pl_find_meta_int (it, ":TRACKNUM", 0);
+    deadbeef->pl_unlock ();
+
+    key->startsample = deadbeef->pl_item_get_startsample (it);
+    key->endsample = deadbeef->pl_item_get_endsample (it);
+
+    struct stat st;
+    if (!key->path || stat (key->path, &st) != 0 || !S_ISREG (st.st_mode)) {
+        rg_cache_key_free (key);
+        return -1;
+    }
+    key->size = (uint64_t)st.st_size;
+    key->mtime = (int64_t)st.st_mtime;
+    return 0;
+}
+
+void
+rg_cache_key_free (rg_cache_key_t *key) {
+    free (key->path);
+    key->path = NULL;
+}
+
+static int
+_same_position (const rg_cache_track_t *t, const rg_cache_key_t *key) {
+    return t->startsample == key->startsample && t->endsample == key->endsample && t->tracknum == key->tracknum;
+}
+
+static int
+_same_path (const rg_cache_track_t *t, const char *path, size_t path_len) {
+    return t->path_len == path_len && !memcmp (strings + t->path_offset, path, path_len);
+}
+
+// finds the entry of the same track in the same file, which may have been modified since
+static rg_cache_track_t *
+_find_by_path (const rg_cache_key_t *key) {
+    if (!path_index.size) {
+        return NULL;
+    }
+    size_t path_len = strlen (key->path);
+    uint32_t mask = path_index.size - 1;
+    for (uint32_t s = (uint32_t)_hash_bytes (key->path, path_len) & mask; path_index.slots[s]; s = (s + 1) & mask) {
+        rg_cache_track_t *t = &tracks[path_index.slots[s] - 1];
+        if (_same_path (t, key->path, path_len) && _same_position (t, key)) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static rg_cache_track_t *
+_find_by_md5 (const rg_cache_key_t *key) {
+    if (!md5_index.size) {
+        return NULL;
+    }
+    uint32_t mask = md5_index.size - 1;
+    for (uint32_t s = (uint32_t)_hash_digest (key->audio_md5) & mask; md5_index.slots[s]; s = (s + 1) & mask) {
+        rg_cache_track_t *t = &tracks[md5_index.slots[s] - 1];
+        if ((t->flags & RG_CACHE_FLAG_AUDIO_MD5) && !memcmp (t->audio_md5, key->audio_md5, 16) && _same_position (t, key)) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void
+_touch (uint16_t *last_used) {
+    uint16_t today = _today ();
+    if (*last_used != today) {
+        *last_used = today;
+        dirty = 1;
+    }
+}
+
+int
+rg_cache_get_track (const rg_cache_key_t *key, float *loudness, float *peak) {
+    rg_cache_track_t *t = _find_by_path (key);
+    if (t && (t->size != key->size || t->mtime != key->mtime)) {
+        t = NULL;
+    }
+    if (!t && key->has_audio_md5) {
+        t = _find_by_md5 (key);
+    }
+    if (!t) {
+        return -1;
+    }
+    _touch (&t->last_used);
+    *loudness = t->loudness;
+    *peak = t->peak;
+    return 0;
+}
+
+void
+rg_cache_set_track (const rg_cache_key_t *key, float loudness, float peak) {
+    rg_cache_track_t *t = _find_by_path (key);
+    if (!t) {
+        size_t path_len = strlen (key->path);
+        if (strings_size + path_len > strings_allocated) {
+            strings_allocated = (strings_size + (uint32_t)path_len) * 2;
+            strings = realloc (strings, strings_allocated);
+        }
+        if (track_count == tracks_allocated) {
+            tracks_allocated = tracks_allocated ? tracks_allocated * 2 : 1024;
+            tracks = realloc (tracks, tracks_allocated * sizeof (rg_cache_track_t));
+        }
+        t = &tracks[track_count];
+        memset (t, 0, sizeof (rg_cache_track_t));
+        memcpy (strings + strings_size, key->path, path_len);
+        t->path_offset = strings_size;
+        t->path_len = (uint32_t)path_len;
+        strings_size += (uint32_t)path_len;
+        t->startsample = key->startsample;
+        t->endsample = key->endsample;
+        t->tracknum = key->tracknum;
+        track_count++;
+        _index_insert (&path_index, _track_path_hash (track_count - 1), track_count - 1, _track_path_hash);
+    }
+
+    t->size = key->size;
+    t->mtime = key->mtime;
+    if (key->has_audio_md5 && (!(t->flags & RG_CACHE_FLAG_AUDIO_MD5) || memcmp (t->audio_md5, key->audio_md5, 16))) {
+        t->flags |= RG_CACHE_FLAG_AUDIO_MD5;
+        memcpy (t->audio_md5, key->audio_md5, 16);
+        _index_insert (&md5_index, _hash_digest (key->audio_md5), (uint32_t)(t - tracks), _track_md5_hash);
+    }
+    t->loudness = loudness;
+    t->peak = peak;
+    t->last_used = _today ();
+    dirty = 1;
+}
+
+// Identifies the audio of a track, for the album digest.
+// Without the audio MD5, the track values are used instead of the file size and mtime,
+// so that writing the tags doesn't invalidate the album.
+static void
+_track_digest (const rg_cache_key_t *key, float loudness, float peak, uint8_t digest[16]) {
+    DB_md5_t md5;
+    deadbeef->md5_init (&md5);
+    if (key->has_audio_md5) {
+        deadbeef->md5_append (&md5, key->audio_md5, 16);
+    }
+    else {
+        deadbeef->md5_append (&md5, (const uint8_t *)key->path, (int)strlen (key->path));
+        deadbeef->md5_append (&md5, (const uint8_t *)&loudness, sizeof (loudness));
+        deadbeef->md5_append (&md5, (const uint8_t *)&peak, sizeof (peak));
+    }
+    deadbeef->md5_append (&md5, (const uint8_t *)&key->startsample, sizeof (key->startsample));
+    deadbeef->md5_append (&md5, (const uint8_t *)&key->endsample, sizeof (key->endsample));
+    deadbeef->md5_append (&md5, (const uint8_t *)&key->tracknum, sizeof (key->tracknum));
+    deadbeef->md5_finish (&md5, digest);
+}
+
+static int
+_digest_cmp (const void *a, const void *b) {
+    return memcmp (a, b, 16);
+}
+
+void
+rg_cache_album_digest (const rg_cache_key_t *keys, const float *loudness, const float *peak, int count, uint8_t digest[16]) {
+    uint8_t *digests = malloc (count * 16);
+    for (int i = 0; i < count; i++) {
+        _track_digest (&keys[i], loudness[i], peak[i], digests + i * 16);
+    }
+    qsort (digests, count, 16, _digest_cmp);
+    deadbeef->md5 (digest, (const char *)digests, count * 16);
+    free (digests);
+}
+
+static rg_cache_album_t *
+_find_album (const uint8_t digest[16]) {
+    if (!album_index.size) {
+        return NULL;
+    }
+    uint32_t mask = album_index.size - 1;
+    for (uint32_t s = (uint32_t)_hash_digest (digest) & mask; album_index.slots[s]; s = (s + 1) & mask) {
+        rg_cache_album_t *a = &albums[album_index.slots[s] - 1];
+        if (!memcmp (a->digest, digest, 16)) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+int
+rg_cache_get_album (const uint8_t digest[16], float *loudness, float *peak) {
+    rg_cache_album_t *a = _find_album (digest);
+    if (!a) {
+        return -1;
+    }
+    _touch (&a->last_used);
+    *loudness = a->loudness;
+    *peak = a->peak;
+    return 0;
+}
+
+void
+rg_cache_set_album (const uint8_t digest[16], float loudness, float peak) {
+    rg_cache_album_t *a = _find_album (digest);
+    if (!a) {
+        if (album_count == albums_allocated) {
+            albums_allocated = albums_allocated ? albums_allocated * 2 : 256;
+            albums = realloc (albums, albums_allocated * sizeof (rg_cache_album_t));
+        }
+        a = &albums[album_count++];
+        memcpy (a->digest, digest, 16);
+        _index_insert (&album_index, _album_hash (album_count - 1), album_count - 1, _album_hash);
+    }
+    a->loudness = loudness;
+    a->peak = peak;
+    a->last_used = _today ();
+    dirty = 1;
+}
+
+void
+rg_cache_file_changed (const char *path, const struct stat *old_st, const struct stat *new_st) {
+    if (!path_index.size) {
+        return;
+    }
+    size_t path_len = strlen (path);
+    uint32_t mask = path_index.size - 1;
+    for (uint32_t s = (uint32_t)_hash_bytes (path, path_len) & mask; path_index.slots[s]; s = (s + 1) & mask) {
+        rg_cache_track_t *t = &tracks[path_index.slots[s] - 1];
+        if (_same_path (t, path, path_len) && t->size == (uint64_t)old_st->st_size && t->mtime == (int64_t)old_st->st_mtime) {
+            t->size = (uint64_t)new_st->st_size;
+            t->mtime = (int64_t)new_st->st_mtime;
+            dirty = 1;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * ReplayGain Scanner plugin for DeaDBeeF Player
+ *
+ * Copyright (c) 2026 Oleksiy Yakovenko
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef __RG_CACHE_H
+#define __RG_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include "../../deadbeef.h"
+
+// Persistent cache of the scan results, stored in the cache dir.
+// A track is found by the file path, size and mtime, and its position in the file (cuesheets, subsongs);
+// or by the MD5 of the decoded audio, if the file stores it (FLAC STREAMINFO),
+// which also covers retagged and renamed files.
+// The album values are found by a digest of all the album tracks.
+// The loudness is stored in LUFS, so that changing the reference loudness doesn't invalidate the cache.
+// All calls must be made with the cache locked.
+
+typedef struct {
+    char *path;
+    uint64_t size;
+    int64_t mtime;
+    int64_t startsample;
+    int64_t endsample;
+    int tracknum;
+    int has_audio_md5;
+    uint8_t audio_md5[16];
+} rg_cache_key_t;
+
+void
+rg_cache_init (DB_functions_t *api);
+
+// saves the cache if it has changed, and frees it
+void
+rg_cache_free (void);
+
+void
+rg_cache_lock (void);
+
+void
+rg_cache_unlock (void);
+
+// Returns -1 if the track can't be cached, e.g. it's a network stream
+int
+rg_cache_key_init (rg_cache_key_t *key, DB_playItem_t *it);
+
+void
+rg_cache_key_free (rg_cache_key_t *key);
+
+// Returns 0 if found
+int
+rg_cache_get_track (const rg_cache_key_t *key, float *loudness, float *peak);
+
+void
+rg_cache_set_track (const rg_cache_key_t *key, float loudness, float peak);
+
+// Digest of the album tracks, with their loudness and peak values.
+// It doesn't depend on the order of the tracks.
+void
+rg_cache_album_digest (const rg_cache_key_t *keys, const float *loudness, const float *peak, int count, uint8_t digest[16]);
+
+// Returns 0 if found
+int
+rg_cache_get_album (const uint8_t digest[16], float *loudness, float *peak);
+
+void
+rg_cache_set_album (const uint8_t digest[16], float loudness, float peak);
+
+// Updates the entries of a file which was changed by writing the tags
+void
+rg_cache_file_changed (const char *path, const struct stat *old_st, const struct stat *new_st);
+
+void
+rg_cache_save (void);
+
+#endif //__RG_CACHE_H
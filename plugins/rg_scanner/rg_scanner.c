@@ -30,9 +30,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
+#include <sys/stat.h>
 
 #include "../../deadbeef.h"
 #include "ebur128/ebur128.h"
+#include "rg_cache.h"
 #include "../../strdupa.h"
 
 #define trace(...) { deadbeef->log_detailed (&plugin.misc.plugin, 0, __VA_ARGS__); }
@@ -47,8 +49,79 @@ typedef struct {
     ddb_rg_scanner_settings_t *settings;
     ebur128_state **gain_state;
     ebur128_state **peak_state;
+    float *track_loudness;
+    int *tracks_started;
 } track_state_t;
 
+// speaker mask mapping from WAV to EBUR128
+static void
+_rg_set_channel_map (ebur128_state *gain_state, ebur128_state *peak_state, int channels, uint32_t channelmask) {
+    static const int chmap[18] = {
+        EBUR128_LEFT,
+        EBUR128_RIGHT,
+        EBUR128_CENTER,
+        EBUR128_UNUSED,
+        EBUR128_LEFT_SURROUND,
+        EBUR128_RIGHT_SURROUND,
+        EBUR128_LEFT_SURROUND,
+        EBUR128_RIGHT_SURROUND,
+        EBUR128_CENTER,
+        EBUR128_LEFT_SURROUND,
+        EBUR128_RIGHT_SURROUND,
+        EBUR128_CENTER,
+        EBUR128_LEFT_SURROUND,
+        EBUR128_CENTER,
+        EBUR128_RIGHT_SURROUND,
+        EBUR128_LEFT_SURROUND,
+        EBUR128_CENTER,
+        EBUR128_RIGHT_SURROUND,
+    };
+
+    // first 18 speaker positions are known, the rest will be marked as UNUSED
+    int ch = 0;
+    for (int i = 0; i < 32 && ch < channels; i++) {
+        if (i < 18) {
+            if (channelmask & (1<<i))
+            {
+                ebur128_set_channel (gain_state, ch, chmap[i]);
+                ebur128_set_channel (peak_state, ch, chmap[i]);
+                ch++;
+            }
+        }
+        else {
+            ebur128_set_channel (gain_state, ch, EBUR128_UNUSED);
+            ebur128_set_channel (peak_state, ch, EBUR128_UNUSED);
+            ch++;
+        }
+    }
+}
+
+// libEBUR128 calculates peak per channel, so we have to pick the highest value
+static float
+_rg_track_peak (ebur128_state *peak_state, int channels) {
+    double tr_peak = 0;
+    double ch_peak = 0;
+    for (int ch = 0; ch < channels; ++ch) {
+        ebur128_sample_peak (peak_state, ch, &ch_peak);
+        if (ch_peak > tr_peak) {
+            tr_peak = ch_peak;
+        }
+    }
+    return (float)tr_peak;
+}
+
+/*
+ * EBUR128 sets the target level to -23 LUFS = 84dB
+ * -> -23 - loudness = track gain to get to 84dB
+ *
+ * The old implementation of RG used 89dB, most people still use that
+ * -> the above + (loudness - 84) = track gain to get to 89dB (or user specified)
+ */
+static float
+_rg_gain (double loudness, float ref_loudness) {
+    return -23 - (float)loudness + ref_loudness - 84;
+}
+
 void
 rg_calc_thread(void *ctx) {
     DB_decoder_t *dec = NULL;
@@ -61,6 +134,12 @@ rg_calc_thread(void *ctx) {
     if (st->settings->pabort && *(st->settings->pabort)) {
         return;
     }
+
+    if (st->settings->progress_callback) {
+        deadbeef->mutex_lock (st->settings->sync_mutex);
+        st->settings->progress_callback ((*st->tracks_started)++, st->settings->progress_cb_user_data);
+        deadbeef->mutex_unlock (st->settings->sync_mutex);
+    }
     if (deadbeef->pl_get_item_duration (st->settings->tracks[st->track_index]) <= 0) {
         st->settings->results[st->track_index].scan_result = DDB_RG_SCAN_RESULT_INVALID_FILE;
         return;
@@ -72,7 +151,7 @@ rg_calc_thread(void *ctx) {
     deadbeef->pl_unlock ();
 
     if (dec) {
-        fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL);
+        fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL | DDB_DECODER_HINT_OFFLINE);
 
         if (!fileinfo || dec->init (fileinfo, DB_PLAYITEM (st->settings->tracks[st->track_index])) != 0) {
             st->settings->results[st->track_index].scan_result = DDB_RG_SCAN_RESULT_FILE_NOT_FOUND;
@@ -82,47 +161,7 @@ rg_calc_thread(void *ctx) {
         st->gain_state[st->track_index] = ebur128_init(fileinfo->fmt.channels, fileinfo->fmt.samplerate, EBUR128_MODE_I);
         st->peak_state[st->track_index] = ebur128_init(fileinfo->fmt.channels, fileinfo->fmt.samplerate, EBUR128_MODE_SAMPLE_PEAK);
 
-        // speaker mask mapping from WAV to EBUR128
-        static const int chmap[18] = {
-            EBUR128_LEFT,
-            EBUR128_RIGHT,
-            EBUR128_CENTER,
-            EBUR128_UNUSED,
-            EBUR128_LEFT_SURROUND,
-            EBUR128_RIGHT_SURROUND,
-            EBUR128_LEFT_SURROUND,
-            EBUR128_RIGHT_SURROUND,
-            EBUR128_CENTER,
-            EBUR128_LEFT_SURROUND,
-            EBUR128_RIGHT_SURROUND,
-            EBUR128_CENTER,
-            EBUR128_LEFT_SURROUND,
-            EBUR128_CENTER,
-            EBUR128_RIGHT_SURROUND,
-            EBUR128_LEFT_SURROUND,
-            EBUR128_CENTER,
-            EBUR128_RIGHT_SURROUND,
-        };
-
-        uint32_t channelmask = fileinfo->fmt.channelmask;
-
-        // first 18 speaker positions are known, the rest will be marked as UNUSED
-        int ch = 0;
-        for (int i = 0; i < 32 && ch < fileinfo->fmt.channels; i++) {
-            if (i < 18) {
-                if (channelmask & (1<<i))
-                {
-                    ebur128_set_channel (st->gain_state[st->track_index], ch, chmap[i]);
-                    ebur128_set_channel (st->peak_state[st->track_index], ch, chmap[i]);
-                    ch++;
-                }
-            }
-            else {
-                ebur128_set_channel (st->gain_state[st->track_index], ch, EBUR128_UNUSED);
-                ebur128_set_channel (st->peak_state[st->track_index], ch, EBUR128_UNUSED);
-                ch++;
-            }
-        }
+        _rg_set_channel_map (st->gain_state[st->track_index], st->peak_state[st->track_index], fileinfo->fmt.channels, fileinfo->fmt.channelmask);
 
         int samplesize = fileinfo->fmt.channels * fileinfo->fmt.bps / 8;
 
@@ -175,34 +214,14 @@ rg_calc_thread(void *ctx) {
         }
 
         if (!st->settings->pabort || !(*(st->settings->pabort))) {
-            // calculating track peak
-            // libEBUR128 calculates peak per channel, so we have to pick the highest value
-            double tr_peak = 0;
-            double ch_peak = 0;
-            int res;
-            for (int ch = 0; ch < fileinfo->fmt.channels; ++ch) {
-                res = ebur128_sample_peak (st->peak_state[st->track_index], ch, &ch_peak);
-                //trace ("rg_scanner: peak for ch %d: %f\n", ch, ch_peak);
-                if (ch_peak > tr_peak) {
-                    //trace ("rg_scanner: %f > %f\n", ch_peak, tr_peak);
-                    tr_peak = ch_peak;
-                }
-            }
-
-            st->settings->results[st->track_index].track_peak = (float) tr_peak;
+            st->settings->results[st->track_index].track_peak = _rg_track_peak (st->peak_state[st->track_index], fileinfo->fmt.channels);
 
             // calculate track loudness
             double loudness = st->settings->ref_loudness;
             ebur128_loudness_global (st->gain_state[st->track_index], &loudness);
-            /*
-             * EBUR128 sets the target level to -23 LUFS = 84dB
-             * -> -23 - loudness = track gain to get to 84dB
-             *
-             * The old implementation of RG used 89dB, most people still use that
-             * -> the above + (loudness - 84) = track gain to get to 89dB (or user specified)
-             */
+            st->track_loudness[st->track_index] = (float)loudness;
             if (loudness != -HUGE_VAL) {
-                st->settings->results[st->track_index].track_gain = -23 - loudness + st->settings->ref_loudness - 84;
+                st->settings->results[st->track_index].track_gain = _rg_gain (loudness, st->settings->ref_loudness);
             }
         }
     }
@@ -224,37 +243,113 @@ error:
     }
 }
 
+static void
+_rg_set_track_result (ddb_rg_scanner_result_t *result, float loudness, float peak, float ref_loudness) {
+    result->track_peak = peak;
+    result->track_gain = loudness != -HUGE_VAL ? _rg_gain (loudness, ref_loudness) : 0;
+    result->scan_result = DDB_RG_SCAN_RESULT_SUCCESS;
+}
+
+static void
+_rg_set_album_result (ddb_rg_scanner_result_t *result, float loudness, float peak, float ref_loudness) {
+    result->album_peak = peak;
+    result->album_gain = loudness != -HUGE_VAL ? _rg_gain (loudness, ref_loudness) : 0;
+}
+
+// Assigns an album index to each track, the tracks of an album are adjacent.
+// Returns the number of albums, which is 0 in the track mode.
 static int
-_update_album_gain (ddb_rg_scanner_settings_t *settings, int i, int album_start, char *current_album, char *album, double loudness, ebur128_state **gain_state) {
-    if (strcmp (album, current_album)) {
-        if (i > 0) {
-            // update current album gain/peak
-            float album_peak = 0;
-
-            for (int n = album_start; n < i; ++n) {
-                if (album_peak < settings->results[n].track_peak) {
-                    album_peak = settings->results[n].track_peak;
-                }
-            }
+_rg_find_albums (ddb_rg_scanner_settings_t *settings, int *album_ids) {
+    if (settings->mode == DDB_RG_SCAN_MODE_SINGLE_ALBUM) {
+        return settings->num_tracks > 0 ? 1 : 0;
+    }
+    if (settings->mode != DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS) {
+        return 0;
+    }
+
+    char *album_signature_tf = deadbeef->tf_compile (album_signature);
+    char current_album[1000] = "";
+    char album[1000];
+    int count = 0;
+
+    ddb_tf_context_t ctx;
+    memset (&ctx, 0, sizeof (ctx));
+
+    ctx._size = sizeof (ctx);
+    ctx.plt = NULL;
+    ctx.idx = -1;
+    ctx.id = -1;
+
+    for (int i = 0; i < settings->num_tracks; i++) {
+        ctx.it = settings->tracks[i];
+        deadbeef->tf_eval (&ctx, album_signature_tf, album, sizeof (album));
+        if (i == 0 || strcmp (album, current_album)) {
+            strcpy (current_album, album);
+            count++;
+        }
+        album_ids[i] = count - 1;
+    }
 
-            // calculate gain of all tracks of the current album
-            ebur128_loudness_global_multiple(&gain_state[album_start], (size_t)i-album_start, &loudness);
+    deadbeef->tf_free (album_signature_tf);
+    return count;
+}
 
-            float album_gain = -23 - (float)loudness + settings->ref_loudness - 84;
+// Returns the index after the last track of the album which starts at the index
+static int
+_rg_album_end (ddb_rg_scanner_settings_t *settings, const int *album_ids, int start) {
+    int end = start + 1;
+    while (end < settings->num_tracks && album_ids[end] == album_ids[start]) {
+        end++;
+    }
+    return end;
+}
 
-            for (int n = album_start; n < i; ++n) {
-                settings->results[n].album_gain = album_gain;
-                settings->results[n].album_peak = album_peak;
-            }
+// Takes the results from the cache, and marks the tracks which still need to be scanned.
+// An album can only be taken from the cache as a whole, otherwise all of its tracks are scanned again.
+static void
+_rg_cache_lookup (ddb_rg_scanner_settings_t *settings, rg_cache_key_t *keys, float *track_loudness, char *need_scan, const int *album_ids, int num_albums) {
+    float *track_peak = calloc (settings->num_tracks, sizeof (float));
+
+    rg_cache_lock ();
+    for (int i = 0; i < settings->num_tracks; i++) {
+        if (rg_cache_key_init (&keys[i], settings->tracks[i]) || rg_cache_get_track (&keys[i], &track_loudness[i], &track_peak[i])) {
+            continue;
         }
+        need_scan[i] = 0;
+        _rg_set_track_result (&settings->results[i], track_loudness[i], track_peak[i], settings->ref_loudness);
+    }
 
-        // proceed to next album
-        strcpy (current_album, album);
+    for (int start = 0; num_albums > 0 && start < settings->num_tracks;) {
+        int end = _rg_album_end (settings, album_ids, start);
+        int all_cached = 1;
+        for (int i = start; i < end; i++) {
+            if (need_scan[i]) {
+                all_cached = 0;
+                break;
+            }
+        }
 
-        //trace ("next album found %d -> %d\n", album_start, i);
-        return i;
+        uint8_t digest[16];
+        float album_loudness;
+        float album_peak;
+        if (all_cached) {
+            rg_cache_album_digest (&keys[start], &track_loudness[start], &track_peak[start], end - start, digest);
+        }
+        if (all_cached && !rg_cache_get_album (digest, &album_loudness, &album_peak)) {
+            for (int i = start; i < end; i++) {
+                _rg_set_album_result (&settings->results[i], album_loudness, album_peak, settings->ref_loudness);
+            }
+        }
+        else {
+            for (int i = start; i < end; i++) {
+                need_scan[i] = 1;
+            }
+        }
+        start = end;
     }
-    return album_start;
+    rg_cache_unlock ();
+
+    free (track_peak);
 }
 
 int
@@ -269,9 +364,7 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
         settings->num_threads = 4;
     }
 
-    char *album_signature_tf = NULL;
     if (settings->mode == DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS) {
-        album_signature_tf = deadbeef->tf_compile (album_signature);
         deadbeef->sort_track_array (NULL, settings->tracks, settings->num_tracks, album_signature, DDB_SORT_ASCENDING);
     }
 
@@ -284,30 +377,37 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
         settings->ref_loudness = DDB_RG_SCAN_DEFAULT_LOUDNESS;
     }
 
-    double loudness = settings->ref_loudness;
-
     // allocate status array
     gain_state = calloc (settings->num_tracks, sizeof (ebur128_state *));
     peak_state = calloc (settings->num_tracks, sizeof (ebur128_state *));
+    float *track_loudness = calloc (settings->num_tracks, sizeof (float));
+
+    int *album_ids = calloc (settings->num_tracks, sizeof (int));
+    int num_albums = _rg_find_albums (settings, album_ids);
 
-    // used for joining threads
-    intptr_t *rg_threads = calloc (settings->num_tracks, sizeof (intptr_t));
+    char *need_scan = malloc (settings->num_tracks);
+    memset (need_scan, 1, settings->num_tracks);
+
+    rg_cache_key_t *keys = NULL;
+    if (deadbeef->conf_get_int ("rg_scanner.use_cache", 1)) {
+        keys = calloc (settings->num_tracks, sizeof (rg_cache_key_t));
+        _rg_cache_lookup (settings, keys, track_loudness, need_scan, album_ids, num_albums);
+    }
+
+    // the tracks are scanned by the shared thread pool, at most num_threads at a time
+    ddb_task_group_t *task_group = deadbeef->task_group_create ("rg_scanner", DDB_TASK_PRIORITY_LOW, settings->num_threads);
     track_state_t *track_states = calloc (settings->num_tracks, sizeof (track_state_t));
 
-    // calculate gain for each track and album
+    // the cached tracks are reported as done
+    int tracks_started = 0;
     for (int i = 0; i < settings->num_tracks; ++i) {
-        if (settings->progress_callback) {
-            settings->progress_callback (i, settings->progress_cb_user_data);
-        }
-        // limit number of parallel threads
-        if (i >= settings->num_threads) {
-            // simple blocking mechanism: join the 'oldest' thread
-            deadbeef->thread_join(rg_threads[i - settings->num_threads]);
-            rg_threads[i - settings->num_threads] = 0;
-        }
+        tracks_started += !need_scan[i];
+    }
 
-        if (settings->pabort && *(settings->pabort)) {
-            goto cleanup;
+    // calculate gain for each track and album
+    for (int i = 0; i < settings->num_tracks; ++i) {
+        if (!need_scan[i]) {
+            continue;
         }
 
         // initialize arguments
@@ -315,84 +415,85 @@ rg_scan (ddb_rg_scanner_settings_t *settings) {
         track_states[i].settings = settings;
         track_states[i].gain_state = gain_state;
         track_states[i].peak_state = peak_state;
+        track_states[i].track_loudness = track_loudness;
+        track_states[i].tracks_started = &tracks_started;
 
-        // run thread
-        rg_threads[i] = deadbeef->thread_start(&rg_calc_thread, (void*)(&track_states[i]));
+        if (deadbeef->task_group_submit (task_group, &rg_calc_thread, (void*)(&track_states[i])) < 0) {
+            break;
+        }
     }
 
-    // wait for remaining threads to join
-    int remaining_thread_id = settings->num_tracks - settings->num_threads;
-    if (remaining_thread_id < 0) {
-        remaining_thread_id = 0;
-    }
-    for (int i = remaining_thread_id; i < settings->num_tracks; ++i) {
-        deadbeef->thread_join(rg_threads[i]);
-        rg_threads[i] = 0;
+    deadbeef->task_group_wait (task_group);
 
-        if (settings->pabort && *(settings->pabort)) {
-            goto cleanup;
-        }
+    if (settings->pabort && *(settings->pabort)) {
+        goto cleanup;
     }
 
-    if (settings->mode == DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS) {
-        int album_start = -1;
-        char current_album[1000] = "";
-        char album[1000];
+    if (keys) {
+        rg_cache_lock ();
+    }
 
-        ddb_tf_context_t ctx;
-        memset (&ctx, 0, sizeof (ctx));
+    for (int i = 0; keys && i < settings->num_tracks; ++i) {
+        if (need_scan[i] && keys[i].path && gain_state[i] && settings->results[i].scan_result == DDB_RG_SCAN_RESULT_SUCCESS) {
+            rg_cache_set_track (&keys[i], track_loudness[i], settings->results[i].track_peak);
+        }
+    }
 
-        ctx._size = sizeof (ctx);
-        ctx.plt = NULL;
-        ctx.idx = -1;
-        ctx.id = -1;
+    // calculate gain of all tracks of each album, which was not found in the cache
+    ebur128_state **album_state = calloc (settings->num_tracks, sizeof (ebur128_state *));
+    float *track_peak = calloc (settings->num_tracks, sizeof (float));
+    for (int start = 0; num_albums > 0 && start < settings->num_tracks;) {
+        int end = _rg_album_end (settings, album_ids, start);
+        if (!need_scan[start]) {
+            start = end;
+            continue;
+        }
 
-        for (int i = 0; i <= settings->num_tracks; i++) {
-            // set album gain when the album change is detected
-            if (i < settings->num_tracks) {
-                ctx.it = settings->tracks[i];
-                deadbeef->tf_eval(&ctx, album_signature_tf, album, sizeof (album));
+        float album_peak = 0;
+        size_t count = 0;
+        int cacheable = keys != NULL;
+        for (int i = start; i < end; ++i) {
+            track_peak[i] = settings->results[i].track_peak;
+            if (album_peak < track_peak[i]) {
+                album_peak = track_peak[i];
+            }
+            if (gain_state[i]) {
+                album_state[count++] = gain_state[i];
             }
-            else {
-                *album = 0;
+            if (!gain_state[i] || (keys && !keys[i].path)) {
+                cacheable = 0;
             }
-            album_start = _update_album_gain (settings, i, album_start, current_album, album, loudness, gain_state);
         }
-    }
 
-    if (settings->mode == DDB_RG_SOURCE_MODE_ALBUM) {
-        float album_peak = 0;
+        double loudness = settings->ref_loudness;
+        if (count > 0) {
+            ebur128_loudness_global_multiple (album_state, count, &loudness);
+        }
 
-        for (int i = 0; i < settings->num_tracks; ++i) {
-            if (album_peak < settings->results[i].track_peak) {
-                album_peak = settings->results[i].track_peak;
-            }
+        for (int i = start; i < end; ++i) {
+            _rg_set_album_result (&settings->results[i], (float)loudness, album_peak, settings->ref_loudness);
         }
 
-        // calculate gain of all tracks combined
-        ebur128_loudness_global_multiple(gain_state, (size_t)settings->num_tracks, &loudness);
+        if (cacheable) {
+            uint8_t digest[16];
+            rg_cache_album_digest (&keys[start], &track_loudness[start], &track_peak[start], end - start, digest);
+            rg_cache_set_album (digest, (float)loudness, album_peak);
+        }
 
-        float album_gain = -23 - (float)loudness + settings->ref_loudness - 84;
+        start = end;
+    }
+    free (album_state);
+    free (track_peak);
 
-        for (int i = 0; i < settings->num_tracks; ++i) {
-            settings->results[i].album_gain = album_gain;
-            settings->results[i].album_peak = album_peak;
-        }
+    if (keys) {
+        rg_cache_save ();
+        rg_cache_unlock ();
     }
 
 cleanup:
-    // free thread storage
-    if (rg_threads) {
-        // join the still-active threads
-        for (int i = 0; i < settings->num_tracks; i++) {
-            if (rg_threads[i]) {
-                deadbeef->thread_join (rg_threads[i]);
-                rg_threads[i] = 0;
-            }
-        }
-
-        free (rg_threads);
-        rg_threads = NULL;
+    if (task_group) {
+        deadbeef->task_group_free (task_group);
+        task_group = NULL;
     }
 
     if (track_states) {
@@ -420,11 +521,18 @@ cleanup:
         peak_state = NULL;
     }
 
-    if (album_signature_tf) {
-        deadbeef->tf_free (album_signature_tf);
-        album_signature_tf = NULL;
+    if (keys) {
+        for (int i = 0; i < settings->num_tracks; ++i) {
+            rg_cache_key_free (&keys[i]);
+        }
+        free (keys);
+        keys = NULL;
     }
 
+    free (track_loudness);
+    free (album_ids);
+    free (need_scan);
+
     if (settings->sync_mutex) {
         deadbeef->mutex_free (settings->sync_mutex);
         settings->sync_mutex = 0;
@@ -433,6 +541,177 @@ cleanup:
     return 0;
 }
 
+// Analyzer, for the audio decoded by the caller
+
+typedef struct {
+    ebur128_state *gain_state;
+    ebur128_state *peak_state;
+    int channels;
+    char *album; // album signature, only in DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS mode
+} rg_analyzer_track_t;
+
+struct ddb_rg_analyzer_s {
+    int mode;
+    float ref_loudness;
+    char *album_signature_tf;
+    rg_analyzer_track_t *tracks;
+    int num_tracks;
+    int tracks_allocated;
+};
+
+static ddb_rg_analyzer_t *
+rg_analyzer_alloc (int mode, float ref_loudness) {
+    ddb_rg_analyzer_t *analyzer = calloc (1, sizeof (ddb_rg_analyzer_t));
+    analyzer->mode = mode;
+    analyzer->ref_loudness = ref_loudness != 0 ? ref_loudness : DDB_RG_SCAN_DEFAULT_LOUDNESS;
+    if (mode == DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS) {
+        analyzer->album_signature_tf = deadbeef->tf_compile (album_signature);
+    }
+    return analyzer;
+}
+
+static void
+rg_analyzer_free (ddb_rg_analyzer_t *analyzer) {
+    for (int i = 0; i < analyzer->num_tracks; i++) {
+        rg_analyzer_track_t *track = &analyzer->tracks[i];
+        if (track->gain_state) {
+            ebur128_destroy (&track->gain_state);
+            ebur128_destroy (&track->peak_state);
+        }
+        free (track->album);
+    }
+    free (analyzer->tracks);
+    if (analyzer->album_signature_tf) {
+        deadbeef->tf_free (analyzer->album_signature_tf);
+    }
+    free (analyzer);
+}
+
+static int
+rg_analyzer_add_track (ddb_rg_analyzer_t *analyzer, DB_playItem_t *it, const ddb_waveformat_t *fmt) {
+    ebur128_state *gain_state = ebur128_init (fmt->channels, fmt->samplerate, EBUR128_MODE_I);
+    ebur128_state *peak_state = ebur128_init (fmt->channels, fmt->samplerate, EBUR128_MODE_SAMPLE_PEAK);
+    if (!gain_state || !peak_state) {
+        if (gain_state) {
+            ebur128_destroy (&gain_state);
+        }
+        if (peak_state) {
+            ebur128_destroy (&peak_state);
+        }
+        return -1;
+    }
+    _rg_set_channel_map (gain_state, peak_state, fmt->channels, fmt->channelmask);
+
+    if (analyzer->num_tracks == analyzer->tracks_allocated) {
+        analyzer->tracks_allocated = analyzer->tracks_allocated ? analyzer->tracks_allocated * 2 : 16;
+        analyzer->tracks = realloc (analyzer->tracks, analyzer->tracks_allocated * sizeof (rg_analyzer_track_t));
+    }
+
+    rg_analyzer_track_t *track = &analyzer->tracks[analyzer->num_tracks];
+    memset (track, 0, sizeof (rg_analyzer_track_t));
+    track->gain_state = gain_state;
+    track->peak_state = peak_state;
+    track->channels = fmt->channels;
+
+    if (analyzer->album_signature_tf) {
+        char album[1000];
+        ddb_tf_context_t ctx = {
+            ._size = sizeof (ddb_tf_context_t),
+            .it = it,
+            .idx = -1,
+            .id = -1,
+        };
+        deadbeef->tf_eval (&ctx, analyzer->album_signature_tf, album, sizeof (album));
+        track->album = strdup (album);
+    }
+
+    return analyzer->num_tracks++;
+}
+
+static void
+rg_analyzer_add_frames (ddb_rg_analyzer_t *analyzer, int track_index, const float *samples, int frames) {
+    rg_analyzer_track_t *track = &analyzer->tracks[track_index];
+    ebur128_add_frames_float (track->gain_state, samples, frames);
+    ebur128_add_frames_float (track->peak_state, samples, frames);
+}
+
+static void
+rg_analyzer_remove_track (ddb_rg_analyzer_t *analyzer, int track_index) {
+    rg_analyzer_track_t *track = &analyzer->tracks[track_index];
+    if (track->gain_state) {
+        ebur128_destroy (&track->gain_state);
+        ebur128_destroy (&track->peak_state);
+    }
+}
+
+static void
+rg_analyzer_get_track_result (ddb_rg_analyzer_t *analyzer, int track_index, ddb_rg_scanner_result_t *result) {
+    rg_analyzer_track_t *track = &analyzer->tracks[track_index];
+    memset (result, 0, sizeof (ddb_rg_scanner_result_t));
+    if (!track->gain_state) {
+        result->scan_result = DDB_RG_SCAN_RESULT_INVALID_FILE;
+        return;
+    }
+    result->track_peak = _rg_track_peak (track->peak_state, track->channels);
+
+    double loudness = analyzer->ref_loudness;
+    ebur128_loudness_global (track->gain_state, &loudness);
+    if (loudness != -HUGE_VAL) {
+        result->track_gain = _rg_gain (loudness, analyzer->ref_loudness);
+    }
+    result->scan_result = DDB_RG_SCAN_RESULT_SUCCESS;
+}
+
+static void
+rg_analyzer_get_results (ddb_rg_analyzer_t *analyzer, ddb_rg_scanner_result_t *results) {
+    for (int i = 0; i < analyzer->num_tracks; i++) {
+        rg_analyzer_get_track_result (analyzer, i, &results[i]);
+    }
+
+    if (analyzer->mode != DDB_RG_SCAN_MODE_SINGLE_ALBUM && analyzer->mode != DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS) {
+        return;
+    }
+
+    // the tracks may come in any order, so the albums are gathered by signature
+    ebur128_state **gain_state = calloc (analyzer->num_tracks, sizeof (ebur128_state *));
+    int *album_tracks = calloc (analyzer->num_tracks, sizeof (int));
+    char *done = calloc (analyzer->num_tracks, 1);
+
+    for (int i = 0; i < analyzer->num_tracks; i++) {
+        if (done[i] || !analyzer->tracks[i].gain_state) {
+            continue;
+        }
+        int count = 0;
+        for (int n = i; n < analyzer->num_tracks; n++) {
+            if (!done[n] && analyzer->tracks[n].gain_state && (!analyzer->tracks[i].album || !strcmp (analyzer->tracks[i].album, analyzer->tracks[n].album))) {
+                done[n] = 1;
+                gain_state[count] = analyzer->tracks[n].gain_state;
+                album_tracks[count++] = n;
+            }
+        }
+
+        float album_peak = 0;
+        for (int n = 0; n < count; n++) {
+            if (album_peak < results[album_tracks[n]].track_peak) {
+                album_peak = results[album_tracks[n]].track_peak;
+            }
+        }
+
+        double loudness = analyzer->ref_loudness;
+        ebur128_loudness_global_multiple (gain_state, (size_t)count, &loudness);
+        float album_gain = loudness != -HUGE_VAL ? _rg_gain (loudness, analyzer->ref_loudness) : 0;
+
+        for (int n = 0; n < count; n++) {
+            results[album_tracks[n]].album_gain = album_gain;
+            results[album_tracks[n]].album_peak = album_peak;
+        }
+    }
+
+    free (gain_state);
+    free (album_tracks);
+    free (done);
+}
+
 static int
 _rg_write_meta (DB_playItem_t *track) {
     const char *path = NULL;
@@ -469,10 +748,19 @@ _rg_write_meta (DB_playItem_t *track) {
             if (!strcmp (decoders[i]->plugin.id, decoder_id)) {
                 dec = decoders[i];
                 if (dec->write_metadata) {
+                    struct stat old_st;
+                    int have_old_st = !stat (path, &old_st);
                     if (dec->write_metadata (track)) {
                         trace ("rg_scanner: Failed to write tag to %s\n", path);
                         return -1;
                     }
+                    // writing the tags changes the file, but not the audio
+                    struct stat new_st;
+                    if (have_old_st && !stat (path, &new_st)) {
+                        rg_cache_lock ();
+                        rg_cache_file_changed (path, &old_st, &new_st);
+                        rg_cache_unlock ();
+                    }
                 }
                 else {
                     trace ("rg_scanner: Writing tags is not supported for the file %s\n", path);
@@ -516,6 +804,18 @@ rg_apply (DB_playItem_t *track, uint32_t flags, float track_gain, float track_pe
     return _rg_write_meta (track);
 }
 
+static int
+rg_start (void) {
+    rg_cache_init (deadbeef);
+    return 0;
+}
+
+static int
+rg_stop (void) {
+    rg_cache_free ();
+    return 0;
+}
+
 int
 rg_remove (DB_playItem_t *track) {
     _rg_remove_meta (track);
@@ -528,7 +828,7 @@ static ddb_rg_scanner_t plugin = {
     .misc.plugin.api_vmajor = DB_API_VERSION_MAJOR,
     .misc.plugin.api_vminor = DB_API_VERSION_MINOR,
     .misc.plugin.version_major = 1,
-    .misc.plugin.version_minor = 0,
+    .misc.plugin.version_minor = 1,
     .misc.plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .misc.plugin.type = DB_PLUGIN_MISC,
     .misc.plugin.name = "ReplayGain Scanner",
@@ -563,9 +863,18 @@ static ddb_rg_scanner_t plugin = {
         "OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN\n"
         "THE SOFTWARE.\n",
     .misc.plugin.website = "http://deadbeef.sf.net",
+    .misc.plugin.start = rg_start,
+    .misc.plugin.stop = rg_stop,
     .scan = rg_scan,
     .apply = rg_apply,
-    .remove = rg_remove
+    .remove = rg_remove,
+    .analyzer_alloc = rg_analyzer_alloc,
+    .analyzer_free = rg_analyzer_free,
+    .analyzer_add_track = rg_analyzer_add_track,
+    .analyzer_add_frames = rg_analyzer_add_frames,
+    .analyzer_remove_track = rg_analyzer_remove_track,
+    .analyzer_get_track_result = rg_analyzer_get_track_result,
+    .analyzer_get_results = rg_analyzer_get_results,
 };
 
 DB_plugin_t *
@@ -28,6 +28,9 @@
 
 #include "../../deadbeef.h"
 
+// changes in 1.1:
+//   added the analyzer API, to compute the values from the audio decoded by the caller
+
 enum {
     DDB_RG_SCAN_MODE_TRACK = 1,
     DDB_RG_SCAN_MODE_SINGLE_ALBUM = 2,
@@ -88,6 +91,10 @@ typedef struct {
     uintptr_t sync_mutex;
 } ddb_rg_scanner_settings_t;
 
+// Computes the values of the tracks, which are decoded by the caller, e.g. while converting.
+// Not thread safe: all calls for one analyzer must be serialized by the caller.
+typedef struct ddb_rg_analyzer_s ddb_rg_analyzer_t;
+
 typedef struct {
     DB_misc_t misc;
 
@@ -99,6 +106,31 @@ typedef struct {
     int (*apply) (DB_playItem_t *track, uint32_t flags, float track_gain, float track_peak, float album_gain, float album_peak);
 
     int (*remove) (DB_playItem_t *track);
+
+    // added in rg_scanner-1.1
+
+    // mode: one of DDB_RG_SCAN_MODE_*, which defines how the album values are computed
+    // ref_loudness: 0 for DDB_RG_SCAN_DEFAULT_LOUDNESS
+    ddb_rg_analyzer_t *(*analyzer_alloc) (int mode, float ref_loudness);
+
+    void (*analyzer_free) (ddb_rg_analyzer_t *analyzer);
+
+    // Adds a track with the audio in the specified format, and returns its index, or -1 on error.
+    // The track is used to find its album in DDB_RG_SCAN_MODE_ALBUMS_FROM_TAGS mode.
+    int (*analyzer_add_track) (ddb_rg_analyzer_t *analyzer, DB_playItem_t *track, const ddb_waveformat_t *fmt);
+
+    // Feeds interleaved float32 samples of the track
+    void (*analyzer_add_frames) (ddb_rg_analyzer_t *analyzer, int track_index, const float *samples, int frames);
+
+    // Excludes a track which could not be fed completely, e.g. due to an error, from the album values
+    void (*analyzer_remove_track) (ddb_rg_analyzer_t *analyzer, int track_index);
+
+    // Track gain and peak, once the whole track has been fed
+    void (*analyzer_get_track_result) (ddb_rg_analyzer_t *analyzer, int track_index, ddb_rg_scanner_result_t *result);
+
+    // Results of all the added tracks, including the album values.
+    // The results buffer must have room for all the added tracks.
+    void (*analyzer_get_results) (ddb_rg_analyzer_t *analyzer, ddb_rg_scanner_result_t *results);
 } ddb_rg_scanner_t;
 
 #endif //__RG_SCANNER_H
@@ -19,7 +19,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
@@ -59,20 +65,45 @@ le_int16 (int16_t in, unsigned char *out) {
 // NOTE: we know that current SLDB is larger than that, but we want the code to go into realloc path
 #define SLDB_PREALLOC_ITEMS 50000
 #define SLDB_PREALLOC_LENGTHS SLDB_PREALLOC_ITEMS
+
+// The item layout is shared with the binary cache file, so it must have fixed size and no padding
 typedef struct {
     uint8_t digest[16];
-    size_t lengths_offset;
+    uint32_t lengths_offset;
     uint16_t subsongs;
+    uint16_t reserved;
 } sldb_item_t;
 
+// Binary cache of the parsed songlength database, stored in the cache dir.
+// Layout: header, source path (path_len bytes), sorted sldb_item_t[count], int16_t[lengths_count].
+// It's rebuilt whenever the source file path, size or mtime changes.
+#define SLDB_CACHE_MAGIC "DDBSLDB"
+#define SLDB_CACHE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t legacy;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t path_len;
+    uint32_t count;
+    uint32_t lengths_count;
+    uint32_t reserved;
+} sldb_cache_header_t;
+
 static sldb_item_t *sldb;
 static size_t sldb_allocated_size;
 static size_t sldb_count;
 
-static uint16_t *sldb_lengths;
+static int16_t *sldb_lengths;
 static size_t sldb_lengths_allocated_size;
 static size_t sldb_lengths_count;
 
+// when the cache is mapped, sldb and sldb_lengths point into this region
+static void *sldb_map;
+static size_t sldb_map_size;
+
 static int sldb_loaded;
 static int sldb_disable;
 static int sldb_legacy;
@@ -82,6 +113,139 @@ static int chip_voices_changed = 0;
 
 static int conf_hvsc_enable = 0;
 
+static int
+sldb_item_cmp (const void *a, const void *b) {
+    return memcmp (((const sldb_item_t *)a)->digest, ((const sldb_item_t *)b)->digest, 16);
+}
+
+static int
+sldb_cache_path (char *path, size_t size) {
+    const char *cache_root = deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    if (!cache_root) {
+        return -1;
+    }
+    size_t res = snprintf (path, size, "%s/sid_songlengths.cache", cache_root);
+    if (res >= size) {
+        return -1;
+    }
+    return 0;
+}
+
+// Map the binary cache, if it exists and matches the source file. Returns 0 on success.
+static int
+sldb_cache_load (const char *source, const struct stat *source_st) {
+    char path[PATH_MAX];
+    if (sldb_cache_path (path, sizeof (path)) < 0) {
+        return -1;
+    }
+    int fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat (fd, &st) < 0 || (size_t)st.st_size < sizeof (sldb_cache_header_t)) {
+        close (fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const sldb_cache_header_t *hdr = (const sldb_cache_header_t *)map;
+    size_t source_len = strlen (source);
+    if (memcmp (hdr->magic, SLDB_CACHE_MAGIC, sizeof (hdr->magic))
+        || hdr->version != SLDB_CACHE_VERSION
+        || hdr->source_size != (uint64_t)source_st->st_size
+        || hdr->source_mtime != (int64_t)source_st->st_mtime
+        || hdr->path_len != source_len) {
+        goto invalid;
+    }
+
+    {
+        size_t items_offs = (sizeof (sldb_cache_header_t) + hdr->path_len + 7) & ~(size_t)7;
+        size_t lengths_offs = items_offs + (size_t)hdr->count * sizeof (sldb_item_t);
+        if (lengths_offs + (size_t)hdr->lengths_count * sizeof (int16_t) > size) {
+            goto invalid;
+        }
+        if (memcmp ((const char *)map + sizeof (sldb_cache_header_t), source, source_len)) {
+            goto invalid;
+        }
+
+        // a damaged cache must not make the lookups read past the lengths, or break the binary search
+        const sldb_item_t *items = (const sldb_item_t *)((const char *)map + items_offs);
+        for (uint32_t i = 0; i < hdr->count; i++) {
+            if ((uint64_t)items[i].lengths_offset + items[i].subsongs > hdr->lengths_count) {
+                goto invalid;
+            }
+            if (i > 0 && sldb_item_cmp (&items[i-1], &items[i]) > 0) {
+                goto invalid;
+            }
+        }
+
+        sldb_map = map;
+        sldb_map_size = size;
+        sldb = (sldb_item_t *)((char *)map + items_offs);
+        sldb_count = hdr->count;
+        sldb_lengths = (int16_t *)((char *)map + lengths_offs);
+        sldb_lengths_count = hdr->lengths_count;
+        sldb_legacy = hdr->legacy;
+        trace ("sid: mapped songlength cache %s (%d songs)\n", path, (int)sldb_count);
+        return 0;
+    }
+
+invalid:
+    munmap (map, size);
+    return -1;
+}
+
+static void
+sldb_cache_save (const char *source, const struct stat *source_st) {
+    char path[PATH_MAX];
+    if (sldb_cache_path (path, sizeof (path)) < 0) {
+        return;
+    }
+    char tmp_path[PATH_MAX];
+    if ((size_t)snprintf (tmp_path, sizeof (tmp_path), "%s.part", path) >= sizeof (tmp_path)) {
+        return;
+    }
+
+    sldb_cache_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, SLDB_CACHE_MAGIC, sizeof (hdr.magic));
+    hdr.version = SLDB_CACHE_VERSION;
+    hdr.legacy = sldb_legacy;
+    hdr.source_size = (uint64_t)source_st->st_size;
+    hdr.source_mtime = (int64_t)source_st->st_mtime;
+    hdr.path_len = (uint32_t)strlen (source);
+    hdr.count = (uint32_t)sldb_count;
+    hdr.lengths_count = (uint32_t)sldb_lengths_count;
+
+    FILE *fp = fopen (tmp_path, "w+b");
+    if (!fp) {
+        trace ("sid: failed to create %s\n", tmp_path);
+        return;
+    }
+
+    static const char zeroes[8] = {0};
+    size_t pad = ((sizeof (hdr) + hdr.path_len + 7) & ~(size_t)7) - (sizeof (hdr) + hdr.path_len);
+    int res = fwrite (&hdr, sizeof (hdr), 1, fp) == 1
+        && fwrite (source, 1, hdr.path_len, fp) == hdr.path_len
+        && fwrite (zeroes, 1, pad, fp) == pad
+        && fwrite (sldb, sizeof (sldb_item_t), sldb_count, fp) == sldb_count
+        && fwrite (sldb_lengths, sizeof (int16_t), sldb_lengths_count, fp) == sldb_lengths_count;
+    if (fclose (fp) != 0) {
+        res = 0;
+    }
+
+    if (!res || rename (tmp_path, path) != 0) {
+        trace ("sid: failed to write songlength cache %s\n", path);
+        unlink (tmp_path);
+    }
+}
+
 static void
 sldb_load()
 {
@@ -107,6 +271,13 @@ sldb_load()
     }
 
     const char *fname = conf_hvsc_path;
+    struct stat source_st;
+    int have_source_st = stat (fname, &source_st) == 0;
+    if (have_source_st && !sldb_cache_load (fname, &source_st)) {
+        sldb_disable = 1;
+        return;
+    }
+
     FILE *fp = fopen (fname, "r");
     if (!fp) {
         trace ("sid: failed to open file %s\n", fname);
@@ -126,13 +297,14 @@ sldb_load()
     if (!sldb) {
         sldb = (sldb_item_t *)calloc (SLDB_PREALLOC_ITEMS, sizeof(sldb_item_t));
         sldb_allocated_size = SLDB_PREALLOC_ITEMS;
-        sldb_lengths = (uint16_t *)calloc (SLDB_PREALLOC_LENGTHS, sizeof (uint16_t));
+        sldb_lengths = (int16_t *)calloc (SLDB_PREALLOC_LENGTHS, sizeof (int16_t));
         sldb_lengths_allocated_size = SLDB_PREALLOC_LENGTHS;
     }
     while (fgets (str, 1024, fp) == str) {
         if (sldb_count >= sldb_allocated_size) {
             sldb_allocated_size += 10000;
             sldb = (sldb_item_t *)realloc (sldb, sldb_allocated_size * sizeof (sldb_item_t));
+            memset (sldb + sldb_count, 0, (sldb_allocated_size - sldb_count) * sizeof (sldb_item_t));
         }
         line++;
         if (str[0] == ';') {
@@ -191,7 +363,7 @@ sldb_load()
         }
 
         memcpy (sldb[sldb_count].digest, digest, 16);
-        sldb[sldb_count].lengths_offset = sldb_lengths_count;
+        sldb[sldb_count].lengths_offset = (uint32_t)sldb_lengths_count;
 
         while (*p >= ' ') {
             // read subsong lengths until eol
@@ -229,7 +401,7 @@ sldb_load()
 
             if (sldb_lengths_count >= sldb_lengths_allocated_size) {
                 sldb_lengths_allocated_size += 10000;
-                sldb_lengths = (uint16_t *)realloc (sldb_lengths, sizeof (uint16_t) * sldb_lengths_allocated_size);
+                sldb_lengths = (int16_t *)realloc (sldb_lengths, sizeof (int16_t) * sldb_lengths_allocated_size);
             }
 
             sldb_lengths[sldb_lengths_count++] = time;
@@ -259,7 +431,15 @@ sldb_load()
 fail:
     sldb_disable = 1;
     fclose (fp);
-    trace ("HVSC sldb loaded %d songs, %d subsongs total\n", sldb->sldb_size, sldb->sldb_poolmark);
+
+    // sort by digest for binary search, and store the result for the next startup
+    if (sldb_count > 0) {
+        qsort (sldb, sldb_count, sizeof (sldb_item_t), sldb_item_cmp);
+        if (have_source_st) {
+            sldb_cache_save (fname, &source_st);
+        }
+    }
+    trace ("HVSC sldb loaded %d songs, %d subsongs total\n", (int)sldb_count, (int)sldb_lengths_count);
 }
 
 static int
@@ -268,12 +448,13 @@ sldb_find (const uint8_t *digest) {
         trace ("sldb not loaded\n");
         return -1;
     }
-    for (int i = 0; i < sldb_count; i++) {
-        if (!memcmp (digest, sldb[i].digest, 16)) {
-            return i;
-        }
+    sldb_item_t key;
+    memcpy (key.digest, digest, 16);
+    const sldb_item_t *item = (const sldb_item_t *)bsearch (&key, sldb, sldb_count, sizeof (sldb_item_t), sldb_item_cmp);
+    if (!item) {
+        return -1;
     }
-    return -1;
+    return (int)(item - sldb);
 }
 
 DB_fileinfo_t *
@@ -551,7 +732,7 @@ csid_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
             float length = deadbeef->conf_get_float ("sid.defaultlength", 180);
             if (sldb_loaded && song >= 0 && s < sldb[song].subsongs) {
-                uint16_t l = sldb_lengths[sldb[song].lengths_offset+s];
+                int16_t l = sldb_lengths[sldb[song].lengths_offset+s];
                 if (l >= 0) {
                     length = l;
                 }
@@ -570,11 +751,18 @@ csid_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
 static void
 sldb_free (void) {
-    free (sldb);
+    if (sldb_map) {
+        munmap (sldb_map, sldb_map_size);
+        sldb_map = NULL;
+        sldb_map_size = 0;
+    }
+    else {
+        free (sldb);
+        free (sldb_lengths);
+    }
     sldb = NULL;
     sldb_allocated_size = 0;
     sldb_count = 0;
-    free (sldb_lengths);
     sldb_lengths = NULL;
     sldb_lengths_allocated_size = 0;
     sldb_lengths_count = 0;
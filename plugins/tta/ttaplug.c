@@ -363,5 +363,6 @@ static DB_decoder_t plugin = {
 DB_plugin_t *
 tta_load (DB_functions_t *api) {
     deadbeef = api;
+    deadbeef->plug_register_decoder_signature (&plugin, 0, "TTA1", 4);
     return DB_PLUGIN (&plugin);
 }
@@ -1,4 +1,5 @@
 #include "../../deadbeef.h"
+#include "../../shared/lengthcache.h"
 
 #include "v2/v2mplayer.h"
 #include "v2/libv2.h"
@@ -16,6 +17,9 @@ static DB_decoder_t v2m_plugin;
 
 static bool _v2m_initialized = false;
 
+// song lengths in samples, found by rendering the whole song
+static ddb_lengthcache_t *lengthcache;
+
 typedef struct {
     DB_fileinfo_t info;
     uint8_t *tune;
@@ -213,15 +217,26 @@ v2m_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, v2m_plugin.plugin.id);
     deadbeef->pl_add_meta (it, ":FILETYPE", "V2M");
 
-    V2MPlayer *player = new V2MPlayer ();
-    player->Init();
-    player->Open(conv, 44100);
-    player->Play();
+    uint8_t digest[16];
+    int64_t totalsamples;
+    if (lengthcache) {
+        ddb_lengthcache_digest_buffer (conv, convlen, digest);
+    }
+    if (!lengthcache || ddb_lengthcache_get (lengthcache, digest, 0, &totalsamples) < 0) {
+        V2MPlayer *player = new V2MPlayer ();
+        player->Init();
+        player->Open(conv, 44100);
+        player->Play();
+
+        totalsamples = get_total_samples(player);
 
-    int totalsamples = get_total_samples(player);
+        player->Close();
+        delete player;
 
-    player->Close();
-    delete player;
+        if (lengthcache) {
+            ddb_lengthcache_set (lengthcache, digest, 0, totalsamples);
+        }
+    }
     free (conv);
 
     deadbeef->plt_set_item_duration (plt, it, totalsamples / 44100.f);
@@ -231,11 +246,21 @@ v2m_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     return after;
 }
 
+static int
+v2m_plugin_start (void) {
+    lengthcache = ddb_lengthcache_open ("v2m_lengths");
+    return 0;
+}
+
 static int
 v2m_plugin_stop (void) {
     if (_v2m_initialized) {
         sdClose ();
     }
+    if (lengthcache) {
+        ddb_lengthcache_close (lengthcache);
+        lengthcache = NULL;
+    }
 
     return 0;
 }
@@ -291,6 +316,7 @@ v2m_load (DB_functions_t *api) {
     v2m_plugin.seek_sample = v2m_seek_sample;
     v2m_plugin.insert = v2m_insert;
     v2m_plugin.exts = exts;
+    v2m_plugin.plugin.start = v2m_plugin_start;
     v2m_plugin.plugin.stop = v2m_plugin_stop;
 
     return DB_PLUGIN (&v2m_plugin);
@@ -23,39 +23,91 @@
 
 #include <string.h>
 #include <zip.h>
+#include <zlib.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/stat.h>
 #include "../../deadbeef.h"
 
 //#define trace(...) { fprintf(stderr, __VA_ARGS__); }
 #define trace(fmt,...)
 
-#define ENABLE_CACHE 1
-
 #define min(x,y) ((x)<(y)?(x):(y))
+#define max(x,y) ((x)>(y)?(x):(y))
 
 static DB_functions_t *deadbeef;
 static DB_vfs_t plugin;
 
-#if ENABLE_CACHE
 #define ZIP_BUFFER_SIZE 8192
-#endif
+#define ZIP_INPUT_BUFFER_SIZE 16384
+
+// deflated entries get a copy of the inflate state every CHECKPOINT_INTERVAL bytes of output,
+// the interval is increased for large entries to keep the number of checkpoints under MAX_CHECKPOINTS
+#define CHECKPOINT_INTERVAL (256*1024)
+#define MAX_CHECKPOINTS 64
+
+// number of unused archives kept open, with their checkpoints
+#define MAX_IDLE_ARCHIVES 4
+
+typedef enum {
+    ZIP_MODE_GENERIC, // decompressed by libzip, seeking restarts from the beginning
+    ZIP_MODE_STORED, // uncompressed, seeking in the raw data
+    ZIP_MODE_DEFLATED, // raw data is inflated here, seeking resumes from the checkpoints
+} zip_mode_t;
+
+typedef struct {
+    int64_t offset; // uncompressed
+    int64_t comp_offset; // compressed
+    z_stream *stream; // copy of the inflate state, must not be moved in memory
+} checkpoint_t;
+
+typedef struct entry_index_s {
+    zip_uint64_t index;
+    int64_t interval;
+    checkpoint_t *checkpoints; // sorted by offset
+    int count;
+    int size;
+    struct entry_index_s *next;
+} entry_index_t;
+
+// Open archive, shared by all files from it.
+// libzip archives are not thread safe, so all libzip calls go through the archive mutex.
+typedef struct archive_s {
+    char *path;
+    time_t mtime;
+    off_t size;
+    struct zip *z;
+    uintptr_t mutex;
+    int refcount;
+    int stale; // the file has changed, the archive must not be reused
+    entry_index_t *entries;
+    struct archive_s *next;
+} archive_t;
 
 typedef struct {
     DB_FILE file;
-    struct zip* z;
+    archive_t *archive;
+    entry_index_t *entry;
     struct zip_file *zf;
-    int64_t offset;
     zip_uint64_t index;
     int64_t size;
+    zip_mode_t mode;
+
+    int64_t offset; // read position
+    int64_t raw_offset; // position in zf
+
+    z_stream stream;
+    int64_t next_checkpoint;
+    uint8_t input[ZIP_INPUT_BUFFER_SIZE];
 
-#if ENABLE_CACHE
     uint8_t buffer[ZIP_BUFFER_SIZE];
     zip_int64_t buffer_remaining;
     int buffer_pos;
-#endif
 } ddb_zip_file_t;
 
+static archive_t *_archives; // most recently used first
+static uintptr_t _archives_mutex;
+
 static const char *scheme_names[] = { "zip://", NULL };
 
 const char **
@@ -68,6 +120,315 @@ vfs_zip_is_streaming (void) {
     return 0;
 }
 
+static void
+_entry_index_free (entry_index_t *e) {
+    for (int i = 0; i < e->count; i++) {
+        inflateEnd (e->checkpoints[i].stream);
+        free (e->checkpoints[i].stream);
+    }
+    free (e->checkpoints);
+    free (e);
+}
+
+static void
+_archive_free (archive_t *a) {
+    while (a->entries) {
+        entry_index_t *next = a->entries->next;
+        _entry_index_free (a->entries);
+        a->entries = next;
+    }
+    zip_close (a->z);
+    deadbeef->mutex_free (a->mutex);
+    free (a->path);
+    free (a);
+}
+
+// Closes the archives which are no longer needed, _archives_mutex must be locked
+static void
+_archives_trim (void) {
+    int idle = 0;
+    archive_t *prev = NULL;
+    for (archive_t *a = _archives; a;) {
+        archive_t *next = a->next;
+        if (a->refcount == 0 && (a->stale || ++idle > MAX_IDLE_ARCHIVES)) {
+            if (prev) {
+                prev->next = next;
+            }
+            else {
+                _archives = next;
+            }
+            _archive_free (a);
+        }
+        else {
+            prev = a;
+        }
+        a = next;
+    }
+}
+
+static archive_t *
+_archive_open (const char *path) {
+    struct stat st;
+    if (stat (path, &st) != 0 || !S_ISREG (st.st_mode)) {
+        return NULL;
+    }
+
+    deadbeef->mutex_lock (_archives_mutex);
+    archive_t *prev = NULL;
+    for (archive_t *a = _archives; a; prev = a, a = a->next) {
+        if (a->stale || strcmp (a->path, path)) {
+            continue;
+        }
+        if (a->mtime != st.st_mtime || a->size != st.st_size) {
+            a->stale = 1;
+            continue;
+        }
+        a->refcount++;
+        if (prev) {
+            prev->next = a->next;
+            a->next = _archives;
+            _archives = a;
+        }
+        deadbeef->mutex_unlock (_archives_mutex);
+        return a;
+    }
+    _archives_trim ();
+    deadbeef->mutex_unlock (_archives_mutex);
+
+    struct zip *z = zip_open (path, 0, NULL);
+    if (!z) {
+        return NULL;
+    }
+
+    archive_t *a = calloc (1, sizeof (archive_t));
+    a->path = strdup (path);
+    a->mtime = st.st_mtime;
+    a->size = st.st_size;
+    a->z = z;
+    a->mutex = deadbeef->mutex_create ();
+    a->refcount = 1;
+
+    deadbeef->mutex_lock (_archives_mutex);
+    a->next = _archives;
+    _archives = a;
+    deadbeef->mutex_unlock (_archives_mutex);
+    return a;
+}
+
+static void
+_archive_release (archive_t *a) {
+    deadbeef->mutex_lock (_archives_mutex);
+    a->refcount--;
+    _archives_trim ();
+    deadbeef->mutex_unlock (_archives_mutex);
+}
+
+// archive mutex must be locked
+static entry_index_t *
+_archive_get_entry (archive_t *a, zip_uint64_t index, int64_t size) {
+    for (entry_index_t *e = a->entries; e; e = e->next) {
+        if (e->index == index) {
+            return e;
+        }
+    }
+    entry_index_t *e = calloc (1, sizeof (entry_index_t));
+    e->index = index;
+    e->interval = max (CHECKPOINT_INTERVAL, size / MAX_CHECKPOINTS);
+    e->next = a->entries;
+    a->entries = e;
+    return e;
+}
+
+static int
+_open_entry (ddb_zip_file_t *f) {
+    zip_uint32_t flags = f->mode == ZIP_MODE_GENERIC ? 0 : ZIP_FL_COMPRESSED;
+    deadbeef->mutex_lock (f->archive->mutex);
+    if (f->zf) {
+        zip_fclose (f->zf);
+    }
+    f->zf = zip_fopen_index (f->archive->z, f->index, flags);
+    deadbeef->mutex_unlock (f->archive->mutex);
+    f->raw_offset = 0;
+    return f->zf ? 0 : -1;
+}
+
+static zip_int64_t
+_raw_read (ddb_zip_file_t *f, void *ptr, size_t size) {
+    deadbeef->mutex_lock (f->archive->mutex);
+    zip_int64_t rb = zip_fread (f->zf, ptr, size);
+    deadbeef->mutex_unlock (f->archive->mutex);
+    if (rb > 0) {
+        f->raw_offset += rb;
+    }
+    return rb;
+}
+
+// Positions zf at the offset, directly if libzip can seek in it, or by reading
+static int
+_raw_seek (ddb_zip_file_t *f, int64_t offset) {
+    if (offset == f->raw_offset) {
+        return 0;
+    }
+    if (f->mode != ZIP_MODE_GENERIC) {
+        deadbeef->mutex_lock (f->archive->mutex);
+        int res = zip_fseek (f->zf, offset, SEEK_SET);
+        deadbeef->mutex_unlock (f->archive->mutex);
+        if (res == 0) {
+            f->raw_offset = offset;
+            return 0;
+        }
+    }
+    if (offset < f->raw_offset && _open_entry (f) < 0) {
+        return -1;
+    }
+    while (f->raw_offset < offset) {
+        zip_int64_t rb = _raw_read (f, f->input, min (offset - f->raw_offset, sizeof (f->input)));
+        if (rb <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void
+_add_checkpoint (ddb_zip_file_t *f) {
+    int64_t out = (int64_t)f->stream.total_out;
+    if (out < f->next_checkpoint) {
+        return;
+    }
+
+    archive_t *a = f->archive;
+    entry_index_t *e = f->entry;
+    deadbeef->mutex_lock (a->mutex);
+    int64_t last = e->count ? e->checkpoints[e->count-1].offset : 0;
+    if (out >= last + e->interval) {
+        z_stream *copy = calloc (1, sizeof (z_stream));
+        if (inflateCopy (copy, &f->stream) == Z_OK) {
+            if (e->count == e->size) {
+                e->size = e->size ? e->size * 2 : 16;
+                e->checkpoints = realloc (e->checkpoints, e->size * sizeof (checkpoint_t));
+            }
+            checkpoint_t *cp = &e->checkpoints[e->count++];
+            cp->offset = out;
+            cp->comp_offset = (int64_t)f->stream.total_in;
+            cp->stream = copy;
+            last = out;
+            trace ("vfs_zip: checkpoint %d at %lld\n", e->count, (long long)out);
+        }
+        else {
+            free (copy);
+        }
+    }
+    f->next_checkpoint = last + e->interval;
+    deadbeef->mutex_unlock (a->mutex);
+}
+
+static zip_int64_t
+_inflate_read (ddb_zip_file_t *f, uint8_t *ptr, size_t size) {
+    f->stream.next_out = ptr;
+    f->stream.avail_out = (uInt)size;
+    while (f->stream.avail_out > 0) {
+        if (f->stream.avail_in == 0) {
+            zip_int64_t rb = _raw_read (f, f->input, sizeof (f->input));
+            if (rb <= 0) {
+                break;
+            }
+            f->stream.next_in = f->input;
+            f->stream.avail_in = (uInt)rb;
+        }
+        int ret = inflate (&f->stream, Z_NO_FLUSH);
+        if (ret != Z_OK) {
+            break; // Z_STREAM_END or an error
+        }
+        _add_checkpoint (f);
+    }
+    return (zip_int64_t)(size - f->stream.avail_out);
+}
+
+// Reads uncompressed data from the current stream position
+static zip_int64_t
+_read_data (ddb_zip_file_t *f, void *ptr, size_t size) {
+    if (f->mode == ZIP_MODE_DEFLATED) {
+        return _inflate_read (f, ptr, size);
+    }
+    return _raw_read (f, ptr, size);
+}
+
+// Reads and drops the data, the buffer must be empty
+static int
+_skip (ddb_zip_file_t *f, int64_t n) {
+    while (n > 0) {
+        zip_int64_t rb = _read_data (f, f->buffer, min (n, ZIP_BUFFER_SIZE));
+        if (rb <= 0) {
+            return -1;
+        }
+        n -= rb;
+        f->offset += rb;
+    }
+    return 0;
+}
+
+// Moves the stream to the offset, the buffer must be empty
+static int
+_seek_data (ddb_zip_file_t *f, int64_t offset) {
+    if (f->mode == ZIP_MODE_STORED) {
+        if (_raw_seek (f, offset) < 0) {
+            return -1;
+        }
+        f->offset = offset;
+        return 0;
+    }
+
+    if (f->mode == ZIP_MODE_GENERIC) {
+        if (offset < f->offset) {
+            if (_open_entry (f) < 0) {
+                return -1;
+            }
+            f->offset = 0;
+        }
+        return _skip (f, offset - f->offset);
+    }
+
+    // resume from the nearest checkpoint, unless the current position is closer
+    archive_t *a = f->archive;
+    int64_t comp_offset = -1;
+    deadbeef->mutex_lock (a->mutex);
+    entry_index_t *e = f->entry;
+    for (int i = e->count - 1; i >= 0; i--) {
+        checkpoint_t *cp = &e->checkpoints[i];
+        if (cp->offset > offset) {
+            continue;
+        }
+        if (f->offset <= offset && f->offset >= cp->offset) {
+            break;
+        }
+        inflateEnd (&f->stream);
+        if (inflateCopy (&f->stream, cp->stream) != Z_OK) {
+            deadbeef->mutex_unlock (a->mutex);
+            return -1;
+        }
+        f->offset = cp->offset;
+        comp_offset = cp->comp_offset;
+        break;
+    }
+    deadbeef->mutex_unlock (a->mutex);
+
+    if (comp_offset < 0 && offset < f->offset) {
+        // restart from the beginning
+        inflateReset (&f->stream);
+        f->offset = 0;
+        comp_offset = 0;
+    }
+    if (comp_offset >= 0) {
+        f->stream.next_in = NULL;
+        f->stream.avail_in = 0;
+        if (_raw_seek (f, comp_offset) < 0) {
+            return -1;
+        }
+    }
+    return _skip (f, offset - f->offset);
+}
+
 // fname must have form of zip://full_filepath.zip:full_filepath_in_zip
 DB_FILE*
 vfs_zip_open (const char *fname) {
@@ -78,7 +439,7 @@ vfs_zip_open (const char *fname) {
 
     fname += 6;
 
-    struct zip *z = NULL;
+    archive_t *archive = NULL;
     struct zip_stat st;
 
     const char *colon = fname;
@@ -95,8 +456,8 @@ vfs_zip_open (const char *fname) {
 
         colon = colon+1;
 
-        z = zip_open (zipname, 0, NULL);
-        if (!z) {
+        archive = _archive_open (zipname);
+        if (!archive) {
             continue;
         }
         memset (&st, 0, sizeof (st));
@@ -104,32 +465,51 @@ vfs_zip_open (const char *fname) {
         while (*colon == '/') {
             colon++;
         }
-        int res = zip_stat(z, colon, 0, &st);
+        deadbeef->mutex_lock (archive->mutex);
+        int res = zip_stat(archive->z, colon, 0, &st);
+        deadbeef->mutex_unlock (archive->mutex);
         if (res != 0) {
-            zip_close (z);
+            _archive_release (archive);
             return NULL;
         }
 
         break;
     }
 
-    if (!z) {
-        return NULL;
-    }
-
-    struct zip_file *zf = zip_fopen_index (z, st.index, 0);
-    if (!zf) {
-        zip_close (z);
+    if (!archive) {
         return NULL;
     }
 
     ddb_zip_file_t *f = malloc (sizeof (ddb_zip_file_t));
     memset (f, 0, sizeof (ddb_zip_file_t));
     f->file.vfs = &plugin;
-    f->z = z;
-    f->zf = zf;
+    f->archive = archive;
     f->index = st.index;
     f->size = st.size;
+
+    f->mode = ZIP_MODE_GENERIC;
+    int encrypted = (st.valid & ZIP_STAT_ENCRYPTION_METHOD) && st.encryption_method != ZIP_EM_NONE;
+    if ((st.valid & ZIP_STAT_COMP_METHOD) && !encrypted) {
+        if (st.comp_method == ZIP_CM_STORE) {
+            f->mode = ZIP_MODE_STORED;
+        }
+        else if (st.comp_method == ZIP_CM_DEFLATE && inflateInit2 (&f->stream, -MAX_WBITS) == Z_OK) {
+            f->mode = ZIP_MODE_DEFLATED;
+            deadbeef->mutex_lock (archive->mutex);
+            f->entry = _archive_get_entry (archive, f->index, f->size);
+            deadbeef->mutex_unlock (archive->mutex);
+            f->next_checkpoint = f->entry->interval;
+        }
+    }
+
+    if (_open_entry (f) < 0) {
+        if (f->mode == ZIP_MODE_DEFLATED) {
+            inflateEnd (&f->stream);
+        }
+        _archive_release (archive);
+        free (f);
+        return NULL;
+    }
     trace ("vfs_zip: end open %s\n", fname);
     return (DB_FILE*)f;
 }
@@ -139,11 +519,14 @@ vfs_zip_close (DB_FILE *f) {
     trace ("vfs_zip: close\n");
     ddb_zip_file_t *zf = (ddb_zip_file_t *)f;
     if (zf->zf) {
+        deadbeef->mutex_lock (zf->archive->mutex);
         zip_fclose (zf->zf);
+        deadbeef->mutex_unlock (zf->archive->mutex);
     }
-    if (zf->z) {
-        zip_close (zf->z);
+    if (zf->mode == ZIP_MODE_DEFLATED) {
+        inflateEnd (&zf->stream);
     }
+    _archive_release (zf->archive);
     free (zf);
 }
 
@@ -153,11 +536,10 @@ vfs_zip_read (void *ptr, size_t size, size_t nmemb, DB_FILE *f) {
 //    printf ("read: %d\n", size*nmemb);
 
     size_t sz = size * nmemb;
-#if ENABLE_CACHE
     while (sz) {
         if (zf->buffer_remaining == 0) {
             zf->buffer_pos = 0;
-            zip_int64_t rb = zip_fread (zf->zf, zf->buffer, ZIP_BUFFER_SIZE);
+            zip_int64_t rb = _read_data (zf, zf->buffer, ZIP_BUFFER_SIZE);
             if (rb <= 0) {
                 break;
             }
@@ -171,11 +553,6 @@ vfs_zip_read (void *ptr, size_t size, size_t nmemb, DB_FILE *f) {
         sz -= from_buf;
         ptr += from_buf;
     }
-#else
-    rb = zip_fread (zf->zf, ptr, sz);
-    sz -= rb;
-    zf->offset += rb;
-#endif
 
     return (size * nmemb - sz) / size;
 }
@@ -192,67 +569,30 @@ vfs_zip_seek (DB_FILE *f, int64_t offset, int whence) {
         offset = zf->size + offset;
     }
 
-#if ENABLE_CACHE
+    if (offset < 0 || offset > zf->size) {
+        return -1;
+    }
+
     int64_t offs = offset - zf->offset;
     if ((offs < 0 && -offs <= zf->buffer_pos) || (offs >= 0 && offs < zf->buffer_remaining)) {
-        if (offs != 0) {
-            //printf ("cache success\n");
-
-            //printf ("[before] absoffs: %lld, offs: %lld, rem: %d, pos: %d\n", offset, offs, zf->buffer_remaining, zf->buffer_pos);
-
-            // test cases:
-            // fail: offs = -3, pos = 0, rem = 100
-            // fail: offs = 10, pos = 95, rem = 5
-            // succ: offs = -3, pos = 3, rem = 97 ----> pos = 0, rem=100
-            // succ: offs = 10, pos = 0, rem = 100 ---> pos = 10, rem = 90
-
-            zf->buffer_pos += offs;
-            zf->buffer_remaining -= offs;
-            //printf ("[after] offs: %lld, rem: %d, pos: %d\n", offs, zf->buffer_remaining, zf->buffer_pos);
-            zf->offset = offset;
-            assert (zf->buffer_pos < ZIP_BUFFER_SIZE);
-            return 0;
-        }
-        else {
-//            printf ("cache double success\n");
-            return 0;
-        }
+        // test cases:
+        // fail: offs = -3, pos = 0, rem = 100
+        // fail: offs = 10, pos = 95, rem = 5
+        // succ: offs = -3, pos = 3, rem = 97 ----> pos = 0, rem=100
+        // succ: offs = 10, pos = 0, rem = 100 ---> pos = 10, rem = 90
+        zf->buffer_pos += offs;
+        zf->buffer_remaining -= offs;
+        zf->offset = offset;
+        assert (zf->buffer_pos < ZIP_BUFFER_SIZE);
+        return 0;
     }
-//    else {
-//        printf ("cache miss: abs_offs: %lld, offs: %lld, rem: %d, pos: %d\n", offset, offs, zf->buffer_remaining, zf->buffer_pos);
-//    }
 
+    // drop the buffer, the stream is positioned after it
     zf->offset += zf->buffer_remaining;
-#endif
-    if (offset < zf->offset) {
-        // reopen
-        zip_fclose (zf->zf);
-        zf->zf = zip_fopen_index (zf->z, zf->index, 0);
-        if (!zf->zf) {
-            return -1;
-        }
-        zf->offset = 0;
-    }
-#if ENABLE_CACHE
     zf->buffer_pos = 0;
     zf->buffer_remaining = 0;
-#endif
-    char buf[4096];
-    int64_t n = offset - zf->offset;
-    while (n > 0) {
-        int64_t sz = min (n, sizeof (buf));
-        ssize_t rb = zip_fread (zf->zf, buf, sz);
-        n -= rb;
-        assert (n >= 0);
-        zf->offset += rb;
-        if (rb != sz) {
-            break;
-        }
-    }
-    if (n > 0) {
-        return -1;
-    }
-    return 0;
+
+    return _seek_data (zf, offset);
 }
 
 int64_t
@@ -263,14 +603,7 @@ vfs_zip_tell (DB_FILE *f) {
 
 void
 vfs_zip_rewind (DB_FILE *f) {
-    ddb_zip_file_t *zf = (ddb_zip_file_t *)f;
-    zip_fclose (zf->zf);
-    zf->zf = zip_fopen_index (zf->z, zf->index, 0);
-    assert (zf->zf); // FIXME: better error handling?
-    zf->offset = 0;
-#if ENABLE_CACHE
-    zf->buffer_remaining = 0;
-#endif
+    vfs_zip_seek (f, 0, SEEK_SET);
 }
 
 int64_t
@@ -323,10 +656,29 @@ vfs_zip_get_scheme_for_name (const char *fname) {
     return scheme_names[0];
 }
 
+static int
+vfs_zip_start (void) {
+    _archives_mutex = deadbeef->mutex_create ();
+    return 0;
+}
+
+static int
+vfs_zip_stop (void) {
+    deadbeef->mutex_lock (_archives_mutex);
+    for (archive_t *a = _archives; a; a = a->next) {
+        a->stale = 1;
+    }
+    _archives_trim ();
+    deadbeef->mutex_unlock (_archives_mutex);
+    deadbeef->mutex_free (_archives_mutex);
+    _archives_mutex = 0;
+    return 0;
+}
+
 static DB_vfs_t plugin = {
     DDB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 1,
     .plugin.type = DB_PLUGIN_VFS,
     .plugin.id = "vfs_zip",
     .plugin.name = "ZIP vfs",
@@ -354,6 +706,8 @@ static DB_vfs_t plugin = {
         "3. This notice may not be removed or altered from any source distribution.\n"
     ,
     .plugin.website = "http://deadbeef.sf.net",
+    .plugin.start = vfs_zip_start,
+    .plugin.stop = vfs_zip_stop,
     .open = vfs_zip_open,
     .close = vfs_zip_close,
     .read = vfs_zip_read,
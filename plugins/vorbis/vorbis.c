@@ -119,14 +119,8 @@ replaygain_tag(DB_playItem_t *it, const int tag_enum, const char *tag, const cha
     return true;
 }
 
-static int
-update_vorbis_comments (DB_playItem_t *it, OggVorbis_File *vorbis_file, const int tracknum) {
-    const vorbis_comment *vc = ov_comment(vorbis_file, tracknum);
-    if (!vc) {
-        trace("update_vorbis_comments: ov_comment failed\n");
-        return -1;
-    }
-
+static void
+set_vorbis_comments (DB_playItem_t *it, const vorbis_comment *vc) {
     deadbeef->pl_delete_all_meta (it);
     for (int i = 0; i < vc->comments; i++) {
         char *tag = strdup(vc->user_comments[i]);
@@ -162,7 +156,17 @@ update_vorbis_comments (DB_playItem_t *it, OggVorbis_File *vorbis_file, const in
         deadbeef->plt_unref (plt);
     }
     deadbeef->sendmessage (DB_EV_PLAYLISTCHANGED, 0, DDB_PLAYLIST_CHANGE_CONTENT, 0);
+}
+
+static int
+update_vorbis_comments (DB_playItem_t *it, OggVorbis_File *vorbis_file, const int tracknum) {
+    const vorbis_comment *vc = ov_comment(vorbis_file, tracknum);
+    if (!vc) {
+        trace("update_vorbis_comments: ov_comment failed\n");
+        return -1;
+    }
 
+    set_vorbis_comments (it, vc);
     return 0;
 }
 
@@ -564,6 +568,191 @@ static off_t sample_offset(OggVorbis_File *vorbis_file, const ogg_int64_t sample
     return ov_raw_tell(vorbis_file);
 }
 
+#if !TREMOR
+#define PROBE_CHUNK_SIZE 4096
+#define PROBE_TAIL_SIZE 65536
+
+typedef struct {
+    vorbis_info vi;
+    vorbis_comment vc;
+    int64_t totalsamples;
+    int64_t data_offset; // offset of the first audio page
+} cvorbis_probe_t;
+
+// Returns the file offset of the next page, or -1 at the end of the file.
+// *offset tracks the file position of the data consumed by the sync state.
+static int64_t
+probe_get_page (DB_FILE *fp, ogg_sync_state *oy, ogg_page *og, int64_t *offset) {
+    for (;;) {
+        long res = ogg_sync_pageseek (oy, og);
+        if (res > 0) {
+            int64_t page_offset = *offset;
+            *offset += res;
+            return page_offset;
+        }
+        else if (res < 0) {
+            *offset -= res;
+            continue;
+        }
+        char *buffer = ogg_sync_buffer (oy, PROBE_CHUNK_SIZE);
+        size_t bytes = deadbeef->fread (buffer, 1, PROBE_CHUNK_SIZE, fp);
+        if (!buffer || !bytes) {
+            return -1;
+        }
+        ogg_sync_wrote (oy, bytes);
+    }
+}
+
+// Returns the granule position of the last page of the stream, or -1 on failure.
+// Reads larger windows at the end of the file until a page of the stream is found.
+static int64_t
+probe_last_granulepos (DB_FILE *fp, int64_t fsize, int64_t data_offset, long serialno) {
+    int64_t window = PROBE_TAIL_SIZE;
+    for (;;) {
+        int64_t start = max (data_offset, fsize - window);
+        if (deadbeef->fseek (fp, start, SEEK_SET)) {
+            return -1;
+        }
+        ogg_sync_state oy;
+        ogg_sync_init (&oy);
+        ogg_page og;
+        int64_t offset = start;
+        int64_t granulepos = -1;
+        while (probe_get_page (fp, &oy, &og, &offset) >= 0) {
+            if (ogg_page_serialno (&og) != serialno || ogg_page_bos (&og)) {
+                // chained or multiplexed stream
+                ogg_sync_clear (&oy);
+                return -1;
+            }
+            if (ogg_page_granulepos (&og) >= 0) {
+                granulepos = ogg_page_granulepos (&og);
+            }
+        }
+        ogg_sync_clear (&oy);
+        if (granulepos >= 0 || start == data_offset) {
+            return granulepos;
+        }
+        window *= 4;
+    }
+}
+
+static void
+cvorbis_probe_free (cvorbis_probe_t *probe) {
+    vorbis_comment_clear (&probe->vc);
+    vorbis_info_clear (&probe->vi);
+}
+
+// A lightweight replacement for ov_open on insert:
+// reads the headers in one forward pass from the beginning of the file,
+// and takes the duration from the granule position of the last page,
+// instead of bisecting the whole file in search of the chained stream links.
+// Returns -1 if the file needs to be opened with vorbisfile, e.g. when it's chained or multiplexed.
+static int
+cvorbis_probe (DB_FILE *fp, int64_t fsize, cvorbis_probe_t *probe) {
+    memset (probe, 0, sizeof (cvorbis_probe_t));
+    vorbis_info_init (&probe->vi);
+    vorbis_comment_init (&probe->vc);
+
+    ogg_sync_state oy;
+    ogg_stream_state os;
+    ogg_page og;
+    ogg_packet op;
+    ogg_sync_init (&oy);
+    int stream_init = 0;
+
+    int64_t offset = 0;
+    int64_t page_offset;
+    int headers = 0;
+    long lastblock = -1;
+    int64_t accumulated = 0;
+    int64_t pcmoffset = -1;
+    probe->data_offset = -1;
+
+    while (pcmoffset < 0 && (page_offset = probe_get_page (fp, &oy, &og, &offset)) >= 0) {
+        if (!stream_init) {
+            if (!ogg_page_bos (&og) || ogg_stream_init (&os, ogg_page_serialno (&og))) {
+                goto error;
+            }
+            stream_init = 1;
+        }
+        else if (ogg_page_bos (&og) || ogg_page_serialno (&og) != os.serialno) {
+            // multiplexed stream
+            goto error;
+        }
+        if (ogg_stream_pagein (&os, &og)) {
+            goto error;
+        }
+        if (headers == 3 && probe->data_offset < 0) {
+            probe->data_offset = page_offset;
+        }
+
+        int res;
+        while ((res = ogg_stream_packetout (&os, &op)) != 0) {
+            if (res < 0) {
+                if (headers < 3) {
+                    goto error;
+                }
+                continue; // hole in the data
+            }
+            if (headers < 3) {
+                if (vorbis_synthesis_headerin (&probe->vi, &probe->vc, &op)) {
+                    goto error;
+                }
+                headers++;
+                continue;
+            }
+            long thisblock = vorbis_packet_blocksize (&probe->vi, &op);
+            if (thisblock >= 0) {
+                if (lastblock != -1) {
+                    accumulated += (lastblock + thisblock) >> 2;
+                }
+                lastblock = thisblock;
+            }
+        }
+
+        // same as vorbisfile: the pcm offset of the last packet on the first audio page
+        if (headers == 3 && probe->data_offset >= 0 && ogg_page_granulepos (&og) >= 0) {
+            pcmoffset = max (0, ogg_page_granulepos (&og) - accumulated);
+        }
+    }
+
+    if (pcmoffset < 0 || probe->vi.rate <= 0) {
+        goto error;
+    }
+
+    int64_t granulepos = probe_last_granulepos (fp, fsize, probe->data_offset, os.serialno);
+    if (granulepos <= pcmoffset) {
+        goto error;
+    }
+    probe->totalsamples = granulepos - pcmoffset;
+
+    ogg_stream_clear (&os);
+    ogg_sync_clear (&oy);
+    return 0;
+
+error:
+    if (stream_init) {
+        ogg_stream_clear (&os);
+    }
+    ogg_sync_clear (&oy);
+    cvorbis_probe_free (probe);
+    return -1;
+}
+#endif
+
+static void
+set_stream_info (DB_playItem_t *it, int64_t fsize, off_t stream_size, int64_t totalsamples, int samplerate, int channels) {
+    if (stream_size > 0) {
+        set_meta_ll(it, ":STREAM SIZE", stream_size);
+        deadbeef->pl_set_meta_int(it, ":BITRATE", 8.f * samplerate * stream_size / totalsamples / 1000);
+    }
+    set_meta_ll (it, ":FILE_SIZE", fsize);
+//        deadbeef->pl_add_meta (it, ":BPS", "32");
+    deadbeef->pl_set_meta_int (it, ":CHANNELS", channels);
+    deadbeef->pl_set_meta_int (it, ":SAMPLERATE", samplerate);
+//        deadbeef->pl_set_meta_int (it, ":BITRATE", ov_bitrate (&vorbis_file, stream)/1000);
+}
+
 static DB_playItem_t *
 cvorbis_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     DB_FILE *fp = deadbeef->fopen (fname);
@@ -581,6 +770,33 @@ cvorbis_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         deadbeef->fclose (fp);
         return after;
     }
+#if !TREMOR
+    cvorbis_probe_t probe;
+    if (!cvorbis_probe (fp, fsize, &probe)) {
+        deadbeef->fclose (fp);
+        int samplerate = (int)probe.vi.rate;
+        DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.plugin.id);
+        deadbeef->pl_set_meta_int (it, ":TRACKNUM", 0);
+        deadbeef->plt_set_item_duration (plt, it, (float)probe.totalsamples / samplerate);
+        set_vorbis_comments (it, &probe.vc);
+        deadbeef->pl_replace_meta (it, ":FILETYPE", "Ogg Vorbis");
+        set_stream_info (it, fsize, fsize - probe.data_offset, probe.totalsamples, samplerate, probe.vi.channels);
+        int64_t totalsamples = probe.totalsamples;
+        cvorbis_probe_free (&probe);
+
+        DB_playItem_t *cue = deadbeef->plt_process_cue (plt, after, it,  totalsamples, samplerate);
+        if (cue) {
+            deadbeef->pl_item_unref (it);
+            return cue;
+        }
+        after = deadbeef->plt_insert_item (plt, after, it);
+        deadbeef->pl_item_unref (it);
+        return after;
+    }
+    trace ("vorbis: probe failed, opening %s with vorbisfile\n", fname);
+    deadbeef->rewind (fp);
+#endif
+
     ov_callbacks ovcb = {
         .read_func = cvorbis_fread,
         .seek_func = cvorbis_fseek,
@@ -635,15 +851,7 @@ cvorbis_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
             deadbeef->pl_replace_meta(it, ":FILETYPE", filetype);
             free(filetype);
         }
-        if (stream_size > 0) {
-            set_meta_ll(it, ":STREAM SIZE", stream_size);
-            deadbeef->pl_set_meta_int(it, ":BITRATE", 8.f * samplerate * stream_size / totalsamples / 1000);
-        }
-        set_meta_ll (it, ":FILE_SIZE", fsize);
-//        deadbeef->pl_add_meta (it, ":BPS", "32");
-        deadbeef->pl_set_meta_int (it, ":CHANNELS", vi->channels);
-        deadbeef->pl_set_meta_int (it, ":SAMPLERATE", samplerate);
-//        deadbeef->pl_set_meta_int (it, ":BITRATE", ov_bitrate (&vorbis_file, stream)/1000);
+        set_stream_info (it, fsize, stream_size, totalsamples, samplerate, vi->channels);
 
         if (nstreams == 1) {
             DB_playItem_t *cue = deadbeef->plt_process_cue (plt, after, it,  totalsamples, samplerate);
@@ -835,6 +1043,7 @@ static DB_decoder_t plugin = {
     .plugin.version_major = 1,
     .plugin.version_minor = 0,
     .plugin.type = DB_PLUGIN_DECODER,
+    .plugin.flags = DDB_PLUGIN_FLAG_CONCURRENT_INSERT,
     .plugin.id = "stdogg",
     .plugin.name = "Ogg Vorbis decoder",
     .plugin.descr = "Ogg Vorbis decoder using standard xiph.org libraries",
@@ -126,6 +126,7 @@ project "libwin"
     "shared/windows/fopen.c",
     "shared/windows/mingw32_layer.h",
     "shared/windows/mkdir.c",
+    "shared/windows/mmap.c",
     "shared/windows/rmdir.c",
     "shared/windows/rename.c",
     "shared/windows/scandir.c",
@@ -266,6 +267,7 @@ project "adplug_plugin"
   files {
     "plugins/adplug/plugin.c",
     "plugins/adplug/adplug-db.cpp",
+    "shared/lengthcache.c",
     "plugins/adplug/libbinio/*.c",
     "plugins/adplug/libbinio/*.cpp",
     "plugins/adplug/adplug/*.c",
@@ -341,6 +343,7 @@ project "dumb_plugin"
     "plugins/dumb/unrealfmt.cpp",
     "plugins/dumb/unrealfmtdata.cpp",
     "plugins/dumb/cdumb.c",
+    "shared/lengthcache.c",
     "plugins/dumb/dumb-kode54/src/helpers/resampler_sse2.c"
   }
   includedirs {
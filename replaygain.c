@@ -33,6 +33,7 @@
 #include "common.h"
 #include "playmodes.h"
 #include "plmeta.h"
+#include "dspkernels.h"
 
 static ddb_replaygain_settings_t current_settings;
 
@@ -293,16 +294,5 @@ apply_replay_gain_float32 (ddb_replaygain_settings_t *settings, char *bytes, int
         return;
     }
 
-    float *s = (float*)bytes;
-    for (int j = 0; j < size/4; j++) {
-        float sample = ((float)*s) * vol;
-        if (sample > 1.f) {
-            sample = 1.f;
-        }
-        else if (sample < -1.f) {
-            sample = -1.f;
-        }
-        *s = sample;
-        s++;
-    }
+    dsp_kernel_scale_clamp_float ((float *)bytes, size/4, vol);
 }
@@ -0,0 +1,331 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "plmeta.h"
+#include "searchindex.h"
+#include "utf8.h"
+
+#define MIN_TABLE_SIZE 1024
+
+// list of items containing a trigram
+typedef struct {
+    uint32_t trigram; // 0 in empty slots
+    int sorted;
+    int count;
+    int size;
+    playItem_t **items;
+} posting_t;
+
+struct search_index_s {
+    posting_t *table; // open addressing hash table
+    int table_size;
+    int trigram_count;
+    int item_count;
+    int removed_count;
+    unsigned meta_generation;
+    int64_t build_time_us;
+    size_t items_size;
+};
+
+typedef struct {
+    uint32_t *trigrams;
+    int count;
+    int size;
+} trigram_list_t;
+
+search_index_t *
+search_index_alloc (void) {
+    search_index_t *index = calloc (1, sizeof (search_index_t));
+    index->table_size = MIN_TABLE_SIZE;
+    index->table = calloc (index->table_size, sizeof (posting_t));
+    index->meta_generation = pl_get_meta_generation ();
+    return index;
+}
+
+void
+search_index_free (search_index_t *index) {
+    for (int i = 0; i < index->table_size; i++) {
+        free (index->table[i].items);
+    }
+    free (index->table);
+    free (index);
+}
+
+static uint32_t
+_hash (uint32_t trigram) {
+    trigram *= 0x9e3779b1;
+    return trigram ^ (trigram >> 15);
+}
+
+static posting_t *
+_find (search_index_t *index, uint32_t trigram) {
+    uint32_t mask = index->table_size - 1;
+    for (uint32_t i = _hash (trigram) & mask; ; i = (i + 1) & mask) {
+        posting_t *p = &index->table[i];
+        if (p->trigram == trigram || p->trigram == 0) {
+            return p;
+        }
+    }
+}
+
+static void
+_grow (search_index_t *index) {
+    posting_t *table = index->table;
+    int size = index->table_size;
+    index->table_size *= 2;
+    index->table = calloc (index->table_size, sizeof (posting_t));
+    for (int i = 0; i < size; i++) {
+        if (table[i].trigram) {
+            *_find (index, table[i].trigram) = table[i];
+        }
+    }
+    free (table);
+}
+
+static void
+_posting_append (search_index_t *index, uint32_t trigram, playItem_t *it) {
+    posting_t *p = _find (index, trigram);
+    if (p->trigram == 0) {
+        // keep the load factor under 3/4
+        if ((index->trigram_count + 1) * 4 > index->table_size * 3) {
+            _grow (index);
+            p = _find (index, trigram);
+        }
+        p->trigram = trigram;
+        p->sorted = 1;
+        index->trigram_count++;
+    }
+    if (p->count == p->size) {
+        int size = p->size ? p->size * 2 : 4;
+        p->items = realloc (p->items, size * sizeof (playItem_t *));
+        index->items_size += (size - p->size) * sizeof (playItem_t *);
+        p->size = size;
+    }
+    if (p->count > 0 && (uintptr_t)p->items[p->count-1] >= (uintptr_t)it) {
+        p->sorted = 0;
+    }
+    p->items[p->count++] = it;
+}
+
+static int
+_cmp_ptr (const void *a, const void *b) {
+    uintptr_t pa = (uintptr_t)*(playItem_t **)a;
+    uintptr_t pb = (uintptr_t)*(playItem_t **)b;
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static int
+_cmp_trigram (const void *a, const void *b) {
+    uint32_t ta = *(const uint32_t *)a;
+    uint32_t tb = *(const uint32_t *)b;
+    return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+// items are sorted by address, to allow binary search and intersection; duplicates are dropped
+static void
+_posting_sort (posting_t *p) {
+    if (p->sorted) {
+        return;
+    }
+    qsort (p->items, p->count, sizeof (playItem_t *), _cmp_ptr);
+    int n = 0;
+    for (int i = 0; i < p->count; i++) {
+        if (n == 0 || p->items[n-1] != p->items[i]) {
+            p->items[n++] = p->items[i];
+        }
+    }
+    p->count = n;
+    p->sorted = 1;
+}
+
+static void
+_trigram_list_append (trigram_list_t *list, uint32_t trigram) {
+    if (list->count == list->size) {
+        list->size = list->size ? list->size * 2 : 64;
+        list->trigrams = realloc (list->trigrams, list->size * sizeof (uint32_t));
+    }
+    list->trigrams[list->count++] = trigram;
+}
+
+// Lowercases the string the same way as plt_search_process2 does with the query, and collects the trigrams
+static void
+_add_value_trigrams (trigram_list_t *list, const char *value) {
+    uint32_t window = 0;
+    int window_len = 0;
+    const char *p = value;
+    while (*p) {
+        int32_t i = 0;
+        char s[10];
+        u8_nextchar (p, &i);
+        int l = u8_tolower ((const signed char *)p, i, s);
+        for (int c = 0; c < l; c++) {
+            window = ((window << 8) | (uint8_t)s[c]) & 0xffffff;
+            if (++window_len >= 3) {
+                _trigram_list_append (list, window);
+            }
+        }
+        p += i;
+    }
+}
+
+void
+search_index_add_item (search_index_t *index, playItem_t *it) {
+    trigram_list_t list = {0};
+    for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+        int is_uri = !strcmp (m->key, ":URI");
+        if ((m->key[0] == ':' && !is_uri) || m->key[0] == '_' || m->key[0] == '!') {
+            continue;
+        }
+        if (!strcasecmp (m->key, "cuesheet") || !strcasecmp (m->key, "log")) {
+            continue;
+        }
+        if (is_uri) {
+            // only the file name is searched
+            const char *slash = strrchr (m->value, '/');
+            _add_value_trigrams (&list, slash ? slash + 1 : m->value);
+            continue;
+        }
+        const char *value = m->value;
+        const char *end = value + m->valuesize;
+        while (value < end) {
+            _add_value_trigrams (&list, value);
+            value += strlen (value) + 1;
+        }
+    }
+
+    if (list.count > 0) {
+        qsort (list.trigrams, list.count, sizeof (uint32_t), _cmp_trigram);
+        for (int i = 0; i < list.count; i++) {
+            if (i == 0 || list.trigrams[i] != list.trigrams[i-1]) {
+                _posting_append (index, list.trigrams[i], it);
+            }
+        }
+    }
+    free (list.trigrams);
+    index->item_count++;
+    it->search_dirty = 0;
+}
+
+void
+search_index_remove_item (search_index_t *index, playItem_t *it) {
+    index->item_count--;
+    index->removed_count++;
+}
+
+void
+search_index_sync (search_index_t *index, playItem_t *head) {
+    unsigned generation = pl_get_meta_generation ();
+    if (index->meta_generation == generation) {
+        return;
+    }
+    index->meta_generation = generation;
+    for (playItem_t *it = head; it; it = it->next[PL_MAIN]) {
+        if (it->search_dirty) {
+            search_index_remove_item (index, it);
+            search_index_add_item (index, it);
+        }
+    }
+}
+
+int
+search_index_is_outdated (search_index_t *index) {
+    return index->removed_count > index->item_count;
+}
+
+void
+search_index_set_build_time (search_index_t *index, int64_t build_time_us) {
+    index->build_time_us = build_time_us;
+}
+
+int
+search_index_find_candidates (search_index_t *index, const char *lowercase_text, playItem_t ***candidates) {
+    *candidates = NULL;
+    size_t len = strlen (lowercase_text);
+    if (len < 3) {
+        return -1;
+    }
+
+    posting_t *postings[len - 2];
+    int n = 0;
+    posting_t *smallest = NULL;
+    for (size_t i = 0; i + 2 < len; i++) {
+        const uint8_t *t = (const uint8_t *)lowercase_text + i;
+        posting_t *p = _find (index, (t[0] << 16) | (t[1] << 8) | t[2]);
+        if (p->trigram == 0) {
+            return 0;
+        }
+        int dupe = 0;
+        for (int j = 0; j < n; j++) {
+            if (postings[j] == p) {
+                dupe = 1;
+                break;
+            }
+        }
+        if (dupe) {
+            continue;
+        }
+        _posting_sort (p);
+        postings[n++] = p;
+        if (!smallest || p->count < smallest->count) {
+            smallest = p;
+        }
+    }
+
+    playItem_t **result = malloc (smallest->count * sizeof (playItem_t *));
+    memcpy (result, smallest->items, smallest->count * sizeof (playItem_t *));
+    int count = smallest->count;
+    for (int i = 0; i < n && count > 0; i++) {
+        if (postings[i] == smallest) {
+            continue;
+        }
+        int k = 0;
+        for (int j = 0; j < count; j++) {
+            if (bsearch (&result[j], postings[i]->items, postings[i]->count, sizeof (playItem_t *), _cmp_ptr)) {
+                result[k++] = result[j];
+            }
+        }
+        count = k;
+    }
+
+    if (count == 0) {
+        free (result);
+        return 0;
+    }
+    *candidates = result;
+    return count;
+}
+
+int
+search_index_is_candidate (playItem_t **candidates, int count, playItem_t *it) {
+    return bsearch (&it, candidates, count, sizeof (playItem_t *), _cmp_ptr) != NULL;
+}
+
+void
+search_index_get_stats (search_index_t *index, search_index_stats_t *stats) {
+    stats->item_count = index->item_count;
+    stats->trigram_count = index->trigram_count;
+    stats->memory_size = sizeof (search_index_t) + index->table_size * sizeof (posting_t) + index->items_size;
+    stats->build_time_us = index->build_time_us;
+}
@@ -0,0 +1,77 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef searchindex_h
+#define searchindex_h
+
+#include <stdint.h>
+#include "playlist.h"
+
+// Trigram index over the lowercase searchable metadata of playlist items.
+// It only narrows down the items which may match a query; the candidates still need to be checked.
+// The stored item pointers are never dereferenced, so removed items are allowed to stay in the index,
+// until search_index_is_outdated reports that it's time to rebuild it.
+// Items with changed metadata are re-added by search_index_sync, their old trigrams stay until the rebuild.
+// Must be used with the playlist lock held.
+
+typedef struct search_index_s search_index_t;
+
+typedef ddb_search_index_stats_t search_index_stats_t;
+
+search_index_t *
+search_index_alloc (void);
+
+void
+search_index_free (search_index_t *index);
+
+void
+search_index_add_item (search_index_t *index, playItem_t *it);
+
+void
+search_index_remove_item (search_index_t *index, playItem_t *it);
+
+// Re-indexes the items of the playlist which have the search_dirty flag set.
+// The items are only walked if any metadata has changed since the previous sync.
+void
+search_index_sync (search_index_t *index, playItem_t *head);
+
+// Returns 1 if too many items were removed or re-indexed since the index was built
+int
+search_index_is_outdated (search_index_t *index);
+
+void
+search_index_set_build_time (search_index_t *index, int64_t build_time_us);
+
+// Returns the number of candidates, or -1 if the query is too short to use the index.
+// On success, *candidates is a sorted array which needs to be freed by the caller.
+int
+search_index_find_candidates (search_index_t *index, const char *lowercase_text, playItem_t ***candidates);
+
+// Returns 1 if the item is in the candidate list returned by search_index_find_candidates
+int
+search_index_is_candidate (playItem_t **candidates, int count, playItem_t *it);
+
+void
+search_index_get_stats (search_index_t *index, search_index_stats_t *stats);
+
+#endif /* searchindex_h */
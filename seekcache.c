@@ -0,0 +1,294 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "conf.h"
+#include "seekcache.h"
+
+// The checkpoints are kept for a few tracks, so that seeking back into the previous track,
+// or replaying it, can still use them.
+#define MAX_TRACKS 4
+
+// When a track gets more checkpoints, every other one is dropped, and the interval is doubled.
+#define MAX_CHECKPOINTS 512
+
+#define DEFAULT_INTERVAL 10 // seconds
+
+typedef struct {
+    int64_t sample;
+    size_t size;
+    void *data;
+} checkpoint_t;
+
+typedef struct {
+    playItem_t *track;
+    ddb_decoder2_t *decoder;
+    int samplerate;
+    int64_t interval; // in samples
+    checkpoint_t *checkpoints; // sorted by sample
+    int count;
+    int64_t last_used;
+} track_checkpoints_t;
+
+static track_checkpoints_t _tracks[MAX_TRACKS];
+static int64_t _use_counter;
+static int64_t _restore_count;
+static float _interval_seconds = DEFAULT_INTERVAL;
+
+static void
+_track_clear (track_checkpoints_t *t) {
+    for (int i = 0; i < t->count; i++) {
+        t->decoder->checkpoint_free (t->checkpoints[i].data);
+    }
+    free (t->checkpoints);
+    if (t->track) {
+        pl_item_unref (t->track);
+    }
+    memset (t, 0, sizeof (track_checkpoints_t));
+}
+
+void
+seekcache_init (void) {
+    memset (_tracks, 0, sizeof (_tracks));
+    _use_counter = 0;
+    _restore_count = 0;
+    seekcache_configchanged ();
+}
+
+void
+seekcache_free (void) {
+    seekcache_reset ();
+}
+
+void
+seekcache_reset (void) {
+    for (int i = 0; i < MAX_TRACKS; i++) {
+        _track_clear (&_tracks[i]);
+    }
+}
+
+void
+seekcache_configchanged (void) {
+    _interval_seconds = conf_get_float ("streamer.seek_checkpoint_interval", DEFAULT_INTERVAL);
+}
+
+static ddb_decoder2_t *
+_decoder2 (DB_fileinfo_t *fileinfo) {
+    DB_decoder_t *dec = fileinfo ? fileinfo->plugin : NULL;
+    if (!dec
+        || dec->plugin.api_vminor < 17
+        || !(dec->plugin.flags & DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2)) {
+        return NULL;
+    }
+    ddb_decoder2_t *dec2 = (ddb_decoder2_t *)dec;
+    if (!dec2->checkpoint_save || !dec2->checkpoint_restore || !dec2->checkpoint_free) {
+        return NULL;
+    }
+    return dec2;
+}
+
+int
+seekcache_is_supported (DB_fileinfo_t *fileinfo) {
+    return _decoder2 (fileinfo) != NULL;
+}
+
+static track_checkpoints_t *
+_track_find (playItem_t *track, ddb_decoder2_t *decoder, int samplerate, int create) {
+    track_checkpoints_t *lru = &_tracks[0];
+    for (int i = 0; i < MAX_TRACKS; i++) {
+        track_checkpoints_t *t = &_tracks[i];
+        if (t->track == track && t->decoder == decoder) {
+            if (t->samplerate != samplerate) {
+                // e.g. the output samplerate setting of a synth plugin has changed
+                _track_clear (t);
+                break;
+            }
+            t->last_used = ++_use_counter;
+            return t;
+        }
+        if (t->last_used < lru->last_used) {
+            lru = t;
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    // reuse an empty slot, or the least recently used one
+    track_checkpoints_t *t = lru;
+    for (int i = 0; i < MAX_TRACKS; i++) {
+        if (!_tracks[i].track) {
+            t = &_tracks[i];
+            break;
+        }
+    }
+    _track_clear (t);
+    t->track = track;
+    pl_item_ref (track);
+    t->decoder = decoder;
+    t->samplerate = samplerate;
+    t->interval = (int64_t)(_interval_seconds * samplerate);
+    t->checkpoints = malloc ((MAX_CHECKPOINTS + 1) * sizeof (checkpoint_t));
+    t->last_used = ++_use_counter;
+    return t;
+}
+
+// Returns the index of the last checkpoint at or before the sample, or -1
+static int
+_checkpoint_find (track_checkpoints_t *t, int64_t sample) {
+    int l = 0;
+    int r = t->count;
+    while (l < r) {
+        int m = (l + r) / 2;
+        if (t->checkpoints[m].sample <= sample) {
+            l = m + 1;
+        }
+        else {
+            r = m;
+        }
+    }
+    return l - 1;
+}
+
+static void
+_checkpoint_remove (track_checkpoints_t *t, int idx) {
+    t->decoder->checkpoint_free (t->checkpoints[idx].data);
+    memmove (&t->checkpoints[idx], &t->checkpoints[idx + 1], (t->count - idx - 1) * sizeof (checkpoint_t));
+    t->count--;
+}
+
+static void
+_checkpoint_insert (track_checkpoints_t *t, int64_t sample, size_t size, void *data) {
+    int idx = _checkpoint_find (t, sample);
+    if (idx >= 0 && t->checkpoints[idx].sample == sample) {
+        t->decoder->checkpoint_free (t->checkpoints[idx].data);
+        t->checkpoints[idx].size = size;
+        t->checkpoints[idx].data = data;
+        return;
+    }
+
+    idx++;
+    memmove (&t->checkpoints[idx + 1], &t->checkpoints[idx], (t->count - idx) * sizeof (checkpoint_t));
+    t->checkpoints[idx].sample = sample;
+    t->checkpoints[idx].size = size;
+    t->checkpoints[idx].data = data;
+    t->count++;
+
+    if (t->count > MAX_CHECKPOINTS) {
+        int n = 0;
+        for (int i = 0; i < t->count; i++) {
+            if (i & 1) {
+                t->decoder->checkpoint_free (t->checkpoints[i].data);
+            }
+            else {
+                t->checkpoints[n++] = t->checkpoints[i];
+            }
+        }
+        t->count = n;
+        t->interval *= 2;
+    }
+}
+
+void
+seekcache_record (playItem_t *track, DB_fileinfo_t *fileinfo) {
+    if (!track || _interval_seconds <= 0 || fileinfo->fmt.samplerate <= 0) {
+        return;
+    }
+    ddb_decoder2_t *decoder = _decoder2 (fileinfo);
+    if (!decoder) {
+        return;
+    }
+
+    track_checkpoints_t *t = _track_find (track, decoder, fileinfo->fmt.samplerate, 1);
+
+    // only save if there's no checkpoint within the interval around the current position
+    int64_t pos = (int64_t)((double)fileinfo->readpos * fileinfo->fmt.samplerate);
+    int idx = _checkpoint_find (t, pos);
+    if (idx >= 0 && pos - t->checkpoints[idx].sample < t->interval) {
+        return;
+    }
+    if (idx + 1 < t->count && t->checkpoints[idx + 1].sample - pos < t->interval) {
+        return;
+    }
+    if (idx < 0 && pos < t->interval) {
+        return; // seeking near the beginning is fast anyway
+    }
+
+    int64_t sample = 0;
+    size_t size = 0;
+    void *data = decoder->checkpoint_save (fileinfo, &sample, &size);
+    if (!data) {
+        return;
+    }
+    _checkpoint_insert (t, sample, size, data);
+}
+
+int
+seekcache_restore (playItem_t *track, DB_fileinfo_t *fileinfo, int64_t sample) {
+    ddb_decoder2_t *decoder = _decoder2 (fileinfo);
+    if (!track || !decoder) {
+        return 0;
+    }
+
+    track_checkpoints_t *t = _track_find (track, decoder, fileinfo->fmt.samplerate, 0);
+    if (!t) {
+        return 0;
+    }
+
+    int idx = _checkpoint_find (t, sample);
+    if (idx < 0) {
+        return 0;
+    }
+
+    // when seeking forward, the current position can be closer than the checkpoint
+    int64_t pos = (int64_t)((double)fileinfo->readpos * fileinfo->fmt.samplerate);
+    if (pos <= sample && t->checkpoints[idx].sample <= pos) {
+        return 0;
+    }
+
+    if (decoder->checkpoint_restore (fileinfo, t->checkpoints[idx].data) < 0) {
+        _checkpoint_remove (t, idx);
+        return 0;
+    }
+    _restore_count++;
+    return 1;
+}
+
+void
+seekcache_get_stats (seekcache_stats_t *stats) {
+    memset (stats, 0, sizeof (seekcache_stats_t));
+    for (int i = 0; i < MAX_TRACKS; i++) {
+        track_checkpoints_t *t = &_tracks[i];
+        if (!t->track) {
+            continue;
+        }
+        stats->track_count++;
+        stats->checkpoint_count += t->count;
+        for (int c = 0; c < t->count; c++) {
+            stats->memory_size += t->checkpoints[c].size;
+        }
+    }
+    stats->restore_count = _restore_count;
+}
@@ -0,0 +1,76 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef seekcache_h
+#define seekcache_h
+
+#include "deadbeef.h"
+#include "playlist.h"
+
+// Seek checkpoints of the recently played tracks, saved during playback by the decoders which support them
+// (see checkpoint_save in ddb_decoder2_t), and restored before seeking,
+// so that the decoder doesn't need to scan or decode the track from the beginning.
+// Must be used from the streamer thread only.
+
+typedef struct {
+    int track_count;
+    int checkpoint_count;
+    size_t memory_size; // bytes, as reported by the decoders
+    int64_t restore_count; // number of seeks which started from a checkpoint
+} seekcache_stats_t;
+
+void
+seekcache_init (void);
+
+void
+seekcache_free (void);
+
+// Drops all checkpoints
+void
+seekcache_reset (void);
+
+// Reads the checkpoint interval from the config
+void
+seekcache_configchanged (void);
+
+// Returns 1 if the fileinfo's decoder supports checkpoints
+int
+seekcache_is_supported (DB_fileinfo_t *fileinfo);
+
+// Saves a checkpoint at the current read position of the fileinfo,
+// if there's none within the checkpoint interval yet.
+// Call before reading from the fileinfo.
+void
+seekcache_record (playItem_t *track, DB_fileinfo_t *fileinfo);
+
+// Restores the nearest checkpoint at or before the seek target,
+// if it's closer to the target than the current read position.
+// The caller must seek to the target afterwards.
+// Returns 1 if a checkpoint was restored.
+int
+seekcache_restore (playItem_t *track, DB_fileinfo_t *fileinfo, int64_t sample);
+
+void
+seekcache_get_stats (seekcache_stats_t *stats);
+
+#endif /* seekcache_h */
@@ -0,0 +1,344 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "../deadbeef.h"
+#include "lengthcache.h"
+
+extern DB_functions_t *deadbeef;
+
+#define LENGTHCACHE_MAGIC "DDB_LEN"
+#define LENGTHCACHE_VERSION 1
+
+// ddb_lengthcache_digest_file reads this much at the start and at the end of the file
+#define LENGTHCACHE_DIGEST_CHUNK 65536
+
+// the entries not used for this long are dropped when saving
+#define LENGTHCACHE_EXPIRE_DAYS 365
+// when there are more entries, the least recently used are dropped when saving
+#define LENGTHCACHE_MAX_ENTRIES 100000
+
+// File layout: header, lengthcache_entry_t[count]
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+} lengthcache_header_t;
+
+typedef struct {
+    uint8_t digest[16];
+    int32_t subsong;
+    int32_t last_used; // days since epoch, 0 in the files written before it was tracked
+    int64_t length;
+} lengthcache_entry_t;
+
+struct ddb_lengthcache_s {
+    char path[PATH_MAX];
+    uintptr_t mutex;
+    int dirty;
+
+    lengthcache_entry_t *entries;
+    uint32_t count;
+    uint32_t allocated;
+
+    // open addressing hash table of entry indexes + 1, 0 is an empty slot
+    uint32_t *slots;
+    uint32_t slots_size;
+};
+
+static int32_t
+_today (void) {
+    return (int32_t)(time (NULL) / 86400);
+}
+
+static void
+_touch (ddb_lengthcache_t *cache, lengthcache_entry_t *e) {
+    int32_t today = _today ();
+    if (e->last_used != today) {
+        e->last_used = today;
+        cache->dirty = 1;
+    }
+}
+
+static uint32_t
+_hash (const uint8_t digest[16], int subsong) {
+    // the digest is already well distributed
+    uint32_t h;
+    memcpy (&h, digest, sizeof (h));
+    return h ^ ((uint32_t)subsong * 0x9e3779b9);
+}
+
+static void
+_index_insert (ddb_lengthcache_t *cache, uint32_t idx) {
+    uint32_t mask = cache->slots_size - 1;
+    uint32_t slot = _hash (cache->entries[idx].digest, cache->entries[idx].subsong) & mask;
+    while (cache->slots[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    cache->slots[slot] = idx + 1;
+}
+
+static void
+_index_rebuild (ddb_lengthcache_t *cache) {
+    uint32_t size = 1024;
+    while (size < cache->count * 2) {
+        size *= 2;
+    }
+    free (cache->slots);
+    cache->slots = calloc (size, sizeof (uint32_t));
+    cache->slots_size = size;
+    for (uint32_t i = 0; i < cache->count; i++) {
+        _index_insert (cache, i);
+    }
+}
+
+static lengthcache_entry_t *
+_find (ddb_lengthcache_t *cache, const uint8_t digest[16], int subsong) {
+    uint32_t mask = cache->slots_size - 1;
+    uint32_t slot = _hash (digest, subsong) & mask;
+    while (cache->slots[slot]) {
+        lengthcache_entry_t *e = &cache->entries[cache->slots[slot] - 1];
+        if (e->subsong == subsong && !memcmp (e->digest, digest, 16)) {
+            return e;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+static void
+_load (ddb_lengthcache_t *cache) {
+    FILE *fp = fopen (cache->path, "rb");
+    if (!fp) {
+        return;
+    }
+
+    lengthcache_header_t hdr;
+    if (fread (&hdr, sizeof (hdr), 1, fp) != 1
+        || memcmp (hdr.magic, LENGTHCACHE_MAGIC, sizeof (hdr.magic))
+        || hdr.version != LENGTHCACHE_VERSION) {
+        fclose (fp);
+        return;
+    }
+
+    lengthcache_entry_t *entries = malloc (hdr.count * sizeof (lengthcache_entry_t) + 1);
+    if (!entries || fread (entries, sizeof (lengthcache_entry_t), hdr.count, fp) != hdr.count) {
+        free (entries);
+        fclose (fp);
+        return;
+    }
+    fclose (fp);
+
+    int32_t today = _today ();
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        if (entries[i].last_used == 0) {
+            entries[i].last_used = today;
+        }
+    }
+
+    cache->entries = entries;
+    cache->count = cache->allocated = hdr.count;
+}
+
+static int
+_cmp_last_used_desc (const void *a, const void *b) {
+    int32_t la = ((const lengthcache_entry_t *)a)->last_used;
+    int32_t lb = ((const lengthcache_entry_t *)b)->last_used;
+    return la < lb ? 1 : (la > lb ? -1 : 0);
+}
+
+// Drops the expired entries, and the least recently used ones above the size limit.
+// The index must be rebuilt afterwards.
+static void
+_prune (ddb_lengthcache_t *cache) {
+    int32_t today = _today ();
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < cache->count; i++) {
+        if (today - cache->entries[i].last_used > LENGTHCACHE_EXPIRE_DAYS) {
+            continue;
+        }
+        cache->entries[count++] = cache->entries[i];
+    }
+    if (count > LENGTHCACHE_MAX_ENTRIES) {
+        qsort (cache->entries, count, sizeof (lengthcache_entry_t), _cmp_last_used_desc);
+        count = LENGTHCACHE_MAX_ENTRIES;
+    }
+    cache->count = count;
+}
+
+static void
+_save (ddb_lengthcache_t *cache) {
+    char tmp_path[PATH_MAX];
+    if ((size_t)snprintf (tmp_path, sizeof (tmp_path), "%s.part", cache->path) >= sizeof (tmp_path)) {
+        return;
+    }
+
+    _prune (cache);
+    _index_rebuild (cache);
+
+    lengthcache_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, LENGTHCACHE_MAGIC, sizeof (LENGTHCACHE_MAGIC));
+    hdr.version = LENGTHCACHE_VERSION;
+    hdr.count = cache->count;
+
+    int res = 0;
+    FILE *fp = fopen (tmp_path, "w+b");
+    if (fp) {
+        res = fwrite (&hdr, sizeof (hdr), 1, fp) == 1
+            && fwrite (cache->entries, sizeof (lengthcache_entry_t), cache->count, fp) == cache->count;
+        if (fclose (fp) != 0) {
+            res = 0;
+        }
+    }
+
+    if (!res || rename (tmp_path, cache->path) != 0) {
+        fprintf (stderr, "failed to write length cache %s\n", cache->path);
+        unlink (tmp_path);
+    }
+}
+
+ddb_lengthcache_t *
+ddb_lengthcache_open (const char *name) {
+    const char *cache_root = deadbeef->get_system_dir (DDB_SYS_DIR_CACHE);
+    if (!cache_root) {
+        return NULL;
+    }
+
+    ddb_lengthcache_t *cache = calloc (1, sizeof (ddb_lengthcache_t));
+    if ((size_t)snprintf (cache->path, sizeof (cache->path), "%s/%s.cache", cache_root, name) >= sizeof (cache->path)) {
+        free (cache);
+        return NULL;
+    }
+    cache->mutex = deadbeef->mutex_create ();
+    _load (cache);
+    _index_rebuild (cache);
+    return cache;
+}
+
+void
+ddb_lengthcache_close (ddb_lengthcache_t *cache) {
+    if (cache->dirty) {
+        _save (cache);
+    }
+    deadbeef->mutex_free (cache->mutex);
+    free (cache->entries);
+    free (cache->slots);
+    free (cache);
+}
+
+void
+ddb_lengthcache_digest_buffer (const void *buffer, size_t size, uint8_t digest[16]) {
+    DB_md5_t md5;
+    deadbeef->md5_init (&md5);
+    const uint8_t *p = buffer;
+    while (size > 0) {
+        int n = size > INT_MAX ? INT_MAX : (int)size;
+        deadbeef->md5_append (&md5, p, n);
+        p += n;
+        size -= n;
+    }
+    deadbeef->md5_finish (&md5, digest);
+}
+
+int
+ddb_lengthcache_digest_file (const char *fname, uint8_t digest[16]) {
+    DB_FILE *fp = deadbeef->fopen (fname);
+    if (!fp) {
+        return -1;
+    }
+
+    int64_t size = deadbeef->fgetlength (fp);
+    if (size < 0) {
+        deadbeef->fclose (fp);
+        return -1;
+    }
+
+    DB_md5_t md5;
+    deadbeef->md5_init (&md5);
+    deadbeef->md5_append (&md5, (const uint8_t *)&size, sizeof (size));
+
+    uint8_t buffer[LENGTHCACHE_DIGEST_CHUNK];
+    size_t rb = deadbeef->fread (buffer, 1, sizeof (buffer), fp);
+    deadbeef->md5_append (&md5, buffer, (int)rb);
+    if (size > 2 * LENGTHCACHE_DIGEST_CHUNK) {
+        if (deadbeef->fseek (fp, size - LENGTHCACHE_DIGEST_CHUNK, SEEK_SET)) {
+            deadbeef->fclose (fp);
+            return -1;
+        }
+    }
+    // the rest of a small file, or the tail of a large one
+    while ((rb = deadbeef->fread (buffer, 1, sizeof (buffer), fp)) > 0) {
+        deadbeef->md5_append (&md5, buffer, (int)rb);
+    }
+    deadbeef->fclose (fp);
+    deadbeef->md5_finish (&md5, digest);
+    return 0;
+}
+
+int
+ddb_lengthcache_get (ddb_lengthcache_t *cache, const uint8_t digest[16], int subsong, int64_t *length) {
+    int res = -1;
+    deadbeef->mutex_lock (cache->mutex);
+    lengthcache_entry_t *e = _find (cache, digest, subsong);
+    if (e) {
+        *length = e->length;
+        _touch (cache, e);
+        res = 0;
+    }
+    deadbeef->mutex_unlock (cache->mutex);
+    return res;
+}
+
+void
+ddb_lengthcache_set (ddb_lengthcache_t *cache, const uint8_t digest[16], int subsong, int64_t length) {
+    deadbeef->mutex_lock (cache->mutex);
+    lengthcache_entry_t *e = _find (cache, digest, subsong);
+    if (!e) {
+        if (cache->count >= cache->allocated) {
+            cache->allocated = cache->allocated ? cache->allocated * 2 : 256;
+            cache->entries = realloc (cache->entries, cache->allocated * sizeof (lengthcache_entry_t));
+        }
+        e = &cache->entries[cache->count++];
+        memset (e, 0, sizeof (lengthcache_entry_t));
+        memcpy (e->digest, digest, 16);
+        e->subsong = subsong;
+        if (cache->count * 2 > cache->slots_size) {
+            _index_rebuild (cache);
+        }
+        else {
+            _index_insert (cache, cache->count - 1);
+        }
+    }
+    if (e->length != length) {
+        e->length = length;
+        cache->dirty = 1;
+    }
+    _touch (cache, e);
+    deadbeef->mutex_unlock (cache->mutex);
+}
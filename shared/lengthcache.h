@@ -0,0 +1,75 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef lengthcache_h
+#define lengthcache_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Persistent cache of song lengths, for the formats where the length can only be found
+// by emulating or rendering the whole song.
+// The lengths are keyed by an MD5 digest of the file data and the subsong index,
+// so that moved or renamed files don't need to be measured again.
+// Each plugin uses its own cache file in the cache directory. All functions are thread safe.
+// Entries unused for a year are dropped, and the size is limited by dropping the least recently used ones.
+//
+// Requires `deadbeef` to be defined by the plugin.
+
+typedef struct ddb_lengthcache_s ddb_lengthcache_t;
+
+// Loads <cache dir>/<name>.cache.
+// Returns NULL if the cache dir is not available.
+ddb_lengthcache_t *
+ddb_lengthcache_open (const char *name);
+
+// Saves the changes, and frees the cache
+void
+ddb_lengthcache_close (ddb_lengthcache_t *cache);
+
+void
+ddb_lengthcache_digest_buffer (const void *buffer, size_t size, uint8_t digest[16]);
+
+// Digest of the file size, and the data at the start and at the end of the file.
+// Reads at most 128KB, so it's cheap enough to be done on every insert.
+// Returns -1 if the file can't be read
+int
+ddb_lengthcache_digest_file (const char *fname, uint8_t digest[16]);
+
+// The length is in the units chosen by the plugin, e.g. milliseconds or samples.
+// Returns 0 on success, -1 if the length is not in the cache.
+int
+ddb_lengthcache_get (ddb_lengthcache_t *cache, const uint8_t digest[16], int subsong, int64_t *length);
+
+void
+ddb_lengthcache_set (ddb_lengthcache_t *cache, const uint8_t digest[16], int subsong, int64_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* lengthcache_h */
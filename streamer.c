@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include <assert.h>
 #include <unistd.h>
 #ifdef __linux__
@@ -54,8 +55,13 @@
 #include "decodedblock.h"
 #include "dsp.h"
 #include "playmodes.h"
+#include "replaygain.h"
 #include "viz.h"
 #include "fft.h"
+#include "threadpool.h"
+#include "seekcache.h"
+#include "streamertelemetry.h"
+#include "dspkernels.h"
 
 #ifdef trace
 #undef trace
@@ -99,6 +105,7 @@ static uintptr_t mutex;
 static float last_seekpos = -1;
 
 static float playpos = 0; // play position of current song
+static float output_latency = 0; // reported by the output plugin, not played yet
 static int avg_bitrate = -1; // avg bitrate of current song
 
 static int streamer_is_buffering;
@@ -131,17 +138,24 @@ static int _audio_stall_count;
 static uint64_t streamer_file_identifier;
 static DB_vfs_t *streamer_file_vfs;
 
-// We always decode the entire block, 16384 bytes of input PCM
-// after DSP that can become really big.
-// Think converting from 8KHz/8 bit to 192KHz/32 bit, thats 96x size increase,
-// which gives us the need of 1.5MB buffer.
+// We always decode the entire block of input PCM, and after DSP that can become really big.
+// Think converting from 8KHz/8 bit to 192KHz/32 bit, thats 96x size increase.
+// The buffer fits the playback buffer duration plus two blocks, in the output format.
+// The larger buffer is allocated by the streamer thread, and the output thread only switches to it,
+// see _output_buffer_reserve and _output_buffer_swap.
 //
 // It's guaranteed that outbuffer contains only samples from the files with same wave format.
 //
-#define OUTPUT_BUFFER_SIZE (512*1024) // FIXME: need to be able to calculate that size from DSP chain
+#define OUTPUT_BUFFER_MIN_SIZE (64*1024)
 static char *_output_buffer;
 static size_t _output_buffer_size;
 static int _outbuffer_remaining;
+// protected by the streamer mutex
+static int _output_block_max_size; // the largest block after the DSP chain, in the output format
+static size_t _output_buffer_wanted; // requested by the output thread, when the next block didn't fit
+static char *_output_buffer_next; // allocated by the streamer thread, for the output thread to switch to
+static size_t _output_buffer_next_size;
+static char *_output_buffer_retired; // switched away from by the output thread, for the streamer thread to free
 
 #if defined(HAVE_XGUI) || defined(ANDROID)
 #include "equalizer.h"
@@ -194,6 +208,9 @@ _handle_playback_stopped (void);
 static void
 _streamer_mark_album_played_up_to (playItem_t *item);
 
+static void
+_output_buffer_reserve (streamblock_t *block);
+
 static void
 streamer_abort_files (void) {
     streamer_lock ();
@@ -464,26 +481,9 @@ str_get_for_idx (int idx) {
     return it;
 }
 
+// Returns 1 if both tracks have the same album and artist
 static int
-stop_after_album_check (playItem_t *cur, playItem_t *next) {
-    if (!stop_after_album) {
-        return 0;
-    }
-
-    if (!cur) {
-        return 0;
-    }
-
-    if (!next) {
-        stream_track (NULL, 0);
-        if (conf_get_int ("playlist.stop_after_album_reset", 0)) {
-            conf_set_int ("playlist.stop_after_album", 0);
-            stop_after_album = 0;
-            messagepump_push (DB_EV_CONFIGCHANGED, 0, 0, 0);
-        }
-        return 1;
-    }
-
+_is_same_album (playItem_t *cur, playItem_t *next) {
     const char *cur_album = pl_find_meta_raw (cur, "album");
     const char *next_album = pl_find_meta_raw (next, "album");
 
@@ -509,7 +509,30 @@ stop_after_album_check (playItem_t *cur, playItem_t *next) {
         }
     }
 
-    if (cur_artist == next_artist && cur_album == next_album) {
+    return cur_artist == next_artist && cur_album == next_album;
+}
+
+static int
+stop_after_album_check (playItem_t *cur, playItem_t *next) {
+    if (!stop_after_album) {
+        return 0;
+    }
+
+    if (!cur) {
+        return 0;
+    }
+
+    if (!next) {
+        stream_track (NULL, 0);
+        if (conf_get_int ("playlist.stop_after_album_reset", 0)) {
+            conf_set_int ("playlist.stop_after_album", 0);
+            stop_after_album = 0;
+            messagepump_push (DB_EV_CONFIGCHANGED, 0, 0, 0);
+        }
+        return 1;
+    }
+
+    if (_is_same_album (cur, next)) {
         return 0;
     }
 
@@ -548,8 +571,9 @@ get_random_track (void) {
     return plt_get_item_for_idx (plt, r, PL_MAIN);
 }
 
+// When predict is set, returns NULL instead of the choices which have side effects (reshuffling, random pick)
 static playItem_t *
-get_next_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
+_get_next_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat, int predict) {
     pl_lock ();
     if (!streamer_playlist) {
         playlist_t *plt = plt_get_curr ();
@@ -594,6 +618,10 @@ get_next_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
                 }
             }
             it = pmin;
+            if (!it && predict) {
+                pl_unlock ();
+                return NULL;
+            }
             if (!it) {
                 // all songs played, reshuffle and try again
                 if (repeat == DDB_REPEAT_ALL) { // loop
@@ -618,6 +646,10 @@ get_next_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
                 }
             }
             it = pmin;
+            if (!it && predict) {
+                pl_unlock ();
+                return NULL;
+            }
             if (!it) {
                 // all songs played, reshuffle and try again
                 if (repeat == DDB_REPEAT_ALL) { // loop
@@ -675,12 +707,17 @@ get_next_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
     }
     else if (shuffle == DDB_SHUFFLE_RANDOM) { // random
         pl_unlock ();
-        return get_random_track ();
+        return predict ? NULL : get_random_track ();
     }
     pl_unlock ();
     return NULL;
 }
 
+static playItem_t *
+get_next_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
+    return _get_next_track (curr, shuffle, repeat, 0);
+}
+
 static playItem_t *
 get_prev_track (playItem_t *curr, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
     pl_lock ();
@@ -908,16 +945,660 @@ fileinfo_free (DB_fileinfo_t *fileinfo) {
     }
 }
 
+// Gapless preloading:
+// Shortly before the streaming track ends, the predicted next track is opened,
+// initialized and partially decoded by a thread pool worker.
+// If the prediction turns out right, stream_track takes over the decoder and the decoded data,
+// and the streamer thread doesn't need to wait for the file to open.
+
+#define PRELOAD_CHUNK_SIZE 16384
+#define PRELOAD_MAX_BUFFER_SIZE (1024*1024)
+
+typedef enum {
+    PRELOAD_OPENING,
+    PRELOAD_READY,
+    PRELOAD_FAILED,
+} preload_state_t;
+
+typedef struct {
+    playItem_t *track;
+    DB_decoder_t *decoder;
+    DB_fileinfo_t *fileinfo; // initialized decoder, set when ready
+    char *buffer; // decoded data from the beginning of the track
+    int size;
+    int eof; // the whole track is in the buffer
+    preload_state_t state;
+    int started; // the task is running, or has finished
+    int cancelled; // the task frees the preload when it finishes
+    DB_vfs_t *file_vfs;
+    uint64_t file_identifier;
+} preload_t;
+
+static preload_t *_preload; // protected by the streamer mutex
+static ddb_task_group_t *_preload_group;
+static float conf_preload_seconds = 10;
+static float conf_crossfade_seconds = 0;
+static int64_t _preload_last_check_ms;
+
+static void
+_preload_free (preload_t *p) {
+    if (p->fileinfo) {
+        fileinfo_free (p->fileinfo);
+    }
+    free (p->buffer);
+    pl_item_unref (p->track);
+    free (p);
+}
+
+static void
+_preload_task (void *ctx) {
+    preload_t *p = ctx;
+
+    streamer_lock ();
+    p->started = 1;
+    int cancelled = p->cancelled;
+    streamer_unlock ();
+    if (cancelled) {
+        _preload_free (p);
+        return;
+    }
+
+    DB_fileinfo_t *fileinfo = dec_open (p->decoder, STREAMER_HINTS, p->track);
+
+    streamer_lock ();
+    if (fileinfo && fileinfo->file) {
+        p->file_vfs = fileinfo->file->vfs;
+        p->file_identifier = vfs_get_identifier (fileinfo->file);
+    }
+    cancelled = p->cancelled;
+    streamer_unlock ();
+
+    if (fileinfo && (cancelled || p->decoder->init (fileinfo, DB_PLAYITEM (p->track)) != 0)) {
+        p->decoder->free (fileinfo);
+        fileinfo = NULL;
+    }
+
+    // decode up to 1 second of audio
+    char *buffer = NULL;
+    int size = 0;
+    int eof = 0;
+    int samplesize = fileinfo ? fileinfo->fmt.channels * (fileinfo->fmt.bps >> 3) : 0;
+    if (samplesize > 0) {
+        int64_t buffer_size = (int64_t)fileinfo->fmt.samplerate * samplesize;
+        if (buffer_size > PRELOAD_MAX_BUFFER_SIZE) {
+            buffer_size = PRELOAD_MAX_BUFFER_SIZE;
+        }
+        buffer_size -= buffer_size % samplesize;
+        int chunk = PRELOAD_CHUNK_SIZE - PRELOAD_CHUNK_SIZE % samplesize;
+        buffer = malloc (buffer_size);
+        while (size + chunk <= buffer_size && !__atomic_load_n (&p->cancelled, __ATOMIC_ACQUIRE)) {
+            int rb = fileinfo->plugin->read (fileinfo, buffer + size, chunk);
+            if (rb > 0) {
+                size += rb;
+            }
+            if (rb != chunk) {
+                eof = 1;
+                break;
+            }
+        }
+    }
+
+    streamer_lock ();
+    p->file_vfs = NULL;
+    p->file_identifier = 0;
+    cancelled = p->cancelled;
+    if (!cancelled) {
+        p->fileinfo = fileinfo;
+        p->buffer = buffer;
+        p->size = size;
+        p->eof = eof;
+        p->state = fileinfo ? PRELOAD_READY : PRELOAD_FAILED;
+    }
+    streamer_unlock ();
+
+    if (cancelled) {
+        if (fileinfo) {
+            fileinfo_free (fileinfo);
+        }
+        free (buffer);
+        _preload_free (p);
+    }
+    trace ("preload: %s, decoded %d bytes\n", cancelled ? "cancelled" : (fileinfo ? "ready" : "failed"), size);
+}
+
+static void
+_preload_cancel (void) {
+    streamer_lock ();
+    preload_t *p = _preload;
+    _preload = NULL;
+    if (!p) {
+        streamer_unlock ();
+        return;
+    }
+    if (p->state == PRELOAD_OPENING) {
+        __atomic_store_n (&p->cancelled, 1, __ATOMIC_RELEASE);
+        DB_vfs_t *file_vfs = p->file_vfs;
+        uint64_t file_identifier = p->file_identifier;
+        streamer_unlock ();
+        // don't wait for a slow file to finish opening
+        if (file_vfs && file_identifier) {
+            vfs_abort_with_identifier (file_vfs, file_identifier);
+        }
+        return;
+    }
+    streamer_unlock ();
+    _preload_free (p);
+}
+
+static void
+_preload_start (playItem_t *track) {
+    // only the local tracks with known decoder and duration, network streams are opened the usual way
+    if (pl_get_item_duration (track) <= 0) {
+        return;
+    }
+    char decoder_id[100] = "";
+    pl_lock ();
+    const char *dec_id = pl_find_meta (track, ":DECODER");
+    if (dec_id && plug_is_local_file (pl_find_meta (track, ":URI"))) {
+        strncpy (decoder_id, dec_id, sizeof (decoder_id) - 1);
+    }
+    pl_unlock ();
+    DB_decoder_t *dec = decoder_id[0] ? plug_get_decoder_for_id (decoder_id) : NULL;
+    if (!dec) {
+        return;
+    }
+
+    if (!_preload_group) {
+        _preload_group = task_group_create ("gapless preload", DDB_TASK_PRIORITY_HIGH, 1);
+    }
+
+    preload_t *p = calloc (1, sizeof (preload_t));
+    p->track = track;
+    pl_item_ref (track);
+    p->decoder = dec;
+    p->state = PRELOAD_OPENING;
+
+    streamer_lock ();
+    _preload = p;
+    streamer_unlock ();
+
+    if (task_group_submit (_preload_group, _preload_task, p) < 0) {
+        streamer_lock ();
+        _preload = NULL;
+        streamer_unlock ();
+        _preload_free (p);
+    }
+}
+
+// Called by the streamer thread after each block of the streaming track
+static void
+_preload_update (ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
+    if ((conf_preload_seconds <= 0 && conf_crossfade_seconds <= 0) || stop_after_current || !streaming_track || !fileinfo_curr || !fileinfo_curr->plugin) {
+        return;
+    }
+    // the crossfade needs the next track to be ready before it starts
+    float window = max (conf_preload_seconds, conf_crossfade_seconds > 0 ? conf_crossfade_seconds + 2 : 0);
+    float dur = pl_get_item_duration (streaming_track);
+    if (dur <= 0 || dur - fileinfo_curr->readpos > window) {
+        return;
+    }
+
+    // the prediction is checked once per second, and the preload is restarted if it changed
+    struct timeval tm;
+    gettimeofday (&tm, NULL);
+    int64_t ms = (int64_t)tm.tv_sec * 1000 + tm.tv_usec / 1000;
+    if (ms - _preload_last_check_ms < 1000) {
+        return;
+    }
+    _preload_last_check_ms = ms;
+
+    playItem_t *next;
+    if (repeat == DDB_REPEAT_SINGLE) {
+        next = streaming_track;
+        pl_item_ref (next);
+    }
+    else {
+        next = _get_next_track (streaming_track, shuffle, repeat, 1);
+    }
+
+    streamer_lock ();
+    int same = _preload && _preload->track == next;
+    streamer_unlock ();
+
+    if (!same) {
+        _preload_cancel ();
+        if (next) {
+            _preload_start (next);
+        }
+    }
+    if (next) {
+        pl_item_unref (next);
+    }
+}
+
+// If the track has been preloaded, makes it the new fileinfo, and returns 1
+static int
+_preload_take (playItem_t *track) {
+    streamer_lock ();
+    preload_t *p = _preload;
+    if (!p || p->track != track) {
+        streamer_unlock ();
+        return 0;
+    }
+    if (p->state == PRELOAD_OPENING && !p->started) {
+        // the task is still queued, and may not run soon, so open the track the usual way
+        _preload = NULL;
+        __atomic_store_n (&p->cancelled, 1, __ATOMIC_RELEASE);
+        streamer_unlock ();
+        return 0;
+    }
+    if (p->state == PRELOAD_OPENING) {
+        // opening is already in progress, don't start over
+        streamer_unlock ();
+        task_group_wait (_preload_group);
+        streamer_lock ();
+    }
+    _preload = NULL;
+    if (p->state != PRELOAD_READY) {
+        streamer_unlock ();
+        _preload_free (p);
+        return 0;
+    }
+
+    new_fileinfo = p->fileinfo;
+    if (new_fileinfo->file) {
+        new_fileinfo_file_vfs = new_fileinfo->file->vfs;
+        new_fileinfo_file_identifier = vfs_get_identifier (new_fileinfo->file);
+    }
+    else {
+        new_fileinfo_file_vfs = NULL;
+        new_fileinfo_file_identifier = 0;
+    }
+    streamreader_set_prebuffer (new_fileinfo, p->buffer, p->size, p->eof);
+    p->fileinfo = NULL;
+    p->buffer = NULL;
+    streamer_set_streaming_track (track);
+    streamer_unlock ();
+
+    _preload_free (p);
+    trace ("preload: using preloaded track\n");
+    return 1;
+}
+
+// Crossfade:
+// When the streaming track is about to end, and the next track is preloaded with the same samplerate,
+// the streaming switches to the next track early, and the rest of the previous track is mixed into its first blocks.
+// The mixed blocks belong to the next track, so its playback position starts at 0 from the first mixed sample.
+// All of this happens on the streamer thread, the output path is not affected.
+
+typedef enum {
+    CROSSFADE_CURVE_LINEAR = 0,
+    CROSSFADE_CURVE_EQUAL_POWER = 1,
+    CROSSFADE_CURVE_S = 2,
+} crossfade_curve_t;
+
+typedef struct {
+    DB_fileinfo_t *fileinfo; // decoder of the outgoing track, NULL when not crossfading
+    playItem_t *track;
+    ddb_replaygain_settings_t rg_settings;
+    int eof;
+    int64_t total_frames;
+    int64_t done_frames;
+
+    // scratch buffers, reused across crossfades
+    char *raw;
+    float *in;
+    float *out;
+    int buffer_frames;
+    int raw_size;
+    int float_size;
+} crossfade_t;
+
+static crossfade_t _xfade;
+static crossfade_curve_t conf_crossfade_curve = CROSSFADE_CURVE_EQUAL_POWER;
+static int conf_crossfade_within_album = 0;
+
+static void
+_xfade_end (void) {
+    if (_xfade.fileinfo) {
+        fileinfo_free (_xfade.fileinfo);
+        _xfade.fileinfo = NULL;
+    }
+    if (_xfade.track) {
+        pl_item_unref (_xfade.track);
+        _xfade.track = NULL;
+    }
+}
+
+static void
+_xfade_free (void) {
+    _xfade_end ();
+    free (_xfade.raw);
+    free (_xfade.in);
+    free (_xfade.out);
+    memset (&_xfade, 0, sizeof (_xfade));
+}
+
+// Called by the streamer thread after reading a block of the streaming track
+static int
+_xfade_can_start (void) {
+    if (conf_crossfade_seconds <= 0 || _xfade.fileinfo || stop_after_current || !streaming_track || !fileinfo_curr || !fileinfo_curr->plugin) {
+        return 0;
+    }
+    float dur = pl_get_item_duration (streaming_track);
+    if (dur <= 0 || dur - fileinfo_curr->readpos > conf_crossfade_seconds || streamreader_is_prebuffered (fileinfo_curr)) {
+        return 0;
+    }
+
+    streamer_lock ();
+    playItem_t *next = NULL;
+    if (_preload && _preload->state == PRELOAD_READY && _preload->fileinfo->fmt.samplerate == fileinfo_curr->fmt.samplerate) {
+        next = _preload->track;
+        pl_item_ref (next);
+    }
+    streamer_unlock ();
+    if (!next) {
+        return 0;
+    }
+
+    // repeating a single track stays gapless
+    int res = next != streaming_track;
+    if (res) {
+        pl_lock ();
+        int same_album = _is_same_album (streaming_track, next);
+        int has_album = pl_find_meta_raw (next, "album") != NULL;
+        pl_unlock ();
+        if (same_album && has_album && !conf_crossfade_within_album) {
+            res = 0;
+        }
+        else if (!same_album && stop_after_album) {
+            res = 0; // playback stops at the end of the album
+        }
+    }
+    pl_item_unref (next);
+    return res;
+}
+
+// Takes over the outgoing decoder, before the streamer switches to the next track
+static void
+_xfade_begin (DB_fileinfo_t *fileinfo, playItem_t *track) {
+    _xfade_end ();
+    _xfade.fileinfo = fileinfo;
+    _xfade.track = track;
+    pl_item_ref (track);
+    _xfade.eof = 0;
+    _xfade.done_frames = 0;
+
+    // fade over the remaining part of the track
+    float remaining = pl_get_item_duration (track) - fileinfo->readpos;
+    _xfade.total_frames = (int64_t)(remaining * fileinfo->fmt.samplerate);
+    if (_xfade.total_frames <= 0) {
+        _xfade.total_frames = 1;
+    }
+
+    _xfade.rg_settings._size = sizeof (ddb_replaygain_settings_t);
+    replaygain_init_settings (&_xfade.rg_settings, track);
+    trace ("crossfade: %d frames\n", (int)_xfade.total_frames);
+}
+
+static void
+_xfade_reserve (int frames, int raw_samplesize, int channels) {
+    if (frames <= _xfade.buffer_frames && frames * raw_samplesize <= _xfade.raw_size && frames * channels <= _xfade.float_size) {
+        return;
+    }
+    _xfade.buffer_frames = frames;
+    _xfade.raw_size = frames * raw_samplesize;
+    _xfade.float_size = frames * channels;
+    _xfade.raw = realloc (_xfade.raw, _xfade.raw_size);
+    _xfade.in = realloc (_xfade.in, _xfade.float_size * sizeof (float));
+    _xfade.out = realloc (_xfade.out, _xfade.float_size * sizeof (float));
+}
+
+static void
+_xfade_gains (float t, float *gain_in, float *gain_out) {
+    switch (conf_crossfade_curve) {
+    case CROSSFADE_CURVE_LINEAR:
+        *gain_in = t;
+        *gain_out = 1.f - t;
+        break;
+    case CROSSFADE_CURVE_S:
+        *gain_in = 0.5f - 0.5f * cosf ((float)M_PI * t);
+        *gain_out = 1.f - *gain_in;
+        break;
+    default:
+        *gain_in = sinf (t * (float)M_PI_2);
+        *gain_out = cosf (t * (float)M_PI_2);
+        break;
+    }
+}
+
+// Mixes the next part of the outgoing track into the block of the incoming track
+static void
+_xfade_mix (streamblock_t *block) {
+    DB_fileinfo_t *out = _xfade.fileinfo;
+    int in_ss = block->fmt.channels * (block->fmt.bps >> 3);
+    int out_ss = out->fmt.channels * (out->fmt.bps >> 3);
+    if (in_ss <= 0 || out_ss <= 0 || block->size <= 0 || block->is_silent_header) {
+        return;
+    }
+
+    int64_t remaining = _xfade.total_frames - _xfade.done_frames;
+    int frames = block->size / in_ss;
+    if (frames > remaining) {
+        frames = (int)remaining;
+    }
+    int channels = block->fmt.channels;
+    _xfade_reserve (frames, out_ss, channels);
+
+    ddb_waveformat_t float_fmt;
+    memcpy (&float_fmt, &block->fmt, sizeof (ddb_waveformat_t));
+    float_fmt.bps = 32;
+    float_fmt.is_float = 1;
+
+    // outgoing track, converted to the channel layout of the incoming one
+    int out_frames = 0;
+    if (!_xfade.eof) {
+        int rb = out->plugin->read (out, _xfade.raw, frames * out_ss);
+        out_frames = rb > 0 ? rb / out_ss : 0;
+        if (out_frames < frames) {
+            _xfade.eof = 1;
+        }
+    }
+    memset (_xfade.out, 0, frames * channels * sizeof (float));
+    if (out_frames > 0) {
+        if (!(out->plugin->plugin.flags & DDB_PLUGIN_FLAG_REPLAYGAIN)) {
+            replaygain_apply_with_settings (&_xfade.rg_settings, &out->fmt, _xfade.raw, out_frames * out_ss);
+        }
+        pcm_convert (&out->fmt, _xfade.raw, &float_fmt, (char *)_xfade.out, out_frames * out_ss);
+    }
+
+    pcm_convert (&block->fmt, block->buf, &float_fmt, (char *)_xfade.in, frames * in_ss);
+
+    float *in = _xfade.in;
+    const float *o = _xfade.out;
+    for (int i = 0; i < frames; i++) {
+        float gain_in, gain_out;
+        _xfade_gains ((float)(_xfade.done_frames + i) / _xfade.total_frames, &gain_in, &gain_out);
+        for (int c = 0; c < channels; c++) {
+            float s = in[c] * gain_in + o[c] * gain_out;
+            in[c] = s > 1.f ? 1.f : (s < -1.f ? -1.f : s);
+        }
+        in += channels;
+        o += channels;
+    }
+
+    pcm_convert (&float_fmt, (char *)_xfade.in, &block->fmt, block->buf, frames * channels * (int)sizeof (float));
+
+    _xfade.done_frames += frames;
+    if (_xfade.done_frames >= _xfade.total_frames) {
+        trace ("crossfade: done\n");
+        _xfade_end ();
+    }
+}
+
+// Fades on seek and stop:
+// The output thread applies a gain ramp to the data it passes to the output plugin.
+// After the fade-out, silence is returned until the buffered data is discarded by streamer_reset.
+// The streamer thread doesn't wait for the fade-out: the message which started it is deferred,
+// and handled by the streamer loop once the output went silent (see _fade_out_finished).
+
+static int conf_fade_in_ms = 0;
+static int conf_fade_out_ms = 0;
+
+// protected by the streamer mutex, in output frames
+static int _fade_in_total;
+static int _fade_in_remaining;
+static int _fade_out_total;
+static int _fade_out_remaining;
+static int _fade_out_silent;
+
+// set under the streamer mutex, read atomically by the output thread to skip locking when no fade is running
+static int _fade_active;
+
+// accessed by the streamer thread only, in microseconds of streamer_telemetry_time
+static int64_t _fade_out_timeout;
+static int64_t _fade_out_latency;
+
+// written by the output thread, when the fade-out has finished
+static int64_t _fade_out_silent_time;
+
+static void
+_apply_output_fade (char *bytes, int sz) {
+    DB_output_t *output = plug_get_output ();
+
+    if (!__atomic_load_n (&_fade_active, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    streamer_lock ();
+    if (!_fade_in_remaining && !_fade_out_remaining && !_fade_out_silent) {
+        __atomic_store_n (&_fade_active, 0, __ATOMIC_RELEASE);
+        streamer_unlock ();
+        return;
+    }
+
+    int ss = output->fmt.channels * (output->fmt.bps >> 3);
+    int frames = ss > 0 ? sz / ss : 0;
+
+    if (_fade_out_silent) {
+        memset (bytes, 0, sz);
+        streamer_unlock ();
+        return;
+    }
+
+    char *stream = bytes;
+    for (int i = 0; i < frames; i++) {
+        float gain = 1.f;
+        if (_fade_out_remaining) {
+            gain = (float)_fade_out_remaining / _fade_out_total;
+            if (--_fade_out_remaining == 0) {
+                _fade_out_silent = 1;
+                __atomic_store_n (&_fade_out_silent_time, streamer_telemetry_time (), __ATOMIC_RELEASE);
+                memset (stream, 0, (frames - i) * ss);
+                break;
+            }
+        }
+        else if (_fade_in_remaining) {
+            gain = 1.f - (float)_fade_in_remaining / _fade_in_total;
+            _fade_in_remaining--;
+        }
+        else {
+            break;
+        }
+
+        for (int c = 0; c < output->fmt.channels; c++) {
+            if (output->fmt.bps == 8) {
+                *stream = (int8_t)(*stream * gain);
+            }
+            else if (output->fmt.bps == 16) {
+                *((int16_t*)stream) = (int16_t)(*((int16_t*)stream) * gain);
+            }
+            else if (output->fmt.bps == 24) {
+                int32_t sample = ((unsigned char)stream[0]) | ((unsigned char)stream[1]<<8) | ((signed char)stream[2]<<16);
+                int32_t newsample = (int32_t)(sample * gain);
+                stream[0] = (newsample&0x0000ff);
+                stream[1] = (newsample&0x00ff00)>>8;
+                stream[2] = (newsample&0xff0000)>>16;
+            }
+            else if (output->fmt.bps == 32 && !output->fmt.is_float) {
+                *((int32_t*)stream) = (int32_t)(*((int32_t*)stream) * (double)gain);
+            }
+            else if (output->fmt.bps == 32 && output->fmt.is_float) {
+                *((float*)stream) = *((float*)stream) * gain;
+            }
+            stream += output->fmt.bps >> 3;
+        }
+    }
+    streamer_unlock ();
+}
+
+// Starts fading out the playback, returns 1 if the caller needs to wait for _fade_out_finished
+static int
+_fade_out_begin (void) {
+    DB_output_t *output = plug_get_output ();
+    if (conf_fade_out_ms <= 0 || !output || output->state () != DDB_PLAYBACK_STATE_PLAYING) {
+        return 0;
+    }
+
+    int64_t now = streamer_telemetry_time ();
+    streamer_lock ();
+    _fade_in_remaining = 0;
+    _fade_out_total = _fade_out_remaining = max (1, (int)((int64_t)output->fmt.samplerate * conf_fade_out_ms / 1000));
+    _fade_out_silent = 0;
+    __atomic_store_n (&_fade_active, 1, __ATOMIC_RELEASE);
+    // the end of the fade is still in the output buffers when the output thread gets to it
+    _fade_out_latency = (int64_t)(min (output_latency, 0.5f) * 1000000);
+    streamer_unlock ();
+
+    // in case the output doesn't read, e.g. when paused
+    _fade_out_timeout = now + (int64_t)(conf_fade_out_ms + 200) * 1000;
+    return 1;
+}
+
+static int
+_fade_out_finished (void) {
+    int64_t now = streamer_telemetry_time ();
+    if (now >= _fade_out_timeout) {
+        return 1;
+    }
+    streamer_lock ();
+    int silent = _fade_out_silent;
+    streamer_unlock ();
+    return silent && now >= __atomic_load_n (&_fade_out_silent_time, __ATOMIC_ACQUIRE) + _fade_out_latency;
+}
+
+// Stops the fade-out, and starts the fade-in if requested
+static void
+_fade_reset (int fade_in) {
+    DB_output_t *output = plug_get_output ();
+    streamer_lock ();
+    _fade_out_remaining = 0;
+    _fade_out_silent = 0;
+    if (fade_in && conf_fade_in_ms > 0 && output) {
+        _fade_in_total = _fade_in_remaining = max (1, (int)((int64_t)output->fmt.samplerate * conf_fade_in_ms / 1000));
+    }
+    else {
+        _fade_in_remaining = 0;
+    }
+    __atomic_store_n (&_fade_active, _fade_in_remaining != 0, __ATOMIC_RELEASE);
+    streamer_unlock ();
+}
+
 static int
 stream_track (playItem_t *it, int startpaused) {
+    _xfade_end ();
     streamer_lock();
     if (fileinfo_curr) {
+        streamreader_set_prebuffer (NULL, NULL, 0, 0);
         fileinfo_free (fileinfo_curr);
         fileinfo_curr = NULL;
         fileinfo_file_vfs = NULL;
         fileinfo_file_identifier = 0;
     }
     streamer_unlock();
+    if (!it) {
+        _preload_cancel ();
+    }
     trace ("stream_track %s\n", playing_track ? pl_find_meta (playing_track, ":URI") : "null");
     int err = 0;
     playItem_t *from = NULL;
@@ -951,6 +1632,10 @@ stream_track (playItem_t *it, int startpaused) {
         goto success;
     }
 
+    if (_preload_take (it)) {
+        goto success;
+    }
+
     char decoder_id[100] = "";
     char filetype[100] = "";
     pl_lock ();
@@ -1327,9 +2012,16 @@ streamer_get_playpos (void) {
         streamer_unlock();
         return seek;
     }
-    float ret = playpos;
+    float ret = playpos - output_latency;
+    streamer_unlock();
+    return ret > 0 ? ret : 0;
+}
+
+void
+streamer_set_output_latency (float latency) {
+    streamer_lock();
+    output_latency = latency;
     streamer_unlock();
-    return ret;
 }
 
 int
@@ -1422,13 +2114,19 @@ streamer_seek_real (float seekpos) {
         }
 
         if (fileinfo_curr && track && dur > 0) {
+            _xfade_end ();
             streamer_lock ();
+            streamreader_set_prebuffer (NULL, NULL, 0, 0);
+            if (track == streaming_track) {
+                seekcache_restore (track, fileinfo_curr, (int64_t)((double)playpos * fileinfo_curr->fmt.samplerate));
+            }
             if (fileinfo_curr->plugin->seek (fileinfo_curr, playpos) >= 0) {
                 streamer_reset (1);
             }
             playpos = fileinfo_curr->readpos;
             avg_bitrate = -1;
             streamer_unlock();
+            _fade_reset (1);
         }
         ddb_event_playpos_t *ev = (ddb_event_playpos_t *)messagepump_event_alloc (DB_EV_SEEKED);
         ev->track = DB_PLAYITEM (track);
@@ -1443,6 +2141,21 @@ streamer_seek_real (float seekpos) {
     streamer_unlock();
 }
 
+static void
+_update_telemetry (void) {
+    if (!streamer_telemetry_sample_due ()) {
+        return;
+    }
+    streamreader_buffer_info_t info;
+    streamer_lock ();
+    int blocks_ready = streamreader_num_blocks_ready ();
+    streamreader_get_buffer_info (&info);
+    int outbuffer_remaining = _outbuffer_remaining;
+    int is_buffering = streamer_is_buffering;
+    streamer_unlock ();
+    streamer_telemetry_sample (blocks_ready, info.block_count, outbuffer_remaining, is_buffering);
+}
+
 static void
 _update_buffering_state () {
     streamer_lock ();
@@ -1454,6 +2167,7 @@ _update_buffering_state () {
         streamer_lock();
         streamer_is_buffering = buffering;
         streamer_unlock();
+        streamer_telemetry_buffering_changed ();
 
         // update buffering UI
         if (!buffering) {
@@ -1590,6 +2304,57 @@ _streamer_track_deleted (ddb_repeat_t repeat, ddb_shuffle_t shuffle) {
     }
 }
 
+// Messages which interrupt the playback, and are handled after the fade-out
+static int
+_streamer_message_fades_out (uint32_t id) {
+    switch (id) {
+    case STR_EV_PLAY_TRACK_IDX:
+    case STR_EV_PLAY_CURR:
+    case STR_EV_NEXT:
+    case STR_EV_PREV:
+    case STR_EV_RAND:
+    case STR_EV_SEEK:
+        return 1;
+    }
+    return 0;
+}
+
+static void
+_streamer_handle_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
+    switch (id) {
+    case STR_EV_PLAY_TRACK_IDX:
+        play_index (p1, p2);
+        break;
+    case STR_EV_PLAY_CURR:
+        play_current ();
+        break;
+    case STR_EV_NEXT:
+        play_next (1, shuffle, repeat);
+        break;
+    case STR_EV_PREV:
+        play_next (-1, shuffle, repeat);
+        break;
+    case STR_EV_RAND:
+        play_next (0, shuffle, repeat);
+        break;
+    case STR_EV_SEEK:
+        streamer_seek_real(*((float *)&p1));
+        break;
+    case STR_EV_SET_CURR_PLT:
+        streamer_set_current_playlist_real (p1);
+        break;
+    case STR_EV_DSP_RELOAD:
+        streamer_dsp_postinit ();
+        break;
+    case STR_EV_SET_DSP_CHAIN:
+        streamer_set_dsp_chain_real ((ddb_dsp_context_t *)ctx);
+        break;
+    case STR_EV_TRACK_DELETED:
+        _streamer_track_deleted (repeat, shuffle);
+        break;
+    }
+}
+
 void
 streamer_thread (void *unused) {
 #if defined(__linux__) && !defined(ANDROID)
@@ -1603,6 +2368,12 @@ streamer_thread (void *unused) {
     uintptr_t ctx;
     uint32_t p1, p2;
 
+    // the message waiting for the fade-out to finish
+    int has_deferred = 0;
+    uint32_t deferred_id = 0;
+    uintptr_t deferred_ctx = 0;
+    uint32_t deferred_p1 = 0, deferred_p2 = 0;
+
     ddb_waveformat_t prev_block_fmt = {0};
     double _add_format_silence = .0;
 
@@ -1611,39 +2382,33 @@ streamer_thread (void *unused) {
         DB_output_t *output = plug_get_output ();
         gettimeofday (&tm1, NULL);
 
+        if (has_deferred && _fade_out_finished ()) {
+            has_deferred = 0;
+            _streamer_handle_message (deferred_id, deferred_ctx, deferred_p1, deferred_p2, shuffle, repeat);
+        }
+
         while (!handler_pop (handler, &id, &ctx, &p1, &p2)) {
-            switch (id) {
-            case STR_EV_PLAY_TRACK_IDX:
-                play_index (p1, p2);
-                break;
-            case STR_EV_PLAY_CURR:
-                play_current ();
-                break;
-            case STR_EV_NEXT:
-                play_next (1, shuffle, repeat);
-                break;
-            case STR_EV_PREV:
-                play_next (-1, shuffle, repeat);
-                break;
-            case STR_EV_RAND:
-                play_next (0, shuffle, repeat);
-                break;
-            case STR_EV_SEEK:
-                streamer_seek_real(*((float *)&p1));
-                break;
-            case STR_EV_SET_CURR_PLT:
-                streamer_set_current_playlist_real (p1);
-                break;
-            case STR_EV_DSP_RELOAD:
-                streamer_dsp_postinit ();
-                break;
-            case STR_EV_SET_DSP_CHAIN:
-                streamer_set_dsp_chain_real ((ddb_dsp_context_t *)ctx);
-                break;
-            case STR_EV_TRACK_DELETED:
-                _streamer_track_deleted (repeat, shuffle);
-                break;
+            if (has_deferred) {
+                if (id == STR_EV_PLAY_TRACK_IDX && (int)p1 == -1) {
+                    // the stop query clears the queue, including the deferred message, and uses the running fade-out
+                    deferred_id = id;
+                    deferred_p1 = p1;
+                    deferred_p2 = p2;
+                    continue;
+                }
+                // the next message cuts the fade-out short, to preserve the order
+                has_deferred = 0;
+                _streamer_handle_message (deferred_id, deferred_ctx, deferred_p1, deferred_p2, shuffle, repeat);
+            }
+            else if (_streamer_message_fades_out (id) && _fade_out_begin ()) {
+                has_deferred = 1;
+                deferred_id = id;
+                deferred_ctx = ctx;
+                deferred_p1 = p1;
+                deferred_p2 = p2;
+                continue;
             }
+            _streamer_handle_message (id, ctx, p1, p2, shuffle, repeat);
         }
 
         // each event can modify shuffle/repeat, so update them here, so that subsequent event handlers use new values
@@ -1675,6 +2440,7 @@ streamer_thread (void *unused) {
         }
 
         _update_buffering_state ();
+        _update_telemetry ();
 
         if (!fileinfo_curr) {
             // HACK: This is to overcome the output plugin API limitation.
@@ -1698,6 +2464,7 @@ streamer_thread (void *unused) {
         streamer_unlock();
 
         if (!block) {
+            _output_buffer_reserve (NULL);
             usleep (50000); // all blocks are full
             continue;
         }
@@ -1717,18 +2484,41 @@ streamer_thread (void *unused) {
             _add_format_silence -= block->size / (double)bytes_per_sec;
         }
         else {
+            seekcache_record (streaming_track, fileinfo_curr);
+            int64_t decode_start = streamer_telemetry_time ();
             res = streamreader_read_block (block, streaming_track, fileinfo_curr, mutex);
+            if (res >= 0) {
+                streamer_telemetry_block_decoded (streaming_track, block->size, &block->fmt, streamer_telemetry_time () - decode_start);
+            }
         }
 
         // streamreader has locked the mutex on success
         int last = 0;
+        int xfade_start = 0;
 
         if (res >= 0) {
+            streamer_unlock ();
+            _output_buffer_reserve (block);
+            if (_xfade.fileinfo) {
+                _xfade_mix (block);
+            }
+            else if (!block->last && _add_format_silence <= 0 && _xfade_can_start ()) {
+                xfade_start = 1;
+            }
+            streamer_lock ();
+            if (xfade_start) {
+                // switch to the next track now, the rest of this one gets mixed into it
+                streamreader_end_stream (block);
+            }
             streamreader_enqueue_block (block);
             last = block->last;
             streamer_unlock ();
         }
 
+        if (res >= 0 && !last) {
+            _preload_update (shuffle, repeat);
+        }
+
         if (res < 0 || last) {
             // error or eof
 
@@ -1756,6 +2546,31 @@ streamer_thread (void *unused) {
             if (stop) {
                 stream_track (NULL, 0);
             }
+            else if (xfade_start) {
+                // keep the decoder of the outgoing track
+                streamer_lock ();
+                DB_fileinfo_t *prev_fileinfo = fileinfo_curr;
+                playItem_t *prev_track = streaming_track;
+                pl_item_ref (prev_track);
+                fileinfo_curr = NULL;
+                fileinfo_file_vfs = NULL;
+                fileinfo_file_identifier = 0;
+                streamer_unlock ();
+
+                streamer_next (shuffle, repeat, next);
+
+                streamer_lock ();
+                int can_mix = fileinfo_curr && fileinfo_curr->plugin && streaming_track != prev_track
+                    && fileinfo_curr->fmt.samplerate == prev_fileinfo->fmt.samplerate;
+                streamer_unlock ();
+                if (can_mix) {
+                    _xfade_begin (prev_fileinfo, prev_track);
+                }
+                else {
+                    fileinfo_free (prev_fileinfo);
+                }
+                pl_item_unref (prev_track);
+            }
             else {
                 streamer_next (shuffle, repeat, next);
             }
@@ -1766,9 +2581,13 @@ streamer_thread (void *unused) {
     // drain event queue
     while (!handler_pop (handler, &id, &ctx, &p1, &p2));
 
+    _preload_cancel ();
+    _xfade_end ();
+
     // stop streaming song
     streamer_lock ();
     if (fileinfo_curr) {
+        streamreader_set_prebuffer (NULL, NULL, 0, 0);
         fileinfo_free (fileinfo_curr);
         fileinfo_curr = NULL;
         fileinfo_file_vfs = NULL;
@@ -1793,10 +2612,15 @@ streamer_init (void) {
 #endif
     mutex = mutex_create ();
 
+    _output_buffer_size = OUTPUT_BUFFER_MIN_SIZE;
+    _output_buffer = malloc (_output_buffer_size);
+
     viz_init();
 
     streamreader_init ();
     decoded_blocks_init ();
+    seekcache_init ();
+    streamer_telemetry_init ();
 
     streamer_dsp_init ();
 
@@ -1820,8 +2644,15 @@ streamer_free (void) {
     streaming_terminate = 1;
     thread_join (streamer_tid);
 
+    if (_preload_group) {
+        task_group_free (_preload_group);
+        _preload_group = NULL;
+    }
+    _xfade_free ();
+
     streamreader_free ();
     decoded_blocks_free ();
+    seekcache_free ();
 
     if (first_failed_track) {
         pl_item_unref (first_failed_track);
@@ -1858,21 +2689,99 @@ streamer_free (void) {
     _output_buffer = NULL;
     _output_buffer_size = 0;
     _outbuffer_remaining = 0;
+    free (_output_buffer_next);
+    _output_buffer_next = NULL;
+    _output_buffer_next_size = 0;
+    free (_output_buffer_retired);
+    _output_buffer_retired = NULL;
+    _output_block_max_size = 0;
+    _output_buffer_wanted = 0;
 }
 
+// Grows the buffer if needed, keeping the data.
+// Only used by the output thread as the last resort, when a block is larger than reserved for.
 static char *
 _get_output_buffer (size_t size) {
-    if (_output_buffer) {
-        if (_output_buffer_size >= size) {
-            return _output_buffer;
-        }
-        free (_output_buffer);
+    if (_output_buffer && _output_buffer_size >= size) {
+        return _output_buffer;
     }
     _output_buffer_size = size;
-    _output_buffer = malloc (_output_buffer_size);
+    _output_buffer = realloc (_output_buffer, _output_buffer_size);
     return _output_buffer;
 }
 
+// Returns the estimated number of bytes which the block can produce in the output format
+static int
+_get_output_block_size (streamblock_t *block, ddb_waveformat_t *output_fmt) {
+    int input_ss = block->fmt.channels * block->fmt.bps / 8;
+    int output_ss = output_fmt->channels * output_fmt->bps / 8;
+    if (input_ss <= 0 || block->fmt.samplerate <= 0) {
+        return 0;
+    }
+    float ratio = (float)output_fmt->samplerate / block->fmt.samplerate;
+    int64_t frames = (int64_t)(block->size / input_ss * ratio) + 1024;
+    return (int)(frames * output_ss);
+}
+
+// Allocates a larger output buffer when needed, called by the streamer thread.
+// The block is the one just decoded, or NULL.
+static void
+_output_buffer_reserve (streamblock_t *block) {
+    DB_output_t *output = plug_get_output ();
+
+    streamer_lock ();
+    int block_size = _output_block_max_size;
+    if (block) {
+        block_size = max (block_size, _get_output_block_size (block, &output->fmt));
+    }
+    int ss = output->fmt.channels * output->fmt.bps / 8;
+    size_t needed = (size_t)(conf_playback_buffer_size * output->fmt.samplerate) * ss + 2 * (size_t)block_size;
+    needed = max (needed, _output_buffer_wanted);
+    needed = max (needed, OUTPUT_BUFFER_MIN_SIZE);
+    int grow = needed > _output_buffer_size && needed > _output_buffer_next_size;
+    char *retired = _output_buffer_retired;
+    _output_buffer_retired = NULL;
+    streamer_unlock ();
+
+    free (retired);
+    if (!grow) {
+        return;
+    }
+
+    char *buffer = malloc (needed);
+    streamer_lock ();
+    if (needed > _output_buffer_size && needed > _output_buffer_next_size) {
+        char *prev = _output_buffer_next;
+        _output_buffer_next = buffer;
+        _output_buffer_next_size = needed;
+        buffer = prev;
+    }
+    streamer_unlock ();
+    free (buffer);
+}
+
+// Switches to the buffer allocated by _output_buffer_reserve, keeping the data.
+// Called by the output thread, with the streamer mutex locked.
+static void
+_output_buffer_swap (void) {
+    if (!_output_buffer_next || _output_buffer_retired) {
+        return;
+    }
+    if (_output_buffer_next_size > _output_buffer_size) {
+        if (_outbuffer_remaining) {
+            memcpy (_output_buffer_next, _output_buffer, _outbuffer_remaining);
+        }
+        _output_buffer_retired = _output_buffer;
+        _output_buffer = _output_buffer_next;
+        _output_buffer_size = _output_buffer_next_size;
+    }
+    else {
+        _output_buffer_retired = _output_buffer_next;
+    }
+    _output_buffer_next = NULL;
+    _output_buffer_next_size = 0;
+}
+
 void
 streamer_reset (int full) { // must be called when current song changes by external reasons
     if (!mutex) {
@@ -1889,8 +2798,11 @@ streamer_reset (int full) { // must be called when current song changes by exter
     viz_reset ();
 }
 
+// Appends the processed block to the _output_buffer at the offset.
+// The size is only known after running the DSP chain, since the DSPs can change the samplerate, tempo or channel count,
+// so the largest size is recorded for _output_buffer_reserve.
 static int
-process_output_block (streamblock_t *block, char *bytes, int bytes_available_size) {
+process_output_block (streamblock_t *block, int offset) {
     DB_output_t *output = plug_get_output ();
 
     if (block->pos < 0) {
@@ -1960,8 +2872,10 @@ process_output_block (streamblock_t *block, char *bytes, int bytes_available_siz
     datafmt.samplerate = output->fmt.samplerate;
     sz = dspsize;
 #else
+    int64_t dsp_start = streamer_telemetry_time ();
     int dsp_res = dsp_apply (&block->fmt, block->buf + block->pos, sz,
                              &datafmt, &dspbytes, &dspsize, &dspratio);
+    streamer_telemetry_dsp_processed (streamer_telemetry_time () - dsp_start);
     if (dsp_res) {
         sz = dspsize;
     }
@@ -1982,8 +2896,10 @@ process_output_block (streamblock_t *block, char *bytes, int bytes_available_siz
         required_size = sz;
     }
 
-    // Crash here to catch the buffer issues early, instead of corrupting sound.
-    assert(bytes_available_size >= required_size);
+    streamer_lock ();
+    _output_block_max_size = max (_output_block_max_size, required_size);
+    char *bytes = _get_output_buffer (max (OUTPUT_BUFFER_MIN_SIZE, offset + required_size)) + offset;
+    streamer_unlock ();
 
     if (need_convert) {
         sz = pcm_convert (&datafmt, dspbytes, &output->fmt, bytes, sz);
@@ -2090,10 +3006,7 @@ streamer_apply_soft_volume (char *bytes, int sz) {
         else if (output->fmt.bps == 32 && output->fmt.is_float) {
             float fvolume = vol * (1-audio_is_mute ());
             if (fvolume != 1.f) {
-                for (int i = 0; i < bytesread/4; i++) {
-                    *((float*)stream) = (*((float*)stream)) * fvolume;
-                    stream += 4;
-                }
+                dsp_kernel_scale_float ((float *)stream, bytesread/4, fvolume);
             }
         }
     }
@@ -2103,17 +3016,20 @@ static int
 _streamer_get_bytes (char *bytes, int size) {
     DB_output_t *output = plug_get_output ();
 
-    char *outbuffer = _get_output_buffer (OUTPUT_BUFFER_SIZE);
-
     streamer_lock ();
+    char *outbuffer = _output_buffer;
     int remaining = _outbuffer_remaining;
     streamer_unlock ();
 
     // consume decoded data
     int sz = min (size, remaining);
+    if (sz < size && streaming_track) {
+        streamer_telemetry_underrun ();
+    }
     if (!sz) {
         // no data available
         memset (bytes, 0, size);
+        _apply_output_fade (bytes, size);
         return size;
     }
 
@@ -2177,6 +3093,7 @@ _streamer_get_bytes (char *bytes, int size) {
     streamer_unlock();
 
     streamer_apply_soft_volume (bytes, sz);
+    _apply_output_fade (bytes, sz);
 
     return sz;
 }
@@ -2215,15 +3132,20 @@ _streamer_fill_playback_buffer(void) {
 
     int block_bitrate = -1;
 
+    _output_buffer_swap ();
+
     // only decode until the next format change
     // decode enough blocks to fill the output buffer
-    char *outbuffer = _get_output_buffer (OUTPUT_BUFFER_SIZE);
     while (block != NULL
            && decoded_blocks_have_free()
            && decoded_blocks_playback_time_total() < conf_playback_buffer_size
-           && OUTPUT_BUFFER_SIZE-_outbuffer_remaining >= block->size * MAX_DSP_RATIO
            && !memcmp (&block->fmt, &last_block_fmt, sizeof (ddb_waveformat_t))) {
-        int rb = process_output_block (block, outbuffer + _outbuffer_remaining, OUTPUT_BUFFER_SIZE - _outbuffer_remaining);
+        if (_outbuffer_remaining && _output_buffer_size - _outbuffer_remaining < _output_block_max_size) {
+            // wait for the streamer thread to allocate a larger buffer
+            _output_buffer_wanted = max (_output_buffer_wanted, _outbuffer_remaining + 2 * (size_t)_output_block_max_size);
+            break;
+        }
+        int rb = process_output_block (block, _outbuffer_remaining);
         if (rb <= 0) {
             break;
         }
@@ -2369,6 +3291,12 @@ streamer_configchanged (void) {
     conf_streamer_samplerate_mult_44 = new_conf_streamer_samplerate_mult_44;
 
     conf_format_silence = conf_get_float ("streamer.format_change_silence", -1.f);
+    conf_preload_seconds = conf_get_float ("streamer.gapless_preload_seconds", 10);
+    conf_crossfade_seconds = conf_get_float ("streamer.crossfade_seconds", 0);
+    conf_crossfade_curve = conf_get_int ("streamer.crossfade_curve", CROSSFADE_CURVE_EQUAL_POWER);
+    conf_crossfade_within_album = conf_get_int ("streamer.crossfade_within_album", 0);
+    conf_fade_in_ms = conf_get_int ("streamer.fade_in_ms", 0);
+    conf_fade_out_ms = conf_get_int ("streamer.fade_out_ms", 0);
 
     int playback_buffer_size = conf_get_int ("streamer.playback_buffer_size", 300);
     if (playback_buffer_size < 100) {
@@ -2380,6 +3308,8 @@ streamer_configchanged (void) {
     conf_playback_buffer_size = playback_buffer_size / 1000.f;
 
     streamreader_configchanged ();
+    seekcache_configchanged ();
+    streamer_telemetry_configchanged ();
 
     streamer_unlock ();
 }
@@ -2403,6 +3333,7 @@ static void
 _play_track (playItem_t *it, int startpaused) {
     DB_output_t *output = plug_get_output();
     output->stop ();
+    _fade_reset (!startpaused);
     streamer_lock();
     streamer_reset(1);
     streamer_is_buffering = 1;
@@ -2498,6 +3429,7 @@ play_index (int idx, int startpaused) {
 
 error:
     output->stop ();
+    _fade_reset (0);
     streamer_reset (1);
     viz_reset();
     viz_process(NULL, 0, output, 0, 0);
@@ -2622,6 +3554,7 @@ play_next (int dir, ddb_shuffle_t shuffle, ddb_repeat_t repeat) {
     if (!next) {
         streamer_set_last_played (NULL);
         output->stop ();
+        _fade_reset (0);
         streamer_reset(1);
         _handle_playback_stopped ();
         return;
@@ -2772,6 +3705,7 @@ streamer_set_output (DB_output_t *output) {
         streamer_lock ();
     }
     plug_set_output (output);
+    output_latency = 0;
 
     if (fmt.channels) {
         output->setformat (&fmt);
@@ -85,6 +85,10 @@ streamer_ok_to_read (int len);
 float
 streamer_get_playpos (void);
 
+// Duration of audio buffered by the output plugin, in seconds
+void
+streamer_set_output_latency (float latency);
+
 void
 streamer_song_removed_notify (playItem_t *it);
 
@@ -0,0 +1,231 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "conf.h"
+#include "streamertelemetry.h"
+
+// 100 seconds at the default interval
+#define RING_SIZE 1024
+
+#define DEFAULT_INTERVAL 100 // milliseconds
+
+// seq is set to the sample number + 1 when the slot is written, and to 0 while it's being written,
+// which allows the readers to detect the samples overwritten during copying.
+typedef struct {
+    uint64_t seq;
+    ddb_streamer_telemetry_t sample;
+} telemetry_slot_t;
+
+static telemetry_slot_t _ring[RING_SIZE];
+static uint64_t _write_count;
+
+static int _interval = DEFAULT_INTERVAL;
+static int64_t _last_sample_time;
+
+// updated from any thread
+static int64_t _underruns;
+static int64_t _buffering_changes;
+static int64_t _dsp_time_total;
+static int64_t _dsp_blocks_total;
+
+// streamer thread only
+static playItem_t *_decode_track;
+static double _decode_duration;
+static int64_t _decode_time;
+static int64_t _last_dsp_time_total;
+static int64_t _last_dsp_blocks_total;
+
+void
+streamer_telemetry_init (void) {
+    memset (_ring, 0, sizeof (_ring));
+    __atomic_store_n (&_write_count, 0, __ATOMIC_SEQ_CST);
+    _last_sample_time = 0;
+    _underruns = 0;
+    _buffering_changes = 0;
+    _dsp_time_total = 0;
+    _dsp_blocks_total = 0;
+    _decode_track = NULL;
+    _decode_duration = 0;
+    _decode_time = 0;
+    _last_dsp_time_total = 0;
+    _last_dsp_blocks_total = 0;
+    streamer_telemetry_configchanged ();
+}
+
+void
+streamer_telemetry_configchanged (void) {
+    _interval = conf_get_int ("streamer.telemetry_interval", DEFAULT_INTERVAL);
+}
+
+int64_t
+streamer_telemetry_time (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void
+streamer_telemetry_block_decoded (playItem_t *track, int size, const ddb_waveformat_t *fmt, int64_t elapsed) {
+    int bytes_per_second = fmt->samplerate * fmt->channels * (fmt->bps / 8);
+    if (bytes_per_second <= 0) {
+        return;
+    }
+    if (track != _decode_track) {
+        // the pointer is only compared, never dereferenced
+        _decode_track = track;
+        _decode_duration = 0;
+        _decode_time = 0;
+    }
+    _decode_duration += (double)size / bytes_per_second;
+    _decode_time += elapsed;
+}
+
+void
+streamer_telemetry_dsp_processed (int64_t elapsed) {
+    __atomic_add_fetch (&_dsp_time_total, elapsed, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&_dsp_blocks_total, 1, __ATOMIC_RELAXED);
+}
+
+void
+streamer_telemetry_underrun (void) {
+    __atomic_add_fetch (&_underruns, 1, __ATOMIC_RELAXED);
+}
+
+void
+streamer_telemetry_buffering_changed (void) {
+    __atomic_add_fetch (&_buffering_changes, 1, __ATOMIC_RELAXED);
+}
+
+static int
+_sample_due (int64_t now) {
+    return _interval > 0 && (_last_sample_time == 0 || now - _last_sample_time >= (int64_t)_interval * 1000);
+}
+
+int
+streamer_telemetry_sample_due (void) {
+    return _sample_due (streamer_telemetry_time ());
+}
+
+void
+streamer_telemetry_sample (int blocks_ready, int block_count, int output_buffer_bytes, int is_buffering) {
+    int64_t now = streamer_telemetry_time ();
+    if (!_sample_due (now)) {
+        return;
+    }
+    _last_sample_time = now;
+
+    ddb_streamer_telemetry_t s;
+    memset (&s, 0, sizeof (s));
+    s.time = now;
+    s.blocks_ready = blocks_ready;
+    s.block_count = block_count;
+    s.output_buffer_bytes = output_buffer_bytes;
+    s.is_buffering = is_buffering;
+    if (_decode_time > 0) {
+        s.decode_speed = (float)(_decode_duration * 1000000 / _decode_time);
+    }
+
+    int64_t dsp_time_total = __atomic_load_n (&_dsp_time_total, __ATOMIC_RELAXED);
+    int64_t dsp_blocks_total = __atomic_load_n (&_dsp_blocks_total, __ATOMIC_RELAXED);
+    if (dsp_blocks_total > _last_dsp_blocks_total) {
+        s.dsp_time = (float)((double)(dsp_time_total - _last_dsp_time_total) / (dsp_blocks_total - _last_dsp_blocks_total) / 1000000);
+    }
+    _last_dsp_time_total = dsp_time_total;
+    _last_dsp_blocks_total = dsp_blocks_total;
+
+    s.underruns = __atomic_load_n (&_underruns, __ATOMIC_RELAXED);
+    s.buffering_changes = __atomic_load_n (&_buffering_changes, __ATOMIC_RELAXED);
+
+    uint64_t n = _write_count;
+    telemetry_slot_t *slot = &_ring[n % RING_SIZE];
+    __atomic_store_n (&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    memcpy (&slot->sample, &s, sizeof (s));
+    __atomic_store_n (&slot->seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n (&_write_count, n + 1, __ATOMIC_RELEASE);
+}
+
+int
+streamer_telemetry_read (ddb_streamer_telemetry_t *samples, int count, uint64_t *cursor) {
+    uint64_t end = __atomic_load_n (&_write_count, __ATOMIC_ACQUIRE);
+    uint64_t n = *cursor;
+    if (n > end) {
+        n = end;
+    }
+    if (end - n > RING_SIZE) {
+        n = end - RING_SIZE;
+    }
+
+    int copied = 0;
+    for (; n < end && copied < count; n++) {
+        telemetry_slot_t *slot = &_ring[n % RING_SIZE];
+        if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != n + 1) {
+            continue; // overwritten by a newer sample
+        }
+        memcpy (&samples[copied], &slot->sample, sizeof (ddb_streamer_telemetry_t));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (&slot->seq, __ATOMIC_RELAXED) != n + 1) {
+            continue;
+        }
+        copied++;
+    }
+    *cursor = n;
+    return copied;
+}
+
+int
+streamer_telemetry_dump (const char *fname) {
+    FILE *fp = fopen (fname, "w");
+    if (!fp) {
+        return -1;
+    }
+
+    fprintf (fp, "time_us\tblocks_ready\tblock_count\toutput_buffer_bytes\tis_buffering\tdecode_speed\tdsp_time_us\tunderruns\tbuffering_changes\n");
+
+    uint64_t cursor = 0;
+    ddb_streamer_telemetry_t samples[64];
+    int n;
+    while ((n = streamer_telemetry_read (samples, 64, &cursor)) > 0) {
+        for (int i = 0; i < n; i++) {
+            ddb_streamer_telemetry_t *s = &samples[i];
+            fprintf (fp, "%lld\t%d\t%d\t%d\t%d\t%.2f\t%.1f\t%lld\t%lld\n",
+                     (long long)s->time,
+                     s->blocks_ready,
+                     s->block_count,
+                     s->output_buffer_bytes,
+                     s->is_buffering,
+                     s->decode_speed,
+                     s->dsp_time * 1000000,
+                     (long long)s->underruns,
+                     (long long)s->buffering_changes);
+        }
+    }
+
+    if (fclose (fp) != 0) {
+        return -1;
+    }
+    return 0;
+}
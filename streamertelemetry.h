@@ -0,0 +1,84 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef streamertelemetry_h
+#define streamertelemetry_h
+
+#include "deadbeef.h"
+#include "playlist.h"
+
+// Streamer and output health, sampled periodically by the streamer thread
+// into a ring of ddb_streamer_telemetry_t, which can be read from any thread without locking.
+// The samples are only written by the streamer thread,
+// the event counters can be updated from any thread.
+
+void
+streamer_telemetry_init (void);
+
+// Reads the sampling interval from the config
+void
+streamer_telemetry_configchanged (void);
+
+// Monotonic time in microseconds
+int64_t
+streamer_telemetry_time (void);
+
+// Called by the streamer thread after decoding a block of the track.
+// The decoding speed is tracked per track, and starts over when the track changes.
+void
+streamer_telemetry_block_decoded (playItem_t *track, int size, const ddb_waveformat_t *fmt, int64_t elapsed);
+
+// Called from the output thread after running a block through the DSP chain
+void
+streamer_telemetry_dsp_processed (int64_t elapsed);
+
+// The output plugin asked for more data than the streamer had ready
+void
+streamer_telemetry_underrun (void);
+
+void
+streamer_telemetry_buffering_changed (void);
+
+// Returns 1 if the sampling interval has passed since the previous sample.
+// Allows to skip collecting the sample values, which may require locking.
+int
+streamer_telemetry_sample_due (void);
+
+// Appends a sample to the ring, if the sampling interval has passed since the previous one.
+// Must be called from the streamer thread.
+void
+streamer_telemetry_sample (int blocks_ready, int block_count, int output_buffer_bytes, int is_buffering);
+
+// Copies up to count samples, starting from the sample number *cursor, oldest first.
+// If the samples were overwritten, the oldest available sample is returned first.
+// *cursor is updated to the number of the sample following the last returned one.
+// Returns the number of samples copied.
+int
+streamer_telemetry_read (ddb_streamer_telemetry_t *samples, int count, uint64_t *cursor);
+
+// Writes all available samples to a text file, one line per sample.
+// Returns 0 on success, -1 on failure.
+int
+streamer_telemetry_dump (const char *fname);
+
+#endif /* streamertelemetry_h */
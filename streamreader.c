@@ -25,12 +25,16 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "streamreader.h"
+#include "conf.h"
 #include "replaygain.h"
 #include "threading.h"
 
-// read ahead about 5 sec at 44100/16/2
-#define BLOCK_SIZE 16384
+// The amount of read-ahead is configured in seconds.
+// The number of blocks is fixed, and the block size is calculated from the format of the track being read,
+// e.g. 5 sec at 44100/16/2 gives 18375 byte blocks.
 #define BLOCK_COUNT 48
+#define MIN_BLOCK_SIZE 4096
+#define MAX_BLOCK_SIZE (2*1024*1024)
 
 static streamblock_t *blocks; // list of all blocks
 
@@ -46,17 +50,31 @@ static playItem_t *_prev_rg_track;
 static int _rg_settingschanged = 1;
 static int _firstblock = 0;
 
+static streamreader_profile_t _profile = STREAMREADER_PROFILE_DEFAULT;
+static float _target_seconds = 5;
+static int _curr_block_size; // block size for the format of the last read block
+static size_t _allocated_size; // total size of the block buffers
+
+// data decoded ahead of time from the beginning of a track, returned before reading from the decoder
+static DB_fileinfo_t *_prebuffer_fileinfo;
+static char *_prebuffer;
+static int _prebuffer_size;
+static int _prebuffer_pos;
+static int _prebuffer_eof;
+
 void
 streamreader_init (void) {
     _prev_rg_track = NULL;
     _rg_settingschanged = 1;
+    // the buffers are allocated on first use, when the format is known
     for (int i = 0; i < BLOCK_COUNT; i++) {
         streamblock_t *b = calloc (1, sizeof (streamblock_t));
         b->pos = -1;
-        b->buf = malloc (BLOCK_SIZE);
         b->next = blocks;
         blocks = b;
     }
+    _curr_block_size = 0;
+    _allocated_size = 0;
     block_next = blocks;
     numblocks_ready = 0;
     _firstblock = 0;
@@ -73,9 +91,63 @@ streamreader_free (void) {
     }
     block_next = block_data = NULL;
     numblocks_ready = 0;
+    _curr_block_size = 0;
+    _allocated_size = 0;
     _prev_rg_track = NULL;
     _rg_settingschanged = 1;
     _firstblock = 0;
+    streamreader_set_prebuffer (NULL, NULL, 0, 0);
+}
+
+void
+streamreader_set_prebuffer (DB_fileinfo_t *fileinfo, char *buffer, int size, int eof) {
+    free (_prebuffer);
+    _prebuffer_fileinfo = buffer ? fileinfo : NULL;
+    _prebuffer = buffer;
+    _prebuffer_size = size;
+    _prebuffer_pos = 0;
+    _prebuffer_eof = eof;
+}
+
+// Same as fileinfo->plugin->read, but returns the prebuffered data first
+static int
+_read (DB_fileinfo_t *fileinfo, char *bytes, int size) {
+    if (fileinfo != _prebuffer_fileinfo) {
+        return fileinfo->plugin->read (fileinfo, bytes, size);
+    }
+
+    int n = _prebuffer_size - _prebuffer_pos;
+    if (n > size) {
+        n = size;
+    }
+    memcpy (bytes, _prebuffer + _prebuffer_pos, n);
+    _prebuffer_pos += n;
+    if (_prebuffer_pos < _prebuffer_size) {
+        return n;
+    }
+
+    int eof = _prebuffer_eof;
+    streamreader_set_prebuffer (NULL, NULL, 0, 0);
+    if (eof || n == size) {
+        return n;
+    }
+
+    int rb = fileinfo->plugin->read (fileinfo, bytes + n, size - n);
+    if (rb < 0) {
+        return n > 0 ? n : rb;
+    }
+    return n + rb;
+}
+
+int
+streamreader_is_prebuffered (DB_fileinfo_t *fileinfo) {
+    return fileinfo && fileinfo == _prebuffer_fileinfo;
+}
+
+void
+streamreader_end_stream (streamblock_t *block) {
+    block->last = 1;
+    _firstblock = 1;
 }
 
 streamblock_t *
@@ -92,11 +164,62 @@ streamreader_get_next_block (void) {
 void
 streamreader_configchanged (void) {
     _rg_settingschanged = 1;
+
+    _profile = conf_get_int ("streamer.buffer_profile", STREAMREADER_PROFILE_DEFAULT);
+    switch (_profile) {
+    case STREAMREADER_PROFILE_LOW_LATENCY:
+        _target_seconds = 1;
+        break;
+    case STREAMREADER_PROFILE_LARGE:
+        _target_seconds = 30;
+        break;
+    default:
+        _profile = STREAMREADER_PROFILE_DEFAULT;
+        _target_seconds = 5;
+        break;
+    }
+
+    // explicit override of the profile duration
+    float seconds = conf_get_float ("streamer.buffer_seconds", 0);
+    if (seconds > 0) {
+        _target_seconds = seconds;
+    }
+}
+
+// Returns the block size which gives the configured read-ahead duration with the format
+static int
+_block_size_for_format (ddb_waveformat_t *fmt) {
+    int samplesize = fmt->channels * (fmt->bps>>3);
+    if (samplesize <= 0 || fmt->samplerate <= 0) {
+        return MIN_BLOCK_SIZE;
+    }
+    int64_t size = (int64_t)(_target_seconds * fmt->samplerate / BLOCK_COUNT) * samplesize;
+    if (size < MIN_BLOCK_SIZE) {
+        size = MIN_BLOCK_SIZE;
+    }
+    else if (size > MAX_BLOCK_SIZE) {
+        size = MAX_BLOCK_SIZE;
+    }
+    return (int)size;
+}
+
+// Makes sure the free block can hold the requested amount of data.
+// Oversized buffers are shrunk, to release the memory after playing high resolution formats.
+static void
+_block_reserve (streamblock_t *block, int size) {
+    if (block->bufsize >= size && block->bufsize <= size * 2) {
+        return;
+    }
+    _allocated_size -= block->bufsize;
+    free (block->buf);
+    block->buf = malloc (size);
+    block->bufsize = size;
+    _allocated_size += size;
 }
 
 int
 streamreader_read_block (streamblock_t *block, playItem_t *track, DB_fileinfo_t *fileinfo, uint64_t mutex) {
-    int size = BLOCK_SIZE;
+    int size = _block_size_for_format (&fileinfo->fmt);
     int samplesize = fileinfo->fmt.channels * (fileinfo->fmt.bps>>3);
 
     // NOTE: samplesize has to be checked to protect against faulty input plugins
@@ -116,6 +239,10 @@ streamreader_read_block (streamblock_t *block, playItem_t *track, DB_fileinfo_t
 
     // replaygain settings
     mutex_lock (mutex);
+    if (size > 0) {
+        _block_reserve (block, size);
+        _curr_block_size = size;
+    }
     if (_rg_settingschanged || _prev_rg_track != track) {
         _prev_rg_track = track;
         _rg_settingschanged = 0;
@@ -130,7 +257,7 @@ streamreader_read_block (streamblock_t *block, playItem_t *track, DB_fileinfo_t
     curr_block_bitrate = -1;
     int rb;
     if (size > 0) {
-        rb = fileinfo->plugin->read (fileinfo, block->buf, size);
+        rb = _read (fileinfo, block->buf, size);
     }
     else {
         rb = -1;
@@ -184,11 +311,17 @@ streamreader_read_block (streamblock_t *block, playItem_t *track, DB_fileinfo_t
 int
 streamreader_silence_block (streamblock_t *block, playItem_t *track, DB_fileinfo_t *fileinfo, uint64_t mutex) {
     curr_block_bitrate = -1;
+    int size = _block_size_for_format (&fileinfo->fmt);
+    int samplesize = fileinfo->fmt.channels * (fileinfo->fmt.bps>>3);
+    if (samplesize > 0) {
+        size -= size % samplesize;
+    }
     mutex_lock (mutex);
+    _block_reserve (block, size);
     block->bitrate = -1;
     block->pos = 0;
-    memset (block->buf, 0, BLOCK_SIZE);
-    block->size = BLOCK_SIZE;
+    memset (block->buf, 0, size);
+    block->size = size;
 
     memcpy (&block->fmt, &fileinfo->fmt, sizeof (ddb_waveformat_t));
     block->track = track;
@@ -321,3 +454,12 @@ streamreader_flush_after (playItem_t *it) {
         n--;
     }
 }
+
+void
+streamreader_get_buffer_info (streamreader_buffer_info_t *info) {
+    info->profile = _profile;
+    info->target_seconds = _target_seconds;
+    info->block_count = BLOCK_COUNT;
+    info->block_size = _curr_block_size;
+    info->allocated_size = _allocated_size;
+}
@@ -27,10 +27,26 @@
 #include "deadbeef.h"
 #include "playlist.h"
 
+// Read-ahead buffering profiles, selected by streamer.buffer_profile
+typedef enum {
+    STREAMREADER_PROFILE_DEFAULT = 0, // 5 seconds
+    STREAMREADER_PROFILE_LOW_LATENCY = 1, // 1 second, for faster seeking and track changes
+    STREAMREADER_PROFILE_LARGE = 2, // 30 seconds, for network streams and slow network file systems
+} streamreader_profile_t;
+
+typedef struct {
+    streamreader_profile_t profile;
+    float target_seconds; // read-ahead duration
+    int block_count;
+    int block_size; // size of the blocks for the format of the current stream
+    size_t allocated_size; // total memory used by the blocks
+} streamreader_buffer_info_t;
+
 typedef struct streamblock_s {
     struct streamblock_s *next;
     char *buf;
-    int size; // how much bytes total in the buffer, up to BLOCK_SIZE, but can be less
+    int bufsize; // allocated size of the buffer, depends on the format of the data
+    int size; // how much bytes total in the buffer, up to bufsize, but can be less
     int pos; // read position in the buffer
     int first; // set to 1 for the first buffer of the stream, following the block with last=1
     int last; // set to 1 for last buffer of the stream
@@ -93,4 +109,25 @@ streamreader_configchanged (void);
 void
 streamreader_flush_after (playItem_t *it);
 
+// Makes the next reads from the fileinfo return the data from the buffer first.
+// The buffer must contain decoded data from the current read position, and is freed by the streamreader.
+// If eof is set, the buffer contains the rest of the track.
+// Pass NULL buffer to drop the previous one, e.g. after seeking.
+void
+streamreader_set_prebuffer (DB_fileinfo_t *fileinfo, char *buffer, int size, int eof);
+
+// Returns 1 if the next reads from the fileinfo will return the prebuffered data
+int
+streamreader_is_prebuffered (DB_fileinfo_t *fileinfo);
+
+// Marks the block as the last one of the current track, the next read block will be marked as first.
+// Used for switching to the next track before the end of the current one.
+// The mutex must be locked
+void
+streamreader_end_stream (streamblock_t *block);
+
+// The mutex must be locked
+void
+streamreader_get_buffer_info (streamreader_buffer_info_t *info);
+
 #endif /* streamreader_h */
@@ -0,0 +1,450 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "conf.h"
+#include "threading.h"
+#include "threadpool.h"
+
+//#define trace(...) { fprintf(stderr, __VA_ARGS__); }
+#define trace(fmt,...)
+
+#define MAX_WORKERS 32
+
+typedef struct task_s {
+    void (*fn)(void *ctx);
+    void *ctx;
+    struct task_s *next;
+} task_t;
+
+struct ddb_task_group_s {
+    char *name;
+    ddb_task_priority_t priority;
+    int max_concurrency;
+    int running;
+    int cancelled;
+    task_t *head;
+    task_t *tail;
+
+    // a group is in the run queue while it has pending tasks and is below its concurrency limit
+    int queued;
+    struct ddb_task_group_s *next_queued;
+
+    // signalled when the group becomes idle
+    pthread_cond_t idle_cond;
+
+    struct ddb_task_group_s *next;
+};
+
+typedef struct {
+    ddb_task_group_t *head;
+    ddb_task_group_t *tail;
+} runqueue_t;
+
+// NOTE: pthread primitives are used directly, because the waits below need to atomically release the lock
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _cond = PTHREAD_COND_INITIALIZER;
+static int _initialized;
+static runqueue_t _runqueues[DDB_TASK_PRIORITY_COUNT];
+static ddb_task_group_t *_groups;
+static intptr_t _workers[MAX_WORKERS];
+static int _worker_count;
+static int _terminate;
+
+// running tasks of the groups below DDB_TASK_PRIORITY_HIGH;
+// one worker is reserved for the high priority tasks, so that they don't wait behind long running ones
+static int _running_low;
+
+static int
+_low_priority_can_run (void) {
+    return _worker_count <= 1 || _running_low < _worker_count - 1;
+}
+
+static void
+_runqueue_append (ddb_task_group_t *group) {
+    runqueue_t *q = &_runqueues[group->priority];
+    group->queued = 1;
+    group->next_queued = NULL;
+    if (q->tail) {
+        q->tail->next_queued = group;
+    }
+    else {
+        q->head = group;
+    }
+    q->tail = group;
+}
+
+static ddb_task_group_t *
+_runqueue_pop (void) {
+    for (int p = 0; p < DDB_TASK_PRIORITY_COUNT; p++) {
+        if (p != DDB_TASK_PRIORITY_HIGH && !_low_priority_can_run ()) {
+            break;
+        }
+        runqueue_t *q = &_runqueues[p];
+        ddb_task_group_t *group = q->head;
+        if (group) {
+            q->head = group->next_queued;
+            if (!q->head) {
+                q->tail = NULL;
+            }
+            group->queued = 0;
+            group->next_queued = NULL;
+            return group;
+        }
+    }
+    return NULL;
+}
+
+static int
+_group_can_run (ddb_task_group_t *group) {
+    return group->head != NULL && group->running < group->max_concurrency;
+}
+
+static void
+_worker_thread (void *ctx) {
+    pthread_mutex_lock (&_mutex);
+    for (;;) {
+        ddb_task_group_t *group = _runqueue_pop ();
+        if (!group) {
+            if (_terminate) {
+                break;
+            }
+            pthread_cond_wait (&_cond, &_mutex);
+            continue;
+        }
+
+        task_t *task = group->head;
+        if (!task) {
+            // the pending tasks were taken back by task_parallel_for
+            continue;
+        }
+        group->head = task->next;
+        if (!group->head) {
+            group->tail = NULL;
+        }
+        group->running++;
+        if (group->priority != DDB_TASK_PRIORITY_HIGH) {
+            _running_low++;
+        }
+
+        // requeue at the tail, so that groups with the same priority take turns
+        if (_group_can_run (group)) {
+            _runqueue_append (group);
+        }
+
+        pthread_mutex_unlock (&_mutex);
+        task->fn (task->ctx);
+        free (task);
+        pthread_mutex_lock (&_mutex);
+
+        group->running--;
+        if (group->priority != DDB_TASK_PRIORITY_HIGH) {
+            _running_low--;
+        }
+        if (!group->queued && _group_can_run (group)) {
+            _runqueue_append (group);
+            pthread_cond_signal (&_cond);
+        }
+        if (!group->running && !group->head) {
+            pthread_cond_broadcast (&group->idle_cond);
+        }
+    }
+    pthread_mutex_unlock (&_mutex);
+}
+
+int
+threadpool_init (void) {
+    _terminate = 0;
+    _initialized = 1;
+
+    // leave one core to the streamer and the output
+    long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+    int count = conf_get_int ("threadpool.max_workers", 0);
+    if (count <= 0) {
+        count = ncpu > 1 ? (int)ncpu - 1 : 1;
+    }
+    if (count > MAX_WORKERS) {
+        count = MAX_WORKERS;
+    }
+
+    for (int i = 0; i < count; i++) {
+        _workers[i] = thread_start_low_priority (_worker_thread, NULL);
+        if (!_workers[i]) {
+            break;
+        }
+        _worker_count++;
+    }
+    trace ("threadpool: started %d workers\n", _worker_count);
+    return _worker_count > 0 ? 0 : -1;
+}
+
+void
+threadpool_free (void) {
+    if (!_initialized) {
+        return;
+    }
+    pthread_mutex_lock (&_mutex);
+    for (ddb_task_group_t *group = _groups; group; group = group->next) {
+        group->cancelled = 1;
+    }
+    _terminate = 1;
+    pthread_cond_broadcast (&_cond);
+    pthread_mutex_unlock (&_mutex);
+
+    // the workers drain the remaining tasks before exiting; cancelled groups are expected to return quickly
+    for (int i = 0; i < _worker_count; i++) {
+        thread_join (_workers[i]);
+        _workers[i] = 0;
+    }
+    _worker_count = 0;
+    _initialized = 0;
+}
+
+int
+threadpool_get_worker_count (void) {
+    return _worker_count;
+}
+
+ddb_task_group_t *
+task_group_create (const char *name, ddb_task_priority_t priority, int max_concurrency) {
+    if (priority < 0 || priority >= DDB_TASK_PRIORITY_COUNT) {
+        return NULL;
+    }
+    ddb_task_group_t *group = calloc (1, sizeof (ddb_task_group_t));
+    group->name = strdup (name ? name : "");
+    group->priority = priority;
+    group->max_concurrency = max_concurrency > 0 && max_concurrency < _worker_count ? max_concurrency : _worker_count;
+    if (group->max_concurrency <= 0) {
+        group->max_concurrency = 1;
+    }
+    pthread_cond_init (&group->idle_cond, NULL);
+
+    pthread_mutex_lock (&_mutex);
+    group->next = _groups;
+    _groups = group;
+    pthread_mutex_unlock (&_mutex);
+    return group;
+}
+
+void
+task_group_free (ddb_task_group_t *group) {
+    task_group_cancel (group);
+    task_group_wait (group);
+
+    pthread_mutex_lock (&_mutex);
+    ddb_task_group_t *prev = NULL;
+    for (ddb_task_group_t *g = _groups; g; prev = g, g = g->next) {
+        if (g == group) {
+            if (prev) {
+                prev->next = g->next;
+            }
+            else {
+                _groups = g->next;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock (&_mutex);
+
+    pthread_cond_destroy (&group->idle_cond);
+    free (group->name);
+    free (group);
+}
+
+int
+task_group_submit (ddb_task_group_t *group, void (*fn)(void *ctx), void *ctx) {
+    task_t *task = calloc (1, sizeof (task_t));
+    task->fn = fn;
+    task->ctx = ctx;
+
+    pthread_mutex_lock (&_mutex);
+    if (_terminate || !_worker_count) {
+        pthread_mutex_unlock (&_mutex);
+        free (task);
+        return -1;
+    }
+    if (group->tail) {
+        group->tail->next = task;
+    }
+    else {
+        group->head = task;
+    }
+    group->tail = task;
+
+    if (!group->queued && _group_can_run (group)) {
+        _runqueue_append (group);
+        pthread_cond_signal (&_cond);
+    }
+    pthread_mutex_unlock (&_mutex);
+    return 0;
+}
+
+void
+task_group_cancel (ddb_task_group_t *group) {
+    pthread_mutex_lock (&_mutex);
+    group->cancelled = 1;
+    pthread_mutex_unlock (&_mutex);
+}
+
+int
+task_group_is_cancelled (ddb_task_group_t *group) {
+    pthread_mutex_lock (&_mutex);
+    int cancelled = group->cancelled;
+    pthread_mutex_unlock (&_mutex);
+    return cancelled;
+}
+
+void
+task_group_wait (ddb_task_group_t *group) {
+    pthread_mutex_lock (&_mutex);
+    while (group->running || group->head) {
+        pthread_cond_wait (&group->idle_cond, &_mutex);
+    }
+    pthread_mutex_unlock (&_mutex);
+}
+
+// parallel for
+
+typedef struct {
+    ddb_task_group_t *group;
+    void (*fn)(void *ctx, int index);
+    void *ctx;
+    int count;
+    int next_index;
+    int active_helpers;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} parallel_for_t;
+
+static void
+_parallel_for_run (parallel_for_t *pf) {
+    for (;;) {
+        pthread_mutex_lock (&pf->mutex);
+        int index = pf->next_index < pf->count ? pf->next_index++ : -1;
+        pthread_mutex_unlock (&pf->mutex);
+        if (index < 0 || task_group_is_cancelled (pf->group)) {
+            break;
+        }
+        pf->fn (pf->ctx, index);
+    }
+}
+
+static void
+_parallel_for_helper (void *ctx) {
+    parallel_for_t *pf = ctx;
+    _parallel_for_run (pf);
+    pthread_mutex_lock (&pf->mutex);
+    pf->active_helpers--;
+    pthread_cond_signal (&pf->cond);
+    pthread_mutex_unlock (&pf->mutex);
+}
+
+// Takes the helper tasks which haven't been started yet out of the group.
+// Returns the number of removed tasks.
+static int
+_parallel_for_unqueue_helpers (parallel_for_t *pf) {
+    ddb_task_group_t *group = pf->group;
+    int removed = 0;
+    pthread_mutex_lock (&_mutex);
+    task_t *prev = NULL;
+    task_t *task = group->head;
+    while (task) {
+        task_t *next = task->next;
+        if (task->fn == _parallel_for_helper && task->ctx == pf) {
+            if (prev) {
+                prev->next = next;
+            }
+            else {
+                group->head = next;
+            }
+            if (group->tail == task) {
+                group->tail = prev;
+            }
+            free (task);
+            removed++;
+        }
+        else {
+            prev = task;
+        }
+        task = next;
+    }
+    if (removed && !group->running && !group->head) {
+        pthread_cond_broadcast (&group->idle_cond);
+    }
+    pthread_mutex_unlock (&_mutex);
+    return removed;
+}
+
+void
+task_parallel_for (ddb_task_group_t *group, int count, void (*fn)(void *ctx, int index), void *ctx) {
+    if (count <= 0) {
+        return;
+    }
+
+    parallel_for_t pf = {
+        .group = group,
+        .fn = fn,
+        .ctx = ctx,
+        .count = count,
+    };
+    pthread_mutex_init (&pf.mutex, NULL);
+    pthread_cond_init (&pf.cond, NULL);
+
+    // the calling thread takes part in the loop, so it's never blocked on a busy pool;
+    // when the group has no free slots (e.g. called from a task of the same group), the loop runs inline
+    pthread_mutex_lock (&_mutex);
+    int helpers = group->max_concurrency - group->running;
+    pthread_mutex_unlock (&_mutex);
+    if (helpers > count - 1) {
+        helpers = count - 1;
+    }
+    for (int i = 0; i < helpers; i++) {
+        pthread_mutex_lock (&pf.mutex);
+        pf.active_helpers++;
+        pthread_mutex_unlock (&pf.mutex);
+        if (task_group_submit (group, _parallel_for_helper, &pf) < 0) {
+            pthread_mutex_lock (&pf.mutex);
+            pf.active_helpers--;
+            pthread_mutex_unlock (&pf.mutex);
+            break;
+        }
+    }
+
+    _parallel_for_run (&pf);
+
+    // the helpers which didn't get a slot while the loop was running are not needed anymore
+    int removed = _parallel_for_unqueue_helpers (&pf);
+
+    pthread_mutex_lock (&pf.mutex);
+    pf.active_helpers -= removed;
+    while (pf.active_helpers > 0) {
+        pthread_cond_wait (&pf.cond, &pf.mutex);
+    }
+    pthread_mutex_unlock (&pf.mutex);
+
+    pthread_cond_destroy (&pf.cond);
+    pthread_mutex_destroy (&pf.mutex);
+}
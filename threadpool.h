@@ -0,0 +1,61 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2026 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef threadpool_h
+#define threadpool_h
+
+#include "deadbeef.h"
+
+int
+threadpool_init (void);
+
+// Cancels all groups, waits for the running tasks to finish, and stops the workers.
+void
+threadpool_free (void);
+
+int
+threadpool_get_worker_count (void);
+
+ddb_task_group_t *
+task_group_create (const char *name, ddb_task_priority_t priority, int max_concurrency);
+
+// Cancels and waits for the group, then frees it.
+void
+task_group_free (ddb_task_group_t *group);
+
+int
+task_group_submit (ddb_task_group_t *group, void (*fn)(void *ctx), void *ctx);
+
+void
+task_group_cancel (ddb_task_group_t *group);
+
+int
+task_group_is_cancelled (ddb_task_group_t *group);
+
+void
+task_group_wait (ddb_task_group_t *group);
+
+void
+task_parallel_for (ddb_task_group_t *group, int count, void (*fn)(void *ctx, int index), void *ctx);
+
+#endif /* threadpool_h */
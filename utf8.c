@@ -45,6 +45,11 @@
 #include "utf8.h"
 #include "u8_lc_map.h"
 #include "u8_uc_map.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 static const uint32_t offsetsFromUTF8[6] = {
     0x00000000UL, 0x00003080UL, 0x000E2080UL,
@@ -787,38 +792,194 @@ utfcasestr (const char *s1, const char *s2) {
 }
 
 #define min(x,y) ((x)<(y)?(x):(y))
-// s2 must be lowercase
+
+// Returns the end of the match, if s1 starts with the lowercase s2 (case-insensitively), or NULL
+static const char *
+_casestr_match_at (const char *s1, const char *s2) {
+    const char *p1 = s1;
+    const char *p2 = s2;
+    while (*p2 && *p1) {
+        int32_t i1 = 0;
+        int32_t i2 = 0;
+        char lw1[10];
+        u8_nextchar (p1, &i1);
+        u8_nextchar (p2, &i2);
+        int l1 = u8_tolower ((const signed char *)p1, i1, lw1);
+        if (memcmp (lw1, p2, min(i2,l1))) {
+            break;
+        }
+        p1 += i1;
+        p2 += i2;
+    }
+    if (*p2 == 0) {
+        return p1;
+    }
+    return NULL;
+}
+
+void
+u8_casestr_needle_init (u8_casestr_needle_t *needle, const char *lowercase_text) {
+    needle->text = lowercase_text;
+    needle->len = strlen (lowercase_text);
+    needle->is_ascii = 1;
+    for (size_t i = 0; i < needle->len; i++) {
+        if ((uint8_t)lowercase_text[i] >= 0x80) {
+            needle->is_ascii = 0;
+            break;
+        }
+    }
+    uint8_t c = (uint8_t)lowercase_text[0];
+    needle->first_lower = c;
+    needle->first_upper = (c >= 'a' && c <= 'z') ? c - 0x20 : c;
+}
+
+// Returns the first byte which is either of the two characters, a non-ascii byte, or the terminating zero.
+// The loads are aligned, so they never cross into the next page past the end of the string.
+static const char *
+_scan_ascii (const char *s, uint8_t c1, uint8_t c2) {
+#if defined(__SSE2__)
+    const __m128i v1 = _mm_set1_epi8 ((char)c1);
+    const __m128i v2 = _mm_set1_epi8 ((char)c2);
+    const __m128i zero = _mm_setzero_si128 ();
+    uintptr_t offset = (uintptr_t)s & 15;
+    const __m128i *p = (const __m128i *)(s - offset);
+    unsigned mask = 0xffff << offset;
+    for (;;) {
+        __m128i v = _mm_load_si128 (p);
+        // non-ascii bytes have the sign bit set
+        __m128i hit = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, v1), _mm_cmpeq_epi8 (v, v2)), _mm_cmpeq_epi8 (v, zero));
+        unsigned bits = ((unsigned)_mm_movemask_epi8 (hit) | (unsigned)_mm_movemask_epi8 (v)) & mask;
+        if (bits) {
+            return (const char *)p + __builtin_ctz (bits);
+        }
+        mask = 0xffff;
+        p++;
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t v1 = vdupq_n_u8 (c1);
+    const uint8x16_t v2 = vdupq_n_u8 (c2);
+    const uint8x16_t high = vdupq_n_u8 (0x80);
+    const uint8x16_t zero = vdupq_n_u8 (0);
+    uintptr_t offset = (uintptr_t)s & 15;
+    const uint8_t *p = (const uint8_t *)(s - offset);
+    for (;;) {
+        uint8x16_t v = vld1q_u8 (p);
+        uint8x16_t hit = vorrq_u8 (vorrq_u8 (vceqq_u8 (v, v1), vceqq_u8 (v, v2)), vorrq_u8 (vceqq_u8 (v, zero), vcgeq_u8 (v, high)));
+        // narrow to 4 bits per byte
+        uint64_t bits = vget_lane_u64 (vreinterpret_u64_u8 (vshrn_n_u16 (vreinterpretq_u16_u8 (hit), 4)), 0);
+        bits &= ~0ULL << (offset * 4);
+        if (bits) {
+            return (const char *)p + (__builtin_ctzll (bits) >> 2);
+        }
+        offset = 0;
+        p += 16;
+    }
+#else
+    for (;;) {
+        uint8_t c = (uint8_t)*s;
+        if (c == c1 || c == c2 || c == 0 || c >= 0x80) {
+            return s;
+        }
+        s++;
+    }
+#endif
+}
+
 const char *
-utfcasestr_fast (const char *s1, const char *s2) {
-    while (*s1) {
-        const char *p1 = s1;
-        const char *p2 = s2;
-        while (*p2 && *p1) {
-            int32_t i1 = 0;
-            int32_t i2 = 0;
-            char lw1[10];
-            u8_nextchar (p1, &i1);
-            u8_nextchar (p2, &i2);
-            int l1 = u8_tolower ((const signed char *)p1, i1, lw1);
-            if (memcmp (lw1, p2, min(i2,l1))) {
+utfcasestr_needle (const char *s1, const u8_casestr_needle_t *needle) {
+    if (!needle->len) {
+        return s1;
+    }
+
+    if (!needle->is_ascii) {
+        while (*s1) {
+            const char *end = _casestr_match_at (s1, needle->text);
+            if (end) {
+                return end;
+            }
+            int32_t i = 0;
+            u8_nextchar (s1, &i);
+            s1 += i;
+        }
+        return NULL;
+    }
+
+    // The ascii needle can only match ascii text, which is compared bytewise.
+    // Near the non-ascii characters, the positions are checked with the full unicode case folding.
+    const char *p = s1;
+    const char *checked = s1; // positions before this one were checked with case folding
+    for (;;) {
+        p = _scan_ascii (p, needle->first_lower, needle->first_upper);
+        uint8_t c = (uint8_t)*p;
+        if (c == 0) {
+            return NULL;
+        }
+        if (c >= 0x80) {
+            // the matches which include this character could start up to len-1 bytes before it
+            const char *start = p - min ((size_t)(p - checked), needle->len - 1);
+            int32_t i = 0;
+            u8_nextchar (p, &i);
+            const char *next = p + i;
+            while (start < next) {
+                const char *end = _casestr_match_at (start, needle->text);
+                if (end) {
+                    return end;
+                }
+                int32_t l = 0;
+                u8_nextchar (start, &l);
+                start += l;
+            }
+            p = checked = next;
+            continue;
+        }
+        size_t n = 1;
+        while (n < needle->len) {
+            uint8_t h = (uint8_t)p[n];
+            if (h >= 'A' && h <= 'Z') {
+                h += 0x20;
+            }
+            if (h != (uint8_t)needle->text[n]) {
                 break;
             }
-            p1 += i1;
-            p2 += i2;
+            n++;
         }
-        if (*p2 == 0) {
-            return p1;
+        if (n == needle->len) {
+            return p + n;
         }
-        int32_t i = 0;
-        u8_nextchar (s1, &i);
-        s1 += i;
+        p++;
     }
-    return NULL;
+}
+
+// s2 must be lowercase
+const char *
+utfcasestr_fast (const char *s1, const char *s2) {
+    u8_casestr_needle_t needle;
+    u8_casestr_needle_init (&needle, s2);
+    return utfcasestr_needle (s1, &needle);
 }
 
 int
 u8_strcasecmp (const char *a, const char *b) {
     const char *p1 = a, *p2 = b;
+    // ascii prefix
+    for (;;) {
+        uint8_t c1 = (uint8_t)*p1;
+        uint8_t c2 = (uint8_t)*p2;
+        if (!c1 || !c2 || c1 >= 0x80 || c2 >= 0x80) {
+            break;
+        }
+        if (c1 >= 'A' && c1 <= 'Z') {
+            c1 += 0x20;
+        }
+        if (c2 >= 'A' && c2 <= 'Z') {
+            c2 += 0x20;
+        }
+        if (c1 != c2) {
+            return c1 - c2;
+        }
+        p1++;
+        p2++;
+    }
     while (*p1 && *p2) {
         int32_t i1 = 0;
         int32_t i2 = 0;
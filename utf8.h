@@ -139,4 +139,20 @@ utfcasestr (const char *s1, const char *s2);
 const char *
 utfcasestr_fast (const char *s1, const char *s2);
 
+// lowercase search string, prepared for matching against many strings
+typedef struct {
+    const char *text;
+    size_t len;
+    int is_ascii;
+    uint8_t first_lower;
+    uint8_t first_upper;
+} u8_casestr_needle_t;
+
+void
+u8_casestr_needle_init (u8_casestr_needle_t *needle, const char *lowercase_text);
+
+// same as utfcasestr_fast, with the search string prepared by u8_casestr_needle_init
+const char *
+utfcasestr_needle (const char *s1, const u8_casestr_needle_t *needle);
+
 #endif
@@ -174,3 +174,15 @@ vfs_abort_with_identifier (DB_vfs_t *vfs, uint64_t identifier) {
         vfs->abort_with_identifier (identifier);
     }
 }
+
+const uint8_t *
+vfs_get_region (DB_FILE *stream, int64_t offset, int64_t size) {
+    // older plugins don't have this method
+    if (stream->vfs->plugin.api_vminor < 17 || !stream->vfs->get_region) {
+        return NULL;
+    }
+    if (!can_use_file (stream)) {
+        return NULL;
+    }
+    return stream->vfs->get_region (stream, offset, size);
+}
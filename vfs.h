@@ -42,5 +42,6 @@ const char *vfs_get_content_type (DB_FILE *stream);
 void vfs_fabort (DB_FILE *stream);
 uint64_t vfs_get_identifier (DB_FILE *stream);
 void vfs_abort_with_identifier (DB_vfs_t *vfs, uint64_t identifier);
+const uint8_t *vfs_get_region (DB_FILE *stream, int64_t offset, int64_t size);
 
 #endif // __VFS_H
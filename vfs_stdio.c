@@ -31,6 +31,9 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef __MINGW32__
+#include <sys/mman.h>
+#endif
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -44,7 +47,15 @@
 #define USE_BUFFERING
 
 #ifndef USE_STDIO
-#define BUFSIZE 1024
+#define BUFSIZE 16384
+// don't map huge files on 32 bit systems, to keep the address space
+#define MMAP_MAX_SIZE (sizeof (void *) >= 8 ? INT64_MAX : ((int64_t)256 << 20))
+// the offset of a mapping must be aligned to this
+#ifdef __MINGW32__
+#define MMAP_ALIGN ((int64_t)65536)
+#else
+#define MMAP_ALIGN ((int64_t)sysconf (_SC_PAGESIZE))
+#endif
 #endif
 
 static DB_functions_t *deadbeef;
@@ -54,19 +65,83 @@ typedef struct {
     FILE *stream;
 #else
     int stream;
-    int64_t offs;
+    int64_t offs; // read position
+    int64_t pos; // position of the file descriptor, to skip redundant lseek calls
+    int have_size;
+    int64_t size;
+    const uint8_t *map; // the whole file, when opened in mmap mode
 #ifdef USE_BUFFERING
     uint8_t buffer[BUFSIZE];
-    uint8_t *bufptr;
-    int bufremaining;
+    int64_t bufoffs; // file offset of the buffered data
+    int buffill;
 #endif
-    int have_size;
-    size_t size;
+    // data returned by get_region, when the whole file is not mapped:
+    // either a mapping of the pages containing it, or a copy in the region buffer
+    uint8_t *region;
+    size_t region_size;
+    void *region_map;
+    size_t region_map_size;
+    int64_t region_offset; // file range of the returned data
+    int64_t region_end;
 #endif
 } STDIO_FILE;
 
 static DB_vfs_t plugin;
 
+static int conf_use_mmap;
+
+#ifndef USE_STDIO
+static void
+release_region (STDIO_FILE *f) {
+    if (f->region_map) {
+        munmap (f->region_map, f->region_map_size);
+        f->region_map = NULL;
+        f->region_map_size = 0;
+    }
+    if (f->region_size > BUFSIZE) {
+        // don't keep large copies around
+        free (f->region);
+        f->region = NULL;
+        f->region_size = 0;
+    }
+    f->region_offset = f->region_end = 0;
+}
+
+// The region is released once the read position moves out of it
+static void
+release_region_at_offs (STDIO_FILE *f) {
+    if (f->region_end > 0 && (f->offs < f->region_offset || f->offs >= f->region_end)) {
+        release_region (f);
+    }
+}
+
+// Reads from the absolute offset, only seeks the descriptor when needed
+static ssize_t
+read_at (STDIO_FILE *f, int64_t offset, void *ptr, size_t size) {
+    if (f->pos != offset) {
+        if (lseek64 (f->stream, offset, SEEK_SET) == -1) {
+            f->pos = -1;
+            return -1;
+        }
+        f->pos = offset;
+    }
+    size_t total = 0;
+    while (total < size) {
+        ssize_t rb = read (f->stream, (uint8_t *)ptr + total, size - total);
+        if (rb < 0) {
+            f->pos = -1;
+            return total > 0 ? (ssize_t)total : -1;
+        }
+        if (rb == 0) {
+            break;
+        }
+        total += rb;
+        f->pos += rb;
+    }
+    return total;
+}
+#endif
+
 static DB_FILE *
 stdio_open (const char *fname) {
     if (!memcmp (fname, "file://", 7)) {
@@ -87,6 +162,28 @@ stdio_open (const char *fname) {
     memset (fp, 0, sizeof (STDIO_FILE));
     fp->vfs = &plugin;
     fp->stream = file;
+#ifndef USE_STDIO
+    struct stat st;
+    if (!fstat (file, &st) && S_ISREG (st.st_mode)) {
+        fp->size = st.st_size;
+        fp->have_size = 1;
+        if (conf_use_mmap && fp->size > 0 && fp->size <= MMAP_MAX_SIZE) {
+            void *map = mmap (NULL, (size_t)fp->size, PROT_READ, MAP_SHARED, file, 0);
+            if (map != MAP_FAILED) {
+                fp->map = map;
+#ifdef MADV_SEQUENTIAL
+                madvise (map, (size_t)fp->size, MADV_SEQUENTIAL);
+#endif
+            }
+        }
+#if defined(POSIX_FADV_SEQUENTIAL)
+        if (!fp->map) {
+            // larger kernel readahead for decoding
+            posix_fadvise (file, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+    }
+#endif
     return (DB_FILE*)fp;
 }
 
@@ -96,29 +193,17 @@ stdio_close (DB_FILE *stream) {
 #ifdef USE_STDIO
     fclose (((STDIO_FILE *)stream)->stream);
 #else
-    close (((STDIO_FILE *)stream)->stream);
+    STDIO_FILE *f = (STDIO_FILE *)stream;
+    if (f->map) {
+        munmap ((void *)f->map, (size_t)f->size);
+    }
+    release_region (f);
+    free (f->region);
+    close (f->stream);
 #endif
     free (stream);
 }
 
-#ifndef USE_STDIO
-#ifdef USE_BUFFERING
-static int
-fillbuffer (STDIO_FILE *f) {
-    assert (f->bufremaining >= 0);
-    if (f->bufremaining == 0) {
-        f->bufremaining = (int)read (f->stream, f->buffer, BUFSIZE);
-        if (f->bufremaining < 0) {
-            f->bufremaining = 0;
-            return -1;
-        }
-        f->bufptr = f->buffer;
-    }
-    return f->bufremaining;
-}
-#endif
-#endif
-
 static size_t
 stdio_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
     assert (stream);
@@ -129,25 +214,54 @@ stdio_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
     STDIO_FILE *f = (STDIO_FILE*)stream;
 
     size_t nb = size * nmemb;
+    release_region_at_offs (f);
+    if (f->map) {
+        size_t n = f->offs < f->size ? (size_t)(f->size - f->offs) : 0;
+        if (n > nb) {
+            n = nb;
+        }
+        memcpy (ptr, f->map + f->offs, n);
+        f->offs += n;
+        return n / size;
+    }
 #ifdef USE_BUFFERING
     while (nb > 0) {
-        if (fillbuffer (f) <= 0) {
+        int64_t bufpos = f->offs - f->bufoffs;
+        if (bufpos >= 0 && bufpos < f->buffill) {
+            size_t r = f->buffill - bufpos;
+            if (r > nb) {
+                r = nb;
+            }
+            memcpy (ptr, f->buffer + bufpos, r);
+            ptr += r;
+            f->offs += r;
+            nb -= r;
+            continue;
+        }
+
+        if (nb >= BUFSIZE) {
+            // large reads go directly to the destination
+            ssize_t rb = read_at (f, f->offs, ptr, nb);
+            if (rb <= 0) {
+                break;
+            }
+            ptr += rb;
+            f->offs += rb;
+            nb -= rb;
             break;
         }
-        int r = f->bufremaining;
-        if (r > nb) {
-            r = (int)nb;
+
+        ssize_t rb = read_at (f, f->offs, f->buffer, BUFSIZE);
+        if (rb <= 0) {
+            f->buffill = 0;
+            break;
         }
-        memcpy (ptr, f->bufptr, r);
-        f->bufremaining -= r;
-        f->bufptr += r;
-        ptr += r;
-        f->offs += r;
-        nb -= r;
+        f->bufoffs = f->offs;
+        f->buffill = (int)rb;
     }
     size_t ret = ((size * nmemb) - nb) / size;
 #else
-    ssize_t ret = read (f->stream, ptr, nb);
+    ssize_t ret = read_at (f, f->offs, ptr, nb);
     if (ret < 0) {
         return -1;
     }
@@ -158,26 +272,32 @@ stdio_read (void *ptr, size_t size, size_t nmemb, DB_FILE *stream) {
 #endif
 }
 
+static int64_t
+stdio_getlength (DB_FILE *stream);
+
 static int
 stdio_seek (DB_FILE *stream, int64_t offset, int whence) {
     assert (stream);
 #ifdef USE_STDIO
     return fseek (((STDIO_FILE *)stream)->stream, offset, whence);
 #else
-    // convert offset to absolute
+    STDIO_FILE *f = (STDIO_FILE *)stream;
+    // convert offset to absolute, the descriptor is positioned on the next read
     if (whence == SEEK_CUR) {
-        whence = SEEK_SET;
-        offset = ((STDIO_FILE*)stream)->offs + offset;
+        offset = f->offs + offset;
     }
-    off64_t res = lseek64 (((STDIO_FILE *)stream)->stream, offset, whence);
-    if (res == -1) {
+    else if (whence == SEEK_END) {
+        int64_t size = stdio_getlength (stream);
+        if (size < 0) {
+            return -1;
+        }
+        offset = size + offset;
+    }
+    if (offset < 0) {
         return -1;
     }
-//    printf ("lseek res: %lld (%lld, %d, prev=%lld)\n", res, offset, whence,  ((STDIO_FILE*)stream)->offs);
-    ((STDIO_FILE*)stream)->offs = res;
-#ifdef USE_BUFFERING
-    ((STDIO_FILE*)stream)->bufremaining = 0;
-#endif
+    f->offs = offset;
+    release_region_at_offs (f);
 #endif
     return 0;
 }
@@ -215,10 +335,10 @@ stdio_getlength (DB_FILE *stream) {
 #else
     if (!f->have_size) {
         int64_t size = lseek64 (f->stream, 0, SEEK_END);
-        lseek64 (f->stream, f->offs, SEEK_SET);
-#ifdef USE_BUFFERING
-        f->bufremaining = 0;
-#endif
+        f->pos = size;
+        if (size < 0) {
+            return -1;
+        }
         f->have_size = 1;
         f->size = size;
     }
@@ -226,6 +346,64 @@ stdio_getlength (DB_FILE *stream) {
 #endif
 }
 
+// Returns the file data directly from the mapping, or reads it into the region buffer.
+// In mmap mode, the region is mapped separately when the whole file is not mapped.
+// The previous region is released, since it's only valid until the next call.
+// The read position is not changed.
+static const uint8_t *
+stdio_get_region (DB_FILE *stream, int64_t offset, int64_t size) {
+    assert (stream);
+#ifdef USE_STDIO
+    return NULL;
+#else
+    STDIO_FILE *f = (STDIO_FILE *)stream;
+    int64_t length = stdio_getlength (stream);
+    if (offset < 0 || size <= 0 || length < 0 || offset + size > length || (uint64_t)size > SIZE_MAX) {
+        return NULL;
+    }
+    if (f->map) {
+        return f->map + offset;
+    }
+
+    release_region (f);
+
+#ifdef USE_BUFFERING
+    // already buffered
+    if (offset >= f->bufoffs && offset + size <= f->bufoffs + f->buffill) {
+        return f->buffer + (offset - f->bufoffs);
+    }
+#endif
+
+    if (conf_use_mmap && size >= BUFSIZE && size <= MMAP_MAX_SIZE) {
+        int64_t map_offset = offset - offset % MMAP_ALIGN;
+        size_t map_size = (size_t)(offset + size - map_offset);
+        void *map = mmap (NULL, map_size, PROT_READ, MAP_SHARED, f->stream, map_offset);
+        if (map != MAP_FAILED) {
+            f->region_map = map;
+            f->region_map_size = map_size;
+            f->region_offset = offset;
+            f->region_end = offset + size;
+            return (const uint8_t *)map + (offset - map_offset);
+        }
+    }
+
+    if ((size_t)size > f->region_size) {
+        uint8_t *region = realloc (f->region, (size_t)size);
+        if (!region) {
+            return NULL;
+        }
+        f->region = region;
+        f->region_size = (size_t)size;
+    }
+    if (read_at (f, offset, f->region, (size_t)size) != size) {
+        return NULL;
+    }
+    f->region_offset = offset;
+    f->region_end = offset + size;
+    return f->region;
+#endif
+}
+
 const char *
 stdio_get_content_type (DB_FILE *stream) {
     return NULL;
@@ -236,11 +414,25 @@ stdio_is_streaming (void) {
     return 0;
 }
 
+static int
+stdio_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    if (id == DB_EV_CONFIGCHANGED) {
+        conf_use_mmap = deadbeef->conf_get_int ("vfs.stdio.mmap", 0);
+    }
+    return 0;
+}
+
+static int
+stdio_start (void) {
+    conf_use_mmap = deadbeef->conf_get_int ("vfs.stdio.mmap", 0);
+    return 0;
+}
+
 // standard stdio vfs
 static DB_vfs_t plugin = {
     DB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
-    .plugin.version_minor = 0,
+    .plugin.version_minor = 1,
     .plugin.type = DB_PLUGIN_VFS,
     .plugin.name = "stdio vfs",
     .plugin.id = "vfs_stdio",
@@ -269,6 +461,8 @@ static DB_vfs_t plugin = {
         "Oleksiy Yakovenko waker@users.sourceforge.net\n"
     ,
     .plugin.website = "http://deadbeef.sf.net",
+    .plugin.start = stdio_start,
+    .plugin.message = stdio_message,
     .open = stdio_open,
     .close = stdio_close,
     .read = stdio_read,
@@ -277,7 +471,8 @@ static DB_vfs_t plugin = {
     .rewind = stdio_rewind,
     .getlength = stdio_getlength,
     .get_content_type = stdio_get_content_type,
-    .is_streaming = stdio_is_streaming
+    .is_streaming = stdio_is_streaming,
+    .get_region = stdio_get_region,
 };
 
 DB_plugin_t *